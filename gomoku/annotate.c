@@ -0,0 +1,178 @@
+/**
+ * @file annotate.c
+ * @author Jason Wang
+ * This is the main program to annotate archived gomoku/renju games with engine evaluations.
+ * Every move of every game of a directory is scored against the engine's best move, spread over a work-stealing pool,
+ * and the annotations of a game are written to a sidecar file next to it (annotation.c).
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "error-codes.h"
+#include "board.h"
+#include "game.h"
+#include "annotation.h"
+#include "io.h"
+#include "pool.h"
+#include "search.h"
+
+#define DEFAULT_DEPTH 4
+#define DEFAULT_BLUNDER 3000
+#define DEFAULT_CACHE_MB 16
+#define TABLE_BYTES (16u << 20)
+
+typedef struct {
+    char* path;
+    game* g;
+    annotation* annotations;
+} archive;
+
+typedef struct {
+    annotation_cache* positions;
+    search** searches;
+    int depth;
+    int blunder;
+} batch;
+
+typedef struct {
+    batch* b;
+    archive* a;
+    size_t ply;
+} job;
+
+/**
+ * Prints the usage of the program and exits
+*/
+static void usage(void) {
+    printf("usage: ./annotate [-j <threads>] [-d <depth>] [-b <blunder-threshold>] [-m <cache-MB>] [-p <persistent-cache>] <directory>\n"
+           "       writes the annotations of every <game>.gmk to <game>.gmk" ANNOTATION_EXTENSION "\n");
+    exit(ARGUMENT_ERR);
+}
+
+/**
+ * Scores one move of an archived game: the best move of the position before it, and the score of the move played
+ * @param arg the job
+ * @param worker the index of the worker
+*/
+static void annotateMove(void* arg, int worker) {
+    job* j = (job *) arg;
+    batch* b = j->b;
+    annotation_score(b->positions, b->searches[worker], j->a->g, j->ply, b->depth, &j->a->annotations[j->ply]);
+    free(j);
+}
+
+/**
+ * This is the main function of the annotator
+ * @param argc the number of command line args
+ * @param argv an array of command-line argument strings
+*/
+int main(int argc, char *argv[]) {
+    int opt;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    long cacheMegabytes = DEFAULT_CACHE_MB;
+    char* persistentPath = NULL;
+    batch b;
+    memset(&b, 0, sizeof(b));
+    b.depth = DEFAULT_DEPTH;
+    b.blunder = DEFAULT_BLUNDER;
+    while ((opt = getopt(argc, argv, "j:d:b:m:p:")) != -1) {
+        switch (opt) {
+            case 'j': threads = atol(optarg); break;
+            case 'd': b.depth = atoi(optarg); break;
+            case 'b': b.blunder = atoi(optarg); break;
+            case 'm': cacheMegabytes = atol(optarg); break;
+            case 'p': persistentPath = optarg; break;
+            default: usage();
+        }
+    }
+    if (optind != argc - 1 || threads < 1 || b.depth < 1 || b.depth > SEARCH_MAX_DEPTH || b.blunder < 1 || cacheMegabytes < 1) {
+        usage();
+    }
+    b.positions = annotation_cache_create((size_t) cacheMegabytes << 20);
+    b.searches = (search **) malloc(threads * sizeof(search *));
+    if (!b.positions || !b.searches) {
+        exit(NULL_POINTER_ERR);
+    }
+    pcache* persistent = NULL;
+    if (persistentPath) {
+        persistent = pcache_open(persistentPath);
+        if (!persistent) {
+            exit(FILE_INPUT_ERR);
+        }
+    }
+    for (long i = 0; i < threads; i++) {
+        b.searches[i] = search_create(TABLE_BYTES);
+        if (!b.searches[i]) {
+            exit(NULL_POINTER_ERR);
+        }
+        b.searches[i]->persistent = persistent;
+    }
+    size_t count = 0;
+    char** paths = game_list_dir(argv[optind], &count);
+    archive* archives = (archive *) calloc(count + 1, sizeof(archive));
+    pool* p = pool_create(threads);
+    if (!archives || !p) {
+        exit(NULL_POINTER_ERR);
+    }
+    double start = search_clock();
+    size_t moves = 0;
+    size_t skipped = 0;
+    for (size_t i = 0; i < count; i++) {
+        archives[i].path = paths[i];
+        int size = game_peek_size(paths[i]);
+        if (size != 15 && size != 17 && size != 19) {
+            // the search is for dense boards, the game stays without a game struct and gets no sidecar
+            skipped++;
+            continue;
+        }
+        archives[i].g = game_import(paths[i]);
+        archives[i].annotations = (annotation *) calloc(archives[i].g->moves_count + 1, sizeof(annotation));
+        for (size_t ply = 0; ply < archives[i].g->moves_count; ply++) {
+            job* j = (job *) malloc(sizeof(job));
+            if (!j) {
+                exit(NULL_POINTER_ERR);
+            }
+            j->b = &b;
+            j->a = &archives[i];
+            j->ply = ply;
+            // the moves of a game start on one worker, whose table they share, and spread by stealing
+            pool_submit(p, i, annotateMove, j);
+            moves++;
+        }
+    }
+    pool_wait(p);
+    double seconds = search_clock() - start;
+    size_t blunders = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!archives[i].g) {
+            printf("%s: large board, skipped\n", archives[i].path);
+            free(paths[i]);
+            continue;
+        }
+        size_t gameBlunders = annotation_write(archives[i].path, archives[i].g, archives[i].annotations, b.depth,
+                                               b.blunder);
+        printf("%s: %zu moves, %zu blunders\n", archives[i].path, archives[i].g->moves_count, gameBlunders);
+        blunders += gameBlunders;
+        game_delete(archives[i].g);
+        free(archives[i].annotations);
+        free(paths[i]);
+    }
+    printf("%zu games, %zu moves, %zu blunders in %.2f s with %ld threads (%.1f moves/s)\n", count - skipped, moves, blunders,
+           seconds, threads, seconds > 0 ? moves / seconds : 0.0);
+    printf("cache: %llu hits, %llu misses, %zu steals\n", (unsigned long long) b.positions->hits,
+           (unsigned long long) b.positions->misses, p->steals);
+    pool_delete(p);
+    for (long i = 0; i < threads; i++) {
+        search_delete(b.searches[i]);
+    }
+    free(b.searches);
+    if (persistent) {
+        pcache_close(persistent);
+    }
+    annotation_cache_delete(b.positions);
+    free(archives);
+    free(paths);
+    return 0;
+}
@@ -0,0 +1,246 @@
+/**
+ * @file annotation.c
+ * @author Jason Wang
+ * This program scores the moves of archived games against the engine's best move, with a cache of searched positions
+ * shared by threads, and writes the annotations of a game to a sidecar file next to it. ./annotate spreads the moves
+ * over a work-stealing pool, and the workers of ./farm annotate a whole game each.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include "annotation.h"
+#include "error-codes.h"
+#include "board.h"
+#include "io.h"
+#include "sym.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Creates a cache of searched positions, keyed by position hash so that transpositions, shared openings and their
+ * rotations and reflections are searched once
+ * @param bytes the largest memory of the entries
+ * @return the cache, or NULL if it cannot be allocated
+*/
+annotation_cache* annotation_cache_create(size_t bytes) {
+    annotation_cache* c = (annotation_cache *) calloc(1, sizeof(annotation_cache));
+    if (!c) {
+        return NULL;
+    }
+    c->entries_count = 1;
+    while (c->entries_count * 2 * sizeof(annotation_entry) <= bytes) {
+        c->entries_count *= 2;
+    }
+    c->entries = (annotation_entry *) calloc(c->entries_count, sizeof(annotation_entry));
+    if (!c->entries) {
+        free(c);
+        return NULL;
+    }
+    for (int i = 0; i < ANNOTATION_STRIPES; i++) {
+        pthread_mutex_init(&c->locks[i], NULL);
+    }
+    return c;
+}
+
+/**
+ * Deletes a cache of searched positions
+ * @param c the cache
+*/
+void annotation_cache_delete(annotation_cache* c) {
+    if (!c) {
+        exit(NULL_POINTER_ERR);
+    }
+    for (int i = 0; i < ANNOTATION_STRIPES; i++) {
+        pthread_mutex_destroy(&c->locks[i]);
+    }
+    free(c->entries);
+    free(c);
+}
+
+/**
+ * Looks a position up in the cache
+ * @param c the cache
+ * @param key the key of the position
+ * @param depth the smallest depth accepted
+ * @param r the cached result
+ * @return true if the position was searched at least that deep
+*/
+static bool cacheProbe(annotation_cache* c, uint64_t key, int depth, search_result* r) {
+    size_t i = key & (c->entries_count - 1);
+    pthread_mutex_t* lock = &c->locks[i % ANNOTATION_STRIPES];
+    pthread_mutex_lock(lock);
+    annotation_entry e = c->entries[i];
+    bool found = e.key == key && e.depth >= depth;
+    if (found) {
+        c->hits++;
+    } else {
+        c->misses++;
+    }
+    pthread_mutex_unlock(lock);
+    if (found) {
+        r->cell = e.cell;
+        r->score = e.score;
+        r->depth = e.depth;
+    }
+    return found;
+}
+
+/**
+ * Stores a searched position in the cache
+ * @param c the cache
+ * @param key the key of the position
+ * @param r the search result
+*/
+static void cacheStore(annotation_cache* c, uint64_t key, search_result* r) {
+    size_t i = key & (c->entries_count - 1);
+    pthread_mutex_t* lock = &c->locks[i % ANNOTATION_STRIPES];
+    annotation_entry e = {key, r->score, r->cell, (uint8_t) r->depth};
+    pthread_mutex_lock(lock);
+    c->entries[i] = e;
+    pthread_mutex_unlock(lock);
+}
+
+/**
+ * Finds the best move of a position, from the cache or by a fixed-depth search
+ * @param c the cache
+ * @param s the searcher of the thread
+ * @param g the position
+ * @param depth the depth of the search
+ * @return the best move and its score for the side to move
+*/
+static search_result evaluate(annotation_cache* c, search* s, game* g, int depth) {
+    search_result r;
+    memset(&r, 0, sizeof(r));
+    // symmetric positions share an entry, whose move is stored in the canonical orientation
+    int transform;
+    int size = g->board->size;
+    uint64_t key = search_canonical_key(g, &transform);
+    if (cacheProbe(c, key, depth, &r)) {
+        r.cell = sym_permutation(size, sym_invert(transform))[r.cell];
+        return r;
+    }
+    r = search_run(s, g, depth, SEARCH_FOREVER);
+    if (r.score > SEARCH_WIN_BOUND || r.score < -SEARCH_WIN_BOUND) {
+        // a forced result found early holds at any depth
+        r.depth = SEARCH_MAX_DEPTH;
+    }
+    search_result canonical = r;
+    if (r.depth > 0) {
+        canonical.cell = sym_permutation(size, transform)[r.cell];
+    }
+    cacheStore(c, key, &canonical);
+    return r;
+}
+
+/**
+ * Scores one move of an archived game: the best move of the position before it, and the score of the move played
+ * @param c the cache
+ * @param s the searcher of the thread
+ * @param source the archived game
+ * @param ply the index of the move
+ * @param depth the depth of the searches
+ * @param a the annotation of the move
+*/
+void annotation_score(annotation_cache* c, search* s, const game* source, size_t ply, int depth, annotation* a) {
+    game* g = game_create(source->board->size, source->type);
+    if (!g) {
+        exit(NULL_POINTER_ERR);
+    }
+    for (size_t i = 0; i < ply; i++) {
+        game_play(g, source->moves[i].cell);
+    }
+    search_result best = evaluate(c, s, g, depth);
+    a->best_cell = best.cell;
+    a->best_score = best.score;
+    move played = source->moves[ply];
+    if (played.cell == best.cell) {
+        a->score = best.score;
+    } else {
+        unsigned char mover = g->stone;
+        if (game_play(g, played.cell) != GAME_STATE_PLAYING) {
+            a->score = g->winner == mover ? SEARCH_WIN - 1 : (g->winner == EMPTY_INTERSECTION ? 0 : -(SEARCH_WIN - 1));
+        } else {
+            int reply = -evaluate(c, s, g, depth > 1 ? depth - 1 : 1).score;
+            // win and loss scores of the reply count one move less than from the position before
+            a->score = reply > SEARCH_WIN_BOUND ? reply - 1 : (reply < -SEARCH_WIN_BOUND ? reply + 1 : reply);
+        }
+    }
+    if (a->score > a->best_score) {
+        // the move played beats the engine's choice beyond its horizon
+        a->best_cell = played.cell;
+        a->best_score = a->score;
+    }
+    game_delete(g);
+}
+
+/**
+ * Writes the annotations of a game to its sidecar file, one line per move. If the file cannot be written, exit with
+ * FILE_OUTPUT_ERR.
+ * @param path the path of the game, to which the extension of the sidecar is added
+ * @param g the game
+ * @param annotations the annotations of its moves
+ * @param depth the depth of the searches
+ * @param blunder the smallest loss of a blunder
+ * @return the number of blunders
+*/
+size_t annotation_write(const char* path, const game* g, const annotation* annotations, int depth, int blunder) {
+    char* sidecar = (char *) malloc(strlen(path) + strlen(ANNOTATION_EXTENSION) + 1);
+    if (!sidecar) {
+        exit(NULL_POINTER_ERR);
+    }
+    sprintf(sidecar, "%s%s", path, ANNOTATION_EXTENSION);
+    FILE* fp = fopen(sidecar, "w");
+    if (!fp) {
+        exit(FILE_OUTPUT_ERR);
+    }
+    fprintf(fp, "# depth %d, blunder threshold %d, scores for the side to move\n", depth, blunder);
+    size_t blunders = 0;
+    for (size_t i = 0; i < g->moves_count; i++) {
+        const annotation* an = &annotations[i];
+        move m = g->moves[i];
+        char coord[BOARD_COORD_LEN];
+        char bestCoord[BOARD_COORD_LEN];
+        char score[SEARCH_SCORE_LEN];
+        char bestScore[SEARCH_SCORE_LEN];
+        board_formal_coord(g->board, m.cell, coord);
+        board_formal_coord(g->board, an->best_cell, bestCoord);
+        search_format_score(an->score, score);
+        search_format_score(an->best_score, bestScore);
+        bool isBlunder = (long) an->best_score - an->score >= blunder;
+        blunders += isBlunder;
+        fprintf(fp, "%zu %s %s %s best %s %s%s\n", i + 1, m.stone == BLACK_STONE ? "black" : "white", coord, score,
+                bestCoord, bestScore, isBlunder ? " blunder" : "");
+    }
+    fclose(fp);
+    free(sidecar);
+    return blunders;
+}
+
+/**
+ * Annotates every move of a saved game in turn, writes its sidecar and describes the outcome in the line that
+ * ./annotate prints for it. Games that are not on a 15, 17 or 19 board are skipped.
+ * @param c the cache
+ * @param s the searcher of the thread
+ * @param path the path of the game
+ * @param depth the depth of the searches
+ * @param blunder the smallest loss of a blunder
+ * @param report the report to fill, ANNOTATION_REPORT_LEN bytes
+*/
+void annotation_file(annotation_cache* c, search* s, const char* path, int depth, int blunder, char* report) {
+    int size = game_peek_size(path);
+    if (size != 15 && size != 17 && size != 19) {
+        snprintf(report, ANNOTATION_REPORT_LEN, "%s: large board, skipped", path);
+        return;
+    }
+    game* g = game_import(path);
+    annotation* annotations = (annotation *) calloc(g->moves_count + 1, sizeof(annotation));
+    if (!annotations) {
+        exit(NULL_POINTER_ERR);
+    }
+    for (size_t ply = 0; ply < g->moves_count; ply++) {
+        annotation_score(c, s, g, ply, depth, &annotations[ply]);
+    }
+    size_t blunders = annotation_write(path, g, annotations, depth, blunder);
+    snprintf(report, ANNOTATION_REPORT_LEN, "%s: %zu moves, %zu blunders", path, g->moves_count, blunders);
+    free(annotations);
+    game_delete(g);
+}
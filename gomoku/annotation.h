@@ -0,0 +1,47 @@
+#ifndef _ANNOTATION_H_
+#define _ANNOTATION_H_
+#include "game.h"
+#include "search.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+/** number of locks guarding the position cache */
+#define ANNOTATION_STRIPES 64
+/** extension of the annotation files */
+#define ANNOTATION_EXTENSION ".ann"
+/** buffer length of the report of an annotated game */
+#define ANNOTATION_REPORT_LEN 1024
+
+typedef struct {
+    uint64_t key;
+    int32_t score;
+    uint16_t cell;
+    uint8_t depth;
+} annotation_entry;
+
+typedef struct {
+    annotation_entry* entries;
+    size_t entries_count;
+    uint64_t hits;
+    uint64_t misses;
+    pthread_mutex_t locks[ANNOTATION_STRIPES];
+} annotation_cache;
+
+typedef struct {
+    int score;
+    int best_score;
+    uint16_t best_cell;
+} annotation;
+
+/** function to create a cache of searched positions shared by the annotating threads */
+annotation_cache* annotation_cache_create(size_t bytes);
+/** function to delete a cache of searched positions */
+void annotation_cache_delete(annotation_cache* c);
+/** function to score one move of a game against the best move of the position before it */
+void annotation_score(annotation_cache* c, search* s, const game* source, size_t ply, int depth, annotation* a);
+/** function to write the annotations of a game next to its file */
+size_t annotation_write(const char* path, const game* g, const annotation* annotations, int depth, int blunder);
+/** function to annotate every move of a saved game and describe the outcome in a report line */
+void annotation_file(annotation_cache* c, search* s, const char* path, int depth, int blunder, char* report);
+#endif
@@ -0,0 +1,498 @@
+/**
+ * @file bench.c
+ * @author Jason Wang
+ * This is the main program to benchmark the board structures. It builds random midgame positions for each board size
+ * and times the threat heatmap of each instruction set against a naive loop over the neighbours of every intersection.
+ * The candidate bitmap of the board is timed against a scan of every intersection and against the neighbourhoods of the moves.
+ * The cost of publishing each move to the spectator feed is timed against the move itself. Given a journal file, it
+ * also measures how many moves per second reach the disk as more games share the journal.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "error-codes.h"
+#include "board.h"
+#include "game.h"
+#include "heatmap.h"
+#include "journal.h"
+#include "feed.h"
+#include "search.h"
+
+#define DEFAULT_POSITIONS 64
+#define DEFAULT_REPETITIONS 50
+/** number of moves of a benchmark position */
+#define MIDGAME_PLIES 40
+#define MAX_CELLS 361
+/** number of instruction sets of the heatmap */
+#define HEATMAP_ISAS 3
+/** number of timings of each method, of which the fastest is reported */
+#define TRIALS 5
+/** name of the scratch spectator feed */
+#define FEED_BENCH "/gomoku-bench"
+/** largest number of games sharing the journal */
+#define JOURNAL_GAMES 16
+/** number of times each game replays its moves into the journal */
+#define JOURNAL_ROUNDS 4
+
+typedef struct {
+    game** positions;
+    int count;
+    int repetitions;
+} workload;
+
+typedef struct {
+    journal* j;
+    const game* position;
+} journal_worker;
+
+/**
+ * Prints the usage of the program and exits
+*/
+static void usage(void) {
+    printf("usage: ./bench [-n <positions>] [-r <repetitions>] [-j <journal>]\n"
+           "       -j measures the journal with a scratch file, which it removes\n");
+    exit(ARGUMENT_ERR);
+}
+
+/**
+ * Lists the empty intersections within BOARD_NEAR_DISTANCE of the stones of a move list, in the order the
+ * neighbourhoods of the moves are scanned, the way the move generators did before the candidate bitmap
+ * @param g the game
+ * @param cells the grid indexes of the intersections
+ * @return the number of intersections
+*/
+static size_t nearCells(const game* g, uint16_t* cells) {
+    int size = g->board->size;
+    bool near[MAX_CELLS] = {false};
+    size_t found = 0;
+    for (size_t i = 0; i < g->moves_count; i++) {
+        int col = g->moves[i].cell % size;
+        int row = g->moves[i].cell / size;
+        int top = row + BOARD_NEAR_DISTANCE < size - 1 ? row + BOARD_NEAR_DISTANCE : size - 1;
+        int left = col > BOARD_NEAR_DISTANCE ? col - BOARD_NEAR_DISTANCE : 0;
+        int right = col + BOARD_NEAR_DISTANCE < size - 1 ? col + BOARD_NEAR_DISTANCE : size - 1;
+        for (int r = row > BOARD_NEAR_DISTANCE ? row - BOARD_NEAR_DISTANCE : 0; r <= top; r++) {
+            for (int cell = r * size + left; cell <= r * size + right; cell++) {
+                if (!near[cell] && g->board->grid[cell] == EMPTY_INTERSECTION) {
+                    near[cell] = true;
+                    cells[found++] = cell;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+/**
+ * Plays random moves near the stones until a game has a number of moves, starting over whenever it ends
+ * @param size the size of the board
+ * @param plies the number of moves
+ * @param seed the state of the random generator
+ * @return the position
+*/
+static game* randomPosition(int size, int plies, unsigned int* seed) {
+    game* g = game_create(size, GAME_FREESTYLE);
+    while (g->moves_count < (size_t) plies) {
+        if (g->moves_count == 0) {
+            game_play(g, size / 2 * size + size / 2);
+            continue;
+        }
+        uint16_t cells[MAX_CELLS];
+        size_t count = nearCells(g, cells);
+        int cell = cells[rand_r(seed) % count];
+        if (game_play(g, cell) != GAME_STATE_PLAYING) {
+            game_delete(g);
+            g = game_create(size, GAME_FREESTYLE);
+        }
+    }
+    return g;
+}
+
+/**
+ * Computes the heatmap of a board one intersection and one neighbour at a time, checking the edges of the board
+ * the way countLine walks a line
+ * @param b the board
+ * @param stone the color of the side to move
+ * @param h the heatmap
+*/
+static void naiveHeatmap(board* b, unsigned char stone, heatmap* h) {
+    static const int dcol[4] = {1, 0, 1, 1};
+    static const int drow[4] = {0, 1, 1, -1};
+    unsigned char opponent = stone == BLACK_STONE ? WHITE_STONE : BLACK_STONE;
+    h->size = b->size;
+    h->width = b->size + 2 * HEATMAP_DISTANCE;
+    for (int row = 0; row < b->size; row++) {
+        for (int col = 0; col < b->size; col++) {
+            int own = 0;
+            int other = 0;
+            for (int d = 0; d < 4; d++) {
+                for (int k = -HEATMAP_DISTANCE; k <= HEATMAP_DISTANCE; k++) {
+                    int c = col + k * dcol[d];
+                    int r = row + k * drow[d];
+                    if (k != 0 && c >= 0 && c < b->size && r >= 0 && r < b->size) {
+                        own += b->grid[r * b->size + c] == stone;
+                        other += b->grid[r * b->size + c] == opponent;
+                    }
+                }
+            }
+            h->own[HEATMAP_INDEX(h, col, row)] = own;
+            h->opponent[HEATMAP_INDEX(h, col, row)] = other;
+        }
+    }
+}
+
+/**
+ * Times the heatmaps of the positions for both colors
+ * @param w the workload
+ * @param isa the instruction set, or -1 for the naive loop
+ * @param calls the number of heatmaps computed
+ * @return the time in seconds
+*/
+static double timeHeatmap(workload* w, int isa, size_t* calls) {
+    static heatmap h;
+    *calls = 0;
+    double start = search_clock();
+    for (int r = 0; r < w->repetitions; r++) {
+        for (int i = 0; i < w->count; i++) {
+            for (unsigned char stone = BLACK_STONE; stone <= WHITE_STONE; stone++) {
+                if (isa < 0) {
+                    naiveHeatmap(w->positions[i]->board, stone, &h);
+                } else {
+                    heatmap_compute_isa(w->positions[i]->board, stone, &h, isa);
+                }
+                (*calls)++;
+            }
+        }
+    }
+    return search_clock() - start;
+}
+
+/**
+ * Checks the heatmaps of an instruction set against the naive loop on every position
+ * @param w the workload
+ * @param isa the instruction set
+ * @return true if they match
+*/
+static bool checkHeatmap(workload* w, int isa) {
+    static heatmap expected;
+    static heatmap actual;
+    for (int i = 0; i < w->count; i++) {
+        board* b = w->positions[i]->board;
+        for (unsigned char stone = BLACK_STONE; stone <= WHITE_STONE; stone++) {
+            naiveHeatmap(b, stone, &expected);
+            heatmap_compute_isa(b, stone, &actual, isa);
+            for (int cell = 0; cell < b->size * b->size; cell++) {
+                int index = HEATMAP_INDEX(&actual, cell % b->size, cell / b->size);
+                if (expected.own[index] != actual.own[index] || expected.opponent[index] != actual.opponent[index]) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Prints the best time per heatmap of the naive loop and of each instruction set the machine runs
+ * @param w the workload
+ * @param size the size of the board
+*/
+static void benchHeatmap(workload* w, int size) {
+    double best[HEATMAP_ISAS + 1] = {0};
+    for (int trial = 0; trial < TRIALS; trial++) {
+        for (int isa = -1; isa < HEATMAP_ISAS; isa++) {
+            if (isa >= 0 && !heatmap_supports(isa)) {
+                continue;
+            }
+            size_t calls;
+            double seconds = timeHeatmap(w, isa, &calls) * 1e9 / calls;
+            best[isa + 1] = trial == 0 || seconds < best[isa + 1] ? seconds : best[isa + 1];
+        }
+    }
+    printf("%-5d %12.1f", size, best[0]);
+    double fastest = best[0];
+    for (int isa = 0; isa < HEATMAP_ISAS; isa++) {
+        if (!heatmap_supports(isa)) {
+            printf(" %12s", "-");
+            continue;
+        }
+        if (!checkHeatmap(w, isa)) {
+            printf(" %12s", "mismatch");
+            continue;
+        }
+        printf(" %12.1f", best[isa + 1]);
+        fastest = best[isa + 1] < fastest ? best[isa + 1] : fastest;
+    }
+    printf(" %7.2fx\n", best[0] / fastest);
+}
+
+/**
+ * Lists the candidate moves of a board by scanning the neighbourhood of every intersection
+ * @param b the board
+ * @param cells the output array
+ * @return the number of candidates
+*/
+static size_t scanCandidates(const board* b, uint16_t* cells) {
+    int size = b->size;
+    size_t count = 0;
+    for (int cell = 0; cell < size * size; cell++) {
+        if (b->grid[cell] != EMPTY_INTERSECTION) {
+            continue;
+        }
+        int col = cell % size;
+        int row = cell / size;
+        bool near = false;
+        for (int r = row - BOARD_NEAR_DISTANCE; r <= row + BOARD_NEAR_DISTANCE && !near; r++) {
+            for (int c = col - BOARD_NEAR_DISTANCE; c <= col + BOARD_NEAR_DISTANCE && !near; c++) {
+                near = r >= 0 && r < size && c >= 0 && c < size && b->grid[r * size + c] != EMPTY_INTERSECTION;
+            }
+        }
+        if (near) {
+            cells[count++] = cell;
+        }
+    }
+    return count;
+}
+
+/**
+ * Times the candidate moves of the positions
+ * @param w the workload
+ * @param method 0 for the scan of every intersection, 1 for the neighbourhoods of the moves, 2 for the bitmap
+ * @param calls the number of lists made
+ * @return the time in seconds
+*/
+static double timeCandidates(workload* w, int method, size_t* calls) {
+    volatile size_t found = 0;
+    uint16_t cells[MAX_CELLS];
+    *calls = 0;
+    double start = search_clock();
+    for (int r = 0; r < w->repetitions; r++) {
+        for (int i = 0; i < w->count; i++) {
+            game* g = w->positions[i];
+            board* b = g->board;
+            if (method == 0) {
+                found += scanCandidates(b, cells);
+            } else if (method == 1) {
+                found += nearCells(g, cells);
+            } else {
+                found += board_candidates(b, cells);
+            }
+            (*calls)++;
+        }
+    }
+    return search_clock() - start;
+}
+
+/**
+ * Checks the candidate bitmap of every position against the scan, which lists the same intersections in the same order
+ * @param w the workload
+ * @return true if they match
+*/
+static bool checkCandidates(workload* w) {
+    uint16_t expected[MAX_CELLS];
+    uint16_t actual[MAX_CELLS];
+    for (int i = 0; i < w->count; i++) {
+        size_t count = scanCandidates(w->positions[i]->board, expected);
+        if (board_candidates(w->positions[i]->board, actual) != count
+            || memcmp(expected, actual, count * sizeof(uint16_t)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Prints the best time per candidate list of the scan, of the neighbourhoods of the moves and of the bitmap
+ * @param w the workload
+ * @param size the size of the board
+*/
+static void benchCandidates(workload* w, int size) {
+    double best[3] = {0};
+    for (int trial = 0; trial < TRIALS; trial++) {
+        for (int method = 0; method < 3; method++) {
+            size_t calls;
+            double seconds = timeCandidates(w, method, &calls) * 1e9 / calls;
+            best[method] = trial == 0 || seconds < best[method] ? seconds : best[method];
+        }
+    }
+    if (!checkCandidates(w)) {
+        printf("%-5d %12.1f %12.1f %12s\n", size, best[0], best[1], "mismatch");
+        return;
+    }
+    printf("%-5d %12.1f %12.1f %12.1f %7.2fx\n", size, best[0], best[1], best[2], best[1] / best[2]);
+}
+
+/**
+ * Replays the moves of the positions, stone by stone, into new games
+ * @param w the workload
+ * @param f the feed publishing the games, or NULL
+ * @param calls the number of moves
+ * @return the time in seconds
+*/
+static double timeFeed(workload* w, feed* f, size_t* calls) {
+    *calls = 0;
+    double start = search_clock();
+    for (int r = 0; r < w->repetitions; r++) {
+        for (int i = 0; i < w->count; i++) {
+            game* g = game_create(w->positions[i]->board->size, GAME_FREESTYLE);
+            if (f) {
+                feed_watch(f, g);
+            }
+            for (size_t m = 0; m < w->positions[i]->moves_count; m++) {
+                game_place_stone(g, w->positions[i]->moves[m].cell);
+            }
+            *calls += w->positions[i]->moves_count;
+            game_delete(g);
+        }
+    }
+    return search_clock() - start;
+}
+
+/**
+ * Prints the best time per placed stone without and with the spectator feed
+ * @param w the workload
+ * @param size the size of the board
+*/
+static void benchFeed(workload* w, int size) {
+    feed* f = feed_open(FEED_BENCH);
+    if (!f) {
+        printf("%-5d %12s\n", size, "no shared memory");
+        return;
+    }
+    double alone = 0;
+    double published = 0;
+    for (int trial = 0; trial < TRIALS; trial++) {
+        size_t calls;
+        double seconds = timeFeed(w, NULL, &calls) * 1e9 / calls;
+        alone = trial == 0 || seconds < alone ? seconds : alone;
+        seconds = timeFeed(w, f, &calls) * 1e9 / calls;
+        published = trial == 0 || seconds < published ? seconds : published;
+    }
+    printf("%-5d %12.1f %12.1f %12.1f\n", size, alone, published, published - alone);
+    feed_close(f);
+}
+
+/**
+ * Replays the moves of a position into the journal as a new game, stone by stone, several times
+ * @param arg the journal worker
+ * @return NULL
+*/
+static void* journalGames(void* arg) {
+    journal_worker* worker = (journal_worker *) arg;
+    for (int round = 0; round < JOURNAL_ROUNDS; round++) {
+        game* g = game_create(worker->position->board->size, GAME_FREESTYLE);
+        journal_watch(worker->j, g);
+        for (size_t i = 0; i < worker->position->moves_count; i++) {
+            game_place_stone(g, worker->position->moves[i].cell);
+        }
+        game_delete(g);
+    }
+    return NULL;
+}
+
+/**
+ * Prints the moves per second made durable and the moves per commit as 1 to JOURNAL_GAMES games play at once, each
+ * in its own thread. A game alone waits for one sync per move; games that share the journal share the syncs.
+ * @param w the workload, whose positions are replayed
+ * @param path the path of the scratch journal
+*/
+static void benchJournal(workload* w, const char* path) {
+    printf("\n%-5s %12s %12s %12s\n", "games", "moves", "moves/s", "moves/sync");
+    for (int games = 1; games <= JOURNAL_GAMES; games *= 2) {
+        unlink(path);
+        journal* j = journal_open(path);
+        if (!j) {
+            exit(FILE_OUTPUT_ERR);
+        }
+        pthread_t threads[JOURNAL_GAMES];
+        journal_worker workers[JOURNAL_GAMES];
+        double start = search_clock();
+        for (int t = 0; t < games; t++) {
+            workers[t].j = j;
+            workers[t].position = w->positions[t % w->count];
+            pthread_create(&threads[t], NULL, journalGames, &workers[t]);
+        }
+        for (int t = 0; t < games; t++) {
+            pthread_join(threads[t], NULL);
+        }
+        double seconds = search_clock() - start;
+        printf("%-5d %12llu %12.0f %12.1f\n", games, (unsigned long long) j->durable, j->durable / seconds,
+               (double) j->durable / j->commits);
+        journal_close(j);
+    }
+    unlink(path);
+}
+
+/**
+ * This is the main function of the benchmark
+ * @param argc the number of command line args
+ * @param argv an array of command-line argument strings
+*/
+int main(int argc, char *argv[]) {
+    int opt;
+    workload w = {NULL, DEFAULT_POSITIONS, DEFAULT_REPETITIONS};
+    const char* journalPath = NULL;
+    while ((opt = getopt(argc, argv, "n:r:j:")) != -1) {
+        switch (opt) {
+            case 'n': w.count = atoi(optarg); break;
+            case 'r': w.repetitions = atoi(optarg); break;
+            case 'j': journalPath = optarg; break;
+            default: usage();
+        }
+    }
+    if (optind != argc || w.count < 1 || w.repetitions < 1) {
+        usage();
+    }
+    w.positions = (game **) malloc(w.count * sizeof(game *));
+    if (!w.positions) {
+        exit(NULL_POINTER_ERR);
+    }
+    printf("%-5s %12s %12s %12s %12s %8s\n", "size", "naive ns", "scalar ns", "sse2 ns", "avx2 ns", "speedup");
+    for (int size = 15; size <= 19; size += 2) {
+        unsigned int seed = size;
+        for (int i = 0; i < w.count; i++) {
+            w.positions[i] = randomPosition(size, MIDGAME_PLIES, &seed);
+        }
+        benchHeatmap(&w, size);
+        for (int i = 0; i < w.count; i++) {
+            game_delete(w.positions[i]);
+        }
+    }
+    printf("\n%-5s %12s %12s %12s %8s\n", "size", "scan ns", "near ns", "bitmap ns", "speedup");
+    for (int size = 15; size <= 19; size += 2) {
+        unsigned int seed = size;
+        for (int i = 0; i < w.count; i++) {
+            w.positions[i] = randomPosition(size, MIDGAME_PLIES, &seed);
+        }
+        benchCandidates(&w, size);
+        for (int i = 0; i < w.count; i++) {
+            game_delete(w.positions[i]);
+        }
+    }
+    printf("\n%-5s %12s %12s %12s\n", "size", "move ns", "+feed ns", "publish ns");
+    for (int size = 15; size <= 19; size += 2) {
+        unsigned int seed = size;
+        for (int i = 0; i < w.count; i++) {
+            w.positions[i] = randomPosition(size, MIDGAME_PLIES, &seed);
+        }
+        benchFeed(&w, size);
+        for (int i = 0; i < w.count; i++) {
+            game_delete(w.positions[i]);
+        }
+    }
+    if (journalPath) {
+        unsigned int seed = 0;
+        for (int i = 0; i < w.count; i++) {
+            w.positions[i] = randomPosition(19, MIDGAME_PLIES, &seed);
+        }
+        benchJournal(&w, journalPath);
+        for (int i = 0; i < w.count; i++) {
+            game_delete(w.positions[i]);
+        }
+    }
+    free(w.positions);
+    return 0;
+}
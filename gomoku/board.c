@@ -1,190 +1,525 @@
-/** 
- * @file board.c
- * @author Jason Wang
- * This program utilizes functions to manage board structs and control the board.
-*/
-#include "board.h"
-#include "error-codes.h"
-#include <stddef.h>
-#include <stdio.h>
-#include <stdlib.h>
-/**
- * This function creates a new dynamically allocated board struct, initializes board.size with the parameter size, 
- * initializes board.grid with a new dynamically allocated array, initializes all grid intersections with EMPTY_INTERSECTION, 
- * finally it returns the struct created.
- * If an invalid size is given, exit with the code BOARD_SIZE_ERR as defined in  error-codes.h
- * @param size the size of the board
- * @return board structure 
-*/
-board* board_create(unsigned char size) {
-    if (!(size == 15 || size == 17 || size == 19)) {
-        exit(BOARD_SIZE_ERR);
-    }
-    board *newBoard = (board *) malloc(sizeof(board));
-    if (!newBoard) {
-        return NULL;
-    }
-    newBoard->size = size;
-    newBoard->grid = (unsigned char *) malloc(size * size * sizeof(unsigned char));
-    if (!newBoard->grid) {
-        free(newBoard);
-        return NULL;
-    }
-    for (int i = 0; i < size * size; i++) {
-        newBoard->grid[i] = EMPTY_INTERSECTION;
-    }
-    return newBoard;
-}
-
-/**
- * This function frees the memory of a dynamically allocated board struct, it also frees the memory of its dynamically allocated grid field.
- * If the pointer b is NULL, exit with the code NULL_POINTER_ERR as defined in error-codes.h.
- * @param b the board to free space from
-*/
-void board_delete(board* b) {
-    if (!b) {
-        exit(NULL_POINTER_ERR);
-    }
-    free(b->grid);
-    free(b);
-}
-
-/**
- * This function prints a the board in the format specified
- * If in_place is true, it clears the terminal first
- * @param b the board to print
- * @param in_place clears terminal if true.
-*/
-void board_print(board* b, bool in_place) {
-    if (in_place) {
-        clear();
-    }
-    for (int i = b->size - 1; i >= 0; i--) {
-        for (int j = 0; j < b->size; j++) {
-            if (j == 0) {
-                printf("%2d ", i + 1);
-            }
-            if (j == b->size - 1) {
-                switch (b->grid[b->size * i + j]) {
-                    case EMPTY_INTERSECTION: printf("+"); break;
-                    case BLACK_STONE: printf("\u25CF"); break;
-                    case WHITE_STONE: printf("\u25CB"); break;
-                    default: break;
-                }
-                printf("\n");
-            } else {
-                switch (b->grid[b->size * i + j]) {
-                    case EMPTY_INTERSECTION: printf("+"); break;
-                    case BLACK_STONE: printf("\u25CF"); break;
-                    case WHITE_STONE: printf("\u25CB"); break;
-                    default: break;
-                }
-                printf("-");
-            }
-        }
-    }
-    printf("   ");
-    for (int j = 0; j < b->size; j++) {
-        if (j == b->size - 1) {
-            printf("%c\n", 'A' + j);
-        } else {
-            printf("%c ", 'A' + j);
-        }
-    }
-}
-
-/**
- * This function converts the horizontal coordinate x and vertical coordinate y for a  board.grid to a "letter + number" formal coordinate,
- * and stores the result in the buffer  formal_coord. Finally it returns SUCCESS.
- * If the x and y coordinates are invalid for board b,
- * return  COORDINATE_ERR instead. Return codes are defined in error-codes.h.
- * @param b the board
- * @param x the horizontal coordinate
- * @param y the vertical coordinate
- * @param formal_coord the buffer
- * @return unsigned char for the success.
-*/
-unsigned char board_formal_coord(board* b, unsigned char x, unsigned char y, char* formal_coord) {
-    if (x < 'A' || x > b->size - 1 + 'A' || y < 1 || y > b->size) {
-        return COORDINATE_ERR;
-    }
-    unsigned char letter = x;
-    unsigned char number = y;
-    sprintf(formal_coord, "%c%d", letter, number);
-
-    return SUCCESS;
-}
-
-/**
- * This function converts a "letter + number" formal coordinate string formal_coord to the horizontal and vertical coordinates for a board.grid, 
- * and stores the results in x and  y that are passed by reference. Finally it returns SUCCESS.
- * If formal_coord is invalid for board b
- * return FORMAL_COORDINATE_ERR instead. Return codes are defined in error-codes.h.
- * @param b the board
- * @param formal_coord the stored x/y coordinates
- * @param x the horizontal coordinate
- * @param y the vertical coordinate
- * @return return codes
-*/
-unsigned char board_coord(board* b, const char* formal_coord, unsigned char* x, unsigned char* y) {
-    unsigned char letter;
-    char numberStr[10];
-    if (sscanf(formal_coord, "%c%s", &letter, numberStr) != 2) {
-        return FORMAL_COORDINATE_ERR;
-    }
-    if (letter < 'A' || letter > 'A' + b->size - 1) {
-        return FORMAL_COORDINATE_ERR;
-    }
-    int number = atoi(numberStr);
-    if (number < 1 || number > b->size) {
-        return FORMAL_COORDINATE_ERR;
-    }
-    *x = letter;
-    *y = number;
-
-    return SUCCESS;
-}
-
-/**
- * This function returns the intersection occupation state stored in a board.grid at the given horizontal and vertical coordinate pair x and y.
- * @param b the board
- * @param x the horizontal coordinate
- * @param y the vertical coordinates
- * @return the item at the location.
-*/
-unsigned char board_get(board* b, unsigned char x, unsigned char y) {
-    int col = x - 'A';
-    int row = y - 1;
-    return b->grid[row * b->size + col];
-}
-
-/**
- * This function stores the intersection occupation state stone to a board.grid at the given horizontal and vertical coordinate pair x and y.
- * If stone is neither BLACK_STONE or WHITE_STONE, exit with the code  STONE_TYPE_ERR as defined in error-codes.h.
- * @param b the board
- * @param x the horizontal coordinates
- * @param y the vertical coordinates
- * @param stone the color of the stone
-*/
-void board_set(board* b, unsigned char x, unsigned char y, unsigned char stone) {
-    if (!(stone == BLACK_STONE || stone == WHITE_STONE)) {
-        exit(STONE_TYPE_ERR);
-    }
-    int col = x - 'A';
-    int row = y - 1;
-    b->grid[row * b->size + col] = stone;
-}
-
-/**
- * This function returns true if all intersections of a board.grid is occupied by a stone, otherwise it returns false.
- * @param b the board
- * @return true or false based on whether the board is full or not.
-*/
-bool board_is_full(board* b) {
-    for (int i = 0; i < b->size * b->size; i++) {
-        if (b->grid[i] == EMPTY_INTERSECTION) {
-            return false;
-        }
-    }
-    return true;
+/** 
+ * @file board.c
+ * @author Jason Wang
+ * This program utilizes functions to manage board structs and control the board.
+*/
+#include "board.h"
+#include "error-codes.h"
+#include "eval.h"
+#include "sym.h"
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef GOMOKU_DEBUG
+#include <assert.h>
+#endif
+
+/** largest number of intersections of a board, plus the sentinel intersection */
+#define MAX_CELLS (19 * 19 + 1)
+/** number of board sizes with neighbour tables */
+#define SIZES_COUNT 3
+
+static uint16_t neighbourTables[SIZES_COUNT][BOARD_DIRECTIONS][MAX_CELLS];
+static pthread_once_t neighboursOnce = PTHREAD_ONCE_INIT;
+/** the windows through each intersection of each board size, and their number */
+static uint16_t windowTables[SIZES_COUNT][MAX_CELLS][BOARD_CELL_WINDOWS];
+static unsigned char windowCounts[SIZES_COUNT][MAX_CELLS];
+static int windowTotals[SIZES_COUNT];
+static pthread_once_t windowsOnce = PTHREAD_ONCE_INIT;
+/**
+ * Scrambles a 64-bit value with the splitmix64 finalizer
+ * @param z the value
+ * @return the scrambled value
+*/
+static uint64_t mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/**
+ * This function returns the Zobrist key of a stone on the intersection with the grid index cell.
+ * Keys are derived from the index and the stone, so they need no table and are identical across processes.
+ * @param cell the grid index, row * size + column
+ * @param stone the color of the stone
+ * @return the key
+*/
+uint64_t board_zobrist(int cell, unsigned char stone) {
+    return mix64(0x9E3779B97F4A7C15ull * (uint64_t) (2 * cell + stone));
+}
+
+/**
+ * Adds or removes the Zobrist key of a stone in the hash of the board and in the hashes of its symmetric images
+ * @param b the board
+ * @param cell the grid index
+ * @param stone the color of the stone
+*/
+static void toggleStone(board* b, int cell, unsigned char stone) {
+    b->hash ^= board_zobrist(cell, stone);
+    for (int t = 0; t < BOARD_SYMMETRIES; t++) {
+        b->sym_hash[t] ^= board_zobrist(sym_permutation(b->size, t)[cell], stone);
+    }
+}
+
+/**
+ * Adds or removes a stone from the counts of the intersections within BOARD_NEAR_DISTANCE of it, and sets the bit of
+ * each of them in the candidate bitmap if it is empty with a stone nearby. The grid already holds the change.
+ * @param b the board
+ * @param cell the grid index of the stone
+ * @param delta 1 when the stone is placed, -1 when it is removed
+*/
+static void updateNear(board* b, int cell, int delta) {
+    int size = b->size;
+    int col = cell % size;
+    int row = cell / size;
+    int top = row + BOARD_NEAR_DISTANCE < size - 1 ? row + BOARD_NEAR_DISTANCE : size - 1;
+    int left = col > BOARD_NEAR_DISTANCE ? col - BOARD_NEAR_DISTANCE : 0;
+    int right = col + BOARD_NEAR_DISTANCE < size - 1 ? col + BOARD_NEAR_DISTANCE : size - 1;
+    for (int r = row > BOARD_NEAR_DISTANCE ? row - BOARD_NEAR_DISTANCE : 0; r <= top; r++) {
+        for (int c = left; c <= right; c++) {
+            int n = r * size + c;
+            b->near[n] += delta;
+            uint64_t bit = 1ULL << (n & 63);
+            uint64_t set = b->near[n] && b->grid[n] == EMPTY_INTERSECTION ? bit : 0;
+            b->candidates[n >> 6] = (b->candidates[n >> 6] & ~bit) | set;
+        }
+    }
+}
+
+/**
+ * Adds or removes a stone from the counts of the windows through its intersection. A window stays open for a color
+ * while it holds no stone of the other color, so the first stone of a color in a window closes it for the other one.
+ * @param b the board
+ * @param cell the grid index of the stone
+ * @param stone the color of the stone
+ * @param delta 1 when the stone is placed, -1 when it is removed
+*/
+static void updateWindows(board* b, int cell, unsigned char stone, int delta) {
+    int table = (b->size - 15) / 2;
+    int own = stone - 1;
+    int other = 2 - stone;
+    for (int i = 0; i < windowCounts[table][cell]; i++) {
+        unsigned char* stones = b->window_stones[windowTables[table][cell][i]];
+        if (delta > 0) {
+            b->open_windows[other] -= stones[own]++ == 0;
+        } else {
+            b->open_windows[other] += --stones[own] == 0;
+        }
+    }
+}
+
+/**
+ * Fills the window tables of the board sizes: every line of BOARD_WINDOW_LEN intersections along a row, a column or
+ * a diagonal is numbered, and listed in the tables of the intersections it goes through
+*/
+static void buildWindows(void) {
+    static const int DCOL[4] = {1, 0, 1, 1};
+    static const int DROW[4] = {0, 1, 1, -1};
+    for (int i = 0; i < SIZES_COUNT; i++) {
+        int size = 15 + 2 * i;
+        int window = 0;
+        for (int d = 0; d < 4; d++) {
+            for (int cell = 0; cell < size * size; cell++) {
+                int lastCol = cell % size + (BOARD_WINDOW_LEN - 1) * DCOL[d];
+                int lastRow = cell / size + (BOARD_WINDOW_LEN - 1) * DROW[d];
+                if (lastCol < 0 || lastCol >= size || lastRow < 0 || lastRow >= size) {
+                    continue;
+                }
+                for (int k = 0; k < BOARD_WINDOW_LEN; k++) {
+                    int member = cell + k * (DROW[d] * size + DCOL[d]);
+                    windowTables[i][member][windowCounts[i][member]++] = window;
+                }
+                window++;
+            }
+        }
+        windowTotals[i] = window;
+    }
+}
+
+/**
+ * Fills the neighbour tables of the board sizes: the neighbour of an intersection in a direction, or the sentinel
+ * intersection past the edge. The sentinel is its own neighbour, so a walk along a line can step any number of times
+ * without a bounds check and stops on the first intersection that does not hold the stones it follows.
+*/
+static void buildNeighbours(void) {
+    static const int DCOL[BOARD_DIRECTIONS] = {1, 0, 1, 1, -1, 0, -1, -1};
+    static const int DROW[BOARD_DIRECTIONS] = {0, 1, 1, -1, 0, -1, -1, 1};
+    for (int i = 0; i < SIZES_COUNT; i++) {
+        int size = 15 + 2 * i;
+        for (int d = 0; d < BOARD_DIRECTIONS; d++) {
+            for (int cell = 0; cell < size * size; cell++) {
+                int col = cell % size + DCOL[d];
+                int row = cell / size + DROW[d];
+                bool inside = col >= 0 && col < size && row >= 0 && row < size;
+                neighbourTables[i][d][cell] = inside ? row * size + col : size * size;
+            }
+            neighbourTables[i][d][size * size] = size * size;
+        }
+    }
+}
+
+/**
+ * This function creates a new dynamically allocated board struct, initializes board.size with the parameter size, 
+ * initializes board.grid with a new dynamically allocated array, initializes all grid intersections with EMPTY_INTERSECTION, 
+ * finally it returns the struct created.
+ * If an invalid size is given, exit with the code BOARD_SIZE_ERR as defined in  error-codes.h
+ * @param size the size of the board
+ * @return board structure 
+*/
+board* board_create(unsigned char size) {
+    if (!(size == 15 || size == 17 || size == 19)) {
+        exit(BOARD_SIZE_ERR);
+    }
+    board *newBoard = (board *) malloc(sizeof(board));
+    if (!newBoard) {
+        return NULL;
+    }
+    newBoard->size = size;
+    newBoard->hash = mix64(size);
+    for (int t = 0; t < BOARD_SYMMETRIES; t++) {
+        newBoard->sym_hash[t] = 0;
+    }
+    sym_init();
+    pthread_once(&neighboursOnce, buildNeighbours);
+    for (int d = 0; d < BOARD_DIRECTIONS; d++) {
+        newBoard->neighbours[d] = neighbourTables[(size - 15) / 2][d];
+    }
+    memset(newBoard->near, 0, sizeof(newBoard->near));
+    memset(newBoard->candidates, 0, sizeof(newBoard->candidates));
+    pthread_once(&windowsOnce, buildWindows);
+    memset(newBoard->window_stones, 0, sizeof(newBoard->window_stones));
+    newBoard->open_windows[0] = windowTotals[(size - 15) / 2];
+    newBoard->open_windows[1] = windowTotals[(size - 15) / 2];
+    newBoard->eval = NULL;
+    newBoard->grid = (unsigned char *) malloc((size * size + 1) * sizeof(unsigned char));
+    if (!newBoard->grid) {
+        free(newBoard);
+        return NULL;
+    }
+    for (int i = 0; i < size * size; i++) {
+        newBoard->grid[i] = EMPTY_INTERSECTION;
+    }
+    newBoard->grid[size * size] = BOARD_EDGE;
+    return newBoard;
+}
+
+/**
+ * This function frees the memory of a dynamically allocated board struct, it also frees the memory of its dynamically allocated grid field
+ * and of the evaluator attached to it.
+ * If the pointer b is NULL, exit with the code NULL_POINTER_ERR as defined in error-codes.h.
+ * @param b the board to free space from
+*/
+void board_delete(board* b) {
+    if (!b) {
+        exit(NULL_POINTER_ERR);
+    }
+    if (b->eval) {
+        eval_delete(b->eval);
+    }
+    free(b->grid);
+    free(b);
+}
+
+/**
+ * This function prints a the board in the format specified
+ * If in_place is true, it clears the terminal first
+ * @param b the board to print
+ * @param in_place clears terminal if true.
+*/
+void board_print(board* b, bool in_place) {
+    if (in_place) {
+        clear();
+    }
+    for (int i = b->size - 1; i >= 0; i--) {
+        for (int j = 0; j < b->size; j++) {
+            if (j == 0) {
+                printf("%2d ", i + 1);
+            }
+            if (j == b->size - 1) {
+                switch (b->grid[b->size * i + j]) {
+                    case EMPTY_INTERSECTION: printf("+"); break;
+                    case BLACK_STONE: printf("\u25CF"); break;
+                    case WHITE_STONE: printf("\u25CB"); break;
+                    default: break;
+                }
+                printf("\n");
+            } else {
+                switch (b->grid[b->size * i + j]) {
+                    case EMPTY_INTERSECTION: printf("+"); break;
+                    case BLACK_STONE: printf("\u25CF"); break;
+                    case WHITE_STONE: printf("\u25CB"); break;
+                    default: break;
+                }
+                printf("-");
+            }
+        }
+    }
+    printf("   ");
+    for (int j = 0; j < b->size; j++) {
+        if (j == b->size - 1) {
+            printf("%c\n", 'A' + j);
+        } else {
+            printf("%c ", 'A' + j);
+        }
+    }
+}
+
+/**
+ * This function converts a 0-based column and row to an extended "letters + number" formal coordinate,
+ * and stores the result in the buffer formal_coord. Columns are written in bijective base 26
+ * (A...Z, AA...AZ, BA...), so single letters are unchanged for boards up to 26 columns.
+ * If col or row is negative or larger than BOARD_COORD_MAX, return COORDINATE_ERR instead.
+ * @param col the 0-based column
+ * @param row the 0-based row
+ * @param formal_coord the buffer, at least BOARD_COORD_LEN bytes
+ * @return return codes
+*/
+unsigned char board_format_coord(int col, int row, char* formal_coord) {
+    if (col < 0 || col > BOARD_COORD_MAX || row < 0 || row > BOARD_COORD_MAX) {
+        return COORDINATE_ERR;
+    }
+    char letters[8];
+    int len = 0;
+    for (int n = col + 1; n > 0; n = (n - 1) / 26) {
+        letters[len++] = 'A' + (n - 1) % 26;
+    }
+    for (int i = 0; i < len; i++) {
+        formal_coord[i] = letters[len - 1 - i];
+    }
+    sprintf(formal_coord + len, "%d", row + 1);
+
+    return SUCCESS;
+}
+
+/**
+ * This function parses an extended "letters + number" formal coordinate into a 0-based column and row.
+ * The letters are read in bijective base 26 (A...Z, AA...AZ, BA...), the number is 1-based.
+ * If formal_coord is not a valid coordinate, or it is larger than BOARD_COORD_MAX, return FORMAL_COORDINATE_ERR instead.
+ * @param formal_coord the formal coordinate
+ * @param col the 0-based column
+ * @param row the 0-based row
+ * @return return codes
+*/
+unsigned char board_parse_coord(const char* formal_coord, int* col, int* row) {
+    int letters = 0;
+    int column = 0;
+    while (formal_coord[letters] >= 'A' && formal_coord[letters] <= 'Z') {
+        column = column * 26 + (formal_coord[letters] - 'A' + 1);
+        if (column - 1 > BOARD_COORD_MAX) {
+            return FORMAL_COORDINATE_ERR;
+        }
+        letters++;
+    }
+    char numberStr[10];
+    if (letters == 0 || sscanf(formal_coord + letters, "%9s", numberStr) != 1) {
+        return FORMAL_COORDINATE_ERR;
+    }
+    int number = atoi(numberStr);
+    if (number < 1 || number - 1 > BOARD_COORD_MAX) {
+        return FORMAL_COORDINATE_ERR;
+    }
+    *col = column - 1;
+    *row = number - 1;
+
+    return SUCCESS;
+}
+
+/**
+ * This function converts the grid index cell of a board.grid to a "letter + number" formal coordinate,
+ * and stores the result in the buffer  formal_coord. Finally it returns SUCCESS.
+ * If the grid index is invalid for board b,
+ * return  COORDINATE_ERR instead. Return codes are defined in error-codes.h.
+ * @param b the board
+ * @param cell the grid index, row * size + column
+ * @param formal_coord the buffer
+ * @return unsigned char for the success.
+*/
+unsigned char board_formal_coord(board* b, uint16_t cell, char* formal_coord) {
+    if (cell >= BOARD_OFF(b)) {
+        return COORDINATE_ERR;
+    }
+    return board_format_coord(BOARD_COL(b, cell), BOARD_ROW(b, cell), formal_coord);
+}
+
+/**
+ * This function converts a "letter + number" formal coordinate string formal_coord to the grid index of a board.grid,
+ * and stores the result in cell that is passed by reference. Finally it returns SUCCESS.
+ * If formal_coord is invalid for board b
+ * return FORMAL_COORDINATE_ERR instead. Return codes are defined in error-codes.h.
+ * @param b the board
+ * @param formal_coord the formal coordinate
+ * @param cell the grid index
+ * @return return codes
+*/
+unsigned char board_coord(board* b, const char* formal_coord, uint16_t* cell) {
+    int col, row;
+    if (board_parse_coord(formal_coord, &col, &row) != SUCCESS) {
+        return FORMAL_COORDINATE_ERR;
+    }
+    if (col >= b->size || row >= b->size) {
+        return FORMAL_COORDINATE_ERR;
+    }
+    *cell = BOARD_CELL(b, col, row);
+
+    return SUCCESS;
+}
+
+/**
+ * This function returns the intersection occupation state stored in a board.grid at the given grid index.
+ * The sentinel index BOARD_OFF(b) holds BOARD_EDGE.
+ * @param b the board
+ * @param cell the grid index
+ * @return the item at the location.
+*/
+unsigned char board_get(board* b, uint16_t cell) {
+    return b->grid[cell];
+}
+
+/**
+ * This function stores the intersection occupation state stone to a board.grid at the given grid index.
+ * If stone is neither BLACK_STONE or WHITE_STONE, exit with the code  STONE_TYPE_ERR as defined in error-codes.h.
+ * The Zobrist hashes of the board and of its symmetric images are updated, as are the candidate bitmap and the window counts, and if an evaluator
+ * is attached to the board, its shape counts are too.
+ * @param b the board
+ * @param cell the grid index
+ * @param stone the color of the stone
+*/
+void board_set(board* b, uint16_t cell, unsigned char stone) {
+    if (!(stone == BLACK_STONE || stone == WHITE_STONE)) {
+        exit(STONE_TYPE_ERR);
+    }
+    bool placed = b->grid[cell] == EMPTY_INTERSECTION;
+    if (!placed) {
+        toggleStone(b, cell, b->grid[cell]);
+        updateWindows(b, cell, b->grid[cell], -1);
+    }
+    toggleStone(b, cell, stone);
+    updateWindows(b, cell, stone, 1);
+    b->grid[cell] = stone;
+    if (placed) {
+        updateNear(b, cell, 1);
+    }
+    if (b->eval) {
+        eval_update(b->eval, cell);
+    }
+}
+
+/**
+ * This function clears the intersection at the given grid index, to take back a move.
+ * The Zobrist hashes of the board and of its symmetric images are updated, as are the candidate bitmap and the window counts, and if an evaluator
+ * is attached to the board, its shape counts are too.
+ * @param b the board
+ * @param cell the grid index
+*/
+void board_unset(board* b, uint16_t cell) {
+    if (b->grid[cell] == EMPTY_INTERSECTION) {
+        return;
+    }
+    toggleStone(b, cell, b->grid[cell]);
+    updateWindows(b, cell, b->grid[cell], -1);
+    b->grid[cell] = EMPTY_INTERSECTION;
+    updateNear(b, cell, -1);
+    if (b->eval) {
+        eval_update(b->eval, cell);
+    }
+}
+
+/**
+ * This function lists the candidate moves of a board, the empty intersections within BOARD_NEAR_DISTANCE of a stone, in
+ * ascending grid index. It reads the bitmap that board_set and board_unset keep up to date, one word and one set bit
+ * at a time, so its cost follows the number of candidates rather than the number of stones or intersections.
+ * With GOMOKU_DEBUG defined, the bitmap is checked against the grid.
+ * @param b the board
+ * @param cells the output array, with room for every intersection
+ * @return the number of candidates
+*/
+size_t board_candidates(const board* b, uint16_t* cells) {
+#ifdef GOMOKU_DEBUG
+    assert(board_check_candidates(b));
+#endif
+    size_t count = 0;
+    int words = (b->size * b->size + 63) / 64;
+    for (int w = 0; w < words; w++) {
+        for (uint64_t bits = b->candidates[w]; bits; bits &= bits - 1) {
+            cells[count++] = w * 64 + __builtin_ctzll(bits);
+        }
+    }
+    return count;
+}
+
+/**
+ * This function checks the counts and the candidate bitmap of a board against a from-scratch computation from its grid.
+ * @param b the board
+ * @return true if both are right
+*/
+bool board_check_candidates(const board* b) {
+    int size = b->size;
+    for (int cell = 0; cell < size * size; cell++) {
+        int col = cell % size;
+        int row = cell / size;
+        int count = 0;
+        for (int r = row - BOARD_NEAR_DISTANCE; r <= row + BOARD_NEAR_DISTANCE; r++) {
+            for (int c = col - BOARD_NEAR_DISTANCE; c <= col + BOARD_NEAR_DISTANCE; c++) {
+                count += r >= 0 && r < size && c >= 0 && c < size && b->grid[r * size + c] != EMPTY_INTERSECTION;
+            }
+        }
+        bool candidate = count > 0 && b->grid[cell] == EMPTY_INTERSECTION;
+        if (b->near[cell] != count || ((b->candidates[cell >> 6] >> (cell & 63)) & 1) != candidate) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * This function returns true if neither color can make five anymore: every window holds stones of both colors.
+ * It reads the counts of open windows that board_set and board_unset keep up to date, so it costs the same at every move.
+ * With GOMOKU_DEBUG defined, the window counts are checked against the grid.
+ * @param b the board
+ * @return true if the game can only be a draw
+*/
+bool board_is_dead(const board* b) {
+#ifdef GOMOKU_DEBUG
+    assert(board_check_windows(b));
+#endif
+    return b->open_windows[0] == 0 && b->open_windows[1] == 0;
+}
+
+/**
+ * This function checks the stone counts of the windows of a board and its counts of open windows against a from-scratch computation from its grid.
+ * @param b the board
+ * @return true if all of them are right
+*/
+bool board_check_windows(const board* b) {
+    int table = (b->size - 15) / 2;
+    unsigned char stones[BOARD_MAX_WINDOWS][2];
+    memset(stones, 0, sizeof(stones));
+    for (int cell = 0; cell < b->size * b->size; cell++) {
+        for (int i = 0; i < windowCounts[table][cell] && b->grid[cell] != EMPTY_INTERSECTION; i++) {
+            stones[windowTables[table][cell][i]][b->grid[cell] - 1]++;
+        }
+    }
+    int open[2] = {0, 0};
+    for (int window = 0; window < windowTotals[table]; window++) {
+        open[0] += stones[window][1] == 0;
+        open[1] += stones[window][0] == 0;
+    }
+    return memcmp(stones, b->window_stones, windowTotals[table] * sizeof(stones[0])) == 0
+           && open[0] == b->open_windows[0] && open[1] == b->open_windows[1];
+}
+
+/**
+ * This function returns true if all intersections of a board.grid is occupied by a stone, otherwise it returns false.
+ * @param b the board
+ * @return true or false based on whether the board is full or not.
+*/
+bool board_is_full(board* b) {
+    for (int i = 0; i < b->size * b->size; i++) {
+        if (b->grid[i] == EMPTY_INTERSECTION) {
+            return false;
+        }
+    }
+    return true;
 }
\ No newline at end of file
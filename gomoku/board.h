@@ -1,14 +1,59 @@
 #ifndef _BOARD_H_
 #define _BOARD_H_
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #define EMPTY_INTERSECTION 0
 #define BLACK_STONE 1
 #define WHITE_STONE 2
 #define clear() printf("\033[H\033[J")
+/** largest 0-based column or row accepted by the extended coordinate syntax */
+#define BOARD_COORD_MAX 32767
+/** buffer length that fits any extended coordinate */
+#define BOARD_COORD_LEN 12
+/** number of symmetries of the square board: rotations and reflections */
+#define BOARD_SYMMETRIES 8
+/** content of the sentinel intersection that stands for everything past the edges of the board */
+#define BOARD_EDGE 3
+/** number of directions of the neighbour tables: right, up, up-right and down-right, then their opposites */
+#define BOARD_DIRECTIONS 8
+/** largest number of intersections of a board */
+#define BOARD_MAX_CELLS (19 * 19)
+/** largest distance of a candidate move from the stones on the board */
+#define BOARD_NEAR_DISTANCE 2
+/** number of 64-bit words of the candidate bitmap */
+#define BOARD_CANDIDATE_WORDS ((BOARD_MAX_CELLS + 63) / 64)
+/** number of intersections of a window, the line of intersections a five fills */
+#define BOARD_WINDOW_LEN 5
+/** largest number of windows of a board: along the rows and columns, then along both diagonals */
+#define BOARD_MAX_WINDOWS (2 * 19 * (19 - BOARD_WINDOW_LEN + 1) + 2 * (19 - BOARD_WINDOW_LEN + 1) * (19 - BOARD_WINDOW_LEN + 1))
+/** largest number of windows through an intersection, BOARD_WINDOW_LEN in each of the 4 directions */
+#define BOARD_CELL_WINDOWS (4 * BOARD_WINDOW_LEN)
+/** Gets the grid index of an intersection from its 0-based column and row */
+#define BOARD_CELL(b, col, row) ((row) * (b)->size + (col))
+/** Gets the 0-based column and row of a grid index */
+#define BOARD_COL(b, cell) ((cell) % (b)->size)
+#define BOARD_ROW(b, cell) ((cell) / (b)->size)
+/** Gets the grid index of the sentinel intersection, right after the last one of the board */
+#define BOARD_OFF(b) ((b)->size * (b)->size)
+
+struct evaluator;
 
 typedef struct {
     unsigned char size;
     unsigned char* grid;
+    const uint16_t* neighbours[BOARD_DIRECTIONS];
+    uint64_t hash;
+    uint64_t sym_hash[BOARD_SYMMETRIES];
+    /** number of stones within BOARD_NEAR_DISTANCE of each intersection */
+    unsigned char near[BOARD_MAX_CELLS];
+    /** bit set for each empty intersection with a stone within BOARD_NEAR_DISTANCE */
+    uint64_t candidates[BOARD_CANDIDATE_WORDS];
+    /** number of black and of white stones in each window */
+    unsigned char window_stones[BOARD_MAX_WINDOWS][2];
+    /** number of windows without a white stone, where black can still make five, and without a black stone */
+    int open_windows[2];
+    struct evaluator* eval;
 } board;
 
 /** function to create a board */
@@ -18,13 +63,29 @@ void board_delete(board* b);
 /** function to print a board */
 void board_print(board* b, bool in_place);
 /** function to calculate coord a board */
-unsigned char board_formal_coord(board* b, unsigned char x, unsigned char y, char* formal_coord);
+unsigned char board_formal_coord(board* b, uint16_t cell, char* formal_coord);
 /** function to help calculate coord for board */
-unsigned char board_coord(board* b, const char* formal_coord, unsigned char* x, unsigned char* y);
+unsigned char board_coord(board* b, const char* formal_coord, uint16_t* cell);
+/** function to format an extended coordinate */
+unsigned char board_format_coord(int col, int row, char* formal_coord);
+/** function to parse an extended coordinate */
+unsigned char board_parse_coord(const char* formal_coord, int* col, int* row);
 /** function to get a board */
-unsigned char board_get(board* b, unsigned char x, unsigned char y);
+unsigned char board_get(board* b, uint16_t cell);
 /** function to set a piece a board */
-void board_set(board* b, unsigned char x, unsigned char y, unsigned char stone);
+void board_set(board* b, uint16_t cell, unsigned char stone);
+/** function to remove a piece from a board */
+void board_unset(board* b, uint16_t cell);
+/** function to get the Zobrist key of a stone on an intersection */
+uint64_t board_zobrist(int cell, unsigned char stone);
+/** function to list the candidate moves of a board */
+size_t board_candidates(const board* b, uint16_t* cells);
+/** function to check the candidate bitmap against the grid */
+bool board_check_candidates(const board* b);
+/** function to check if neither color can make five anymore */
+bool board_is_dead(const board* b);
+/** function to check the window counts against the grid */
+bool board_check_windows(const board* b);
 /** function to check if board is full */
 bool board_is_full(board* b);
 #endif
@@ -0,0 +1,227 @@
+/**
+ * @file book.c
+ * @author Jason Wang
+ * This program implements the opening book: a memory-mapped array of (position key, move, weighted results) sorted by
+ * key. Keys are folded over the symmetries of the board and spread uniformly, so an interpolation search finds a
+ * position in a few probes.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include "book.h"
+#include "search.h"
+#include "sym.h"
+#include "error-codes.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAGIC "GMKBOOK1"
+
+/**
+ * Maps an opening book file
+ * @param path the path of the book
+ * @return the book, or NULL if the file cannot be opened or is not a book
+*/
+book* book_open(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(book_header)) {
+        close(fd);
+        return NULL;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+    book_header* header = (book_header *) map;
+    book* b = (book *) malloc(sizeof(book));
+    if (!b || memcmp(header->magic, MAGIC, sizeof(header->magic)) != 0
+        || sizeof(book_header) + header->count * sizeof(book_entry) != (size_t) st.st_size) {
+        free(b);
+        munmap(map, st.st_size);
+        close(fd);
+        return NULL;
+    }
+    b->fd = fd;
+    b->header = header;
+    b->entries = (book_entry *) (header + 1);
+    b->mapped_bytes = st.st_size;
+    return b;
+}
+
+/**
+ * Unmaps an opening book
+ * @param b the book
+*/
+void book_close(book* b) {
+    if (!b) {
+        exit(NULL_POINTER_ERR);
+    }
+    munmap(b->header, b->mapped_bytes);
+    close(b->fd);
+    free(b);
+}
+
+/**
+ * Finds the first entry of a position key by interpolation search, alternating with bisection so that clustered keys
+ * cannot make it linear
+ * @param b the book
+ * @param key the position key
+ * @return the index of the first entry, or the number of entries if the position is not in the book
+*/
+size_t book_find(book* b, uint64_t key) {
+    const book_entry* e = b->entries;
+    size_t count = b->header->count;
+    if (count == 0 || key < e[0].key || key > e[count - 1].key) {
+        return count;
+    }
+    size_t lo = 0;
+    size_t hi = count - 1;
+    bool interpolate = true;
+    while (lo < hi && e[lo].key != key) {
+        // key <= e[hi].key, and e[lo].key < key unless a miss moved lo past the key, where only bisection is defined
+        bool spread = e[lo].key < key && e[lo].key < e[hi].key;
+        size_t pos = interpolate && spread
+                     ? lo + (size_t) ((double) (key - e[lo].key) / (double) (e[hi].key - e[lo].key) * (hi - lo))
+                     : lo + (hi - lo) / 2;
+        interpolate = !interpolate;
+        if (pos >= hi) {
+            pos = hi - 1;
+        }
+        if (e[pos].key < key) {
+            lo = pos + 1;
+        } else if (e[pos].key > key) {
+            hi = pos;
+        } else {
+            lo = pos;
+        }
+    }
+    if (e[lo].key != key) {
+        return count;
+    }
+    while (lo > 0 && e[lo - 1].key == key) {
+        lo--;
+    }
+    return lo;
+}
+
+/**
+ * Computes the expected result of a book move for the side to move, counting a draw as half a win
+ * @param m the book move
+ * @return the expectation between 0 and 1
+*/
+double book_expectation(const book_move* m) {
+    double total = m->wins + m->draws + m->losses;
+    return total > 0 ? (m->wins + m->draws / 2) / total : 0.5;
+}
+
+/**
+ * Lists the book moves of the current position, best expectation first
+ * @param b the book
+ * @param g the game
+ * @param moves the output array
+ * @param max the room of the output array
+ * @return the number of moves
+*/
+size_t book_probe(book* b, game* g, book_move* moves, size_t max) {
+    if (g->state != GAME_STATE_PLAYING) {
+        return 0;
+    }
+    int transform;
+    uint64_t key = search_canonical_key(g, &transform);
+    int size = g->board->size;
+    size_t count = 0;
+    for (size_t i = book_find(b, key); i < b->header->count && b->entries[i].key == key && count < max; i++) {
+        const book_entry* e = &b->entries[i];
+        if (e->cell >= size * size) {
+            continue;
+        }
+        int cell = sym_permutation(size, sym_invert(transform))[e->cell];
+        if (g->board->grid[cell] != EMPTY_INTERSECTION) {
+            continue;
+        }
+        book_move m = {(uint16_t) cell, e->wins, e->draws, e->losses};
+        size_t j = count++;
+        for (; j > 0 && book_expectation(&moves[j - 1]) < book_expectation(&m); j--) {
+            moves[j] = moves[j - 1];
+        }
+        moves[j] = m;
+    }
+    return count;
+}
+
+/**
+ * Chooses the move of the current position with the best expectation among those played in at least
+ * BOOK_MIN_WEIGHT weighted games
+ * @param b the book
+ * @param g the game
+ * @param cell the grid index of the move
+ * @return true if the book has such a move
+*/
+bool book_choose(book* b, game* g, uint16_t* cell) {
+    book_move moves[BOOK_MAX_MOVES];
+    size_t count = book_probe(b, g, moves, BOOK_MAX_MOVES);
+    for (size_t i = 0; i < count; i++) {
+        if (moves[i].wins + moves[i].draws + moves[i].losses >= BOOK_MIN_WEIGHT) {
+            *cell = moves[i].cell;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Compares two book entries by key and move for qsort
+ * @param a the first entry
+ * @param b the second entry
+ * @return the comparison
+*/
+static int compareEntries(const void* a, const void* b) {
+    const book_entry* ea = (const book_entry *) a;
+    const book_entry* eb = (const book_entry *) b;
+    if (ea->key != eb->key) {
+        return ea->key < eb->key ? -1 : 1;
+    }
+    return (int) ea->cell - (int) eb->cell;
+}
+
+/**
+ * Sorts book entries, merges the entries of the same position and move, and writes them to a book file
+ * @param path the path of the book
+ * @param entries the entries, sorted and merged in place
+ * @param count the number of entries
+ * @return the number of entries written
+*/
+size_t book_write(const char* path, book_entry* entries, size_t count) {
+    qsort(entries, count, sizeof(book_entry), compareEntries);
+    size_t merged = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (merged > 0 && entries[merged - 1].key == entries[i].key && entries[merged - 1].cell == entries[i].cell) {
+            entries[merged - 1].wins += entries[i].wins;
+            entries[merged - 1].draws += entries[i].draws;
+            entries[merged - 1].losses += entries[i].losses;
+        } else {
+            entries[merged++] = entries[i];
+        }
+    }
+    FILE* fp = fopen(path, "wb");
+    if (!fp) {
+        exit(FILE_OUTPUT_ERR);
+    }
+    book_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, sizeof(header.magic));
+    header.count = merged;
+    if (fwrite(&header, sizeof(header), 1, fp) != 1 || fwrite(entries, sizeof(book_entry), merged, fp) != merged) {
+        exit(FILE_OUTPUT_ERR);
+    }
+    fclose(fp);
+    return merged;
+}
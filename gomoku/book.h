@@ -0,0 +1,53 @@
+#ifndef _BOOK_H_
+#define _BOOK_H_
+#include "game.h"
+#include <stdbool.h>
+#include <stdint.h>
+/** smallest total weight of the games behind a move chosen from the book */
+#define BOOK_MIN_WEIGHT 3.0
+/** largest number of book moves of a position */
+#define BOOK_MAX_MOVES 32
+
+typedef struct {
+    uint64_t key;
+    uint16_t cell;
+    uint16_t reserved;
+    float wins;
+    float draws;
+    float losses;
+} book_entry;
+
+typedef struct {
+    char magic[8];
+    uint64_t count;
+} book_header;
+
+typedef struct {
+    int fd;
+    book_header* header;
+    book_entry* entries;
+    size_t mapped_bytes;
+} book;
+
+typedef struct {
+    uint16_t cell;
+    double wins;
+    double draws;
+    double losses;
+} book_move;
+
+/** function to map an opening book file */
+book* book_open(const char* path);
+/** function to unmap an opening book */
+void book_close(book* b);
+/** function to find the first entry of a position key */
+size_t book_find(book* b, uint64_t key);
+/** function to list the book moves of a position, best first */
+size_t book_probe(book* b, game* g, book_move* moves, size_t max);
+/** function to choose the best book move of a position */
+bool book_choose(book* b, game* g, uint16_t* cell);
+/** function to sort, merge and write book entries to a file */
+size_t book_write(const char* path, book_entry* entries, size_t count);
+/** function to compute the expected result of a book move for the side to move */
+double book_expectation(const book_move* m);
+#endif
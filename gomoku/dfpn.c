@@ -0,0 +1,585 @@
+/**
+ * @file dfpn.c
+ * @author Jason Wang
+ * This program implements a depth-first proof-number (df-pn) solver over the game struct.
+ * It proves or disproves that one color, the attacker, can force a win under the rules of the game,
+ * storing proof and disproof numbers in a fixed-size table so that memory stays bounded.
+*/
+#include "dfpn.h"
+#include "eval.h"
+#include "rules.h"
+#include "io.h"
+#include "error-codes.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** largest number of candidate moves of a position */
+#define MAX_MOVES 361
+/** number of proof tree nodes counted before giving up on the exact size */
+#define PROOF_BUDGET 10000000
+
+typedef struct {
+    dfpn_table* table;
+    game* game;
+    unsigned char attacker;
+    bool threats_only;
+    size_t nodes;
+    size_t max_nodes;
+    size_t proof_budget;
+    size_t line_budget;
+} solver;
+
+/**
+ * Adds two proof numbers, saturating at infinity
+ * @param a the first number
+ * @param b the second number
+ * @return the sum
+*/
+static uint32_t addNumbers(uint32_t a, uint32_t b) {
+    return a + b >= DFPN_INFINITY ? DFPN_INFINITY : a + b;
+}
+
+/**
+ * Computes the table key of the current position, which also depends on the side to move and the attacker
+ * @param s the solver
+ * @return the key
+*/
+static uint64_t positionKey(solver* s) {
+    uint64_t key = s->game->board->hash;
+    if (s->game->stone == WHITE_STONE) {
+        key ^= 0x5DEECE66DF00DF00ull;
+    }
+    if (s->attacker == WHITE_STONE) {
+        key ^= 0xA3B195354A39B70Dull;
+    }
+    return key;
+}
+
+/**
+ * Looks up the proof and disproof numbers of a position, unknown positions start at 1 and 1
+ * @param t the table
+ * @param key the position key
+ * @param pn the proof number
+ * @param dn the disproof number
+*/
+static void lookup(dfpn_table* t, uint64_t key, uint32_t* pn, uint32_t* dn) {
+    dfpn_entry* bucket = &t->entries[key & (t->entries_count - 2)];
+    for (int i = 0; i < 2; i++) {
+        if (bucket[i].key == key) {
+            *pn = bucket[i].pn;
+            *dn = bucket[i].dn;
+            return;
+        }
+    }
+    *pn = 1;
+    *dn = 1;
+}
+
+/**
+ * Stores the proof and disproof numbers of a position in its two-entry bucket, evicting the entry that cost less work
+ * @param t the table
+ * @param key the position key
+ * @param pn the proof number
+ * @param dn the disproof number
+ * @param work the number of nodes spent on the position
+*/
+static void store(dfpn_table* t, uint64_t key, uint32_t pn, uint32_t dn, size_t work) {
+    dfpn_entry* bucket = &t->entries[key & (t->entries_count - 2)];
+    dfpn_entry* victim = bucket[0].key == key || (bucket[1].key != key && bucket[0].work <= bucket[1].work) ? &bucket[0] : &bucket[1];
+    victim->key = key;
+    victim->pn = pn;
+    victim->dn = dn;
+    victim->work = work > UINT32_MAX ? UINT32_MAX : (uint32_t) work;
+}
+
+/**
+ * Checks if a color would win by playing on an empty intersection, and restores the game afterwards
+ * @param g the game
+ * @param cell the grid index
+ * @param stone the color to play
+ * @return true if the move wins
+*/
+static bool wouldWin(game* g, uint16_t cell, unsigned char stone) {
+    unsigned char toMove = g->stone;
+    g->stone = stone;
+    bool wins = game_play(g, cell) == GAME_STATE_FINISHED && g->winner == stone;
+    game_undo(g);
+    g->stone = toMove;
+    return wins;
+}
+
+/**
+ * Counts, over the four lines through an empty intersection, the most stones of a color that a shape made by a stone
+ * there could use: the stones within four intersections on both sides, up to the first opponent stone or the edge.
+ * With contiguous set, only the stones next to the intersection count. This is a cheap necessary condition: a five
+ * needs 4 contiguous stones, and a four or an open three needs 2 stones within reach.
+ * @param b the board
+ * @param cell the grid index
+ * @param stone the color
+ * @param contiguous true to stop at the first empty intersection
+ * @return the largest count over the four lines
+*/
+static int lineStones(board* b, uint16_t cell, unsigned char stone, bool contiguous) {
+    int most = 0;
+    for (int d = 0; d < 4; d++) {
+        int count = 0;
+        for (int side = d; side < BOARD_DIRECTIONS; side += 4) {
+            const uint16_t* step = b->neighbours[side];
+            uint16_t next = cell;
+            for (int i = 1; i <= 4; i++) {
+                next = step[next];
+                unsigned char value = b->grid[next];
+                if (value == stone) {
+                    count++;
+                } else if (value != EMPTY_INTERSECTION || contiguous) {
+                    break;
+                }
+            }
+        }
+        most = count > most ? count : most;
+    }
+    return most;
+}
+
+/**
+ * Checks if a stone of a color on an empty intersection would make a four or a five
+ * @param b the board
+ * @param m the intersection
+ * @param stone the color
+ * @param open_four set to true if the stone would make an open four
+ * @return true if the stone would make a four or a five
+*/
+static bool makesFour(board* b, const move* m, unsigned char stone, bool* open_four) {
+    *open_four = false;
+    if (lineStones(b, m->cell, stone, false) < 3) {
+        return false;
+    }
+    int delta[SHAPE_COUNT];
+    eval_placement(b, m->cell, stone, delta);
+    *open_four = delta[SHAPE_OPEN_FOUR] > 0;
+    return delta[SHAPE_FIVE] + delta[SHAPE_OPEN_FOUR] + delta[SHAPE_FOUR] > 0;
+}
+
+/**
+ * Restricts the defender's replies to an open three of the attacker to the moves that can matter: the intersections
+ * where the attacker would make a four, which include every intersection of the three's line that stops it, and the
+ * defender's own fours, which gain a tempo. Any other reply lets the attacker make an open four.
+ * Without an open three of the attacker the moves are left as they are.
+ * @param b the board
+ * @param moves the defender's moves, compacted in place
+ * @param count the number of moves
+ * @param attacker the color of the attacker
+ * @return the number of moves kept
+*/
+static size_t threatDefences(board* b, move* moves, size_t count, unsigned char attacker) {
+    unsigned char defender = attacker == BLACK_STONE ? WHITE_STONE : BLACK_STONE;
+    bool relevant[MAX_MOVES];
+    bool openThree = false;
+    for (size_t i = 0; i < count; i++) {
+        bool openFour;
+        relevant[i] = makesFour(b, &moves[i], attacker, &openFour);
+        openThree = openThree || openFour;
+        if (!relevant[i]) {
+            relevant[i] = makesFour(b, &moves[i], defender, &openFour);
+        }
+    }
+    if (!openThree) {
+        return count;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (relevant[i]) {
+            moves[kept++] = moves[i];
+        }
+    }
+    return kept;
+}
+
+/**
+ * Generates the moves worth searching in the current position: an immediate win if there is one,
+ * otherwise the blocks of the opponent's immediate wins if there are any, otherwise every intersection near a stone.
+ * In threats-only mode the attacker is further restricted to moves that make a four or an open three,
+ * and the defender's replies to an open three to the moves that stop it or make a four.
+ * Renju forbidden moves are left out, since they lose at once.
+ * @param s the solver
+ * @param moves the output array
+ * @return the number of moves
+*/
+static size_t generate(solver* s, move* moves) {
+    game* g = s->game;
+    board* b = g->board;
+    int size = b->size;
+    unsigned char opponent = g->stone == BLACK_STONE ? WHITE_STONE : BLACK_STONE;
+    if (g->moves_count == 0) {
+        move centre = {size / 2 * size + size / 2, g->stone};
+        moves[0] = centre;
+        return 1;
+    }
+    uint16_t near[MAX_MOVES];
+    size_t count = board_candidates(b, near);
+    for (size_t i = 0; i < count; i++) {
+        move candidate = {near[i], g->stone};
+        moves[i] = candidate;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (lineStones(b, moves[i].cell, g->stone, true) >= 4 && wouldWin(g, moves[i].cell, g->stone)) {
+            moves[0] = moves[i];
+            return 1;
+        }
+    }
+    size_t blocks = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (lineStones(b, moves[i].cell, opponent, true) >= 4 && wouldWin(g, moves[i].cell, opponent)) {
+            moves[blocks++] = moves[i];
+        }
+    }
+    if (blocks > 0) {
+        count = blocks;
+    } else if (s->threats_only && g->stone != s->attacker) {
+        count = threatDefences(b, moves, count, s->attacker);
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (s->threats_only && blocks == 0 && g->stone == s->attacker) {
+            if (lineStones(b, moves[i].cell, g->stone, false) < 2) {
+                continue;
+            }
+            int delta[SHAPE_COUNT];
+            eval_placement(b, moves[i].cell, g->stone, delta);
+            if (delta[SHAPE_OPEN_FOUR] + delta[SHAPE_FOUR] <= 0 && delta[SHAPE_OPEN_THREE] <= 0) {
+                continue;
+            }
+        }
+        if (g->stone == g->rules->forbidden_stone) {
+            bool forbidden = game_play(g, moves[i].cell) == GAME_STATE_FORBIDDEN;
+            game_undo(g);
+            if (forbidden) {
+                continue;
+            }
+        }
+        moves[kept++] = moves[i];
+    }
+    return kept;
+}
+
+/**
+ * Computes the proof and disproof numbers of the position after a move without playing it,
+ * unless the move ends the game, in which case the numbers are exact
+ * @param s the solver
+ * @param m the move
+ * @param pn the proof number
+ * @param dn the disproof number
+*/
+static void childNumbers(solver* s, const move* m, uint32_t* pn, uint32_t* dn) {
+    game* g = s->game;
+    unsigned char state = game_play(g, m->cell);
+    if (state != GAME_STATE_PLAYING) {
+        bool won = g->winner == s->attacker;
+        *pn = won ? 0 : DFPN_INFINITY;
+        *dn = won ? DFPN_INFINITY : 0;
+    } else {
+        lookup(s->table, positionKey(s), pn, dn);
+    }
+    game_undo(g);
+}
+
+/**
+ * Expands the current position until its proof number reaches thpn or its disproof number reaches thdn
+ * @param s the solver
+ * @param thpn the proof number threshold
+ * @param thdn the disproof number threshold
+*/
+static void mid(solver* s, uint32_t thpn, uint32_t thdn) {
+    game* g = s->game;
+    uint64_t key = positionKey(s);
+    size_t start = s->nodes++;
+    bool orNode = g->stone == s->attacker;
+    move moves[MAX_MOVES];
+    size_t count = generate(s, moves);
+    if (count == 0) {
+        store(s->table, key, orNode ? DFPN_INFINITY : 0, orNode ? 0 : DFPN_INFINITY, 1);
+        return;
+    }
+    uint32_t pn, dn;
+    while (true) {
+        size_t best = 0;
+        uint32_t bestValue = DFPN_INFINITY + 1, second = DFPN_INFINITY, bestPn = 0, bestDn = 0;
+        pn = orNode ? DFPN_INFINITY : 0;
+        dn = orNode ? 0 : DFPN_INFINITY;
+        for (size_t i = 0; i < count; i++) {
+            uint32_t cpn, cdn;
+            childNumbers(s, &moves[i], &cpn, &cdn);
+            uint32_t value = orNode ? cpn : cdn;
+            if (orNode) {
+                pn = cpn < pn ? cpn : pn;
+                dn = addNumbers(dn, cdn);
+            } else {
+                pn = addNumbers(pn, cpn);
+                dn = cdn < dn ? cdn : dn;
+            }
+            if (value < bestValue) {
+                second = bestValue;
+                bestValue = value;
+                best = i;
+                bestPn = cpn;
+                bestDn = cdn;
+            } else if (value < second) {
+                second = value;
+            }
+        }
+        if (pn >= thpn || dn >= thdn || s->nodes >= s->max_nodes) {
+            break;
+        }
+        uint32_t childPn, childDn;
+        if (orNode) {
+            childPn = thpn < second + 1 ? thpn : second + 1;
+            childDn = addNumbers(thdn - dn, bestDn);
+        } else {
+            childPn = addNumbers(thpn - pn, bestPn);
+            childDn = thdn < second + 1 ? thdn : second + 1;
+        }
+        game_play(g, moves[best].cell);
+        mid(s, childPn, childDn);
+        game_undo(g);
+    }
+    store(s->table, key, pn, dn, s->nodes - start);
+}
+
+/**
+ * Finds the moves of the current position whose positions are proven
+ * @param s the solver
+ * @param moves the output array
+ * @return the number of proven moves
+*/
+static size_t provenMoves(solver* s, move* moves) {
+    size_t count = generate(s, moves);
+    size_t proven = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t pn, dn;
+        childNumbers(s, &moves[i], &pn, &dn);
+        if (pn == 0) {
+            moves[proven++] = moves[i];
+        }
+    }
+    return proven;
+}
+
+/**
+ * Counts the nodes of the proof tree below the current position, which must be proven.
+ * Positions whose entries were evicted from the table count as leaves.
+ * @param s the solver
+ * @return the number of nodes
+*/
+static size_t proofSize(solver* s) {
+    game* g = s->game;
+    if (s->proof_budget == 0) {
+        return 1;
+    }
+    s->proof_budget--;
+    move moves[MAX_MOVES];
+    size_t count = generate(s, moves);
+    size_t size = 1;
+    if (g->stone == s->attacker) {
+        if (provenMoves(s, moves) == 0) {
+            return size;
+        }
+        count = 1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (game_play(g, moves[i].cell) == GAME_STATE_PLAYING) {
+            size += proofSize(s);
+        } else {
+            size++;
+        }
+        game_undo(g);
+    }
+    return size;
+}
+
+/**
+ * Follows the proof from the current position: the attacker plays a proven move, the defender the move
+ * with the largest proof tree. The moves are appended to the result, and taken back afterwards.
+ * @param s the solver
+ * @param result the result to fill
+*/
+static void provenLine(solver* s, dfpn_result* result) {
+    game* g = s->game;
+    size_t played = 0;
+    while (g->state == GAME_STATE_PLAYING && result->line_count < DFPN_MAX_LINE) {
+        move moves[MAX_MOVES];
+        size_t count = g->stone == s->attacker ? provenMoves(s, moves) : generate(s, moves);
+        if (count == 0) {
+            break;
+        }
+        size_t best = 0;
+        if (g->stone != s->attacker) {
+            size_t largest = 0;
+            for (size_t i = 0; i < count; i++) {
+                s->proof_budget = s->line_budget / count;
+                size_t size = game_play(g, moves[i].cell) == GAME_STATE_PLAYING ? proofSize(s) : 1;
+                game_undo(g);
+                if (size > largest) {
+                    largest = size;
+                    best = i;
+                }
+            }
+        }
+        result->line[result->line_count++] = moves[best];
+        game_play(g, moves[best].cell);
+        played++;
+    }
+    while (played-- > 0) {
+        game_undo(g);
+    }
+}
+
+/**
+ * Creates a solver table using at most the given number of bytes
+ * @param bytes the memory budget
+ * @return the table or NULL if malloc fails
+*/
+dfpn_table* dfpn_create(size_t bytes) {
+    dfpn_table* t = (dfpn_table *) malloc(sizeof(dfpn_table));
+    if (!t) {
+        return NULL;
+    }
+    t->entries_count = 2;
+    while (t->entries_count * 2 * sizeof(dfpn_entry) <= bytes) {
+        t->entries_count *= 2;
+    }
+    t->entries = (dfpn_entry *) calloc(t->entries_count, sizeof(dfpn_entry));
+    if (!t->entries) {
+        free(t);
+        return NULL;
+    }
+    return t;
+}
+
+/**
+ * Deletes a solver table
+ * @param t the table
+*/
+void dfpn_delete(dfpn_table* t) {
+    if (!t) {
+        exit(NULL_POINTER_ERR);
+    }
+    free(t->entries);
+    free(t);
+}
+
+/**
+ * Forgets every entry of a solver table
+ * @param t the table
+*/
+void dfpn_clear(dfpn_table* t) {
+    memset(t->entries, 0, t->entries_count * sizeof(dfpn_entry));
+}
+
+/**
+ * Tries to prove that the attacker wins the game from its current position, whichever side is to move.
+ * The search stops after max_nodes expansions with DFPN_UNKNOWN. When the attacker is proven to win, the result holds
+ * the size of the proof tree and the winning line. In threats-only mode the attacker only plays fours and open threes,
+ * so a disproof only means that no such win exists.
+ * @param t the table
+ * @param g the game, which is left unchanged
+ * @param attacker the color to prove a win for
+ * @param max_nodes the largest number of expansions
+ * @param threats_only true to restrict the attacker to threats
+ * @return the result
+*/
+dfpn_result dfpn_solve(dfpn_table* t, game* g, unsigned char attacker, size_t max_nodes, bool threats_only) {
+    return dfpn_solve_bounded(t, g, attacker, max_nodes, threats_only, PROOF_BUDGET);
+}
+
+/**
+ * Works like dfpn_solve, except that measuring the proof tree and choosing the defender's longest resistance along the
+ * winning line visit at most proof_budget nodes. With a budget of 0 the proof size is 1 and the defender's moves of the
+ * line are its first candidates, which is all a caller that only needs the result pays for.
+ * @param t the table
+ * @param g the game, which is left unchanged
+ * @param attacker the color to prove a win for
+ * @param max_nodes the largest number of expansions
+ * @param threats_only true to restrict the attacker to threats
+ * @param proof_budget the largest number of proof tree nodes visited
+ * @return the result
+*/
+dfpn_result dfpn_solve_bounded(dfpn_table* t, game* g, unsigned char attacker, size_t max_nodes, bool threats_only,
+                               size_t proof_budget) {
+    solver s = {t, g, attacker, threats_only, 0, max_nodes, proof_budget, proof_budget};
+    dfpn_result result;
+    memset(&result, 0, sizeof(result));
+    result.attacker = attacker;
+    if (g->state != GAME_STATE_PLAYING) {
+        result.result = g->winner == attacker ? DFPN_PROVEN : DFPN_DISPROVEN;
+        return result;
+    }
+    mid(&s, DFPN_INFINITY, DFPN_INFINITY);
+    uint32_t pn, dn;
+    lookup(t, positionKey(&s), &pn, &dn);
+    result.nodes = s.nodes;
+    if (pn == 0) {
+        result.result = DFPN_PROVEN;
+        result.proof_size = proofSize(&s);
+        provenLine(&s, &result);
+    } else if (dn == 0) {
+        result.result = DFPN_DISPROVEN;
+    }
+    return result;
+}
+
+/**
+ * Appends a line of moves to a report
+ * @param g the game the moves were played in
+ * @param line the moves
+ * @param count the number of moves
+ * @param report the report
+*/
+static void appendLine(game* g, const move* line, size_t count, char* report) {
+    for (size_t i = 0; i < count && strlen(report) + BOARD_COORD_LEN + 1 < DFPN_REPORT_LEN; i++) {
+        char formalCoord[BOARD_COORD_LEN];
+        board_formal_coord(g->board, line[i].cell, formalCoord);
+        strcat(report, " ");
+        strcat(report, formalCoord);
+    }
+}
+
+/**
+ * Solves a saved stopped game for the side to move and then for its opponent, and describes the outcome in the line
+ * that ./solve and ./farm print for it. Games that are not stopped or not on a 15, 17 or 19 board are skipped.
+ * @param t the solver table
+ * @param path the path of the game
+ * @param max_nodes the largest number of expanded nodes per color
+ * @param threats_only true to restrict the attacker to fours and open threes
+ * @param report the report to fill, DFPN_REPORT_LEN bytes
+*/
+void dfpn_adjudicate(dfpn_table* t, const char* path, size_t max_nodes, bool threats_only, char* report) {
+    int size = game_peek_size(path);
+    if (size != 15 && size != 17 && size != 19) {
+        snprintf(report, DFPN_REPORT_LEN, "%s: large board, skipped", path);
+        return;
+    }
+    game* g = game_import(path);
+    if (g->state != GAME_STATE_STOPPED) {
+        snprintf(report, DFPN_REPORT_LEN, "%s: not stopped, skipped", path);
+        game_delete(g);
+        return;
+    }
+    g->state = GAME_STATE_PLAYING;
+    unsigned char attackers[2] = {g->stone, g->stone == BLACK_STONE ? WHITE_STONE : BLACK_STONE};
+    size_t nodes = 0;
+    for (int i = 0; i < 2; i++) {
+        dfpn_clear(t);
+        dfpn_result r = dfpn_solve(t, g, attackers[i], max_nodes, threats_only);
+        nodes += r.nodes;
+        if (r.result == DFPN_PROVEN) {
+            snprintf(report, DFPN_REPORT_LEN, "%s: %s wins, proof tree %zu nodes, %zu nodes searched, line",
+                     path, attackers[i] == BLACK_STONE ? "black" : "white", r.proof_size, nodes);
+            appendLine(g, r.line, r.line_count, report);
+            game_delete(g);
+            return;
+        }
+    }
+    snprintf(report, DFPN_REPORT_LEN, "%s: unresolved, %zu nodes searched", path, nodes);
+    game_delete(g);
+}
@@ -0,0 +1,50 @@
+#ifndef _DFPN_H_
+#define _DFPN_H_
+#include "game.h"
+#include <stdbool.h>
+#include <stdint.h>
+#define DFPN_UNKNOWN 0
+#define DFPN_PROVEN 1
+#define DFPN_DISPROVEN 2
+/** proof and disproof number standing for infinity */
+#define DFPN_INFINITY 0x3FFFFFFFu
+/** longest winning line reported by the solver */
+#define DFPN_MAX_LINE 64
+/** buffer length of the report of an adjudicated game */
+#define DFPN_REPORT_LEN 1024
+
+typedef struct {
+    uint64_t key;
+    uint32_t pn;
+    uint32_t dn;
+    uint32_t work;
+} dfpn_entry;
+
+typedef struct {
+    dfpn_entry* entries;
+    size_t entries_count;
+} dfpn_table;
+
+typedef struct {
+    unsigned char result;
+    unsigned char attacker;
+    size_t nodes;
+    size_t proof_size;
+    move line[DFPN_MAX_LINE];
+    size_t line_count;
+} dfpn_result;
+
+/** function to create a solver table within a memory budget */
+dfpn_table* dfpn_create(size_t bytes);
+/** function to delete a solver table */
+void dfpn_delete(dfpn_table* t);
+/** function to forget every entry of a solver table */
+void dfpn_clear(dfpn_table* t);
+/** function to prove or disprove that a color wins a game */
+dfpn_result dfpn_solve(dfpn_table* t, game* g, unsigned char attacker, size_t max_nodes, bool threats_only);
+/** function to prove or disprove that a color wins a game, bounding the work spent measuring the proof */
+dfpn_result dfpn_solve_bounded(dfpn_table* t, game* g, unsigned char attacker, size_t max_nodes, bool threats_only,
+                               size_t proof_budget);
+/** function to solve a saved stopped game for both colors and describe the outcome */
+void dfpn_adjudicate(dfpn_table* t, const char* path, size_t max_nodes, bool threats_only, char* report);
+#endif
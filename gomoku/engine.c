@@ -0,0 +1,112 @@
+/**
+ * @file engine.c
+ * @author Jason Wang
+ * This is the main program to let the engine think about a gomoku/renju position and report its move.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "error-codes.h"
+#include "board.h"
+#include "game.h"
+#include "io.h"
+#include "mcts.h"
+#include "book.h"
+#include "rules.h"
+
+#define DEFAULT_SIZE 15
+#define DEFAULT_SECONDS 1.0
+#define DEFAULT_NODES 4000000
+
+/**
+ * Prints the usage of the program and exits
+*/
+static void usage(void) {
+    printf("usage: ./engine [-j <threads>] [-s <seconds>] [-n <tree-nodes>] [-b <15|17|19>] [-R] [-k <book>] [<match.gmk>]\n"
+           "                [-v <freestyle|renju|standard|caro|swap2>]\n"
+           "       -v plays a rule variant on the empty board and -R is short for -v renju,\n"
+           "       -b, -R and -v conflict with a match file\n"
+           "       -k plays the book move of the position when there is one\n");
+    exit(ARGUMENT_ERR);
+}
+
+/**
+ * This is the main function of the engine
+ * @param argc the number of command line args
+ * @param argv an array of command-line argument strings
+*/
+int main(int argc, char *argv[]) {
+    int opt;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    double seconds = DEFAULT_SECONDS;
+    long nodes = DEFAULT_NODES;
+    int size = DEFAULT_SIZE;
+    unsigned char type = GAME_FREESTYLE;
+    char* bookPath = NULL;
+    while ((opt = getopt(argc, argv, "j:s:n:b:Rk:v:")) != -1) {
+        switch (opt) {
+            case 'j': threads = atol(optarg); break;
+            case 's': seconds = atof(optarg); break;
+            case 'n': nodes = atol(optarg); break;
+            case 'b': size = atoi(optarg); break;
+            case 'R': type = GAME_RENJU; break;
+            case 'v': type = rules_parse(optarg); break;
+            case 'k': bookPath = optarg; break;
+            default: usage();
+        }
+    }
+    if (optind < argc - 1 || threads < 1 || seconds <= 0 || nodes < 1 || type == GAME_VARIANTS) {
+        usage();
+    }
+    game* g = NULL;
+    if (optind == argc - 1) {
+        g = game_import(argv[optind]);
+        if (g->state == GAME_STATE_STOPPED) {
+            g->state = GAME_STATE_PLAYING;
+        }
+    } else {
+        g = game_create(size, type);
+    }
+    if (g->state != GAME_STATE_PLAYING) {
+        printf("The game is over.\n");
+        game_delete(g);
+        return 0;
+    }
+    if (bookPath) {
+        book* b = book_open(bookPath);
+        if (!b) {
+            exit(FILE_INPUT_ERR);
+        }
+        uint16_t cell;
+        bool found = book_choose(b, g, &cell);
+        book_close(b);
+        if (found) {
+            char formalCoord[BOARD_COORD_LEN];
+            board_formal_coord(g->board, cell, formalCoord);
+            printf("%s plays %s from the book\n", g->stone == BLACK_STONE ? "Black" : "White", formalCoord);
+            game_delete(g);
+            return 0;
+        }
+    }
+    mcts* m = mcts_create(nodes);
+    if (!m) {
+        exit(NULL_POINTER_ERR);
+    }
+    mcts_result r = mcts_search(m, g, threads, seconds);
+    if (!r.found) {
+        printf("The tree cannot hold the moves of the position, %ld nodes are too few.\n", nodes);
+        mcts_delete(m);
+        game_delete(g);
+        exit(ARGUMENT_ERR);
+    }
+    char formalCoord[BOARD_COORD_LEN];
+    board_formal_coord(g->board, r.cell, formalCoord);
+    printf("%s plays %s, win rate %.3f\n", g->stone == BLACK_STONE ? "Black" : "White", formalCoord, r.winrate);
+    printf("%llu playouts in %.2f s with %ld threads, %.0f playouts/s, %u tree nodes\n",
+           (unsigned long long) r.playouts, r.seconds, threads, r.playouts_per_second, m->nodes_used);
+    mcts_delete(m);
+    game_delete(g);
+    return 0;
+}
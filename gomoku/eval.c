@@ -0,0 +1,402 @@
+/**
+ * @file eval.c
+ * @author Jason Wang
+ * This program keeps running counts of the shapes (fives, fours, threes and twos) of both colors on a board.
+ * A stone only changes the four lines through it, so each update re-classifies those four lines and nothing else.
+*/
+#include "eval.h"
+#include "error-codes.h"
+#include "kernels.h"
+#include "weights.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** longest line of a dense board */
+#define MAX_LINE 19
+/** marks a cell of a line that the color being classified cannot use */
+#define BLOCKED 3
+
+/** shape weights of the side to move */
+static const int OWN_WEIGHTS[SHAPE_COUNT] = WEIGHTS_OWN;
+/** shape weights of the side waiting for its turn */
+static const int OPPONENT_WEIGHTS[SHAPE_COUNT] = WEIGHTS_OPPONENT;
+
+/**
+ * Computes the index of the line through a grid position in one direction
+ * @param size the size of the board
+ * @param d the direction, 0 row, 1 column, 2 diagonal, 3 anti-diagonal
+ * @param col the 0-based column
+ * @param row the 0-based row
+ * @return the line index
+*/
+static int lineIndex(int size, int d, int col, int row) {
+    switch (d) {
+        case 0: return row;
+        case 1: return size + col;
+        case 2: return 2 * size + col - row + size - 1;
+        default: return 4 * size - 1 + col + row;
+    }
+}
+
+/**
+ * Checks if a grid index is the first cell of its line in one direction
+ * @param b the board
+ * @param d the direction
+ * @param cell the grid index
+ * @return true if the previous cell in that direction is the sentinel past the edge
+*/
+static bool isLineStart(const board* b, int d, int cell) {
+    return b->neighbours[d + 4][cell] == BOARD_OFF(b);
+}
+
+/**
+ * Classifies the shapes one color has on a line.
+ * Every five-cell window the opponent does not block contributes the set of stones it holds, sets contained in
+ * a larger set are dropped, and the rest are counted by their number of stones. A set is open when a six-cell
+ * window with empty ends holds exactly that set in its inner four cells, i.e. it can become an open four.
+ * @param cells the line
+ * @param len the length of the line
+ * @param stone the color to classify
+ * @param shapes the shape counts to add to
+*/
+static void classifyLine(const unsigned char* cells, int len, unsigned char stone, unsigned char* shapes) {
+    unsigned char own[MAX_LINE];
+    for (int i = 0; i < len; i++) {
+        own[i] = cells[i] == stone ? 1 : (cells[i] == EMPTY_INTERSECTION ? 0 : BLOCKED);
+    }
+    unsigned int sets[MAX_LINE];
+    int setsCount = 0;
+    for (int i = 0; i + 5 <= len; i++) {
+        unsigned int set = 0;
+        int k = 0;
+        for (int j = i; j < i + 5 && k >= 0; j++) {
+            if (own[j] == BLOCKED) {
+                k = -1;
+            } else if (own[j]) {
+                set |= 1u << j;
+                k++;
+            }
+        }
+        if (k >= 2 && (setsCount == 0 || sets[setsCount - 1] != set)) {
+            sets[setsCount++] = set;
+        }
+    }
+    for (int i = 0; i < setsCount; i++) {
+        bool dominated = false;
+        for (int j = 0; j < setsCount && !dominated; j++) {
+            dominated = j != i && (sets[i] & sets[j]) == sets[i] && sets[j] != sets[i];
+        }
+        if (dominated) {
+            continue;
+        }
+        int k = __builtin_popcount(sets[i]);
+        if (k == 5) {
+            shapes[SHAPE_FIVE]++;
+            continue;
+        }
+        bool open = false;
+        for (int j = 0; j + 6 <= len && !open; j++) {
+            if (own[j] != 0 || own[j + 5] != 0) {
+                continue;
+            }
+            unsigned int inner = 0;
+            for (int m = j + 1; m < j + 5 && own[m] != BLOCKED; m++) {
+                inner |= own[m] ? 1u << m : 0;
+                open = m == j + 4 && inner == sets[i];
+            }
+        }
+        switch (k) {
+            case 4: shapes[open ? SHAPE_OPEN_FOUR : SHAPE_FOUR]++; break;
+            case 3: shapes[open ? SHAPE_OPEN_THREE : SHAPE_THREE]++; break;
+            default: shapes[open ? SHAPE_OPEN_TWO : SHAPE_TWO]++; break;
+        }
+    }
+}
+
+/**
+ * Classifies both colors on a line
+ * @param cells the line
+ * @param len the length of the line
+ * @param shapes the shape counts, indexed by color - 1
+*/
+static void classifyBoth(const unsigned char* cells, int len, unsigned char shapes[2][SHAPE_COUNT]) {
+    memset(shapes, 0, 2 * SHAPE_COUNT);
+    classifyLine(cells, len, BLACK_STONE, shapes[0]);
+    classifyLine(cells, len, WHITE_STONE, shapes[1]);
+}
+
+/**
+ * Re-classifies the line through a grid index and moves the difference into the running counts
+ * @param e the evaluator
+ * @param d the direction
+ * @param cell the grid index
+*/
+static void refreshLine(evaluator* e, int d, int cell) {
+    board* b = e->board;
+    unsigned char cells[MAX_LINE];
+    int position;
+    int len = kernels_read_line(b->grid, b->size, d, cell, cells, &position);
+    unsigned char (*shapes)[SHAPE_COUNT] = e->lines[lineIndex(b->size, d, BOARD_COL(b, cell), BOARD_ROW(b, cell))];
+    for (int c = 0; c < 2; c++) {
+        for (int s = 0; s < SHAPE_COUNT; s++) {
+            e->counts[c][s] -= shapes[c][s];
+        }
+    }
+    classifyBoth(cells, len, shapes);
+    for (int c = 0; c < 2; c++) {
+        for (int s = 0; s < SHAPE_COUNT; s++) {
+            e->counts[c][s] += shapes[c][s];
+        }
+    }
+}
+
+/**
+ * Creates an evaluator for a board, counts the shapes already on it, and attaches it
+ * so that board_set and board_unset keep the counts up to date.
+ * @param b the board
+ * @return the evaluator or NULL if malloc fails
+*/
+evaluator* eval_create(board* b) {
+    evaluator* e = (evaluator *) malloc(sizeof(evaluator));
+    if (!e) {
+        return NULL;
+    }
+    e->board = b;
+    e->lines = calloc(EVAL_LINES(b->size), sizeof(*e->lines));
+    if (!e->lines) {
+        free(e);
+        return NULL;
+    }
+    memset(e->counts, 0, sizeof(e->counts));
+    for (int cell = 0; cell < BOARD_OFF(b); cell++) {
+        for (int d = 0; d < 4; d++) {
+            if (isLineStart(b, d, cell)) {
+                refreshLine(e, d, cell);
+            }
+        }
+    }
+    b->eval = e;
+    return e;
+}
+
+/**
+ * Detaches an evaluator from its board and frees it
+ * @param e the evaluator
+*/
+void eval_delete(evaluator* e) {
+    if (!e) {
+        exit(NULL_POINTER_ERR);
+    }
+    if (e->board->eval == e) {
+        e->board->eval = NULL;
+    }
+    free(e->lines);
+    free(e);
+}
+
+/**
+ * Updates the shape counts after the intersection at a grid index changed, re-classifying only the four lines
+ * through it. With GOMOKU_DEBUG defined, the result is checked against a from-scratch evaluation.
+ * @param e the evaluator
+ * @param cell the grid index
+*/
+void eval_update(evaluator* e, uint16_t cell) {
+    for (int d = 0; d < 4; d++) {
+        refreshLine(e, d, cell);
+    }
+#ifdef GOMOKU_DEBUG
+    assert(eval_check(e));
+#endif
+}
+
+/** column and row step of each line direction of eval_check */
+static const int STEPS[4][2] = {{1, 0}, {0, 1}, {1, 1}, {1, -1}};
+
+/**
+ * Counts the shapes of one color on a line for eval_check, without classifyLine. Within a five-cell window holding
+ * no opponent stone, the stones of the color are exactly those between its first and last one, so a shape is such
+ * a span; spans lying inside another span are dropped. A span is open when it fits in four cells with no other
+ * stone of the color and an empty cell on each side.
+ * @param line the line
+ * @param len the length of the line
+ * @param stone the color to count
+ * @param counts the shape counts to add to
+*/
+static void countLineSpans(const unsigned char* line, int len, unsigned char stone, int* counts) {
+    int first[MAX_LINE];
+    int last[MAX_LINE];
+    int spans = 0;
+    for (int i = 0; i + 5 <= len; i++) {
+        int stones = 0;
+        bool clear = true;
+        for (int j = i; j < i + 5; j++) {
+            stones += line[j] == stone;
+            clear = clear && (line[j] == stone || line[j] == EMPTY_INTERSECTION);
+        }
+        if (!clear || stones < 2) {
+            continue;
+        }
+        int lo = i;
+        int hi = i + 4;
+        while (line[lo] != stone) {
+            lo++;
+        }
+        while (line[hi] != stone) {
+            hi--;
+        }
+        bool seen = false;
+        for (int k = 0; k < spans && !seen; k++) {
+            seen = first[k] == lo && last[k] == hi;
+        }
+        if (!seen) {
+            first[spans] = lo;
+            last[spans++] = hi;
+        }
+    }
+    for (int k = 0; k < spans; k++) {
+        bool inner = false;
+        for (int m = 0; m < spans && !inner; m++) {
+            inner = m != k && first[m] <= first[k] && last[k] <= last[m];
+        }
+        if (inner) {
+            continue;
+        }
+        int stones = 0;
+        for (int j = first[k]; j <= last[k]; j++) {
+            stones += line[j] == stone;
+        }
+        if (stones == 5) {
+            counts[SHAPE_FIVE]++;
+            continue;
+        }
+        bool open = false;
+        for (int start = last[k] - 3; start <= first[k] && !open; start++) {
+            if (start < 1 || start + 4 >= len || line[start - 1] != EMPTY_INTERSECTION
+                || line[start + 4] != EMPTY_INTERSECTION) {
+                continue;
+            }
+            open = true;
+            for (int j = start; j < start + 4; j++) {
+                open = open && (line[j] == EMPTY_INTERSECTION || (j >= first[k] && j <= last[k]));
+            }
+        }
+        switch (stones) {
+            case 4: counts[open ? SHAPE_OPEN_FOUR : SHAPE_FOUR]++; break;
+            case 3: counts[open ? SHAPE_OPEN_THREE : SHAPE_THREE]++; break;
+            default: counts[open ? SHAPE_OPEN_TWO : SHAPE_TWO]++; break;
+        }
+    }
+}
+
+/**
+ * Recounts every line of the board from scratch and compares the result with the running counts. The lines are
+ * walked by coordinates on the grid and counted by countLineSpans, so neither the line kernels nor classifyLine
+ * take part in the reference.
+ * @param e the evaluator
+ * @return true if the counts match
+*/
+bool eval_check(evaluator* e) {
+    board* b = e->board;
+    int size = b->size;
+    int counts[2][SHAPE_COUNT] = {{0}};
+    unsigned char line[MAX_LINE];
+    for (int d = 0; d < 4; d++) {
+        int dx = STEPS[d][0];
+        int dy = STEPS[d][1];
+        for (int row = 0; row < size; row++) {
+            for (int col = 0; col < size; col++) {
+                int px = col - dx;
+                int py = row - dy;
+                if (px >= 0 && py >= 0 && px < size && py < size) {
+                    continue;
+                }
+                int len = 0;
+                for (int x = col, y = row; x >= 0 && y >= 0 && x < size && y < size; x += dx, y += dy) {
+                    line[len++] = b->grid[BOARD_CELL(b, x, y)];
+                }
+                countLineSpans(line, len, BLACK_STONE, counts[0]);
+                countLineSpans(line, len, WHITE_STONE, counts[1]);
+            }
+        }
+    }
+    return memcmp(counts, e->counts, sizeof(counts)) == 0;
+}
+
+/**
+ * Evaluates a game for the side to move from the running shape counts of its attached evaluator, in constant time
+ * @param g the game struct pointer
+ * @return the score, positive when the side to move is better
+*/
+int eval(game* g) {
+    evaluator* e = g->board->eval;
+    const int* own = e->counts[g->stone - 1];
+    const int* opponent = e->counts[2 - g->stone];
+    int score = 0;
+    for (int s = 0; s < SHAPE_COUNT; s++) {
+        score += OWN_WEIGHTS[s] * own[s] - OPPONENT_WEIGHTS[s] * opponent[s];
+    }
+    return score;
+}
+
+/**
+ * Computes how the shapes of one color on the four lines through an empty intersection would change
+ * if a stone of that color was placed there. The board itself is not modified.
+ * @param b the board
+ * @param cell the grid index
+ * @param stone the color to place
+ * @param delta the change of each shape count
+*/
+void eval_placement(board* b, uint16_t cell, unsigned char stone, int delta[SHAPE_COUNT]) {
+    unsigned char cells[MAX_LINE];
+    unsigned char before[SHAPE_COUNT];
+    unsigned char after[SHAPE_COUNT];
+    memset(delta, 0, SHAPE_COUNT * sizeof(int));
+    for (int d = 0; d < 4; d++) {
+        int position;
+        int len = kernels_read_line(b->grid, b->size, d, cell, cells, &position);
+        memset(before, 0, sizeof(before));
+        memset(after, 0, sizeof(after));
+        classifyLine(cells, len, stone, before);
+        cells[position] = stone;
+        classifyLine(cells, len, stone, after);
+        for (int s = 0; s < SHAPE_COUNT; s++) {
+            delta[s] += after[s] - before[s];
+        }
+    }
+}
+
+/**
+ * Weighs the change of the shapes of one color if a stone was placed on an empty intersection
+ * @param b the board
+ * @param cell the grid index
+ * @param stone the color to place
+ * @param weights the shape weights
+ * @return the weighted gain
+*/
+static int placementGain(board* b, uint16_t cell, unsigned char stone, const int* weights) {
+    int delta[SHAPE_COUNT];
+    eval_placement(b, cell, stone, delta);
+    int gain = 0;
+    for (int s = 0; s < SHAPE_COUNT; s++) {
+        gain += weights[s] * delta[s];
+    }
+    return gain;
+}
+
+/**
+ * Scores an empty intersection for the side to move as the shapes it would gain by playing there
+ * plus the shapes it would take away from the opponent. Occupied intersections score 0.
+ * @param g the game struct pointer
+ * @param cell the grid index
+ * @return the threat score
+*/
+int eval_threat(game* g, uint16_t cell) {
+    if (board_get(g->board, cell) != EMPTY_INTERSECTION) {
+        return 0;
+    }
+    unsigned char opponent = g->stone == BLACK_STONE ? WHITE_STONE : BLACK_STONE;
+    return placementGain(g->board, cell, g->stone, OWN_WEIGHTS)
+        + placementGain(g->board, cell, opponent, OPPONENT_WEIGHTS);
+}
@@ -0,0 +1,36 @@
+#ifndef _EVAL_H_
+#define _EVAL_H_
+#include "board.h"
+#include "game.h"
+#define SHAPE_FIVE 0
+#define SHAPE_OPEN_FOUR 1
+#define SHAPE_FOUR 2
+#define SHAPE_OPEN_THREE 3
+#define SHAPE_THREE 4
+#define SHAPE_OPEN_TWO 5
+#define SHAPE_TWO 6
+#define SHAPE_COUNT 7
+/** number of lines of a board with the given size: rows, columns and both diagonal directions */
+#define EVAL_LINES(size) (6 * (size) - 2)
+
+typedef struct evaluator {
+    board* board;
+    unsigned char (*lines)[2][SHAPE_COUNT];
+    int counts[2][SHAPE_COUNT];
+} evaluator;
+
+/** function to create an evaluator and attach it to a board */
+evaluator* eval_create(board* b);
+/** function to detach and delete an evaluator */
+void eval_delete(evaluator* e);
+/** function to update the shape counts after an intersection changed */
+void eval_update(evaluator* e, uint16_t cell);
+/** function to check the shape counts against a from-scratch evaluation */
+bool eval_check(evaluator* e);
+/** function to compute the shape changes of placing a stone */
+void eval_placement(board* b, uint16_t cell, unsigned char stone, int delta[SHAPE_COUNT]);
+/** function to evaluate a game for the side to move */
+int eval(game* g);
+/** function to score an empty intersection for the side to move */
+int eval_threat(game* g, uint16_t cell);
+#endif
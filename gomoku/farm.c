@@ -0,0 +1,557 @@
+/**
+ * @file farm.c
+ * @author Jason Wang
+ * This is the main program to process the games of a directory in worker processes, so that a game that makes a
+ * worker exit or crash costs that game and not the run. A task names the handler that the workers run on each game:
+ * solve adjudicates stopped games like ./solve, annotate writes the sidecars of ./annotate. The coordinator listens on
+ * a TCP port and forks workers that connect to it like workers of other machines would, and hands out one game at a
+ * time over the connections:
+ *
+ *   coordinator to worker: OPTIONS <task> <max-nodes> <table-bytes> <threats-only 0|1> <depth> <blunder>, once after
+ *                          connecting
+ *                          UNIT <index> <path>, a game to process
+ *                          QUIT, when every game is done
+ *   worker to coordinator: RESULT <index> <report>, the line of ./solve or ./annotate for the game
+ *
+ * A connection that closes while it holds a game sends the game back to the queue, up to a number of attempts, and
+ * a local worker that ends is replaced while games are left. The reports are printed in the order of the games.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "error-codes.h"
+#include "board.h"
+#include "game.h"
+#include "io.h"
+#include "annotation.h"
+#include "dfpn.h"
+#include "search.h"
+
+#define DEFAULT_NODES 1000000
+#define DEFAULT_TABLE_MB 64
+#define DEFAULT_ATTEMPTS 3
+#define DEFAULT_DEPTH 4
+#define DEFAULT_BLUNDER 3000
+/** size of the search table of an annotating worker, whose -m goes to its cache of positions */
+#define ANNOTATE_TABLE_BYTES (16u << 20)
+/** longest task name */
+#define TASK_LEN 16
+/** buffer length of the report of a game, for every task */
+#define REPORT_LEN (DFPN_REPORT_LEN > ANNOTATION_REPORT_LEN ? DFPN_REPORT_LEN : ANNOTATION_REPORT_LEN)
+/** longest message line, a report with its header */
+#define LINE_LEN (REPORT_LEN + 64)
+#define MAX_CONNECTIONS 256
+/** milliseconds between two checks for ended workers */
+#define POLL_INTERVAL 100
+#define NO_UNIT -1
+
+typedef struct {
+    char task[TASK_LEN];
+    size_t max_nodes;
+    size_t table_bytes;
+    int threats_only;
+    int depth;
+    int blunder;
+} farm_options;
+
+typedef struct {
+    const char* name;
+    /** prepares a worker for the games of the task, NULL if it is out of memory */
+    void* (*open)(const farm_options* o);
+    /** processes one game and fills its report, REPORT_LEN bytes */
+    void (*run)(void* state, const farm_options* o, const char* path, char* report);
+    void (*close)(void* state);
+} unit_handler;
+
+typedef struct {
+    annotation_cache* positions;
+    search* s;
+} annotator;
+
+typedef struct {
+    int fd;
+    long unit;
+    char buffer[LINE_LEN];
+    size_t len;
+} connection;
+
+typedef struct {
+    char** paths;
+    char** reports;
+    int* attempts;
+    size_t count;
+    size_t done;
+    long* queue;
+    size_t queue_head;
+    size_t queue_tail;
+    connection connections[MAX_CONNECTIONS];
+    int connections_count;
+    int max_attempts;
+    farm_options options;
+    size_t retried;
+} coordinator;
+
+/**
+ * Prints the usage of the program and exits
+*/
+static void usage(void) {
+    printf("usage: ./farm [-k <solve|annotate>] [-j <workers>] [-n <max-nodes>] [-m <table-MB>] [-t] [-d <depth>] [-b <blunder-threshold>]\n"
+           "              [-a <attempts>] [-p <port>] <directory>\n"
+           "       ./farm -c <host>:<port>\n"
+           "       solves the stopped games of <directory> like ./solve, or annotates its games like ./annotate with -k annotate,\n"
+           "       one worker process per -j, giving each game -a attempts (3 by default) before reporting it as crashed;\n"
+           "       -n and -t are for solve, -d and -b for annotate, whose -m is the cache of each worker;\n"
+           "       -p also accepts workers of other machines, started with -c, which must see the same paths\n");
+    exit(ARGUMENT_ERR);
+}
+
+/**
+ * Creates the solver table of a solving worker
+ * @param o the options of the run
+ * @return the table
+*/
+static void* openSolver(const farm_options* o) {
+    return dfpn_create(o->table_bytes);
+}
+
+/**
+ * Solves a stopped game for both colors, like ./solve
+ * @param state the solver table
+ * @param o the options of the run
+ * @param path the path of the game
+ * @param report the report
+*/
+static void runSolver(void* state, const farm_options* o, const char* path, char* report) {
+    dfpn_adjudicate((dfpn_table *) state, path, o->max_nodes, o->threats_only, report);
+}
+
+/**
+ * Deletes the solver table of a solving worker
+ * @param state the table
+*/
+static void closeSolver(void* state) {
+    dfpn_delete((dfpn_table *) state);
+}
+
+/**
+ * Creates the cache of positions and the searcher of an annotating worker
+ * @param o the options of the run
+ * @return the annotator or NULL if it cannot be allocated
+*/
+static void* openAnnotator(const farm_options* o) {
+    annotator* a = (annotator *) malloc(sizeof(annotator));
+    if (!a) {
+        return NULL;
+    }
+    a->positions = annotation_cache_create(o->table_bytes);
+    a->s = search_create(ANNOTATE_TABLE_BYTES);
+    if (!a->positions || !a->s) {
+        exit(NULL_POINTER_ERR);
+    }
+    return a;
+}
+
+/**
+ * Annotates every move of a game and writes its sidecar, like ./annotate
+ * @param state the annotator
+ * @param o the options of the run
+ * @param path the path of the game
+ * @param report the report
+*/
+static void runAnnotator(void* state, const farm_options* o, const char* path, char* report) {
+    annotator* a = (annotator *) state;
+    annotation_file(a->positions, a->s, path, o->depth, o->blunder, report);
+}
+
+/**
+ * Deletes the cache of positions and the searcher of an annotating worker
+ * @param state the annotator
+*/
+static void closeAnnotator(void* state) {
+    annotator* a = (annotator *) state;
+    annotation_cache_delete(a->positions);
+    search_delete(a->s);
+    free(a);
+}
+
+static const unit_handler HANDLERS[] = {
+    {"solve", openSolver, runSolver, closeSolver},
+    {"annotate", openAnnotator, runAnnotator, closeAnnotator},
+};
+
+/**
+ * Finds the handler of a task
+ * @param task the name of the task
+ * @return the handler or NULL if no handler has that name
+*/
+static const unit_handler* findHandler(const char* task) {
+    for (size_t i = 0; i < sizeof(HANDLERS) / sizeof(HANDLERS[0]); i++) {
+        if (strcmp(task, HANDLERS[i].name) == 0) {
+            return &HANDLERS[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Connects to a coordinator
+ * @param host the name or address of the coordinator
+ * @param port the port of the coordinator
+ * @return the socket, or -1 if no address of the host accepts the connection
+*/
+static int connectTo(const char* host, const char* port) {
+    struct addrinfo hints;
+    struct addrinfo* addresses;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &addresses) != 0) {
+        return -1;
+    }
+    int fd = -1;
+    for (struct addrinfo* a = addresses; a && fd < 0; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    return fd;
+}
+
+/**
+ * Runs a worker: processes the games the coordinator sends with the handler of its task, until it says to quit or
+ * the connection closes
+ * @param host the name or address of the coordinator
+ * @param port the port of the coordinator
+ * @return the exit status
+*/
+static int work(const char* host, const char* port) {
+    int fd = connectTo(host, port);
+    FILE* in = fd < 0 ? NULL : fdopen(fd, "r");
+    if (!in) {
+        return FILE_INPUT_ERR;
+    }
+    const unit_handler* handler = NULL;
+    void* state = NULL;
+    farm_options o;
+    char* line = NULL;
+    size_t capacity = 0;
+    char report[REPORT_LEN];
+    while (getline(&line, &capacity, in) > 0) {
+        line[strcspn(line, "\n")] = '\0';
+        long index;
+        int offset;
+        if (sscanf(line, "OPTIONS %15s %zu %zu %d %d %d", o.task, &o.max_nodes, &o.table_bytes, &o.threats_only,
+                   &o.depth, &o.blunder) == 6) {
+            if (state) {
+                handler->close(state);
+            }
+            handler = findHandler(o.task);
+            if (!handler) {
+                break;
+            }
+            state = handler->open(&o);
+            if (!state) {
+                exit(NULL_POINTER_ERR);
+            }
+        } else if (state && sscanf(line, "UNIT %ld %n", &index, &offset) == 1) {
+            handler->run(state, &o, line + offset, report);
+            if (dprintf(fd, "RESULT %ld %s\n", index, report) < 0) {
+                break;
+            }
+        } else {
+            break;
+        }
+    }
+    free(line);
+    fclose(in);
+    if (state) {
+        handler->close(state);
+    }
+    return 0;
+}
+
+/**
+ * Forks a local worker that connects to the coordinator on the loopback interface
+ * @param c the coordinator
+ * @param port the port of the coordinator
+ * @param listener the listening socket, which the worker closes
+*/
+static void spawn(coordinator* c, const char* port, int listener) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        exit(NULL_POINTER_ERR);
+    }
+    if (pid == 0) {
+        close(listener);
+        for (int i = 0; i < c->connections_count; i++) {
+            close(c->connections[i].fd);
+        }
+        _exit(work("127.0.0.1", port));
+    }
+}
+
+/**
+ * Gives the next queued game to a connection, or tells it to quit once every game is done
+ * @param c the coordinator
+ * @param k the connection, which holds no game
+*/
+static void dispatch(coordinator* c, connection* k) {
+    if (c->queue_head < c->queue_tail) {
+        k->unit = c->queue[c->queue_head++ % c->count];
+        c->attempts[k->unit]++;
+        dprintf(k->fd, "UNIT %ld %s\n", k->unit, c->paths[k->unit]);
+    } else if (c->done == c->count) {
+        dprintf(k->fd, "QUIT\n");
+    }
+}
+
+/**
+ * Closes a connection and sends its game back to the queue, or reports the game as crashed when it has no attempt left
+ * @param c the coordinator
+ * @param index the index of the connection
+*/
+static void dropConnection(coordinator* c, int index) {
+    connection* k = &c->connections[index];
+    if (k->unit != NO_UNIT) {
+        if (c->attempts[k->unit] < c->max_attempts) {
+            c->queue[c->queue_tail++ % c->count] = k->unit;
+            c->retried++;
+        } else {
+            snprintf(c->reports[k->unit], REPORT_LEN, "%s: crashed %d workers, skipped", c->paths[k->unit],
+                     c->attempts[k->unit]);
+            c->done++;
+        }
+    }
+    close(k->fd);
+    c->connections[index] = c->connections[--c->connections_count];
+}
+
+/**
+ * Handles the complete lines received on a connection
+ * @param c the coordinator
+ * @param k the connection
+ * @return false if the worker sent something unexpected
+*/
+static bool handleLines(coordinator* c, connection* k) {
+    char* end;
+    while ((end = memchr(k->buffer, '\n', k->len))) {
+        *end = '\0';
+        long index;
+        int offset;
+        if (sscanf(k->buffer, "RESULT %ld %n", &index, &offset) != 1 || index != k->unit) {
+            return false;
+        }
+        snprintf(c->reports[index], REPORT_LEN, "%s", k->buffer + offset);
+        c->done++;
+        k->unit = NO_UNIT;
+        size_t used = end + 1 - k->buffer;
+        memmove(k->buffer, end + 1, k->len - used);
+        k->len -= used;
+    }
+    return k->len < LINE_LEN;
+}
+
+/**
+ * Hands the games out to the workers until every game has a report, replacing the local workers that end, then
+ * closes the listening socket and waits for the local workers
+ * @param c the coordinator
+ * @param listener the listening socket
+ * @param port the port of the listening socket
+ * @param workers the number of local workers
+*/
+static void coordinate(coordinator* c, int listener, const char* port, long workers) {
+    for (long i = 0; i < workers; i++) {
+        spawn(c, port, listener);
+    }
+    // a worker that ends for good cannot take the run down with it, but every game it was given may end it
+    size_t respawns = c->count * c->max_attempts + workers;
+    struct pollfd fds[MAX_CONNECTIONS + 1];
+    while (c->done < c->count) {
+        int status;
+        while (waitpid(-1, &status, WNOHANG) > 0) {
+            if (respawns > 0) {
+                respawns--;
+                spawn(c, port, listener);
+            }
+        }
+        fds[0].fd = listener;
+        fds[0].events = POLLIN;
+        for (int i = 0; i < c->connections_count; i++) {
+            fds[i + 1].fd = c->connections[i].fd;
+            fds[i + 1].events = POLLIN;
+        }
+        int polled = c->connections_count;
+        if (poll(fds, polled + 1, POLL_INTERVAL) < 0 && errno != EINTR) {
+            exit(INPUT_ERR);
+        }
+        // connections are dropped by moving the last one over them, so the later ones go first
+        for (int i = polled - 1; i >= 0; i--) {
+            if (!(fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            connection* k = &c->connections[i];
+            ssize_t n = read(k->fd, k->buffer + k->len, LINE_LEN - k->len);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            k->len += n > 0 ? n : 0;
+            if (n <= 0 || !handleLines(c, k)) {
+                dropConnection(c, i);
+            } else if (k->unit == NO_UNIT) {
+                dispatch(c, k);
+            }
+        }
+        if ((fds[0].revents & POLLIN) && c->connections_count < MAX_CONNECTIONS) {
+            int fd = accept(listener, NULL, NULL);
+            if (fd >= 0) {
+                connection* k = &c->connections[c->connections_count++];
+                k->fd = fd;
+                k->unit = NO_UNIT;
+                k->len = 0;
+                farm_options* o = &c->options;
+                dprintf(fd, "OPTIONS %s %zu %zu %d %d %d\n", o->task, o->max_nodes, o->table_bytes, o->threats_only,
+                        o->depth, o->blunder);
+                dispatch(c, k);
+            }
+        }
+        // games sent back to the queue go to the workers left idle when it emptied
+        for (int i = 0; i < c->connections_count && c->queue_head < c->queue_tail; i++) {
+            if (c->connections[i].unit == NO_UNIT) {
+                dispatch(c, &c->connections[i]);
+            }
+        }
+    }
+    for (int i = 0; i < c->connections_count; i++) {
+        dispatch(c, &c->connections[i]);
+        close(c->connections[i].fd);
+    }
+    c->connections_count = 0;
+    // workers that have not been accepted yet find the port closed and end
+    close(listener);
+    while (wait(NULL) > 0) {
+    }
+}
+
+/**
+ * Opens the listening socket of the coordinator
+ * @param port the port, 0 for any free one
+ * @param everywhere true to accept the workers of other machines, false for the local ones only
+ * @param bound the port the socket is bound to
+ * @return the socket
+*/
+static int listenOn(int port, bool everywhere, char* bound) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(everywhere ? INADDR_ANY : INADDR_LOOPBACK);
+    socklen_t len = sizeof(address);
+    if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0
+        || bind(fd, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(fd, MAX_CONNECTIONS) != 0
+        || getsockname(fd, (struct sockaddr *) &address, &len) != 0) {
+        exit(FILE_OUTPUT_ERR);
+    }
+    sprintf(bound, "%d", ntohs(address.sin_port));
+    return fd;
+}
+
+/**
+ * This is the main function of the coordinator and of the remote workers
+ * @param argc the number of command line args
+ * @param argv an array of command-line argument strings
+*/
+int main(int argc, char *argv[]) {
+    int opt;
+    long workers = sysconf(_SC_NPROCESSORS_ONLN);
+    int port = -1;
+    char* remote = NULL;
+    coordinator* c = (coordinator *) calloc(1, sizeof(coordinator));
+    if (!c) {
+        exit(NULL_POINTER_ERR);
+    }
+    farm_options* o = &c->options;
+    strcpy(o->task, "solve");
+    o->max_nodes = DEFAULT_NODES;
+    o->table_bytes = (size_t) DEFAULT_TABLE_MB << 20;
+    o->depth = DEFAULT_DEPTH;
+    o->blunder = DEFAULT_BLUNDER;
+    c->max_attempts = DEFAULT_ATTEMPTS;
+    while ((opt = getopt(argc, argv, "k:j:n:m:td:b:a:p:c:")) != -1) {
+        switch (opt) {
+            case 'k': snprintf(o->task, TASK_LEN, "%s", optarg); break;
+            case 'j': workers = atol(optarg); break;
+            case 'n': o->max_nodes = (size_t) atol(optarg); break;
+            case 'm': o->table_bytes = (size_t) atol(optarg) << 20; break;
+            case 't': o->threats_only = 1; break;
+            case 'd': o->depth = atoi(optarg); break;
+            case 'b': o->blunder = atoi(optarg); break;
+            case 'a': c->max_attempts = atoi(optarg); break;
+            case 'p': port = atoi(optarg); break;
+            case 'c': remote = optarg; break;
+            default: usage();
+        }
+    }
+    if (remote) {
+        char* colon = strrchr(remote, ':');
+        if (optind != argc || !colon) {
+            usage();
+        }
+        *colon = '\0';
+        free(c);
+        return work(remote, colon + 1);
+    }
+    if (optind != argc - 1 || workers < 0 || !findHandler(o->task) || o->max_nodes == 0 || o->table_bytes == 0
+        || o->depth < 1 || o->depth > SEARCH_MAX_DEPTH || o->blunder < 1 || c->max_attempts < 1 || port > 65535
+        || (workers == 0 && port < 0)) {
+        usage();
+    }
+    signal(SIGPIPE, SIG_IGN);
+    char bound[16];
+    int listener = listenOn(port < 0 ? 0 : port, port >= 0, bound);
+    c->paths = game_list_dir(argv[optind], &c->count);
+    c->reports = (char **) malloc((c->count + 1) * sizeof(char *));
+    c->attempts = (int *) calloc(c->count + 1, sizeof(int));
+    c->queue = (long *) malloc((c->count + 1) * sizeof(long));
+    if (!c->reports || !c->attempts || !c->queue) {
+        exit(NULL_POINTER_ERR);
+    }
+    for (size_t i = 0; i < c->count; i++) {
+        c->reports[i] = (char *) calloc(REPORT_LEN, 1);
+        c->queue[c->queue_tail++] = i;
+    }
+    if (port >= 0) {
+        printf("Listening on port %s\n", bound);
+    }
+    double start = search_clock();
+    coordinate(c, listener, bound, workers);
+    double seconds = search_clock() - start;
+    for (size_t i = 0; i < c->count; i++) {
+        printf("%s\n", c->reports[i]);
+        free(c->reports[i]);
+        free(c->paths[i]);
+    }
+    printf("%zu games in %.2f s with %ld workers, %.1f games/s, %zu sent again after a worker ended\n", c->count,
+           seconds, workers, seconds > 0 ? c->count / seconds : 0.0, c->retried);
+    free(c->reports);
+    free(c->paths);
+    free(c->attempts);
+    free(c->queue);
+    free(c);
+    return 0;
+}
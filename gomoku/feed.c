@@ -0,0 +1,236 @@
+/**
+ * @file feed.c
+ * @author Jason Wang
+ * This program publishes the moves of a game to local spectators through POSIX shared memory. The game process is the
+ * single writer of a ring of events, each guarded by its own sequence number like a seqlock: readers never block the
+ * game and never take a lock, and a reader that falls a whole ring behind sees a newer sequence number and
+ * resynchronizes from a snapshot of the board kept next to the ring.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include "feed.h"
+#include "error-codes.h"
+#include <fcntl.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Creates a feed, replacing a feed of the same name left by a crashed process
+ * @param name the name of the shared memory object, starting with a slash
+ * @return the feed or NULL if the shared memory cannot be created
+*/
+feed* feed_open(const char* name) {
+    feed* f = (feed *) malloc(sizeof(feed));
+    char* copy = f ? strdup(name) : NULL;
+    if (!copy) {
+        free(f);
+        return NULL;
+    }
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 || ftruncate(fd, sizeof(feed_shared)) != 0) {
+        if (fd >= 0) {
+            close(fd);
+            shm_unlink(name);
+        }
+        free(copy);
+        free(f);
+        return NULL;
+    }
+    void* shared = mmap(NULL, sizeof(feed_shared), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shared == MAP_FAILED) {
+        shm_unlink(name);
+        free(copy);
+        free(f);
+        return NULL;
+    }
+    f->shared = (feed_shared *) shared;
+    f->name = copy;
+    f->shared->capacity = FEED_CAPACITY;
+    __atomic_store_n(&f->shared->magic, FEED_MAGIC, __ATOMIC_RELEASE);
+    return f;
+}
+
+/**
+ * Closes a feed. Readers that mapped it see it closed and keep their mapping; new readers no longer find it.
+ * @param f the feed
+*/
+void feed_close(feed* f) {
+    if (!f) {
+        exit(NULL_POINTER_ERR);
+    }
+    __atomic_store_n(&f->shared->closed, 1, __ATOMIC_RELEASE);
+    munmap(f->shared, sizeof(feed_shared));
+    shm_unlink(f->name);
+    free(f->name);
+    free(f);
+}
+
+/**
+ * Publishes an event of a game: the snapshot is updated first, under its own sequence number, then the event is
+ * written to its slot of the ring. Only the game process writes, so nothing here waits.
+ * @param f the feed
+ * @param g the game
+ * @param kind FEED_MOVE for the last move of the game, FEED_GAME for a new game, FEED_END for a state change alone
+*/
+void feed_publish(feed* f, const game* g, uint8_t kind) {
+    feed_shared* s = f->shared;
+    uint64_t sequence = __atomic_load_n(&s->published, __ATOMIC_RELAXED);
+    feed_event e = {(uint16_t) g->moves_count, 0, 0, EMPTY_INTERSECTION, g->state, g->winner, kind};
+    if (kind == FEED_MOVE && g->moves_count > 0) {
+        const move* last = &g->moves[g->moves_count - 1];
+        e.x = 'A' + BOARD_COL(g->board, last->cell);
+        e.y = BOARD_ROW(g->board, last->cell) + 1;
+        e.stone = last->stone;
+    }
+
+    uint64_t lock = __atomic_load_n(&s->snapshot_lock, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->snapshot_lock, lock + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    if (kind == FEED_GAME) {
+        int cells = g->board->size * g->board->size;
+        for (int i = 0; i < FEED_CELLS; i++) {
+            __atomic_store_n(&s->grid[i], i < cells ? g->board->grid[i] : EMPTY_INTERSECTION, __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&s->size, g->board->size, __ATOMIC_RELAXED);
+        __atomic_store_n(&s->type, g->type, __ATOMIC_RELAXED);
+    } else if (e.stone != EMPTY_INTERSECTION) {
+        __atomic_store_n(&s->grid[g->moves[g->moves_count - 1].cell], e.stone, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&s->stone, g->stone, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->state, g->state, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->winner, g->winner, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->opening, g->opening | (g->swapped ? FEED_SWAPPED : 0), __ATOMIC_RELAXED);
+    __atomic_store_n(&s->moves_count, (uint16_t) g->moves_count, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->snapshot_events, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->snapshot_lock, lock + 2, __ATOMIC_RELEASE);
+
+    feed_slot* slot = &s->slots[sequence % FEED_CAPACITY];
+    uint64_t payload;
+    memcpy(&payload, &e, sizeof(payload));
+    __atomic_store_n(&slot->sequence, 2 * sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&slot->payload, payload, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->sequence, 2 * sequence + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&s->published, sequence + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Publishes every move of a game placed from now on, as its listener
+ * @param g the game
+ * @param context the feed
+*/
+static void feedMove(game* g, void* context) {
+    feed_publish((feed *) context, g, FEED_MOVE);
+}
+
+/**
+ * Publishes a game as a new game of the feed, with the moves it already has in the snapshot, and adds the feed to
+ * its listeners so that each placed stone is published
+ * @param f the feed
+ * @param g the game
+ * @return true if success, false if the board is larger than the snapshot or the game has too many listeners
+*/
+bool feed_watch(feed* f, game* g) {
+    if (g->board->size * g->board->size > FEED_CELLS || !game_listen(g, feedMove, f)) {
+        return false;
+    }
+    feed_publish(f, g, FEED_GAME);
+    return true;
+}
+
+/**
+ * Maps a feed read-only
+ * @param name the name of the shared memory object
+ * @return the shared feed or NULL if there is no ready feed of that name
+*/
+const feed_shared* feed_attach(const char* name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(feed_shared)) {
+        close(fd);
+        return NULL;
+    }
+    void* shared = mmap(NULL, sizeof(feed_shared), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shared == MAP_FAILED) {
+        return NULL;
+    }
+    const feed_shared* s = (const feed_shared *) shared;
+    if (__atomic_load_n(&s->magic, __ATOMIC_ACQUIRE) != FEED_MAGIC || s->capacity != FEED_CAPACITY) {
+        munmap(shared, sizeof(feed_shared));
+        return NULL;
+    }
+    return s;
+}
+
+/**
+ * Unmaps a feed
+ * @param s the shared feed
+*/
+void feed_detach(const feed_shared* s) {
+    munmap((void *) s, sizeof(feed_shared));
+}
+
+/**
+ * Copies the board and state of a feed, retrying while the game process updates them
+ * @param s the shared feed
+ * @param snapshot the copy; its events field is the sequence number of the first event it does not include
+*/
+void feed_read_snapshot(const feed_shared* s, feed_snapshot* snapshot) {
+    while (true) {
+        uint64_t lock = __atomic_load_n(&s->snapshot_lock, __ATOMIC_ACQUIRE);
+        if (lock % 2 == 1) {
+            sched_yield();
+            continue;
+        }
+        for (int i = 0; i < FEED_CELLS; i++) {
+            snapshot->grid[i] = __atomic_load_n(&s->grid[i], __ATOMIC_RELAXED);
+        }
+        snapshot->size = __atomic_load_n(&s->size, __ATOMIC_RELAXED);
+        snapshot->type = __atomic_load_n(&s->type, __ATOMIC_RELAXED);
+        snapshot->stone = __atomic_load_n(&s->stone, __ATOMIC_RELAXED);
+        snapshot->state = __atomic_load_n(&s->state, __ATOMIC_RELAXED);
+        snapshot->winner = __atomic_load_n(&s->winner, __ATOMIC_RELAXED);
+        snapshot->opening = __atomic_load_n(&s->opening, __ATOMIC_RELAXED);
+        snapshot->moves_count = __atomic_load_n(&s->moves_count, __ATOMIC_RELAXED);
+        snapshot->events = __atomic_load_n(&s->snapshot_events, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&s->snapshot_lock, __ATOMIC_RELAXED) == lock) {
+            return;
+        }
+    }
+}
+
+/**
+ * Reads an event of a feed. The sequence number of its slot tells if the event is not written yet, or if the ring
+ * has already moved past it, before or while it is copied.
+ * @param s the shared feed
+ * @param sequence the sequence number of the event, counted from 0
+ * @param e the event
+ * @return FEED_READY, FEED_WAIT if the event is not published yet, FEED_OVERRUN if it was overwritten
+*/
+int feed_read(const feed_shared* s, uint64_t sequence, feed_event* e) {
+    const feed_slot* slot = &s->slots[sequence % FEED_CAPACITY];
+    uint64_t before = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+    if (before < 2 * sequence + 2) {
+        return FEED_WAIT;
+    }
+    if (before > 2 * sequence + 2) {
+        return FEED_OVERRUN;
+    }
+    uint64_t payload = __atomic_load_n(&slot->payload, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) != before) {
+        return FEED_OVERRUN;
+    }
+    memcpy(e, &payload, sizeof(*e));
+    return FEED_READY;
+}
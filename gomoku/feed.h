@@ -0,0 +1,95 @@
+#ifndef _FEED_H_
+#define _FEED_H_
+#include "board.h"
+#include "game.h"
+#include <stdbool.h>
+#include <stdint.h>
+/** environment variable naming the shared memory feed of the game played */
+#define FEED_VARIABLE "GOMOKU_FEED"
+/** name of the feed when the variable is not set */
+#define FEED_DEFAULT "/gomoku"
+/** tag of a feed, written last once the feed is ready */
+#define FEED_MAGIC 0x676D6B66u
+/** number of events kept in the ring; a reader further behind resynchronizes from the snapshot */
+#define FEED_CAPACITY 256
+/** intersections of the largest board of the snapshot */
+#define FEED_CELLS (19 * 19)
+/** kinds of events */
+#define FEED_MOVE 0
+#define FEED_GAME 1
+#define FEED_END 2
+/** results of reading an event */
+#define FEED_READY 0
+#define FEED_WAIT 1
+#define FEED_OVERRUN 2
+/** bit of the opening field of the snapshot set once the players swapped colors */
+#define FEED_SWAPPED 0x80
+
+typedef struct {
+    uint16_t ply;
+    uint8_t x;
+    uint8_t y;
+    uint8_t stone;
+    uint8_t state;
+    uint8_t winner;
+    uint8_t kind;
+} feed_event;
+
+typedef struct {
+    uint64_t sequence;
+    uint64_t payload;
+} feed_slot;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t capacity;
+    uint64_t published;
+    uint64_t snapshot_lock;
+    uint64_t snapshot_events;
+    uint8_t size;
+    uint8_t type;
+    uint8_t stone;
+    uint8_t state;
+    uint8_t winner;
+    uint8_t closed;
+    /** opening step of the game, with FEED_SWAPPED */
+    uint8_t opening;
+    uint16_t moves_count;
+    uint8_t grid[FEED_CELLS];
+    feed_slot slots[FEED_CAPACITY];
+} feed_shared;
+
+typedef struct {
+    feed_shared* shared;
+    char* name;
+} feed;
+
+typedef struct {
+    uint64_t events;
+    uint8_t size;
+    uint8_t type;
+    uint8_t stone;
+    uint8_t state;
+    uint8_t winner;
+    uint8_t opening;
+    uint16_t moves_count;
+    uint8_t grid[FEED_CELLS];
+} feed_snapshot;
+
+/** function to create a feed, as its single publisher */
+feed* feed_open(const char* name);
+/** function to close a feed and remove its name */
+void feed_close(feed* f);
+/** function to publish the moves of a game from now on */
+bool feed_watch(feed* f, game* g);
+/** function to publish an event of a game */
+void feed_publish(feed* f, const game* g, uint8_t kind);
+/** function to map a feed for reading */
+const feed_shared* feed_attach(const char* name);
+/** function to unmap a feed */
+void feed_detach(const feed_shared* s);
+/** function to copy the board and state of a feed */
+void feed_read_snapshot(const feed_shared* s, feed_snapshot* snapshot);
+/** function to read an event of a feed by its sequence number */
+int feed_read(const feed_shared* s, uint64_t sequence, feed_event* e);
+#endif
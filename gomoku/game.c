@@ -1,672 +1,610 @@
-/** 
- * @file board.c
- * @author Jason Wang
- * This program will provide the following functions to manage game structs, implements the rule sets, and interacts with players
-*/
-
-#include "game.h"
-#include "error-codes.h"
-#include <stdio.h>
-#include <string.h>
-#include <unistd.h>
-/**
- * Saves a move in the game structure
- * @param g the Game structure pointer
- * @param x the x coordinate
- * @param y the y coordinate
-*/
-static void saveMove(game *g, unsigned char x, unsigned char y) {
-    if (g->moves_count == g->moves_capacity) {
-        g->moves_capacity *= 2;
-        g->moves = (move *) realloc(g->moves, g->moves_capacity * sizeof(move));
-    }
-    move newMove = {x, y, g->stone};
-    g->moves[(g->moves_count)++] = newMove;
-}
-
-/**
- * Checks if the game is finished by determing if there is a winning alignment
- * @param g the game struct pointer
- * @return code 1 if game is finished and there is a winner code 0 otherwise.
-*/
-static int isGameFinished(game *g) {
-    unsigned char size = g->board->size;
-    unsigned char* grid = g->board->grid;
-    unsigned char i, j;
-
-    // Check horizontal alignment
-    for (i = 0; i < size; i++) {
-        for (j = 0; j < size - 4; j++) {
-            unsigned char stone = grid[i * size + j];
-            if (stone != EMPTY_INTERSECTION && 
-                stone == grid[i * size + j + 1] && 
-                stone == grid[i * size + j + 2] && 
-                stone == grid[i * size + j + 3] && 
-                stone == grid[i * size + j + 4]) {
-                return 1;
-            }
-        }
-    }
-
-    // Check vertical alignment
-    for (i = 0; i < size - 4; i++) {
-        for (j = 0; j < size; j++) {
-            unsigned char stone = grid[i * size + j];
-            if (stone != EMPTY_INTERSECTION && 
-                stone == grid[(i + 1) * size + j] && 
-                stone == grid[(i + 2) * size + j] && 
-                stone == grid[(i + 3) * size + j] && 
-                stone == grid[(i + 4) * size + j]) {
-                return 1;
-            }
-        }
-    }
-
-    // Check diagonal alignment (top-left to bottom-right)
-    for (i = 0; i < size - 4; i++) {
-        for (j = 0; j < size - 4; j++) {
-            unsigned char stone = grid[i * size + j];
-            if (stone != EMPTY_INTERSECTION && 
-                stone == grid[(i + 1) * size + (j + 1)] && 
-                stone == grid[(i + 2) * size + (j + 2)] && 
-                stone == grid[(i + 3) * size + (j + 3)] && 
-                stone == grid[(i + 4) * size + (j + 4)]) {
-                return 1;
-            }
-        }
-    }
-
-    // Check diagonal alignment (top-right to bottom-left)
-    for (i = 0; i < size - 4; i++) {
-        for (j = 4; j < size; j++) {
-            unsigned char stone = grid[i * size + j];
-            if (stone != EMPTY_INTERSECTION && 
-                stone == grid[(i + 1) * size + (j - 1)] && 
-                stone == grid[(i + 2) * size + (j - 2)] && 
-                stone == grid[(i + 3) * size + (j - 3)] && 
-                stone == grid[(i + 4) * size + (j - 4)]) {
-                return 1;
-            }
-        }
-    }
-
-    return 0; // Game is not finished
-}
-
-/**
- * counts the number of consecutive stones in a line on the gird
- * @param grid the grid
- * @param size the size of the grid
- * @param x the starting x coord
- * @param y the starting y coord
- * @param dx the x direction
- * @param dy the y direction
- * @param stone the Stone value
- * @return the number of consecutive stones in line
-*/
-static int countLine(const unsigned char* grid, unsigned char size, int x, int y, int dx, int dy, unsigned char stone) {
-    int count = 0;
-    int i, j;
-
-    for (i = x + dx, j = y + dy; i >= 0 && i < size && j >= 0 && j < size; i += dx, j += dy) {
-        if (grid[i * size + j] == stone) {
-            count++;
-        } else {
-            break;
-        }
-    }
-
-    return count;
-}
-
-/**
- * Checks if there is a winning four stones on the grid
- * @param grid the game grid
- * @param x the x coordinates
- * @param y the y coordinate
- * @param stone the stone value to check
- * @return code 1 if there is a winner return code 0 otherwise
-*/
-static int isFour(const unsigned char* grid, unsigned char size, int x, int y, unsigned char stone) {
-    int count = 0;
-
-    // Check horizontal
-    count += countLine(grid, size, x, y, 0, 1, stone) + countLine(grid, size, x, y, 0, -1, stone);
-    //printf("Count after horizontal = %d\n", count);
-    if (count == 4) {
-        return 1;
-    }
-    count = 0;
-    // Check vertical
-    count += countLine(grid, size, x, y, 1, 0, stone) + countLine(grid, size, x, y, -1, 0, stone);
-    //printf("Count after vertical = %d\n", count);
-    if (count == 4) {
-        return 1;
-    }
-    count = 0;
-    // Check diagonal (top-left to bottom-right)
-    count += countLine(grid, size, x, y, 1, 1, stone) + countLine(grid, size, x, y, -1, -1, stone);
-    //printf("Count after TL-BR = %d\n", count);
-    if (count == 4) {
-        return 1;
-    }
-    count = 0;
-    // Check diagonal (top-right to bottom-left)
-    count += countLine(grid, size, x, y, 1, -1, stone) + countLine(grid, size, x, y, -1, 1, stone);
-    //printf("Count after TR-BL = %d\n", count);
-    if (count == 4) {
-        return 1;
-    }
-    return 0;
-}
-
-/**
- * Checks if there is an overline which is a winning alignment of more than 5 stones
- * @param grid the game grid
- * @param size the size of the game grid
- * @param x the x coordinates
- * @param y the y coordinates
- * @param stone the stone value
- * @return code 1 if there is a winner code 0 otherwise
-*/
-static int isOverline(const unsigned char* grid, unsigned char size, int x, int y, unsigned char stone) {
-    // Check horizontal
-    if (countLine(grid, size, x, y, 0, 1, stone) + countLine(grid, size, x, y, 0, -1, stone) >= 5) {
-        //printf("Horizontal\n");
-        return 1;
-    }
-
-    // Check vertical
-    if (countLine(grid, size, x, y, 1, 0, stone) + countLine(grid, size, x, y, -1, 0, stone) >= 5) {
-        //printf("Vertical\n");
-        return 1;
-    }
-
-    // Check diagonal (top-left to bottom-right)
-    if (countLine(grid, size, x, y, 1, 1, stone) + countLine(grid, size, x, y, -1, -1, stone) >= 5) {
-        //printf("TL-BR\n");
-        return 1;
-    }
-
-    // Check diagonal (top-right to bottom-left)
-    if (countLine(grid, size, x, y, 1, -1, stone) + countLine(grid, size, x, y, -1, 1, stone) >= 5) {
-        //printf("TR-BL\n");
-        return 1;
-    }
-
-    return 0;
-}
-
-/**
- * Checks if the move is forbidden in the game based on coordinates
- * @param g the game struct pointer
- * @param x the x coordinate
- * @param y the y coordinate
- * @return 1 if the move is forbidden 0 otherwise.
-*/
-int isMoveForbidden(game *g, int x, int y) {
-    //printf("in isMoveForbidden for x=%c, y = %d\n", x, y);
-    unsigned char size = g->board->size;
-    unsigned char* grid = g->board->grid;
-    int xGrid = y - 1;
-    int yGrid = x - 'A';
-
-    // Check if the move creates at least two open fours
-    if (isFour(grid, size, xGrid, yGrid, BLACK_STONE) >= 2) {
-        //printf("isFOur\n");
-        return 1;
-    }
-
-    // Check if the move creates at least one overline
-    if (isOverline(grid, size, xGrid, yGrid, BLACK_STONE)) {
-        //printf("Overline\n");
-        return 1;
-    }
-
-    return 0;
-}
-
-/**
- * Checks if the move is forbideen in the game based on coordinates
- * @param g the game struct pointer
- * @param x the x coordinate
- * @param y the y coordinate
- * @return 1 if foribbiden 0 if otherwise.
-*/
-int isMoveForbidden2(game *g, int x, int y) {
-    // check horizontally
-    // check same row, left
-    int blackStonesToLeft = 0;
-    int isEmpyLeftEnd = 0;
-    int xL = x - 1;
-    while (xL >= 'A') {
-        if (board_get(g->board, xL, y) == BLACK_STONE) {
-            blackStonesToLeft++;
-        } else {
-            break;
-        }
-        xL--;
-    }
-    if (xL >= 'A') {
-        if (board_get(g->board, xL, y) == EMPTY_INTERSECTION) {
-            isEmpyLeftEnd = 1;
-        }
-    }
-    // check same row, right
-    int blackStonesToRight = 0;
-    int isEmpyRightEnd = 0;
-    int xR = x + 1;
-    while (xL < 'A' + g->board->size) {
-        if (board_get(g->board, xR, y) == BLACK_STONE) {
-            blackStonesToRight++;
-        } else {
-            break;
-        }
-        xR++;
-    }
-    if (xL < 'A' + g->board->size) {
-        if (board_get(g->board, xR, y) == EMPTY_INTERSECTION) {
-            isEmpyRightEnd = 1;
-        }
-    }
-    if (1 + blackStonesToLeft + blackStonesToRight == 4 && isEmpyLeftEnd && isEmpyRightEnd) {
-        return 1;
-    }
-
-    // check vertically
-
-    // check same column, up
-    int blackStonesUp = 0;
-    int isEmptyUpEnd = 0;
-    int yU = y + 1;
-    while (yU <= g->board->size) {
-        if (board_get(g->board, x, yU) == BLACK_STONE) {
-            blackStonesUp++;
-        } else {
-            break;
-        }
-        yU++;
-    }
-    if (yU <= g->board->size) {
-        if (board_get(g->board, x, yU) == EMPTY_INTERSECTION) {
-            isEmptyUpEnd = 1;
-        }
-    }
-
-    // check same column, down
-    int blackStonesDown = 0;
-    int isEmptyDownEnd = 0;
-    int yD = y - 1;
-    while (yD > 0) {
-        if (board_get(g->board, x, yD) == BLACK_STONE) {
-            blackStonesDown++;
-        } else {
-            break;
-        }
-        yD--;
-    }
-    if (yD > 0) {
-        if (board_get(g->board, x, yD) == EMPTY_INTERSECTION) {
-            isEmptyDownEnd = 1;
-        }
-    }
-    if (1 + blackStonesUp + blackStonesDown == 4 && isEmptyUpEnd && isEmptyDownEnd) {
-        return 1;
-    }
-
-    // check diagonally bottom left to top right
-    // decrease row, decrease column
-    int blackStonesLeftDown = 0;
-    int isEmptyLeftDownEnd = 0;
-    int xLD = x - 1;
-    int yLD = y - 1;
-    while (xLD >= 'A' && yLD > 0) {
-        if (board_get(g->board, xLD, yLD) == BLACK_STONE) {
-            blackStonesLeftDown++;
-        } else {
-            break;
-        }
-        xLD--;
-        yLD--;
-    }
-    if (xLD >= 'A' && yLD > 0) {
-        if (board_get(g->board, xLD, yLD) == EMPTY_INTERSECTION) {
-            isEmptyLeftDownEnd = 1;
-        }
-    }
-    // increase row, increase column
-    int blackStonesRightUp = 0;
-    int isEmptyRightUpEnd = 0;
-    int xRU = x + 1;
-    int yRU = y + 1;
-    while (xRU < 'A' + g->board->size && yRU <= g->board->size) {
-        if (board_get(g->board, xRU, yRU) == BLACK_STONE) {
-            blackStonesRightUp++;
-        } else {
-            break;
-        }
-        xRU++;
-        yRU++;
-    }
-    if (xRU < 'A' + g->board->size && yRU <= g->board->size) {
-        if (board_get(g->board, xRU, yRU) == EMPTY_INTERSECTION) {
-            isEmptyRightUpEnd = 1;
-        }
-    }
-    if (blackStonesLeftDown + blackStonesRightUp + 1 == 4 && isEmptyLeftDownEnd && isEmptyRightUpEnd) {
-        return 1;
-    }
-
-    // check diagonally bottom right to top left
-    // increase row, decrease column
-    int blackStonesLeftUp = 0;
-    int isEmptyLeftUpEnd = 0;
-    int xLU = x - 1;
-    int yLU = y + 1;
-    while (xLU >= 'A' && yLU <= g->board->size) {
-        if (board_get(g->board, xLU, yLU) == BLACK_STONE) {
-            blackStonesLeftUp++;
-        } else {
-            break;
-        }
-        xLU--;
-        yLU++;
-    }
-    if (xLU >= 'A' && yLU <= g->board->size) {
-        if (board_get(g->board, xLU, yLU) == EMPTY_INTERSECTION) {
-            isEmptyLeftUpEnd = 1;
-        }
-    }
-    // decrease row, increase column
-    int blackStonesRightDown = 0;
-    int isEmptyRightDownEnd = 0;
-    int xRD = x + 1;
-    int yRD = y - 1;
-    while (xRD < 'A' + g->board->size && yRD > 0) {
-        if (board_get(g->board, xRD, yRD) == BLACK_STONE) {
-            blackStonesRightDown++;
-        } else {
-            break;
-        }
-        xRD++;
-        yRD--;
-    }
-    if (xRD < 'A' + g->board->size && yRD > 0) {
-        if (board_get(g->board, xRD, yRD) == EMPTY_INTERSECTION) {
-            isEmptyRightDownEnd = 1;
-        }
-    }
-
-    if (blackStonesLeftUp + blackStonesRightDown + 1 == 4 && isEmptyLeftUpEnd && isEmptyRightDownEnd) {
-        return 1;
-    }
-    return 0;
-}
-
-/**
- * Creates a new game with the specified board size and game type
- * @param board_size the size of the game board
- * @param game_type the type of the game
- * @return A pointer to the new game or null if malloc fails.
-*/
-game* game_create(unsigned char board_size, unsigned char game_type) {
-    game *newGame = (game *) malloc (sizeof(game));
-    if (!newGame) {
-        return NULL;
-    }
-    newGame->board = board_create(board_size);
-    newGame->type = game_type;
-    newGame->stone = BLACK_STONE;
-    newGame->state = GAME_STATE_PLAYING;
-    newGame->winner = EMPTY_INTERSECTION;
-    newGame->moves = (move *) malloc(16 * sizeof(move));
-    if (!newGame->moves) {
-        board_delete(newGame->board);
-        free(newGame);
-        return NULL;
-    }
-    newGame->moves_capacity = 16;
-    newGame->moves_count = 0;
-
-    return newGame;
-}
-
-/**
- * Deletes the game
- * @param g the pointer to the game
-*/
-void game_delete(game* g) {
-    if (!g) {
-        exit(NULL_POINTER_ERR);
-    }
-    board_delete(g->board);
-    free(g->moves);
-    free(g);
-}
-
-/**
- * Updates the game state by processing moves and completion
- * @param g the game struct pointer
- * @return true if the game is succesfully updated, false otherwise.
-*/
-bool game_update(game* g) {
-    if (g->state != GAME_STATE_PLAYING) {
-        return false;
-    }
-    bool hasUserIntroducedAValidMove = false;
-    while (!hasUserIntroducedAValidMove) {
-        // Prompt
-        if (g->stone == BLACK_STONE) {
-            printf("Black stone's turn, please enter a move: ");
-        } else {
-            printf("White stone's turn, please enter a move: ");
-        }
-        // Read user input
-        char input[50] = {0};
-        int pos = 0;
-        char inputChar = getchar();
-        while (inputChar != EOF && inputChar != '\n') {
-            input[pos++] = inputChar;
-            inputChar = getchar();
-        }
-        if (inputChar == EOF) {
-            if (strlen(input) > 0) {
-                // run one more round
-                unsigned char x, y;
-                if (!(board_coord(g->board, input, &x, &y) == SUCCESS)) {
-                    printf("The coordinate you entered is invalid, please try again.\n");
-                    printf("The game is stopped.\n");
-                    g->state = GAME_STATE_STOPPED;
-                    return false;
-                }
-                if (board_get(g->board, x, y) != EMPTY_INTERSECTION) {
-                    printf("There is already a stone at the coordinate you entered, please try again.\n");
-                    printf("The game is stopped.\n");
-                    g->state = GAME_STATE_STOPPED;
-                    return false;
-                }
-                saveMove(g, x, y);
-                board_set(g->board, x, y, g->stone);
-                board_print(g->board, true);
-                if (g->type == GAME_RENJU && g->stone == BLACK_STONE) {
-                    if (isMoveForbidden(g, x, y)) {
-                        printf("Game concluded, black made a forbidden move, white won.\n");
-                        g->state = GAME_STATE_FORBIDDEN;
-                        g->winner = WHITE_STONE;
-                        return false;
-                    }
-                }
-                if (isGameFinished(g)) {
-                    char *winnerStr = g->stone == BLACK_STONE ? "black" : "white";
-                    printf("Game concluded, %s won.\n", winnerStr);
-                    g->state = GAME_STATE_FINISHED;
-                    g->winner = g->stone;
-                    return false;
-                }
-                if (board_is_full(g->board)) {
-                    printf("Game concluded, the board is full, draw.\n");
-                    g->state = GAME_STATE_FINISHED;
-                    return true;
-                }
-                g->stone = (g->stone == BLACK_STONE ? WHITE_STONE : BLACK_STONE);
-                if (g->stone == BLACK_STONE) {
-                    printf("Black stone's turn, please enter a move: ");
-                } else {
-                    printf("White stone's turn, please enter a move: ");
-                }
-            }
-            printf("The game is stopped.\n");
-            g->state = GAME_STATE_STOPPED;
-            return false;
-        }
-        unsigned char x, y;
-        if (!(board_coord(g->board, input, &x, &y) == SUCCESS)) {
-            printf("The coordinate you entered is invalid, please try again.\n");
-            continue;
-        }
-        if (game_place_stone(g, x, y)) {
-            hasUserIntroducedAValidMove = true;
-        }
-    }
-    return true;
-}
-
-/**
- * Runs the game loop continuously updating state and printing the board
- * @param g the game structure pointer
-*/
-void game_loop(game* g) {
-    board_print(g->board, true);
-    int gameOn = game_update(g);
-    while (gameOn) {
-        //printf("gameON\n");
-        if (g->winner) {
-            break;
-        }
-        board_print(g->board, true);
-        gameOn = game_update(g);
-    }
-}
-
-/**
- * Resumes the game
- * @param g the game structure pointer
-*/
-void game_resume(game* g) {
-    if (g->state != GAME_STATE_STOPPED) {
-        exit(RESUME_ERR);
-    }
-    g->state = GAME_STATE_PLAYING;
-    game_loop(g);
-}
-
-/**
- * Replays the game
- * @param g the game structure pointer
-*/
-void game_replay(game* g) {
-    game *ng = game_create(g->board->size, g->type);
-
-    move firstMove = g->moves[0];
-    saveMove(ng, firstMove.x, firstMove.y);
-    board_set(ng->board, firstMove.x, firstMove.y, ng->stone);
-    ng->stone = (ng->stone == BLACK_STONE ? WHITE_STONE : BLACK_STONE);
-    board_print(ng->board, true);
-    char buffer[50];
-    board_formal_coord(ng->board, firstMove.x, firstMove.y, buffer);
-    printf("Moves:\n");
-    printf("Black: %3s", buffer);
-    //sleep(1);
-    int finishEarlier = 0;
-    for (int i = 1; i < g->moves_count; i++) {
-        saveMove(ng, g->moves[i].x, g->moves[i].y);
-        board_set(ng->board, g->moves[i].x, g->moves[i].y, ng->stone);
-        board_print(ng->board, true);
-        if (ng->type == GAME_RENJU && ng->stone == BLACK_STONE) {
-            if (isMoveForbidden(ng, ng->moves[i].x, ng->moves[i].y)) {
-                printf("Game concluded, black made a forbidden move, white won.\n");
-                ng->state = GAME_STATE_FORBIDDEN;
-                ng->winner = WHITE_STONE;
-                finishEarlier = 1;
-            }
-        }
-        if (!finishEarlier) {
-            if (isGameFinished(ng)) {
-                char *winnerStr = ng->stone == BLACK_STONE ? "black" : "white";
-                printf("Game concluded, %s won.\n", winnerStr);
-                ng->state = GAME_STATE_FINISHED;
-                ng->winner = g->stone;
-                finishEarlier = 1;
-            }
-        }
-        if (!finishEarlier) {
-            if (board_is_full(ng->board)) {
-                printf("Game concluded, the board is full, draw.\n");
-                ng->state = GAME_STATE_FINISHED;
-                finishEarlier = 1;
-            }
-        }
-        ng->stone = (ng->stone == BLACK_STONE ? WHITE_STONE : BLACK_STONE);
-        if (i == g->moves_count - 1 && !finishEarlier) {
-            printf("The game is stopped.\n");
-            finishEarlier = 1;
-        }
-        //sleep(1);
-        int lastBlack = 0;
-        printf("Moves:\n");
-        for (int j = 0; j < ng->moves_count; j++) {
-            char buffer[50];
-            board_formal_coord(ng->board, ng->moves[j].x, ng->moves[j].y, buffer);
-            if (j % 2 == 0) {
-                printf("Black: %3s", buffer);
-                lastBlack = 1;
-            } else {
-                printf("  White: %3s\n", buffer);
-                lastBlack = 0;
-            }
-        }
-        if (finishEarlier && lastBlack) {
-            printf("\n");
-        }
-    }
-    game_delete(ng);  
-}
-
-/**
- * Places a stone at the specified location
- * @param g the game structure pointer
- * @param x the x coordinate to place
- * @param y the y coordinate to place
- * @return true if success, false otherwise.
-*/
-bool game_place_stone(game* g, unsigned char x, unsigned char y) {
-    if (board_get(g->board, x, y) != EMPTY_INTERSECTION) {
-        printf("There is already a stone at the coordinate you entered, please try again.\n");
-        return false;
-    }
-    saveMove(g, x, y);
-    board_set(g->board, x, y, g->stone);
-    if (g->type == GAME_RENJU && g->stone == BLACK_STONE) {
-        if (isMoveForbidden(g, x, y)) {
-            board_print(g->board, true);
-            printf("Game concluded, black made a forbidden move, white won.\n");
-            g->state = GAME_STATE_FORBIDDEN;
-            g->winner = WHITE_STONE;
-            return true;
-        }
-    }
-    if (isGameFinished(g)) {
-        char *winnerStr = g->stone == BLACK_STONE ? "black" : "white";
-        printf("Game concluded, %s won.\n", winnerStr);
-        g->state = GAME_STATE_FINISHED;
-        g->winner = g->stone;
-        return true;
-    }
-    if (board_is_full(g->board)) {
-        printf("Game concluded, the board is full, draw.\n");
-        g->state = GAME_STATE_FINISHED;
-        return true;
-    }
-    g->stone = (g->stone == BLACK_STONE ? WHITE_STONE : BLACK_STONE);
-    return true;
-}
\ No newline at end of file
+/** 
+ * @file board.c
+ * @author Jason Wang
+ * This program will provide the following functions to manage game structs, implements the rule sets, and interacts with players
+*/
+
+#include "game.h"
+#include "rules.h"
+#include "search.h"
+#include "book.h"
+#include "ponder.h"
+#include "heatmap.h"
+#include "error-codes.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+/**
+ * Saves a move in the game structure
+ * @param g the Game structure pointer
+ * @param cell the grid index
+*/
+static void saveMove(game *g, uint16_t cell) {
+    if (g->moves_count == g->moves_capacity) {
+        g->moves_capacity *= 2;
+        g->moves = (move *) realloc(g->moves, g->moves_capacity * sizeof(move));
+    }
+    move newMove = {cell, g->stone};
+    g->moves[(g->moves_count)++] = newMove;
+}
+
+/**
+ * Tells the listeners of a game that a stone was placed, in the order they were added
+ * @param g the Game structure pointer
+*/
+static void notifyListeners(game* g) {
+    for (int i = 0; i < g->listeners_count; i++) {
+        g->listeners[i](g, g->listener_contexts[i]);
+    }
+}
+
+/**
+ * Creates a new game with the specified board size and game type, selecting the rules of the variant once
+ * @param board_size the size of the game board
+ * @param game_type the type of the game
+ * @return A pointer to the new game or null if malloc fails or the type is not a variant.
+*/
+game* game_create(unsigned char board_size, unsigned char game_type) {
+    const game_rules* rules = rules_select(game_type);
+    game *newGame = rules ? (game *) malloc (sizeof(game)) : NULL;
+    if (!newGame) {
+        return NULL;
+    }
+    newGame->board = board_create(board_size);
+    newGame->type = game_type;
+    newGame->rules = rules;
+    newGame->opening = 0;
+    newGame->swapped = false;
+    newGame->stone = BLACK_STONE;
+    newGame->state = GAME_STATE_PLAYING;
+    newGame->winner = EMPTY_INTERSECTION;
+    newGame->moves = (move *) malloc(16 * sizeof(move));
+    if (!newGame->moves) {
+        board_delete(newGame->board);
+        free(newGame);
+        return NULL;
+    }
+    newGame->moves_capacity = 16;
+    newGame->moves_count = 0;
+    newGame->listeners_count = 0;
+
+    return newGame;
+}
+
+/**
+ * Deletes the game
+ * @param g the pointer to the game
+*/
+void game_delete(game* g) {
+    if (!g) {
+        exit(NULL_POINTER_ERR);
+    }
+    board_delete(g->board);
+    free(g->moves);
+    free(g);
+}
+
+/**
+ * Prints the best moves of the position with their scores and principal variations, searched within a time budget
+ * and starting from the persistent cache of GOMOKU_CACHE when it knows the position, then the intersections of the
+ * threat heatmap with the most stones on their lines
+ * @param g the game structure pointer
+ * @param lines the number of moves to print
+ * @param seconds the time budget
+*/
+static void analyzePosition(game* g, size_t lines, double seconds) {
+    const char* bookPath = getenv(PONDER_BOOK_VARIABLE);
+    book* openings = bookPath ? book_open(bookPath) : NULL;
+    if (openings) {
+        book_move moves[BOOK_MAX_MOVES];
+        size_t count = book_probe(openings, g, moves, lines < BOOK_MAX_MOVES ? lines : BOOK_MAX_MOVES);
+        for (size_t i = 0; i < count; i++) {
+            char coord[BOARD_COORD_LEN];
+            board_formal_coord(g->board, moves[i].cell, coord);
+            printf("Book %-4s %5.1f%% over %.1f games (%.1f wins, %.1f draws, %.1f losses)\n", coord,
+                   100 * book_expectation(&moves[i]), moves[i].wins + moves[i].draws + moves[i].losses, moves[i].wins,
+                   moves[i].draws, moves[i].losses);
+        }
+        book_close(openings);
+    }
+    search* s = search_create(16u << 20);
+    search_result results[GAME_ANALYZE_MAX_LINES];
+    if (!s) {
+        exit(NULL_POINTER_ERR);
+    }
+    s->persistent = ponder_cache();
+    size_t count = search_analyze(s, g, lines, SEARCH_MAX_DEPTH, seconds, results);
+    if (count > 0) {
+        printf("Depth %d, %llu nodes in %.2f s (%.0f nodes/s)\n", results[0].depth, (unsigned long long) results[0].nodes,
+               results[0].seconds, results[0].seconds > 0 ? results[0].nodes / results[0].seconds : 0.0);
+    }
+    for (size_t i = 0; i < count; i++) {
+        char coord[BOARD_COORD_LEN];
+        char score[SEARCH_SCORE_LEN];
+        search_format_score(results[i].score, score);
+        board_formal_coord(g->board, results[i].cell, coord);
+        printf("%2zu. %-4s %-10s", i + 1, coord, score);
+        for (size_t j = 0; j < results[i].pv_count; j++) {
+            board_formal_coord(g->board, results[i].pv[j].cell, coord);
+            printf(" %s", coord);
+        }
+        printf("\n");
+    }
+    search_delete(s);
+    heatmap h;
+    uint16_t spots[BOARD_MAX_CELLS];
+    heatmap_compute(g->board, g->stone, &h);
+    size_t spotsCount = heatmap_candidates(g->board, g->stone, spots);
+    if (spotsCount > 0) {
+        printf("Most stones within %d:", HEATMAP_DISTANCE);
+    }
+    for (size_t i = 0; i < spotsCount && i < GAME_HINT_SPOTS; i++) {
+        char coord[BOARD_COORD_LEN];
+        int index = HEATMAP_INDEX(&h, BOARD_COL(g->board, spots[i]), BOARD_ROW(g->board, spots[i]));
+        board_formal_coord(g->board, spots[i], coord);
+        printf(" %s (%u own, %u opponent)", coord, h.own[index], h.opponent[index]);
+    }
+    if (spotsCount > 0) {
+        printf("\n");
+    }
+}
+
+/**
+ * Reads a line typed by the player without its newline; the part of a longer line that does not fit is dropped
+ * @param input the buffer
+ * @param len the size of the buffer
+ * @return false if the input ended before the line, true otherwise, even for a last line without a newline
+*/
+static bool readInput(char* input, size_t len) {
+    size_t pos = 0;
+    int inputChar = getchar();
+    if (inputChar == EOF) {
+        return false;
+    }
+    while (inputChar != EOF && inputChar != '\n') {
+        if (pos + 1 < len) {
+            input[pos++] = (char) inputChar;
+        }
+        inputChar = getchar();
+    }
+    input[pos] = '\0';
+    return true;
+}
+
+/**
+ * Prints how a game ended, if it did
+ * @param state the game state
+ * @param winner the winner
+*/
+static void printResult(unsigned char state, unsigned char winner) {
+    if (state == GAME_STATE_FORBIDDEN) {
+        printf("Game concluded, black made a forbidden move, white won.\n");
+    } else if (state == GAME_STATE_FINISHED && winner != EMPTY_INTERSECTION) {
+        char *winnerStr = winner == BLACK_STONE ? "black" : "white";
+        printf("Game concluded, %s won.\n", winnerStr);
+    } else if (state == GAME_STATE_FINISHED) {
+        printf("Game concluded, the board is full, draw.\n");
+    } else if (state == GAME_STATE_DRAWN) {
+        printf("Game concluded, neither side can make five, draw.\n");
+    }
+}
+
+/**
+ * Updates the game state by processing moves and completion. A last line without a newline is played like any
+ * other; the game stops when the input ends.
+ * @param g the game struct pointer
+ * @return true if the game is succesfully updated, false otherwise.
+*/
+bool game_update(game* g) {
+    if (g->state != GAME_STATE_PLAYING) {
+        return false;
+    }
+    bool hasUserIntroducedAValidMove = false;
+    while (!hasUserIntroducedAValidMove) {
+        const char* offer = g->rules->opening_offer(g);
+        if (offer) {
+            printf("%s\n", offer);
+        }
+        // Prompt
+        if (g->stone == BLACK_STONE) {
+            printf("Black stone's turn, please enter a move: ");
+        } else {
+            printf("White stone's turn, please enter a move: ");
+        }
+        // Read user input
+        char input[50];
+        if (!readInput(input, sizeof(input))) {
+            printf("The game is stopped.\n");
+            g->state = GAME_STATE_STOPPED;
+            return false;
+        }
+        int lines = GAME_ANALYZE_LINES;
+        if (strcmp(input, "hint") == 0) {
+            analyzePosition(g, GAME_HINT_LINES, GAME_HINT_SECONDS);
+            continue;
+        }
+        if (strcmp(input, "analyze") == 0 || (sscanf(input, "analyze %d", &lines) == 1 && lines > 0)) {
+            analyzePosition(g, lines < GAME_ANALYZE_MAX_LINES ? lines : GAME_ANALYZE_MAX_LINES, GAME_ANALYZE_SECONDS);
+            continue;
+        }
+        bool swapped = g->swapped;
+        if (g->rules->opening_choose(g, input)) {
+            if (g->swapped != swapped) {
+                printf("The players swapped colors.\n");
+            }
+            return true;
+        }
+        uint16_t cell;
+        if (!(board_coord(g->board, input, &cell) == SUCCESS)) {
+            printf("The coordinate you entered is invalid, please try again.\n");
+            continue;
+        }
+        if (game_place_stone(g, cell)) {
+            hasUserIntroducedAValidMove = true;
+        }
+    }
+    return true;
+}
+
+/**
+ * Plays one word of batch input: an opening choice or a move
+ * @param g the game structure pointer
+ * @param word the word, null-terminated
+ * @param report true to print a status line for the move
+ * @return true if the word was played, false if it is not a coordinate of an empty intersection
+*/
+static bool playWord(game* g, const char* word, bool report) {
+    if (g->rules->opening_choose(g, word)) {
+        if (report) {
+            printf("%zu %s\n", g->moves_count, word);
+        }
+        return true;
+    }
+    uint16_t cell;
+    if (board_coord(g->board, word, &cell) != SUCCESS || board_get(g->board, cell) != EMPTY_INTERSECTION) {
+        printf("Move %zu is invalid: %s\n", g->moves_count + 1, word);
+        return false;
+    }
+    unsigned char stone = g->stone;
+    game_play(g, cell);
+    notifyListeners(g);
+    if (report) {
+        char formalCoord[BOARD_COORD_LEN];
+        board_formal_coord(g->board, cell, formalCoord);
+        printf("%zu %s %s\n", g->moves_count, stone == BLACK_STONE ? "black" : "white", formalCoord);
+    }
+    return true;
+}
+
+/**
+ * Plays the moves of a non-interactive input, separated by any whitespace, without prompts or boards.
+ * The input is read in large blocks and split in place; a word cut at the end of a block is carried to the next.
+ * Reading stops when the game ends, at the first word that is not a playable move, or at the end of the input,
+ * which stops the game. Only how the game ended is printed, after a line per move if asked.
+ * @param g the game structure pointer, playing
+ * @param fd the file descriptor of the input
+ * @param report true to print a status line for each move
+ * @return true if every word of the input up to the end of the game was played
+*/
+bool game_batch(game* g, int fd, bool report) {
+    char buffer[GAME_BATCH_BUFFER];
+    char word[BOARD_COORD_LEN + 1];
+    size_t wordLen = 0;
+    bool played = true;
+    ssize_t n;
+    while (played && g->state == GAME_STATE_PLAYING && (n = read(fd, buffer, sizeof(buffer))) > 0) {
+        for (ssize_t i = 0; i < n && played && g->state == GAME_STATE_PLAYING; i++) {
+            char c = buffer[i];
+            if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+                // like a long line typed by a player, a long word keeps only its first characters
+                if (wordLen < BOARD_COORD_LEN) {
+                    word[wordLen++] = c;
+                }
+            } else if (wordLen > 0) {
+                word[wordLen] = '\0';
+                wordLen = 0;
+                played = playWord(g, word, report);
+            }
+        }
+    }
+    if (played && g->state == GAME_STATE_PLAYING && wordLen > 0) {
+        word[wordLen] = '\0';
+        played = playWord(g, word, report);
+    }
+    if (g->state == GAME_STATE_PLAYING) {
+        printf("The game is stopped.\n");
+        g->state = GAME_STATE_STOPPED;
+    } else {
+        printResult(g->state, g->winner);
+    }
+    return played;
+}
+
+/**
+ * Runs the game loop continuously updating state and printing the board
+ * @param g the game structure pointer
+*/
+void game_loop(game* g) {
+    board_print(g->board, true);
+    int gameOn = game_update(g);
+    while (gameOn) {
+        //printf("gameON\n");
+        if (g->winner) {
+            break;
+        }
+        board_print(g->board, true);
+        gameOn = game_update(g);
+    }
+}
+
+/**
+ * Resumes the game
+ * @param g the game structure pointer
+*/
+void game_resume(game* g) {
+    if (g->state != GAME_STATE_STOPPED) {
+        exit(RESUME_ERR);
+    }
+    g->state = GAME_STATE_PLAYING;
+    game_loop(g);
+}
+
+/**
+ * Replays the game, making its opening choices again after the stones they followed
+ * @param g the game structure pointer
+*/
+void game_replay(game* g) {
+    game *ng = game_create(g->board->size, g->type);
+
+    move firstMove = g->moves[0];
+    game_play(ng, firstMove.cell);
+    board_print(ng->board, true);
+    char buffer[50];
+    board_formal_coord(ng->board, firstMove.cell, buffer);
+    printf("Moves:\n");
+    printf("Black: %3s", buffer);
+    //sleep(1);
+    int finishEarlier = 0;
+    for (int i = 1; i < g->moves_count; i++) {
+        unsigned char stone = ng->stone;
+        game_play(ng, g->moves[i].cell);
+        board_print(ng->board, true);
+        if (!finishEarlier && ng->state == GAME_STATE_FORBIDDEN) {
+            printf("Game concluded, black made a forbidden move, white won.\n");
+            finishEarlier = 1;
+        } else if (!finishEarlier && ng->state == GAME_STATE_FINISHED && ng->winner != EMPTY_INTERSECTION) {
+            char *winnerStr = stone == BLACK_STONE ? "black" : "white";
+            printf("Game concluded, %s won.\n", winnerStr);
+            finishEarlier = 1;
+        } else if (!finishEarlier && ng->state == GAME_STATE_FINISHED) {
+            printf("Game concluded, the board is full, draw.\n");
+            finishEarlier = 1;
+        } else if (!finishEarlier && ng->state == GAME_STATE_DRAWN) {
+            printf("Game concluded, neither side can make five, draw.\n");
+            finishEarlier = 1;
+        }
+        if (i == g->moves_count - 1 && !finishEarlier) {
+            printf("The game is stopped.\n");
+            finishEarlier = 1;
+        }
+        const char* choice = g->rules->opening_choice(g->opening, g->swapped, ng->moves_count);
+        if (choice && ng->rules->opening_choose(ng, choice) && ng->swapped) {
+            printf("The players swapped colors.\n");
+        }
+        //sleep(1);
+        int lastBlack = 0;
+        printf("Moves:\n");
+        for (int j = 0; j < ng->moves_count; j++) {
+            char buffer[50];
+            board_formal_coord(ng->board, ng->moves[j].cell, buffer);
+            if (j % 2 == 0) {
+                printf("Black: %3s", buffer);
+                lastBlack = 1;
+            } else {
+                printf("  White: %3s\n", buffer);
+                lastBlack = 0;
+            }
+        }
+        if (finishEarlier && lastBlack) {
+            printf("\n");
+        }
+    }
+    game_delete(ng);  
+}
+
+/**
+ * Places a stone at the specified location and tells the listeners of the game, such as a journal
+ * @param g the game structure pointer
+ * @param cell the grid index to place
+ * @return true if success, false otherwise.
+*/
+bool game_place_stone(game* g, uint16_t cell) {
+    if (board_get(g->board, cell) != EMPTY_INTERSECTION) {
+        printf("There is already a stone at the coordinate you entered, please try again.\n");
+        return false;
+    }
+    game_play(g, cell);
+    notifyListeners(g);
+    if (g->state == GAME_STATE_FORBIDDEN) {
+        board_print(g->board, true);
+    }
+    printResult(g->state, g->winner);
+    return true;
+}
+
+/**
+ * Plays a move on an empty intersection without any output, applying the rules of the variant of the game.
+ * Only the lines through the new stone are checked for a win, which makes this the move path for engines and tools.
+ * The game is drawn as soon as every line of five intersections holds stones of both colors.
+ * @param g the game structure pointer
+ * @param cell the grid index to place
+ * @return the state of the game after the move
+*/
+unsigned char game_play(game* g, uint16_t cell) {
+    saveMove(g, cell);
+    board_set(g->board, cell, g->stone);
+    if (g->rules->is_forbidden(g->board, cell, g->stone)) {
+        g->state = GAME_STATE_FORBIDDEN;
+        g->winner = g->stone == BLACK_STONE ? WHITE_STONE : BLACK_STONE;
+        return g->state;
+    }
+    if (g->rules->is_win(g->board, cell, g->stone)) {
+        g->state = GAME_STATE_FINISHED;
+        g->winner = g->stone;
+        return g->state;
+    }
+    if (board_is_dead(g->board)) {
+        g->state = GAME_STATE_DRAWN;
+        return g->state;
+    }
+    if (g->moves_count == (size_t) g->board->size * g->board->size) {
+        g->state = GAME_STATE_FINISHED;
+        return g->state;
+    }
+    g->stone = (g->stone == BLACK_STONE ? WHITE_STONE : BLACK_STONE);
+    return g->state;
+}
+
+/**
+ * Adds a listener told of each stone placed in a game by a player, after the move is played
+ * @param g the game structure pointer
+ * @param listener the function called with the game and the context
+ * @param context the context of the listener
+ * @return true if success, false if the game has GAME_LISTENERS listeners already
+*/
+bool game_listen(game* g, void (*listener)(game* g, void* context), void* context) {
+    if (g->listeners_count == GAME_LISTENERS) {
+        return false;
+    }
+    g->listeners[g->listeners_count] = listener;
+    g->listener_contexts[g->listeners_count++] = context;
+    return true;
+}
+
+/**
+ * Creates an independent copy of a game, with its own board and move history but without an evaluator or listeners
+ * @param g the game structure pointer
+ * @return the copy or NULL if malloc fails
+*/
+game* game_clone(game* g) {
+    game *copy = game_create(g->board->size, g->type);
+    if (!copy) {
+        return NULL;
+    }
+    for (size_t i = 0; i < g->moves_count; i++) {
+        copy->stone = g->moves[i].stone;
+        saveMove(copy, g->moves[i].cell);
+        board_set(copy->board, g->moves[i].cell, g->moves[i].stone);
+    }
+    copy->stone = g->stone;
+    copy->opening = g->opening;
+    copy->swapped = g->swapped;
+    copy->state = g->state;
+    copy->winner = g->winner;
+    return copy;
+}
+
+/**
+ * Takes back the last move, giving the turn back to the player who made it and reopening the game
+ * @param g the game structure pointer
+*/
+void game_undo(game* g) {
+    if (g->moves_count == 0) {
+        return;
+    }
+    move last = g->moves[--g->moves_count];
+    board_unset(g->board, last.cell);
+    g->stone = last.stone;
+    g->state = GAME_STATE_PLAYING;
+    g->winner = EMPTY_INTERSECTION;
+}
+
+/**
+ * Places a stone on a sparse board and applies the freestyle rules: five or more in a row wins, and a bounded board
+ * that fills up is a draw
+ * @param b the sparse board
+ * @param x the x coordinate, of an empty intersection
+ * @param y the y coordinate, of an empty intersection
+ * @param winner the winner, set when the move wins
+ * @return the state of the game after the move
+*/
+static unsigned char playSparse(sparse_board* b, int x, int y, unsigned char* winner) {
+    unsigned char stone = b->moves_count % 2 == 0 ? BLACK_STONE : WHITE_STONE;
+    sparse_set(b, x, y, stone);
+    if (sparse_is_five(b, x, y)) {
+        *winner = stone;
+        return GAME_STATE_FINISHED;
+    }
+    if (b->size != SPARSE_UNBOUNDED && b->moves_count == (size_t) b->size * b->size) {
+        return GAME_STATE_FINISHED;
+    }
+    return GAME_STATE_PLAYING;
+}
+
+/**
+ * Runs the game loop of a freestyle game on a large or unbounded board kept by the sparse backend, printing the part
+ * of the board around the stones before every move. The game stops when the input ends.
+ * @param b the sparse board
+ * @param state the game state, playing on entry
+ * @param winner the winner
+*/
+void game_sparse_loop(sparse_board* b, unsigned char* state, unsigned char* winner) {
+    sparse_print(b, true);
+    while (*state == GAME_STATE_PLAYING) {
+        if (b->moves_count % 2 == 0) {
+            printf("Black stone's turn, please enter a move: ");
+        } else {
+            printf("White stone's turn, please enter a move: ");
+        }
+        char input[50];
+        if (!readInput(input, sizeof(input))) {
+            printf("The game is stopped.\n");
+            *state = GAME_STATE_STOPPED;
+            return;
+        }
+        int x, y;
+        if (board_parse_coord(input, &x, &y) != SUCCESS || !sparse_contains(b, x, y)) {
+            printf("The coordinate you entered is invalid, please try again.\n");
+            continue;
+        }
+        if (sparse_get(b, x, y) != EMPTY_INTERSECTION) {
+            printf("There is already a stone at the coordinate you entered, please try again.\n");
+            continue;
+        }
+        *state = playSparse(b, x, y, winner);
+        sparse_print(b, true);
+    }
+    printResult(*state, *winner);
+}
+
+/**
+ * Replays a large-board game, printing the part of the board around the stones after every move
+ * @param b the sparse board holding the moves of the game
+*/
+void game_sparse_replay(sparse_board* b) {
+    sparse_board* nb = sparse_create(b->size);
+    if (!nb) {
+        exit(NULL_POINTER_ERR);
+    }
+    unsigned char state = GAME_STATE_PLAYING;
+    unsigned char winner = EMPTY_INTERSECTION;
+    for (size_t i = 0; i < b->moves_count && state == GAME_STATE_PLAYING; i++) {
+        state = playSparse(nb, b->moves[i].x, b->moves[i].y, &winner);
+        sparse_print(nb, true);
+        printf("Moves:\n");
+        for (size_t j = 0; j <= i; j++) {
+            char buffer[BOARD_COORD_LEN];
+            board_format_coord(nb->moves[j].x, nb->moves[j].y, buffer);
+            printf(j % 2 == 0 ? "Black: %3s" : "  White: %3s\n", buffer);
+        }
+        if (i % 2 == 0) {
+            printf("\n");
+        }
+    }
+    if (state == GAME_STATE_PLAYING) {
+        printf("The game is stopped.\n");
+    } else {
+        printResult(state, winner);
+    }
+    sparse_delete(nb);
+}
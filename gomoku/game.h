@@ -1,30 +1,59 @@
 #ifndef _GAME_H
 #define _GAME_H
 #include "board.h"
+#include "sparse.h"
 #include <stdbool.h>
 #include <stdlib.h>
 #define GAME_FREESTYLE 0
 #define GAME_RENJU 1
+#define GAME_STANDARD 2
+#define GAME_CARO 3
+#define GAME_SWAP2 4
+/** number of rule variants, one more than the largest game type */
+#define GAME_VARIANTS 5
 #define GAME_STATE_PLAYING 0
 #define GAME_STATE_FORBIDDEN 1
 #define GAME_STATE_STOPPED 2
 #define GAME_STATE_FINISHED 3
+/** a draw declared as soon as neither color can make five anymore */
+#define GAME_STATE_DRAWN 4
+/** number of moves and time budget of the hint command */
+#define GAME_HINT_LINES 3
+#define GAME_HINT_SECONDS 1.0
+/** number of intersections of the threat heatmap listed by the hint and analyze commands */
+#define GAME_HINT_SPOTS 5
+/** default number of moves, largest number of moves and time budget of the analyze command */
+#define GAME_ANALYZE_LINES 5
+#define GAME_ANALYZE_MAX_LINES 20
+#define GAME_ANALYZE_SECONDS 3.0
+/** size of the blocks read from the input of a batch game */
+#define GAME_BATCH_BUFFER 65536
+/** largest number of listeners told of each placed stone, such as a journal and a spectator feed */
+#define GAME_LISTENERS 4
 
+/** a move packed in 16 bits: the grid index of the intersection and the color of the stone */
 typedef struct {
-    unsigned char x;
-    unsigned char y;
-    unsigned char stone;
+    uint16_t cell : 14;
+    uint16_t stone : 2;
 } move;
 
-typedef struct {
+struct game_rules;
+
+typedef struct game {
     board* board;
     unsigned char type;
+    const struct game_rules* rules;
+    unsigned char opening;
+    bool swapped;
     unsigned char stone;
     unsigned char state;
     unsigned char winner;
     move* moves;
     size_t moves_count;
     size_t moves_capacity;
+    void (*listeners[GAME_LISTENERS])(struct game* g, void* context);
+    void* listener_contexts[GAME_LISTENERS];
+    int listeners_count;
 } game;
 
 /** function to create a game */
@@ -39,6 +68,20 @@ void game_loop(game* g);
 void game_resume(game* g);
 /** function to replay a game */
 void game_replay(game* g);
+/** function to play the moves of a non-interactive input */
+bool game_batch(game* g, int fd, bool report);
 /** function to place a stone in a game */
-bool game_place_stone(game* g, unsigned char x, unsigned char y);
+bool game_place_stone(game* g, uint16_t cell);
+/** function to play a move in a game without output */
+unsigned char game_play(game* g, uint16_t cell);
+/** function to tell a listener of each stone placed in a game */
+bool game_listen(game* g, void (*listener)(game* g, void* context), void* context);
+/** function to copy a game */
+game* game_clone(game* g);
+/** function to take back the last move of a game */
+void game_undo(game* g);
+/** function to loop a game on a large board */
+void game_sparse_loop(sparse_board* b, unsigned char* state, unsigned char* winner);
+/** function to replay a game on a large board */
+void game_sparse_replay(sparse_board* b);
 #endif
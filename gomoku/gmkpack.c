@@ -0,0 +1,485 @@
+/**
+ * @file gmkpack.c
+ * @author Jason Wang
+ * This is the main program to export the positions of archived games as packed training records for machine learning.
+ * Every position of every finished game becomes a fixed-size record: the board at 2 bits an intersection, the side to
+ * move, the move played there and the final result for the side to move, optionally in all 8 symmetric images.
+ * The games are packed over a work-stealing pool into bucket files, each worker buffering its records per bucket.
+ * With -s the records go to random buckets, and each bucket is then shuffled in memory on its own, which shuffles the
+ * whole export uniformly with two passes over the disk however large it is. The bucket of a record is a hash of the
+ * seed, the game, the move and the image, and a bucket is sorted before it is shuffled, so that the order the workers
+ * pack the games in does not show: a seed always gives the same export. The buckets are written in parallel to
+ * their places in shards of a fixed number of records, so every shard can be mapped and indexed directly.
+ *
+ * A shard is a 64-byte header followed by its records, all little-endian:
+ *   header: magic "GMKPACK1", uint32 record bytes (96), uint32 flags (1 shuffled, 2 augmented),
+ *           uint64 records in the shard, uint64 index of its first record in the export, 32 reserved bytes
+ *   record: uint16 grid index (row * size + column) of the move played, uint8 board size, uint8 side to move
+ *           (1 black, 2 white), uint8 result for the side to move (0 loss, 1 draw, 2 win), then 91 bytes holding
+ *           2 bits an intersection in grid order, 4 intersections a byte from the low bits (0 empty, 1 black, 2 white)
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "error-codes.h"
+#include "board.h"
+#include "game.h"
+#include "io.h"
+#include "pool.h"
+#include "search.h"
+#include "sym.h"
+
+#define PACK_MAGIC "GMKPACK1"
+#define PACK_SHUFFLED 1
+#define PACK_AUGMENTED 2
+/** bytes of the packed grid, enough for the largest board */
+#define PACK_GRID_BYTES ((BOARD_MAX_CELLS + 3) / 4)
+#define DEFAULT_SHARD_RECORDS (1u << 20)
+#define DEFAULT_BUCKETS 64
+#define DEFAULT_SEED 1
+/** records each worker buffers for a bucket before writing them */
+#define BUFFER_RECORDS 512
+/** records copied at a time from a bucket that is not shuffled */
+#define COPY_RECORDS 65536
+#define PATH_LEN 4096
+
+typedef struct {
+    uint16_t cell;
+    uint8_t size;
+    uint8_t stone;
+    uint8_t result;
+    uint8_t grid[PACK_GRID_BYTES];
+} pack_record;
+
+typedef struct {
+    char magic[8];
+    uint32_t record_bytes;
+    uint32_t flags;
+    uint64_t records;
+    uint64_t first;
+    uint8_t reserved[32];
+} pack_header;
+
+typedef struct {
+    int fd;
+    uint64_t records;
+    /** index of the first record of the bucket in the export */
+    uint64_t first;
+    pthread_mutex_t lock;
+} bucket;
+
+typedef struct {
+    pack_record* buffers;
+    size_t* filled;
+    uint64_t games;
+    uint64_t unfinished;
+    uint64_t large;
+} packer;
+
+typedef struct {
+    bucket* buckets;
+    int buckets_count;
+    packer* packers;
+    bool shuffle;
+    bool augment;
+    uint64_t seed;
+    int* shards;
+    uint64_t shard_records;
+} exporter;
+
+typedef struct {
+    exporter* e;
+    const char* path;
+    uint64_t index;
+} job;
+
+typedef struct {
+    exporter* e;
+    int index;
+} gather;
+
+/**
+ * Prints the usage of the program and exits
+*/
+static void usage(void) {
+    printf("usage: ./gmkpack -o <output-directory> [-j <threads>] [-a] [-s] [-b <buckets>] [-r <seed>] [-n <shard-records>]\n"
+           "                 [-t <temporary-directory>] <directory>\n"
+           "       writes the positions of the finished games of <directory> as shard-<n>.gpk files of packed records\n"
+           "       -a adds the 7 other symmetric images of every position, -s shuffles the records with the seed -r,\n"
+           "       each of the -j workers holding one of the -b buckets of the shuffle in memory at a time\n");
+    exit(ARGUMENT_ERR);
+}
+
+/**
+ * Draws the next number of a splitmix64 generator
+ * @param state the state of the generator
+ * @return the number
+*/
+static uint64_t nextRandom(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Writes a whole buffer to a file, continuing after partial writes
+ * @param fd the file
+ * @param data the buffer
+ * @param len the length of the buffer
+ * @param offset the position in the file, or -1 to append at the current position
+*/
+static void writeAll(int fd, const void* data, size_t len, off_t offset) {
+    const char* bytes = (const char *) data;
+    while (len > 0) {
+        ssize_t written = offset < 0 ? write(fd, bytes, len) : pwrite(fd, bytes, len, offset);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            exit(FILE_OUTPUT_ERR);
+        }
+        bytes += written;
+        len -= written;
+        offset = offset < 0 ? offset : offset + written;
+    }
+}
+
+/**
+ * Reads a whole range of a file, continuing after partial reads
+ * @param fd the file
+ * @param data the buffer
+ * @param len the length of the range
+ * @param offset the position of the range in the file
+*/
+static void readAll(int fd, void* data, size_t len, off_t offset) {
+    char* bytes = (char *) data;
+    while (len > 0) {
+        ssize_t n = pread(fd, bytes, len, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            exit(FILE_INPUT_ERR);
+        }
+        bytes += n;
+        len -= n;
+        offset += n;
+    }
+}
+
+/**
+ * Writes the buffered records of a worker for a bucket to the bucket file
+ * @param e the exporter
+ * @param worker the index of the worker
+ * @param b the index of the bucket
+*/
+static void flushBuffer(exporter* e, int worker, int b) {
+    packer* p = &e->packers[worker];
+    size_t count = p->filled[b];
+    if (count == 0) {
+        return;
+    }
+    bucket* k = &e->buckets[b];
+    pthread_mutex_lock(&k->lock);
+    writeAll(k->fd, &p->buffers[(size_t) b * BUFFER_RECORDS], count * sizeof(pack_record), -1);
+    k->records += count;
+    pthread_mutex_unlock(&k->lock);
+    p->filled[b] = 0;
+}
+
+/**
+ * Adds a record to the buffer of a worker for a random bucket, or for the only bucket when not shuffling. The bucket
+ * is drawn from the seed and the place of the record in the export, whichever worker packs it.
+ * @param e the exporter
+ * @param worker the index of the worker
+ * @param r the record
+ * @param place the index of the game, the move and the image of the record, packed in one number
+*/
+static void emit(exporter* e, int worker, const pack_record* r, uint64_t place) {
+    packer* p = &e->packers[worker];
+    uint64_t state = e->seed ^ place;
+    int b = e->buckets_count > 1 ? (int) (nextRandom(&state) % e->buckets_count) : 0;
+    p->buffers[(size_t) b * BUFFER_RECORDS + p->filled[b]++] = *r;
+    if (p->filled[b] == BUFFER_RECORDS) {
+        flushBuffer(e, worker, b);
+    }
+}
+
+/**
+ * Packs the positions of a finished game, each before its move, into the buckets. The grids of the symmetric images
+ * are kept packed and updated stone by stone, so the board is never replayed. A game on a large board, which the
+ * records cannot hold, is skipped.
+ * @param arg the job
+ * @param worker the index of the worker
+*/
+static void packGame(void* arg, int worker) {
+    job* j = (job *) arg;
+    exporter* e = j->e;
+    packer* p = &e->packers[worker];
+    int boardSize = game_peek_size(j->path);
+    if (boardSize != 15 && boardSize != 17 && boardSize != 19) {
+        printf("%s: large board, skipped\n", j->path);
+        p->large++;
+        return;
+    }
+    game* g = game_import(j->path);
+    if (g->state != GAME_STATE_FINISHED && g->state != GAME_STATE_FORBIDDEN && g->state != GAME_STATE_DRAWN) {
+        p->unfinished++;
+        game_delete(g);
+        return;
+    }
+    int size = g->board->size;
+    int images = e->augment ? BOARD_SYMMETRIES : 1;
+    pack_record records[BOARD_SYMMETRIES];
+    memset(records, 0, sizeof(records));
+    for (size_t ply = 0; ply < g->moves_count; ply++) {
+        move m = g->moves[ply];
+        unsigned char result = g->winner == m.stone ? 2 : (g->winner == EMPTY_INTERSECTION ? 1 : 0);
+        for (int t = 0; t < images; t++) {
+            int cell = sym_permutation(size, t)[m.cell];
+            records[t].cell = cell;
+            records[t].size = size;
+            records[t].stone = m.stone;
+            records[t].result = result;
+            emit(e, worker, &records[t], j->index << 16 | ply << 3 | t);
+            records[t].grid[cell / 4] |= m.stone << (cell % 4 * 2);
+        }
+    }
+    p->games++;
+    game_delete(g);
+}
+
+/**
+ * Writes consecutive records of the export to their places in the shards
+ * @param e the exporter
+ * @param first the index of the first record in the export
+ * @param records the records
+ * @param count the number of records
+*/
+static void writeRecords(exporter* e, uint64_t first, const pack_record* records, size_t count) {
+    while (count > 0) {
+        uint64_t shard = first / e->shard_records;
+        uint64_t index = first % e->shard_records;
+        size_t n = e->shard_records - index < count ? (size_t) (e->shard_records - index) : count;
+        writeAll(e->shards[shard], records, n * sizeof(pack_record), sizeof(pack_header) + index * sizeof(pack_record));
+        first += n;
+        records += n;
+        count -= n;
+    }
+}
+
+/**
+ * Compares two records byte by byte for qsort
+ * @param a the first record pointer
+ * @param b the second record pointer
+ * @return the comparison
+*/
+static int compareRecords(const void* a, const void* b) {
+    return memcmp(a, b, sizeof(pack_record));
+}
+
+/**
+ * Writes a bucket to the shards: sorted and shuffled in memory, or copied in blocks when not shuffling
+ * @param arg the gather task
+ * @param worker the index of the worker
+*/
+static void gatherBucket(void* arg, int worker) {
+    (void) worker;
+    gather* t = (gather *) arg;
+    exporter* e = t->e;
+    bucket* k = &e->buckets[t->index];
+    size_t count = (size_t) k->records;
+    size_t block = e->shuffle ? count : (count < COPY_RECORDS ? count : COPY_RECORDS);
+    pack_record* records = (pack_record *) malloc((block + 1) * sizeof(pack_record));
+    if (!records) {
+        exit(NULL_POINTER_ERR);
+    }
+    if (e->shuffle) {
+        readAll(k->fd, records, count * sizeof(pack_record), 0);
+        // the workers filled the bucket in any order, sorting it first makes the shuffle depend on the seed alone
+        qsort(records, count, sizeof(pack_record), compareRecords);
+        uint64_t random = e->seed ^ ((uint64_t) t->index << 32);
+        for (size_t i = count; i > 1; i--) {
+            size_t r = nextRandom(&random) % i;
+            pack_record swap = records[i - 1];
+            records[i - 1] = records[r];
+            records[r] = swap;
+        }
+        writeRecords(e, k->first, records, count);
+    } else {
+        for (size_t done = 0; done < count; done += block) {
+            size_t n = count - done < block ? count - done : block;
+            readAll(k->fd, records, n * sizeof(pack_record), done * sizeof(pack_record));
+            writeRecords(e, k->first + done, records, n);
+        }
+    }
+    free(records);
+}
+
+/**
+ * Creates the shard files of an export at their final length, each with its header
+ * @param e the exporter
+ * @param output the output directory
+ * @param total the number of records of the export
+ * @return the number of shards
+*/
+static uint64_t createShards(exporter* e, const char* output, uint64_t total) {
+    uint64_t count = (total + e->shard_records - 1) / e->shard_records;
+    e->shards = (int *) malloc((count + 1) * sizeof(int));
+    if (!e->shards) {
+        exit(NULL_POINTER_ERR);
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        char path[PATH_LEN];
+        snprintf(path, PATH_LEN, "%s/shard-%05llu.gpk", output, (unsigned long long) i);
+        e->shards[i] = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        pack_header h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, PACK_MAGIC, sizeof(h.magic));
+        h.record_bytes = sizeof(pack_record);
+        h.flags = (e->shuffle ? PACK_SHUFFLED : 0) | (e->augment ? PACK_AUGMENTED : 0);
+        h.first = i * e->shard_records;
+        h.records = total - h.first < e->shard_records ? total - h.first : e->shard_records;
+        if (e->shards[i] < 0 || ftruncate(e->shards[i], sizeof(h) + h.records * sizeof(pack_record)) != 0) {
+            exit(FILE_OUTPUT_ERR);
+        }
+        writeAll(e->shards[i], &h, sizeof(h), 0);
+    }
+    return count;
+}
+
+/**
+ * This is the main function of the exporter
+ * @param argc the number of command line args
+ * @param argv an array of command-line argument strings
+*/
+int main(int argc, char *argv[]) {
+    int opt;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char* output = NULL;
+    const char* temporary = NULL;
+    long buckets = DEFAULT_BUCKETS;
+    long shardRecords = DEFAULT_SHARD_RECORDS;
+    exporter e;
+    memset(&e, 0, sizeof(e));
+    e.seed = DEFAULT_SEED;
+    while ((opt = getopt(argc, argv, "o:j:asb:r:n:t:")) != -1) {
+        switch (opt) {
+            case 'o': output = optarg; break;
+            case 'j': threads = atol(optarg); break;
+            case 'a': e.augment = true; break;
+            case 's': e.shuffle = true; break;
+            case 'b': buckets = atol(optarg); break;
+            case 'r': e.seed = strtoull(optarg, NULL, 10); break;
+            case 'n': shardRecords = atol(optarg); break;
+            case 't': temporary = optarg; break;
+            default: usage();
+        }
+    }
+    if (optind != argc - 1 || !output || threads < 1 || buckets < 1 || shardRecords < 1) {
+        usage();
+    }
+    temporary = temporary ? temporary : output;
+    e.buckets_count = e.shuffle ? (int) buckets : 1;
+    e.shard_records = (uint64_t) shardRecords;
+    e.buckets = (bucket *) calloc(e.buckets_count, sizeof(bucket));
+    e.packers = (packer *) calloc(threads, sizeof(packer));
+    if (!e.buckets || !e.packers) {
+        exit(NULL_POINTER_ERR);
+    }
+    for (int b = 0; b < e.buckets_count; b++) {
+        // the bucket files are unlinked at once, so they go away with the process however it ends
+        char path[PATH_LEN];
+        snprintf(path, PATH_LEN, "%s/bucket-%d-%d.tmp", temporary, (int) getpid(), b);
+        e.buckets[b].fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (e.buckets[b].fd < 0) {
+            exit(FILE_OUTPUT_ERR);
+        }
+        unlink(path);
+        pthread_mutex_init(&e.buckets[b].lock, NULL);
+    }
+    for (long w = 0; w < threads; w++) {
+        e.packers[w].buffers = (pack_record *) malloc((size_t) e.buckets_count * BUFFER_RECORDS * sizeof(pack_record));
+        e.packers[w].filled = (size_t *) calloc(e.buckets_count, sizeof(size_t));
+        if (!e.packers[w].buffers || !e.packers[w].filled) {
+            exit(NULL_POINTER_ERR);
+        }
+    }
+    double start = search_clock();
+    size_t count = 0;
+    char** paths = game_list_dir(argv[optind], &count);
+    job* jobs = (job *) malloc((count + 1) * sizeof(job));
+    pool* p = pool_create(threads);
+    if (!jobs || !p) {
+        exit(NULL_POINTER_ERR);
+    }
+    for (size_t i = 0; i < count; i++) {
+        jobs[i].e = &e;
+        jobs[i].path = paths[i];
+        jobs[i].index = i;
+        pool_submit(p, i, packGame, &jobs[i]);
+    }
+    pool_wait(p);
+    uint64_t games = 0;
+    uint64_t unfinished = 0;
+    uint64_t large = 0;
+    for (long w = 0; w < threads; w++) {
+        for (int b = 0; b < e.buckets_count; b++) {
+            flushBuffer(&e, w, b);
+        }
+        games += e.packers[w].games;
+        unfinished += e.packers[w].unfinished;
+        large += e.packers[w].large;
+        free(e.packers[w].buffers);
+        free(e.packers[w].filled);
+    }
+    uint64_t total = 0;
+    for (int b = 0; b < e.buckets_count; b++) {
+        e.buckets[b].first = total;
+        total += e.buckets[b].records;
+    }
+    uint64_t shards = createShards(&e, output, total);
+    gather* gathers = (gather *) malloc(e.buckets_count * sizeof(gather));
+    if (!gathers) {
+        exit(NULL_POINTER_ERR);
+    }
+    for (int b = 0; b < e.buckets_count; b++) {
+        gathers[b].e = &e;
+        gathers[b].index = b;
+        pool_submit(p, b, gatherBucket, &gathers[b]);
+    }
+    pool_wait(p);
+    for (uint64_t i = 0; i < shards; i++) {
+        if (close(e.shards[i]) != 0) {
+            exit(FILE_OUTPUT_ERR);
+        }
+    }
+    double seconds = search_clock() - start;
+    printf("%llu games, %llu unfinished and %llu on large boards skipped, %llu records in %llu shards\n",
+           (unsigned long long) games, (unsigned long long) unfinished, (unsigned long long) large,
+           (unsigned long long) total, (unsigned long long) shards);
+    printf("%.2f s with %ld threads, %.0f records/s, %.1f MB/s\n", seconds, threads,
+           seconds > 0 ? total / seconds : 0.0, seconds > 0 ? total * sizeof(pack_record) / seconds / 1e6 : 0.0);
+    pool_delete(p);
+    for (int b = 0; b < e.buckets_count; b++) {
+        close(e.buckets[b].fd);
+        pthread_mutex_destroy(&e.buckets[b].lock);
+    }
+    for (size_t i = 0; i < count; i++) {
+        free(paths[i]);
+    }
+    free(paths);
+    free(jobs);
+    free(gathers);
+    free(e.shards);
+    free(e.buckets);
+    free(e.packers);
+    return 0;
+}
@@ -0,0 +1,572 @@
+/**
+ * @file gmkstats.c
+ * @author Jason Wang
+ * This is the main program to compute statistics over a corpus of gomoku/renju games: results per board size and
+ * rule set, game lengths, decisive forbidden moves and opening frequencies.
+ * The games of directories and tar archives are mapped over worker threads, each keeping its own aggregates, which
+ * are reduced at the end into a CSV or JSON report.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "error-codes.h"
+#include "board.h"
+#include "game.h"
+#include "io.h"
+#include "rules.h"
+#include "search.h"
+#include "sym.h"
+
+/** number of (board size, rule set) groups */
+#define GROUPS (3 * GAME_VARIANTS)
+/** longest game counted in the length distribution */
+#define MAX_LENGTH 361
+#define DEFAULT_PLIES 3
+#define MAX_PLIES 5
+#define DEFAULT_TOP 20
+/** number of games a worker takes at once */
+#define CHUNK 64
+#define TAR_BLOCK 512
+/** marks a missing move of an opening */
+#define NO_CELL 0x1FF
+
+typedef struct {
+    const char* path;
+    const char* data;
+    size_t len;
+} source;
+
+typedef struct {
+    uint64_t games;
+    uint64_t black_wins;
+    uint64_t white_wins;
+    uint64_t draws;
+    uint64_t forbidden;
+    uint64_t unfinished;
+    uint64_t lengths[MAX_LENGTH + 1];
+} group_stats;
+
+typedef struct {
+    uint64_t key;
+    uint64_t count;
+} opening_count;
+
+typedef struct {
+    group_stats groups[GROUPS];
+    opening_count* openings;
+    size_t openings_capacity;
+    size_t openings_used;
+    uint64_t errors;
+    /** games on large boards, which have no group and no opening key */
+    uint64_t skipped;
+} aggregate;
+
+typedef struct {
+    source* sources;
+    size_t count;
+    size_t capacity;
+    size_t next;
+    int plies;
+} corpus;
+
+typedef struct {
+    corpus* c;
+    aggregate a;
+} worker_state;
+
+static const int SIZES[3] = {15, 17, 19};
+
+/**
+ * Gets the board size of a group
+ * @param group the group
+ * @return the size
+*/
+static int groupSize(int group) {
+    return SIZES[group / GAME_VARIANTS];
+}
+
+/**
+ * Gets the name of the rule variant of a group
+ * @param group the group
+ * @return the name
+*/
+static const char* groupRule(int group) {
+    return rules_select(group % GAME_VARIANTS)->name;
+}
+
+/**
+ * Prints the usage of the program and exits
+*/
+static void usage(void) {
+    printf("usage: ./gmkstats [-j <threads>] [-f <csv|json>] [-p <opening-plies>] [-t <top-openings>] <directory|archive.tar>...\n");
+    exit(ARGUMENT_ERR);
+}
+
+/**
+ * Adds a game source to the corpus
+ * @param c the corpus
+ * @param s the source
+*/
+static void addSource(corpus* c, source s) {
+    if (c->count == c->capacity) {
+        c->capacity = c->capacity ? 2 * c->capacity : 1024;
+        c->sources = (source *) realloc(c->sources, c->capacity * sizeof(source));
+        if (!c->sources) {
+            exit(NULL_POINTER_ERR);
+        }
+    }
+    c->sources[c->count++] = s;
+}
+
+/**
+ * Maps a tar archive and adds its .gmk members to the corpus. The archive stays mapped until the program exits.
+ * @param c the corpus
+ * @param path the path of the archive
+*/
+static void addArchive(corpus* c, const char* path) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        exit(FILE_INPUT_ERR);
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return;
+    }
+    const char* base = (const char *) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        exit(FILE_INPUT_ERR);
+    }
+    size_t size = st.st_size;
+    for (size_t offset = 0; offset + TAR_BLOCK <= size && base[offset] != '\0';) {
+        const char* header = base + offset;
+        char octal[13] = {0};
+        memcpy(octal, header + 124, 12);
+        size_t len = (size_t) strtoull(octal, NULL, 8);
+        char type = header[156];
+        size_t nameLen = strnlen(header, 100);
+        offset += TAR_BLOCK;
+        if (offset + len > size) {
+            exit(FILE_INPUT_ERR);
+        }
+        if ((type == '0' || type == '\0') && nameLen >= 4 && memcmp(header + nameLen - 4, ".gmk", 4) == 0) {
+            source s = {path, base + offset, len};
+            addSource(c, s);
+        }
+        offset += (len + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK;
+    }
+}
+
+/**
+ * Reads a whole file into a growing buffer
+ * @param path the path of the file
+ * @param buffer the buffer
+ * @param capacity the room of the buffer
+ * @return the length of the file, or -1 if it cannot be read
+*/
+static long readFile(const char* path, char** buffer, size_t* capacity) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        return -1;
+    }
+    size_t len = 0;
+    size_t n;
+    while ((n = fread(*buffer + len, 1, *capacity - len, fp)) > 0) {
+        len += n;
+        if (len == *capacity) {
+            *capacity *= 2;
+            *buffer = (char *) realloc(*buffer, *capacity);
+            if (!*buffer) {
+                exit(NULL_POINTER_ERR);
+            }
+        }
+    }
+    fclose(fp);
+    return (long) len;
+}
+
+/**
+ * Packs the first moves of a game, folded over the board symmetries, with its group into an opening key
+ * @param g the game
+ * @param group the group of the game
+ * @param plies the number of moves of an opening
+ * @return the opening key
+*/
+static uint64_t openingKey(game* g, int group, int plies) {
+    int size = g->board->size;
+    size_t count = g->moves_count < (size_t) plies ? g->moves_count : (size_t) plies;
+    move opening[MAX_PLIES];
+    sym_canonical_moves(g->moves, count, size, opening);
+    uint64_t key = 0;
+    for (int i = 0; i < plies; i++) {
+        uint64_t cell = NO_CELL;
+        if ((size_t) i < count) {
+            cell = opening[i].cell;
+        }
+        key = key << 9 | cell;
+    }
+    return (uint64_t) (group + 1) << 56 | key;
+}
+
+/**
+ * Counts an opening in the hash map of an aggregate
+ * @param a the aggregate
+ * @param key the opening key
+ * @param count the number of games to add
+*/
+static void countOpening(aggregate* a, uint64_t key, uint64_t count) {
+    if (a->openings_used * 10 >= a->openings_capacity * 7) {
+        opening_count* old = a->openings;
+        size_t oldCapacity = a->openings_capacity;
+        a->openings_capacity = oldCapacity ? 2 * oldCapacity : 1024;
+        a->openings = (opening_count *) calloc(a->openings_capacity, sizeof(opening_count));
+        if (!a->openings) {
+            exit(NULL_POINTER_ERR);
+        }
+        a->openings_used = 0;
+        for (size_t i = 0; i < oldCapacity; i++) {
+            if (old[i].key) {
+                countOpening(a, old[i].key, old[i].count);
+            }
+        }
+        free(old);
+    }
+    size_t mask = a->openings_capacity - 1;
+    size_t i = (key * 0x9E3779B97F4A7C15ull >> 17) & mask;
+    while (a->openings[i].key && a->openings[i].key != key) {
+        i = (i + 1) & mask;
+    }
+    if (!a->openings[i].key) {
+        a->openings[i].key = key;
+        a->openings_used++;
+    }
+    a->openings[i].count += count;
+}
+
+/**
+ * Adds a game to the aggregate of a worker
+ * @param a the aggregate
+ * @param g the game
+ * @param plies the number of moves of an opening
+*/
+static void countGame(aggregate* a, game* g, int plies) {
+    int group = (g->board->size - 15) / 2 * GAME_VARIANTS + g->type;
+    group_stats* s = &a->groups[group];
+    s->games++;
+    if (g->state == GAME_STATE_FORBIDDEN) {
+        s->forbidden++;
+        s->white_wins++;
+    } else if (g->state == GAME_STATE_FINISHED && g->winner == BLACK_STONE) {
+        s->black_wins++;
+    } else if (g->state == GAME_STATE_FINISHED && g->winner == WHITE_STONE) {
+        s->white_wins++;
+    } else if (g->state == GAME_STATE_FINISHED || g->state == GAME_STATE_DRAWN) {
+        s->draws++;
+    } else {
+        s->unfinished++;
+    }
+    s->lengths[g->moves_count < MAX_LENGTH ? g->moves_count : MAX_LENGTH]++;
+    countOpening(a, openingKey(g, group, plies), 1);
+}
+
+/**
+ * Maps the games of the corpus to the aggregate of a worker, taking them in chunks
+ * @param arg the worker state
+ * @return NULL
+*/
+static void* mapGames(void* arg) {
+    worker_state* w = (worker_state *) arg;
+    corpus* c = w->c;
+    size_t capacity = 4096;
+    char* buffer = (char *) malloc(capacity);
+    if (!buffer) {
+        exit(NULL_POINTER_ERR);
+    }
+    while (true) {
+        size_t first = __atomic_fetch_add(&c->next, CHUNK, __ATOMIC_RELAXED);
+        if (first >= c->count) {
+            break;
+        }
+        for (size_t i = first; i < first + CHUNK && i < c->count; i++) {
+            source* s = &c->sources[i];
+            const char* text = s->data;
+            long len = (long) s->len;
+            if (!text) {
+                len = readFile(s->path, &buffer, &capacity);
+                text = buffer;
+            }
+            int size = len >= 0 ? game_parse_size(text, len) : -1;
+            if (SPARSE_SIZE(size)) {
+                w->a.skipped++;
+                continue;
+            }
+            game* g = len >= 0 ? game_parse(text, len) : NULL;
+            if (!g) {
+                w->a.errors++;
+                continue;
+            }
+            countGame(&w->a, g, c->plies);
+            game_delete(g);
+        }
+    }
+    free(buffer);
+    return NULL;
+}
+
+/**
+ * Reduces the aggregate of a worker into the total
+ * @param total the total aggregate
+ * @param a the aggregate of a worker
+*/
+static void reduce(aggregate* total, aggregate* a) {
+    for (int i = 0; i < GROUPS; i++) {
+        group_stats* t = &total->groups[i];
+        group_stats* s = &a->groups[i];
+        t->games += s->games;
+        t->black_wins += s->black_wins;
+        t->white_wins += s->white_wins;
+        t->draws += s->draws;
+        t->forbidden += s->forbidden;
+        t->unfinished += s->unfinished;
+        for (int j = 0; j <= MAX_LENGTH; j++) {
+            t->lengths[j] += s->lengths[j];
+        }
+    }
+    for (size_t i = 0; i < a->openings_capacity; i++) {
+        if (a->openings[i].key) {
+            countOpening(total, a->openings[i].key, a->openings[i].count);
+        }
+    }
+    total->errors += a->errors;
+    total->skipped += a->skipped;
+}
+
+/**
+ * Compares two opening counts for qsort, most frequent first
+ * @param a the first opening count
+ * @param b the second opening count
+ * @return the comparison
+*/
+static int compareOpenings(const void* a, const void* b) {
+    const opening_count* oa = (const opening_count *) a;
+    const opening_count* ob = (const opening_count *) b;
+    if (oa->count != ob->count) {
+        return oa->count < ob->count ? 1 : -1;
+    }
+    return oa->key < ob->key ? -1 : (oa->key > ob->key);
+}
+
+/**
+ * Formats the moves of an opening key
+ * @param key the opening key
+ * @param plies the number of moves of an opening
+ * @param str the output string
+*/
+static void formatOpening(uint64_t key, int plies, char* str) {
+    int size = groupSize((int) (key >> 56) - 1);
+    str[0] = '\0';
+    for (int i = plies - 1; i >= 0; i--) {
+        int cell = (key >> (9 * i)) & NO_CELL;
+        if (cell == NO_CELL) {
+            break;
+        }
+        char coord[BOARD_COORD_LEN];
+        board_format_coord(cell % size, cell / size, coord);
+        if (str[0]) {
+            strcat(str, " ");
+        }
+        strcat(str, coord);
+    }
+}
+
+/**
+ * Computes the share of a count, 0 when the total is 0
+ * @param count the count
+ * @param total the total
+ * @return the share
+*/
+static double share(uint64_t count, uint64_t total) {
+    return total ? (double) count / total : 0.0;
+}
+
+/**
+ * Prints the report as CSV rows of (table, size, rule, key, value)
+ * @param total the total aggregate
+ * @param top the most frequent openings
+ * @param topCount the number of openings
+ * @param plies the number of moves of an opening
+*/
+static void printCsv(aggregate* total, opening_count* top, size_t topCount, int plies) {
+    printf("table,size,rule,key,value\n");
+    for (int i = 0; i < GROUPS; i++) {
+        group_stats* s = &total->groups[i];
+        if (!s->games) {
+            continue;
+        }
+        const char* rule = groupRule(i);
+        uint64_t decided = s->black_wins + s->white_wins;
+        printf("summary,%d,%s,games,%llu\n", groupSize(i), rule, (unsigned long long) s->games);
+        printf("summary,%d,%s,black_wins,%llu\n", groupSize(i), rule, (unsigned long long) s->black_wins);
+        printf("summary,%d,%s,white_wins,%llu\n", groupSize(i), rule, (unsigned long long) s->white_wins);
+        printf("summary,%d,%s,draws,%llu\n", groupSize(i), rule, (unsigned long long) s->draws);
+        printf("summary,%d,%s,unfinished,%llu\n", groupSize(i), rule, (unsigned long long) s->unfinished);
+        printf("summary,%d,%s,forbidden,%llu\n", groupSize(i), rule, (unsigned long long) s->forbidden);
+        printf("summary,%d,%s,black_win_rate,%.4f\n", groupSize(i), rule, share(s->black_wins, decided));
+        printf("summary,%d,%s,forbidden_rate,%.4f\n", groupSize(i), rule, share(s->forbidden, decided));
+        for (int j = 0; j <= MAX_LENGTH; j++) {
+            if (s->lengths[j]) {
+                printf("length,%d,%s,%d,%llu\n", groupSize(i), rule, j, (unsigned long long) s->lengths[j]);
+            }
+        }
+    }
+    for (size_t i = 0; i < topCount; i++) {
+        char moves[MAX_PLIES * (BOARD_COORD_LEN + 1)];
+        int group = (int) (top[i].key >> 56) - 1;
+        formatOpening(top[i].key, plies, moves);
+        printf("opening,%d,%s,%s,%llu\n", groupSize(group), groupRule(group), moves,
+               (unsigned long long) top[i].count);
+    }
+}
+
+/**
+ * Prints the report as a JSON object
+ * @param total the total aggregate
+ * @param top the most frequent openings
+ * @param topCount the number of openings
+ * @param plies the number of moves of an opening
+ * @param games the number of games read
+*/
+static void printJson(aggregate* total, opening_count* top, size_t topCount, int plies, size_t games) {
+    printf("{\n  \"games\": %zu,\n  \"errors\": %llu,\n  \"skipped\": %llu,\n  \"groups\": [", games,
+           (unsigned long long) total->errors, (unsigned long long) total->skipped);
+    bool first = true;
+    for (int i = 0; i < GROUPS; i++) {
+        group_stats* s = &total->groups[i];
+        if (!s->games) {
+            continue;
+        }
+        uint64_t decided = s->black_wins + s->white_wins;
+        printf("%s\n    {\"size\": %d, \"rule\": \"%s\", \"games\": %llu, \"black_wins\": %llu, \"white_wins\": %llu, "
+               "\"draws\": %llu, \"unfinished\": %llu, \"forbidden\": %llu, \"black_win_rate\": %.4f, "
+               "\"forbidden_rate\": %.4f,\n     \"lengths\": {", first ? "" : ",", groupSize(i), groupRule(i),
+               (unsigned long long) s->games, (unsigned long long) s->black_wins, (unsigned long long) s->white_wins,
+               (unsigned long long) s->draws, (unsigned long long) s->unfinished, (unsigned long long) s->forbidden,
+               share(s->black_wins, decided), share(s->forbidden, decided));
+        first = false;
+        bool firstLength = true;
+        for (int j = 0; j <= MAX_LENGTH; j++) {
+            if (s->lengths[j]) {
+                printf("%s\"%d\": %llu", firstLength ? "" : ", ", j, (unsigned long long) s->lengths[j]);
+                firstLength = false;
+            }
+        }
+        printf("}}");
+    }
+    printf("\n  ],\n  \"openings\": [");
+    for (size_t i = 0; i < topCount; i++) {
+        char moves[MAX_PLIES * (BOARD_COORD_LEN + 1)];
+        int group = (int) (top[i].key >> 56) - 1;
+        formatOpening(top[i].key, plies, moves);
+        printf("%s\n    {\"size\": %d, \"rule\": \"%s\", \"moves\": \"%s\", \"games\": %llu}", i ? "," : "",
+               groupSize(group), groupRule(group), moves, (unsigned long long) top[i].count);
+    }
+    printf("\n  ]\n}\n");
+}
+
+/**
+ * This is the main function of the statistics tool
+ * @param argc the number of command line args
+ * @param argv an array of command-line argument strings
+*/
+int main(int argc, char *argv[]) {
+    int opt;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    bool json = false;
+    long topLimit = DEFAULT_TOP;
+    corpus c = {NULL, 0, 0, 0, DEFAULT_PLIES};
+    while ((opt = getopt(argc, argv, "j:f:p:t:")) != -1) {
+        switch (opt) {
+            case 'j': threads = atol(optarg); break;
+            case 'f':
+                if (strcmp(optarg, "json") == 0) {
+                    json = true;
+                } else if (strcmp(optarg, "csv") != 0) {
+                    usage();
+                }
+                break;
+            case 'p': c.plies = atoi(optarg); break;
+            case 't': topLimit = atol(optarg); break;
+            default: usage();
+        }
+    }
+    if (optind >= argc || threads < 1 || c.plies < 1 || c.plies > MAX_PLIES || topLimit < 0) {
+        usage();
+    }
+    double start = search_clock();
+    for (int i = optind; i < argc; i++) {
+        size_t len = strlen(argv[i]);
+        if (len >= 4 && strcmp(argv[i] + len - 4, ".tar") == 0) {
+            addArchive(&c, argv[i]);
+            continue;
+        }
+        size_t count = 0;
+        char** paths = game_list_dir(argv[i], &count);
+        for (size_t j = 0; j < count; j++) {
+            source s = {paths[j], NULL, 0};
+            addSource(&c, s);
+        }
+        free(paths);
+    }
+    worker_state* workers = (worker_state *) calloc(threads, sizeof(worker_state));
+    pthread_t* ids = (pthread_t *) malloc(threads * sizeof(pthread_t));
+    if (!workers || !ids) {
+        exit(NULL_POINTER_ERR);
+    }
+    for (long i = 0; i < threads; i++) {
+        workers[i].c = &c;
+        pthread_create(&ids[i], NULL, mapGames, &workers[i]);
+    }
+    aggregate total;
+    memset(&total, 0, sizeof(total));
+    for (long i = 0; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+        reduce(&total, &workers[i].a);
+        free(workers[i].a.openings);
+    }
+    double seconds = search_clock() - start;
+    size_t topCount = 0;
+    for (size_t i = 0; i < total.openings_capacity; i++) {
+        if (total.openings[i].key) {
+            total.openings[topCount++] = total.openings[i];
+        }
+    }
+    qsort(total.openings, topCount, sizeof(opening_count), compareOpenings);
+    if (topCount > (size_t) topLimit) {
+        topCount = topLimit;
+    }
+    if (json) {
+        printJson(&total, total.openings, topCount, c.plies, c.count);
+    } else {
+        printCsv(&total, total.openings, topCount, c.plies);
+    }
+    fprintf(stderr, "%zu games (%llu unreadable, %llu on large boards skipped) in %.2f s with %ld threads, "
+            "%.0f games/minute\n", c.count, (unsigned long long) total.errors, (unsigned long long) total.skipped,
+            seconds, threads, seconds > 0 ? c.count * 60 / seconds : 0.0);
+    for (size_t i = 0; i < c.count; i++) {
+        if (!c.sources[i].data) {
+            free((char *) c.sources[i].path);
+        }
+    }
+    free(total.openings);
+    free(c.sources);
+    free(workers);
+    free(ids);
+    return 0;
+}
@@ -12,9 +12,46 @@
 #include "board.h"
 #include "game.h"
 #include "io.h"
+#include "ponder.h"
+#include "journal.h"
+#include "feed.h"
+#include "rules.h"
+#include "sparse.h"
 
 #define DEFAULT_SIZE 15
 
+/**
+ * Plays or resumes a freestyle game on a large or unbounded board, kept by the sparse backend
+ * @param size the size of a new board
+ * @param replayFile the unfinished match to resume, or an empty string for a new game
+ * @param outputFile the file to save the match to, or an empty string
+*/
+static void playLarge(int size, const char* replayFile, const char* outputFile) {
+    unsigned char state = GAME_STATE_PLAYING;
+    unsigned char winner = EMPTY_INTERSECTION;
+    sparse_board* b = NULL;
+    if (replayFile[0] != 0) {
+        b = sparse_import(replayFile, &state, &winner);
+        if (state != GAME_STATE_STOPPED) {
+            exit(RESUME_ERR);
+        }
+        state = GAME_STATE_PLAYING;
+    } else {
+        if (!SPARSE_SIZE(size)) {
+            exit(BOARD_SIZE_ERR);
+        }
+        b = sparse_create(size);
+        if (!b) {
+            exit(NULL_POINTER_ERR);
+        }
+    }
+    game_sparse_loop(b, &state, &winner);
+    if (outputFile[0] != 0) {
+        sparse_export(b, state, winner, outputFile);
+    }
+    sparse_delete(b);
+}
+
 /**
  * The main function of the gomoku game
  * @param argc the number of commandline args
@@ -23,68 +60,190 @@
 */
 int main(int argc, char *argv[]) {
     int opt;
-    char *options = "o:r:b:";
+    int batch = 0;
+    static struct option longOptions[] = {
+        {"batch", optional_argument, NULL, 'B'},
+        {NULL, 0, NULL, 0}
+    };
+    char *options = "o:r:b:c:s:v:";
     char outputFile[255] = {0};
     char replayFile[255] = {0};
     int size = -1;
     int bFlag = 0;
     int rFlag = 0;
-    while ((opt = getopt(argc, argv, options)) != -1) { 
+    int cFlag = 0;
+    int vFlag = 0;
+    unsigned char type = GAME_FREESTYLE;
+    unsigned char computer = EMPTY_INTERSECTION;
+    double seconds = PONDER_DEFAULT_SECONDS;
+    while ((opt = getopt_long(argc, argv, options, longOptions, NULL)) != -1) { 
         switch (opt) { 
-            case 'o': strncpy(outputFile, optarg, 255); break;
-            case 'r': rFlag = 1; strncpy(replayFile, optarg, 255); break;
-            case 'b': bFlag = 1; size = atoi(optarg); break;
+            case 'o': strncpy(outputFile, optarg, 254); break;
+            case 'r': rFlag = 1; strncpy(replayFile, optarg, 254); break;
+            case 'b': bFlag = 1; size = strcmp(optarg, "0") == 0 ? SPARSE_UNBOUNDED : (atoi(optarg) > 0 ? atoi(optarg) : -1); break;
+            case 'c': cFlag = 1; computer = ponder_parse_color(optarg); break;
+            case 's': seconds = atof(optarg); break;
+            case 'B': batch = !optarg ? 1 : (strcmp(optarg, "moves") == 0 ? 2 : -1); break;
+            case 'v': vFlag = 1; type = rules_parse(optarg); break;
             default: {
-                printf("usage: ./gomoku [-r <unfinished-match.gmk>] [-o <saved-match.gmk>] [-b <15|17|19>]\n"
-                       "       -r and -b conflicts with each other\n");
+                printf("usage: ./gomoku [-r <unfinished-match.gmk>] [-o <saved-match.gmk>] [-b <15|17|19|20-100|0>]\n"
+                       "       [-c <black|white>] [-s <seconds>] [-v <freestyle|standard|caro|swap2>] [--batch[=moves]]\n"
+                       "       -r conflicts with -b and -v, --batch conflicts with -c\n"
+                       "       -b 20 to 100 or 0 (unbounded) plays freestyle on a large board and conflicts with -c, -v and --batch\n"
+                       "       --batch plays the moves of the input without prompts, =moves prints a line per move\n");
                 exit(ARGUMENT_ERR);
             }
         } 
     } 
 
     if (strlen(outputFile) > 0 && outputFile[0] == '-') {
-        printf("usage: ./gomoku [-r <unfinished-match.gmk>] [-o <saved-match.gmk>] [-b <15|17|19>]\n"
-                "       -r and -b conflicts with each other\n");
+        printf("usage: ./gomoku [-r <unfinished-match.gmk>] [-o <saved-match.gmk>] [-b <15|17|19|20-100|0>]\n"
+                "       [-c <black|white>] [-s <seconds>] [-v <freestyle|standard|caro|swap2>] [--batch[=moves]]\n"
+                "       -r conflicts with -b and -v, --batch conflicts with -c\n"
+                "       -b 20 to 100 or 0 (unbounded) plays freestyle on a large board and conflicts with -c, -v and --batch\n"
+                "       --batch plays the moves of the input without prompts, =moves prints a line per move\n");
         exit(ARGUMENT_ERR);
     }
     if (strlen(replayFile) > 0 && replayFile[0] == '-') {
-        printf("usage: ./gomoku [-r <unfinished-match.gmk>] [-o <saved-match.gmk>] [-b <15|17|19>]\n"
-                "       -r and -b conflicts with each other\n");
+        printf("usage: ./gomoku [-r <unfinished-match.gmk>] [-o <saved-match.gmk>] [-b <15|17|19|20-100|0>]\n"
+                "       [-c <black|white>] [-s <seconds>] [-v <freestyle|standard|caro|swap2>] [--batch[=moves]]\n"
+                "       -r conflicts with -b and -v, --batch conflicts with -c\n"
+                "       -b 20 to 100 or 0 (unbounded) plays freestyle on a large board and conflicts with -c, -v and --batch\n"
+                "       --batch plays the moves of the input without prompts, =moves prints a line per move\n");
         exit(ARGUMENT_ERR);
     }
-    if (bFlag && (size == -1 || size == 0)) {
-        printf("usage: ./gomoku [-r <unfinished-match.gmk>] [-o <saved-match.gmk>] [-b <15|17|19>]\n"
-                "       -r and -b conflicts with each other\n");
+    if (bFlag && size == -1) {
+        printf("usage: ./gomoku [-r <unfinished-match.gmk>] [-o <saved-match.gmk>] [-b <15|17|19|20-100|0>]\n"
+                "       [-c <black|white>] [-s <seconds>] [-v <freestyle|standard|caro|swap2>] [--batch[=moves]]\n"
+                "       -r conflicts with -b and -v, --batch conflicts with -c\n"
+                "       -b 20 to 100 or 0 (unbounded) plays freestyle on a large board and conflicts with -c, -v and --batch\n"
+                "       --batch plays the moves of the input without prompts, =moves prints a line per move\n");
         exit(ARGUMENT_ERR);
     }
-    if (bFlag && rFlag) {
-        printf("usage: ./gomoku [-r <unfinished-match.gmk>] [-o <saved-match.gmk>] [-b <15|17|19>]\n"
-                "       -r and -b conflicts with each other\n");
+    if ((cFlag && computer == EMPTY_INTERSECTION) || seconds <= 0) {
+        printf("usage: ./gomoku [-r <unfinished-match.gmk>] [-o <saved-match.gmk>] [-b <15|17|19|20-100|0>]\n"
+                "       [-c <black|white>] [-s <seconds>] [-v <freestyle|standard|caro|swap2>] [--batch[=moves]]\n"
+                "       -r conflicts with -b and -v, --batch conflicts with -c\n"
+                "       -b 20 to 100 or 0 (unbounded) plays freestyle on a large board and conflicts with -c, -v and --batch\n"
+                "       --batch plays the moves of the input without prompts, =moves prints a line per move\n");
+        exit(ARGUMENT_ERR);
+    }
+    if (vFlag && (type == GAME_VARIANTS || type == GAME_RENJU)) {
+        printf("usage: ./gomoku [-r <unfinished-match.gmk>] [-o <saved-match.gmk>] [-b <15|17|19|20-100|0>]\n"
+                "       [-c <black|white>] [-s <seconds>] [-v <freestyle|standard|caro|swap2>] [--batch[=moves]]\n"
+                "       -r conflicts with -b and -v, --batch conflicts with -c\n"
+                "       -b 20 to 100 or 0 (unbounded) plays freestyle on a large board and conflicts with -c, -v and --batch\n"
+                "       --batch plays the moves of the input without prompts, =moves prints a line per move\n");
+        exit(ARGUMENT_ERR);
+    }
+    if ((bFlag || vFlag) && rFlag) {
+        printf("usage: ./gomoku [-r <unfinished-match.gmk>] [-o <saved-match.gmk>] [-b <15|17|19|20-100|0>]\n"
+                "       [-c <black|white>] [-s <seconds>] [-v <freestyle|standard|caro|swap2>] [--batch[=moves]]\n"
+                "       -r conflicts with -b and -v, --batch conflicts with -c\n"
+                "       -b 20 to 100 or 0 (unbounded) plays freestyle on a large board and conflicts with -c, -v and --batch\n"
+                "       --batch plays the moves of the input without prompts, =moves prints a line per move\n");
+        exit(ARGUMENT_ERR);
+    }
+    if (batch < 0 || (batch && cFlag)) {
+        printf("usage: ./gomoku [-r <unfinished-match.gmk>] [-o <saved-match.gmk>] [-b <15|17|19|20-100|0>]\n"
+                "       [-c <black|white>] [-s <seconds>] [-v <freestyle|standard|caro|swap2>] [--batch[=moves]]\n"
+                "       -r conflicts with -b and -v, --batch conflicts with -c\n"
+                "       -b 20 to 100 or 0 (unbounded) plays freestyle on a large board and conflicts with -c, -v and --batch\n"
+                "       --batch plays the moves of the input without prompts, =moves prints a line per move\n");
         exit(ARGUMENT_ERR);
     }
 
     for(; optind < argc; optind++) {      
-        printf("usage: ./gomoku [-r <unfinished-match.gmk>] [-o <saved-match.gmk>] [-b <15|17|19>]\n"
-                "       -r and -b conflicts with each other\n");
+        printf("usage: ./gomoku [-r <unfinished-match.gmk>] [-o <saved-match.gmk>] [-b <15|17|19|20-100|0>]\n"
+                "       [-c <black|white>] [-s <seconds>] [-v <freestyle|standard|caro|swap2>] [--batch[=moves]]\n"
+                "       -r conflicts with -b and -v, --batch conflicts with -c\n"
+                "       -b 20 to 100 or 0 (unbounded) plays freestyle on a large board and conflicts with -c, -v and --batch\n"
+                "       --batch plays the moves of the input without prompts, =moves prints a line per move\n");
         exit(ARGUMENT_ERR);
     }
 
+    int fileSize = rFlag ? game_peek_size(replayFile) : size;
+    if ((bFlag || rFlag) && fileSize != 15 && fileSize != 17 && fileSize != 19) {
+        // the journal and the spectator feed record dense games only
+        if (cFlag || (vFlag && type != GAME_FREESTYLE) || batch || getenv(JOURNAL_VARIABLE) || getenv(FEED_VARIABLE)) {
+            exit(ARGUMENT_ERR);
+        }
+        playLarge(size, replayFile, outputFile);
+        return 0;
+    }
+
+    journal* j = NULL;
+    if (getenv(JOURNAL_VARIABLE)) {
+        j = journal_open(getenv(JOURNAL_VARIABLE));
+        if (!j) {
+            exit(FILE_OUTPUT_ERR);
+        }
+    }
+    feed* f = NULL;
+    if (getenv(FEED_VARIABLE)) {
+        f = feed_open(getenv(FEED_VARIABLE));
+        if (!f) {
+            exit(FILE_OUTPUT_ERR);
+        }
+    }
     game *g = NULL;
+    int status = 0;
     if (replayFile[0] != 0) {
         g = game_import(replayFile);
-        if (g->type != GAME_FREESTYLE) {
+        if (g->type == GAME_RENJU) {
             exit(RESUME_ERR);
         }
-        game_resume(g);
+        if (j) {
+            journal_watch(j, g);
+        }
+        if (f && !feed_watch(f, g)) {
+            exit(ARGUMENT_ERR);
+        }
+        if (cFlag) {
+            ponder_resume(g, computer, seconds);
+        } else if (batch) {
+            if (g->state != GAME_STATE_STOPPED) {
+                exit(RESUME_ERR);
+            }
+            g->state = GAME_STATE_PLAYING;
+            status = game_batch(g, STDIN_FILENO, batch == 2) ? 0 : INPUT_ERR;
+        } else {
+            game_resume(g);
+        }
     } else {
         if (size == -1) {
-            g = game_create(DEFAULT_SIZE, GAME_FREESTYLE);
+            g = game_create(DEFAULT_SIZE, type);
         } else {
-            g = game_create(size, GAME_FREESTYLE);
+            g = game_create(size, type);
+        }
+        if (j) {
+            journal_watch(j, g);
+        }
+        if (f && !feed_watch(f, g)) {
+            exit(ARGUMENT_ERR);
+        }
+        if (cFlag) {
+            ponder_loop(g, computer, seconds);
+        } else if (batch) {
+            status = game_batch(g, STDIN_FILENO, batch == 2) ? 0 : INPUT_ERR;
+        } else {
+            game_loop(g);
         }
-        game_loop(g);
     }
+    ponder_cache_close();
     if (outputFile[0] != 0) {
         game_export(g, outputFile);
     }
-}
\ No newline at end of file
+    if (j) {
+        if (j->failed) {
+            printf("The journal could not be written, the game was stopped.\n");
+            status = FILE_OUTPUT_ERR;
+        }
+        journal_close(j);
+    }
+    if (f) {
+        feed_publish(f, g, FEED_END);
+        feed_close(f);
+    }
+    return status;
+}
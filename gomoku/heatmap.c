@@ -0,0 +1,218 @@
+/**
+ * @file heatmap.c
+ * @author Jason Wang
+ * This program computes the threat heatmap of a board: for every intersection, the number of stones of each color
+ * within HEATMAP_DISTANCE on its four lines. The board is copied once into a grid with an empty border, where each of
+ * the 16 neighbours of an intersection is a fixed offset, so the whole board is counted with one vector compare and
+ * subtract per neighbour and color, 16 (SSE2) or 32 (AVX2) intersections at a time.
+*/
+#include "heatmap.h"
+#include <string.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HEATMAP_X86
+#endif
+
+/** number of neighbours of an intersection counted by the heatmap */
+#define NEIGHBOURS (4 * 2 * HEATMAP_DISTANCE)
+/** largest sort key of a candidate, from its total and its own count */
+#define MAX_KEY (NEIGHBOURS * (NEIGHBOURS + 1) + NEIGHBOURS)
+
+/**
+ * Copies a board into the padded grid of a heatmap and computes the offsets of the neighbours
+ * @param b the board
+ * @param h the heatmap
+ * @param padded the padded grid
+ * @param offsets the offsets of the neighbours
+*/
+static void pad(const board* b, heatmap* h, uint8_t* padded, int* offsets) {
+    h->size = b->size;
+    h->width = b->size + 2 * HEATMAP_DISTANCE;
+    memset(padded, EMPTY_INTERSECTION, HEATMAP_BUFFER);
+    for (int row = 0; row < b->size; row++) {
+        memcpy(padded + HEATMAP_INDEX(h, 0, row), b->grid + row * b->size, b->size);
+    }
+    const int steps[4] = {1, h->width, h->width + 1, h->width - 1};
+    int n = 0;
+    for (int d = 0; d < 4; d++) {
+        for (int k = 1; k <= HEATMAP_DISTANCE; k++) {
+            offsets[n++] = k * steps[d];
+            offsets[n++] = -k * steps[d];
+        }
+    }
+}
+
+/**
+ * Counts the neighbours of the intersections of a range one at a time
+ * @param padded the padded grid
+ * @param offsets the offsets of the neighbours
+ * @param own the color of the side to move
+ * @param opponent the other color
+ * @param first the first index
+ * @param last the index after the last one
+ * @param h the heatmap
+*/
+static void countScalar(const uint8_t* padded, const int* offsets, uint8_t own, uint8_t opponent, int first, int last,
+                        heatmap* h) {
+    for (int i = first; i < last; i++) {
+        uint8_t ownCount = 0;
+        uint8_t opponentCount = 0;
+        for (int n = 0; n < NEIGHBOURS; n++) {
+            ownCount += padded[i + offsets[n]] == own;
+            opponentCount += padded[i + offsets[n]] == opponent;
+        }
+        h->own[i] = ownCount;
+        h->opponent[i] = opponentCount;
+    }
+}
+
+#ifdef HEATMAP_X86
+/**
+ * Counts the neighbours of the intersections of a range 16 at a time. A byte compare gives -1 on a match, which is
+ * subtracted from the counts.
+ * @param padded the padded grid
+ * @param offsets the offsets of the neighbours
+ * @param own the color of the side to move
+ * @param opponent the other color
+ * @param first the first index
+ * @param last the index after the last one, rounded up to the vector width within the margin
+ * @param h the heatmap
+*/
+__attribute__((target("sse2")))
+static void countSse2(const uint8_t* padded, const int* offsets, uint8_t own, uint8_t opponent, int first, int last,
+                      heatmap* h) {
+    __m128i ownStones = _mm_set1_epi8((char) own);
+    __m128i opponentStones = _mm_set1_epi8((char) opponent);
+    for (int i = first; i < last; i += 16) {
+        __m128i ownCount = _mm_setzero_si128();
+        __m128i opponentCount = _mm_setzero_si128();
+        for (int n = 0; n < NEIGHBOURS; n++) {
+            __m128i cells = _mm_loadu_si128((const __m128i *) (padded + i + offsets[n]));
+            ownCount = _mm_sub_epi8(ownCount, _mm_cmpeq_epi8(cells, ownStones));
+            opponentCount = _mm_sub_epi8(opponentCount, _mm_cmpeq_epi8(cells, opponentStones));
+        }
+        _mm_storeu_si128((__m128i *) (h->own + i), ownCount);
+        _mm_storeu_si128((__m128i *) (h->opponent + i), opponentCount);
+    }
+}
+
+/**
+ * Counts the neighbours of the intersections of a range 32 at a time
+ * @param padded the padded grid
+ * @param offsets the offsets of the neighbours
+ * @param own the color of the side to move
+ * @param opponent the other color
+ * @param first the first index
+ * @param last the index after the last one, rounded up to the vector width within the margin
+ * @param h the heatmap
+*/
+__attribute__((target("avx2")))
+static void countAvx2(const uint8_t* padded, const int* offsets, uint8_t own, uint8_t opponent, int first, int last,
+                      heatmap* h) {
+    __m256i ownStones = _mm256_set1_epi8((char) own);
+    __m256i opponentStones = _mm256_set1_epi8((char) opponent);
+    for (int i = first; i < last; i += 32) {
+        __m256i ownCount = _mm256_setzero_si256();
+        __m256i opponentCount = _mm256_setzero_si256();
+        for (int n = 0; n < NEIGHBOURS; n++) {
+            __m256i cells = _mm256_loadu_si256((const __m256i *) (padded + i + offsets[n]));
+            ownCount = _mm256_sub_epi8(ownCount, _mm256_cmpeq_epi8(cells, ownStones));
+            opponentCount = _mm256_sub_epi8(opponentCount, _mm256_cmpeq_epi8(cells, opponentStones));
+        }
+        _mm256_storeu_si256((__m256i *) (h->own + i), ownCount);
+        _mm256_storeu_si256((__m256i *) (h->opponent + i), opponentCount);
+    }
+}
+#endif
+
+/**
+ * Checks if the machine runs an instruction set of the heatmap kernel
+ * @param isa HEATMAP_SCALAR, HEATMAP_SSE2 or HEATMAP_AVX2
+ * @return true if it does
+*/
+bool heatmap_supports(int isa) {
+    switch (isa) {
+        case HEATMAP_SCALAR: return true;
+#ifdef HEATMAP_X86
+        case HEATMAP_SSE2: return __builtin_cpu_supports("sse2");
+        case HEATMAP_AVX2: return __builtin_cpu_supports("avx2");
+#endif
+        default: return false;
+    }
+}
+
+/**
+ * Computes the heatmap of a board with one instruction set, which the machine must run. Only the entries of the
+ * intersections of the board are meaningful.
+ * @param b the board, at most 19x19
+ * @param stone the color of the side to move, whose stones are counted as its own
+ * @param h the heatmap
+ * @param isa HEATMAP_SCALAR, HEATMAP_SSE2 or HEATMAP_AVX2
+*/
+void heatmap_compute_isa(const board* b, unsigned char stone, heatmap* h, int isa) {
+    uint8_t padded[HEATMAP_BUFFER];
+    int offsets[NEIGHBOURS];
+    pad(b, h, padded, offsets);
+    uint8_t opponent = stone == BLACK_STONE ? WHITE_STONE : BLACK_STONE;
+    int first = HEATMAP_INDEX(h, -HEATMAP_DISTANCE, 0);
+    int last = HEATMAP_INDEX(h, -HEATMAP_DISTANCE, b->size);
+    switch (isa) {
+#ifdef HEATMAP_X86
+        case HEATMAP_SSE2: countSse2(padded, offsets, stone, opponent, first, last, h); break;
+        case HEATMAP_AVX2: countAvx2(padded, offsets, stone, opponent, first, last, h); break;
+#endif
+        default: countScalar(padded, offsets, stone, opponent, first, last, h); break;
+    }
+}
+
+/**
+ * Computes the heatmap of a board with the widest instruction set of the machine
+ * @param b the board, at most 19x19
+ * @param stone the color of the side to move
+ * @param h the heatmap
+*/
+void heatmap_compute(const board* b, unsigned char stone, heatmap* h) {
+    static int widest = -1;
+    int isa = __atomic_load_n(&widest, __ATOMIC_RELAXED);
+    if (isa < 0) {
+        isa = HEATMAP_SCALAR;
+        isa = heatmap_supports(HEATMAP_SSE2) ? HEATMAP_SSE2 : isa;
+        isa = heatmap_supports(HEATMAP_AVX2) ? HEATMAP_AVX2 : isa;
+        __atomic_store_n(&widest, isa, __ATOMIC_RELAXED);
+    }
+    heatmap_compute_isa(b, stone, h, isa);
+}
+
+/**
+ * Lists the empty intersections with at least one stone within HEATMAP_DISTANCE on their lines, the ones with the
+ * most stones around them first, then the ones with more stones of the side to move, then in grid order
+ * @param b the board, at most 19x19
+ * @param stone the color of the side to move
+ * @param cells the grid indexes of the intersections
+ * @return the number of intersections
+*/
+size_t heatmap_candidates(const board* b, unsigned char stone, uint16_t* cells) {
+    heatmap h;
+    heatmap_compute(b, stone, &h);
+    size_t counts[MAX_KEY + 1] = {0};
+    uint16_t keys[HEATMAP_WIDTH * HEATMAP_WIDTH];
+    int size = b->size;
+    for (int cell = 0; cell < size * size; cell++) {
+        int i = HEATMAP_INDEX(&h, cell % size, cell / size);
+        int total = h.own[i] + h.opponent[i];
+        keys[cell] = b->grid[cell] == EMPTY_INTERSECTION && total > 0 ? total * (NEIGHBOURS + 1) + h.own[i] : 0;
+        counts[keys[cell]]++;
+    }
+    size_t next = 0;
+    for (int key = MAX_KEY; key > 0; key--) {
+        size_t count = counts[key];
+        counts[key] = next;
+        next += count;
+    }
+    for (int cell = 0; cell < size * size; cell++) {
+        if (keys[cell] > 0) {
+            cells[counts[keys[cell]]++] = cell;
+        }
+    }
+    return next;
+}
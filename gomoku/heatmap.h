@@ -0,0 +1,37 @@
+#ifndef _HEATMAP_H_
+#define _HEATMAP_H_
+#include "board.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+/** distance along a line within which the stones of an intersection are counted */
+#define HEATMAP_DISTANCE 2
+/** largest board of the heatmap, with a border of HEATMAP_DISTANCE empty rows and columns on each side */
+#define HEATMAP_WIDTH (19 + 2 * HEATMAP_DISTANCE)
+/** room before and after the padded board so that the vector loops can read past both ends */
+#define HEATMAP_MARGIN 64
+#define HEATMAP_BUFFER (HEATMAP_WIDTH * HEATMAP_WIDTH + 2 * HEATMAP_MARGIN)
+/** instruction sets of the heatmap kernel */
+#define HEATMAP_SCALAR 0
+#define HEATMAP_SSE2 1
+#define HEATMAP_AVX2 2
+
+typedef struct {
+    int size;
+    int width;
+    uint8_t own[HEATMAP_BUFFER];
+    uint8_t opponent[HEATMAP_BUFFER];
+} heatmap;
+
+/** Gets the index of an intersection in the arrays of a heatmap */
+#define HEATMAP_INDEX(h, col, row) (HEATMAP_MARGIN + ((row) + HEATMAP_DISTANCE) * (h)->width + (col) + HEATMAP_DISTANCE)
+
+/** function to check if the machine runs an instruction set of the heatmap kernel */
+bool heatmap_supports(int isa);
+/** function to compute the heatmap of a board with one instruction set */
+void heatmap_compute_isa(const board* b, unsigned char stone, heatmap* h, int isa);
+/** function to compute the heatmap of a board with the widest instruction set of the machine */
+void heatmap_compute(const board* b, unsigned char stone, heatmap* h);
+/** function to list the empty intersections near stones, hottest first */
+size_t heatmap_candidates(const board* b, unsigned char stone, uint16_t* cells);
+#endif
@@ -1,120 +1,404 @@
-/** 
- * @file io.c
- * @author Jason Wang
- * This program controls the input / output for the game. (Read / Write from file)
-*/
-#include "io.h"
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include "error-codes.h"
-#include "board.h"
-#include "game.h"
-
-/**
- * Saves the move to the games move history
- * @param g the game structure pointer
- * @param x the x coordinate
- * @param y the y coordinate
-*/
-static void saveMove(game *g, unsigned char x, unsigned char y) {
-    if (g->moves_count == g->moves_capacity) {
-        g->moves_capacity *= 2;
-        g->moves = (move *) realloc(g->moves, g->moves_capacity * sizeof(move));
-    }
-    move newMove = {x, y, g->stone};
-    g->moves[(g->moves_count)++] = newMove;
-}
-
-/**
- * Imports a saved game from a file
- * @param path the path to the saved game file
- * @return a pointer to the imported game structure
-*/
-game* game_import(const char* path) {
-    FILE *f = fopen(path, "r");
-    if (!f) {
-        exit(FILE_INPUT_ERR);
-    }
-    char mn1, mn2;
-    if (fscanf(f, "%c%c", &mn1, &mn2) != 2) {
-        exit(FILE_INPUT_ERR);
-    }
-    if (!(mn1 == 'G' && mn2 == 'A')) {
-        exit(FILE_INPUT_ERR);
-    }
-    int boardSize = 0;
-    if (fscanf(f, "%d", &boardSize) != 1) {
-        exit(FILE_INPUT_ERR);
-    }
-    if (boardSize != 15 && boardSize != 17 && boardSize != 19) {
-        exit(FILE_INPUT_ERR);
-    }
-    int gameType = 0;
-    if (fscanf(f, "%d", &gameType) != 1) {
-        exit(FILE_INPUT_ERR);
-    }
-    if (gameType < 0 || gameType > 1) {
-        exit(FILE_INPUT_ERR);
-    }
-    int gameState = 0;
-    if (fscanf(f, "%d", &gameState) != 1) {
-        exit(FILE_INPUT_ERR);
-    }
-    if (gameState < 0 || gameState > 3) {
-        exit(FILE_INPUT_ERR);
-    }
-    int gameWinner = 0;
-    if (fscanf(f, "%d", &gameWinner) != 1) {
-        exit(FILE_INPUT_ERR);
-    }
-    if (gameWinner < 0 || gameWinner > 2) {
-        exit(FILE_INPUT_ERR);
-    }
-    game *g = game_create(boardSize, gameType);
-    g->state = gameState;
-    g->winner = gameWinner;
-
-    char buffer[50];
-    while (fgets(buffer, 50, f)) {
-        if (strcmp(buffer, "\n") == 0) {
-            continue;
-        }
-        char line[50] = {0};
-        strncpy(line, buffer, 50);
-        line[strlen(line) - 1] = 0;
-        unsigned char x, y;
-        if (board_coord(g->board, line, &x, &y) == FORMAL_COORDINATE_ERR) {
-            game_delete(g);
-            exit(FILE_INPUT_ERR);
-        }
-        saveMove(g, x, y);
-        board_set(g->board, x, y, g->stone);
-        g->stone = (g->stone == BLACK_STONE ? WHITE_STONE : BLACK_STONE);
-    }
-    fclose(f);
-    return g;
-}
-
-/**
- * Exports the current game state to a file
- * @param g the game structure pointer
- * @param path the path to save the output file
-*/
-void game_export(game* g, const char* path) {
-    FILE *f = fopen(path, "w");
-    if (!f) {
-        exit(FILE_OUTPUT_ERR);
-    }
-    fprintf(f, "GA\n");
-    fprintf(f, "%u\n", g->board->size);
-    fprintf(f, "%u\n", g->type);
-    fprintf(f, "%u\n", g->state);
-    fprintf(f, "%u\n", g->winner);
-    for (int i = 0; i < g->moves_count; i++) {
-        char formalCoord[10] = {0};
-        board_formal_coord(g->board, g->moves[i].x, g->moves[i].y, formalCoord);
-        fprintf(f, "%s\n", formalCoord);
-    }
-    fclose(f);
+/** 
+ * @file io.c
+ * @author Jason Wang
+ * This program controls the input / output for the game. (Read / Write from file)
+*/
+#define _POSIX_C_SOURCE 200809L
+#include "io.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "error-codes.h"
+#include "board.h"
+#include "game.h"
+#include "rules.h"
+#include "sparse.h"
+
+/**
+ * Saves the move to the games move history
+ * @param g the game structure pointer
+ * @param cell the grid index
+*/
+static void saveMove(game *g, uint16_t cell) {
+    if (g->moves_count == g->moves_capacity) {
+        g->moves_capacity *= 2;
+        g->moves = (move *) realloc(g->moves, g->moves_capacity * sizeof(move));
+    }
+    move newMove = {cell, g->stone};
+    g->moves[(g->moves_count)++] = newMove;
+}
+
+/**
+ * Imports a saved game from a file. The opening choices, such as swap or two, are lines among the moves and are only
+ * accepted where the rules of the game wait for them.
+ * @param path the path to the saved game file
+ * @return a pointer to the imported game structure
+*/
+game* game_import(const char* path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        exit(FILE_INPUT_ERR);
+    }
+    char mn1, mn2;
+    if (fscanf(f, "%c%c", &mn1, &mn2) != 2) {
+        exit(FILE_INPUT_ERR);
+    }
+    if (!(mn1 == 'G' && mn2 == 'A')) {
+        exit(FILE_INPUT_ERR);
+    }
+    int boardSize = 0;
+    if (fscanf(f, "%d", &boardSize) != 1) {
+        exit(FILE_INPUT_ERR);
+    }
+    if (boardSize != 15 && boardSize != 17 && boardSize != 19) {
+        exit(FILE_INPUT_ERR);
+    }
+    int gameType = 0;
+    if (fscanf(f, "%d", &gameType) != 1) {
+        exit(FILE_INPUT_ERR);
+    }
+    if (gameType < 0 || gameType >= GAME_VARIANTS) {
+        exit(FILE_INPUT_ERR);
+    }
+    int gameState = 0;
+    if (fscanf(f, "%d", &gameState) != 1) {
+        exit(FILE_INPUT_ERR);
+    }
+    if (gameState < 0 || gameState > GAME_STATE_DRAWN) {
+        exit(FILE_INPUT_ERR);
+    }
+    int gameWinner = 0;
+    if (fscanf(f, "%d", &gameWinner) != 1) {
+        exit(FILE_INPUT_ERR);
+    }
+    if (gameWinner < 0 || gameWinner > 2) {
+        exit(FILE_INPUT_ERR);
+    }
+    game *g = game_create(boardSize, gameType);
+    g->state = gameState;
+    g->winner = gameWinner;
+
+    char buffer[50];
+    while (fgets(buffer, 50, f)) {
+        if (strcmp(buffer, "\n") == 0) {
+            continue;
+        }
+        char line[50] = {0};
+        strncpy(line, buffer, 50);
+        line[strlen(line) - 1] = 0;
+        if (g->rules->opening_choose(g, line)) {
+            continue;
+        }
+        uint16_t cell;
+        if (board_coord(g->board, line, &cell) == FORMAL_COORDINATE_ERR) {
+            game_delete(g);
+            exit(FILE_INPUT_ERR);
+        }
+        saveMove(g, cell);
+        board_set(g->board, cell, g->stone);
+        g->stone = (g->stone == BLACK_STONE ? WHITE_STONE : BLACK_STONE);
+    }
+    fclose(f);
+    return g;
+}
+
+/**
+ * Reads the next whitespace-separated token of a text
+ * @param text the text
+ * @param len the length of the text
+ * @param pos the reading position, moved past the token
+ * @param token the output token
+ * @param max the room of the output token
+ * @return the length of the token, 0 at the end of the text or if the token does not fit
+*/
+static size_t nextToken(const char* text, size_t len, size_t* pos, char* token, size_t max) {
+    while (*pos < len && (text[*pos] == ' ' || text[*pos] == '\n' || text[*pos] == '\r' || text[*pos] == '\t')) {
+        (*pos)++;
+    }
+    size_t n = 0;
+    while (*pos < len && text[*pos] != ' ' && text[*pos] != '\n' && text[*pos] != '\r' && text[*pos] != '\t') {
+        if (n + 1 >= max) {
+            return 0;
+        }
+        token[n++] = text[(*pos)++];
+    }
+    token[n] = '\0';
+    return n;
+}
+
+/**
+ * Reads the next token of a text as a number within a range
+ * @param text the text
+ * @param len the length of the text
+ * @param pos the reading position, moved past the token
+ * @param min the smallest value accepted
+ * @param max the largest value accepted
+ * @param value the number read
+ * @return true if the token is a number within the range
+*/
+static bool nextNumber(const char* text, size_t len, size_t* pos, int min, int max, int* value) {
+    char token[16];
+    if (nextToken(text, len, pos, token, sizeof(token)) == 0) {
+        return false;
+    }
+    char* end;
+    long number = strtol(token, &end, 10);
+    if (*end != '\0' || number < min || number > max) {
+        return false;
+    }
+    *value = (int) number;
+    return true;
+}
+
+/**
+ * Parses a saved game held in memory, such as a member of an archive. Unlike game_import it never exits:
+ * malformed text, a coordinate outside the board or a move on an occupied intersection makes it return NULL.
+ * @param text the content of a .gmk file, not necessarily null-terminated
+ * @param len the length of the text
+ * @return a pointer to the parsed game structure, or NULL if the text is not a valid game
+*/
+game* game_parse(const char* text, size_t len) {
+    size_t pos = 0;
+    char token[BOARD_COORD_LEN + 1];
+    int boardSize, gameType, gameState, gameWinner;
+    if (nextToken(text, len, &pos, token, sizeof(token)) == 0 || strcmp(token, "GA") != 0
+        || !nextNumber(text, len, &pos, 15, 19, &boardSize) || (boardSize != 15 && boardSize != 17 && boardSize != 19)
+        || !nextNumber(text, len, &pos, 0, GAME_VARIANTS - 1, &gameType) || !nextNumber(text, len, &pos, 0, GAME_STATE_DRAWN, &gameState)
+        || !nextNumber(text, len, &pos, 0, 2, &gameWinner)) {
+        return NULL;
+    }
+    game *g = game_create(boardSize, gameType);
+    if (!g) {
+        return NULL;
+    }
+    g->state = gameState;
+    g->winner = gameWinner;
+    while (pos < len) {
+        size_t n = nextToken(text, len, &pos, token, sizeof(token));
+        if (n == 0) {
+            if (pos < len) {
+                game_delete(g);
+                return NULL;
+            }
+            break;
+        }
+        if (g->rules->opening_choose(g, token)) {
+            continue;
+        }
+        uint16_t cell;
+        if (board_coord(g->board, token, &cell) != SUCCESS || board_get(g->board, cell) != EMPTY_INTERSECTION) {
+            game_delete(g);
+            return NULL;
+        }
+        saveMove(g, cell);
+        board_set(g->board, cell, g->stone);
+        g->stone = (g->stone == BLACK_STONE ? WHITE_STONE : BLACK_STONE);
+    }
+    return g;
+}
+
+/**
+ * Reads the board size of a saved game held in memory without parsing its moves, like game_peek_size
+ * @param text the content of a .gmk file, not necessarily null-terminated
+ * @param len the length of the text
+ * @return the board size, 0 for an unbounded board, or -1 if the text does not start like a saved game
+*/
+int game_parse_size(const char* text, size_t len) {
+    size_t pos = 0;
+    char token[BOARD_COORD_LEN + 1];
+    int boardSize;
+    if (nextToken(text, len, &pos, token, sizeof(token)) == 0 || strcmp(token, "GA") != 0
+        || !nextNumber(text, len, &pos, 0, SPARSE_MAX_SIZE, &boardSize)) {
+        return -1;
+    }
+    return boardSize;
+}
+
+/**
+ * Exports the current game state to a file, with each opening choice on its own line after the stones it followed
+ * @param g the game structure pointer
+ * @param path the path to save the output file
+*/
+void game_export(game* g, const char* path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        exit(FILE_OUTPUT_ERR);
+    }
+    fprintf(f, "GA\n");
+    fprintf(f, "%u\n", g->board->size);
+    fprintf(f, "%u\n", g->type);
+    fprintf(f, "%u\n", g->state);
+    fprintf(f, "%u\n", g->winner);
+    for (size_t i = 0; i <= g->moves_count; i++) {
+        const char* choice = g->rules->opening_choice(g->opening, g->swapped, i);
+        if (choice) {
+            fprintf(f, "%s\n", choice);
+        }
+        if (i == g->moves_count) {
+            break;
+        }
+        char formalCoord[10] = {0};
+        board_formal_coord(g->board, g->moves[i].cell, formalCoord);
+        fprintf(f, "%s\n", formalCoord);
+    }
+    fclose(f);
+}
+
+/**
+ * Reads the board size of a saved game without loading it, so that a caller can choose between game_import and
+ * sparse_import. If the file cannot be read or does not start like a saved game, exit with FILE_INPUT_ERR.
+ * @param path the path to the saved game file
+ * @return the board size, 0 for an unbounded board
+*/
+int game_peek_size(const char* path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        exit(FILE_INPUT_ERR);
+    }
+    char mn1, mn2;
+    int boardSize = 0;
+    if (fscanf(f, "%c%c", &mn1, &mn2) != 2 || !(mn1 == 'G' && mn2 == 'A') || fscanf(f, "%d", &boardSize) != 1) {
+        exit(FILE_INPUT_ERR);
+    }
+    fclose(f);
+    return boardSize;
+}
+
+/**
+ * Imports a saved large-board game from a file into a sparse board.
+ * The file format is the same as game_import, except that the size is SPARSE_MIN_SIZE to SPARSE_MAX_SIZE,
+ * or SPARSE_UNBOUNDED, and coordinates use the extended "letters + number" syntax.
+ * @param path the path to the saved game file
+ * @param state the game state read from the file
+ * @param winner the winner read from the file
+ * @return a pointer to the imported sparse board
+*/
+sparse_board* sparse_import(const char* path, unsigned char* state, unsigned char* winner) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        exit(FILE_INPUT_ERR);
+    }
+    char mn1, mn2;
+    if (fscanf(f, "%c%c", &mn1, &mn2) != 2) {
+        exit(FILE_INPUT_ERR);
+    }
+    if (!(mn1 == 'G' && mn2 == 'A')) {
+        exit(FILE_INPUT_ERR);
+    }
+    int boardSize = 0;
+    if (fscanf(f, "%d", &boardSize) != 1) {
+        exit(FILE_INPUT_ERR);
+    }
+    if (boardSize != SPARSE_UNBOUNDED && (boardSize < SPARSE_MIN_SIZE || boardSize > SPARSE_MAX_SIZE)) {
+        exit(FILE_INPUT_ERR);
+    }
+    int gameType = 0;
+    if (fscanf(f, "%d", &gameType) != 1) {
+        exit(FILE_INPUT_ERR);
+    }
+    if (gameType != GAME_FREESTYLE) {
+        exit(FILE_INPUT_ERR);
+    }
+    int gameState = 0;
+    if (fscanf(f, "%d", &gameState) != 1) {
+        exit(FILE_INPUT_ERR);
+    }
+    if (gameState < 0 || gameState > GAME_STATE_DRAWN) {
+        exit(FILE_INPUT_ERR);
+    }
+    int gameWinner = 0;
+    if (fscanf(f, "%d", &gameWinner) != 1) {
+        exit(FILE_INPUT_ERR);
+    }
+    if (gameWinner < 0 || gameWinner > 2) {
+        exit(FILE_INPUT_ERR);
+    }
+    sparse_board *b = sparse_create(boardSize);
+    *state = gameState;
+    *winner = gameWinner;
+
+    unsigned char stone = BLACK_STONE;
+    char buffer[50];
+    while (fgets(buffer, 50, f)) {
+        if (strcmp(buffer, "\n") == 0) {
+            continue;
+        }
+        int x, y;
+        if (board_parse_coord(buffer, &x, &y) != SUCCESS || sparse_set(b, x, y, stone) != SUCCESS) {
+            sparse_delete(b);
+            exit(FILE_INPUT_ERR);
+        }
+        stone = (stone == BLACK_STONE ? WHITE_STONE : BLACK_STONE);
+    }
+    fclose(f);
+    return b;
+}
+
+/**
+ * Exports a large-board game kept in a sparse board to a file
+ * @param b the sparse board
+ * @param state the game state
+ * @param winner the winner
+ * @param path the path to save the output file
+*/
+void sparse_export(sparse_board* b, unsigned char state, unsigned char winner, const char* path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        exit(FILE_OUTPUT_ERR);
+    }
+    fprintf(f, "GA\n");
+    fprintf(f, "%u\n", b->size);
+    fprintf(f, "%u\n", GAME_FREESTYLE);
+    fprintf(f, "%u\n", state);
+    fprintf(f, "%u\n", winner);
+    for (size_t i = 0; i < b->moves_count; i++) {
+        char formalCoord[BOARD_COORD_LEN] = {0};
+        board_format_coord(b->moves[i].x, b->moves[i].y, formalCoord);
+        fprintf(f, "%s\n", formalCoord);
+    }
+    fclose(f);
+}
+
+/**
+ * Compares two strings for qsort
+ * @param a the first string pointer
+ * @param b the second string pointer
+ * @return the comparison
+*/
+static int compareNames(const void* a, const void* b) {
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+/**
+ * Lists the .gmk files of a directory in name order
+ * @param dir the directory
+ * @param count the number of files found
+ * @return the array of paths, each path and the array are to be freed by the caller
+*/
+char** game_list_dir(const char* dir, size_t* count) {
+    DIR* d = opendir(dir);
+    if (!d) {
+        exit(FILE_INPUT_ERR);
+    }
+    size_t capacity = 16;
+    char** paths = (char **) malloc(capacity * sizeof(char *));
+    *count = 0;
+    struct dirent* entry;
+    while ((entry = readdir(d))) {
+        size_t len = strlen(entry->d_name);
+        if (len < 4 || strcmp(entry->d_name + len - 4, ".gmk") != 0) {
+            continue;
+        }
+        if (*count == capacity) {
+            capacity *= 2;
+            paths = (char **) realloc(paths, capacity * sizeof(char *));
+        }
+        paths[*count] = (char *) malloc(strlen(dir) + len + 2);
+        sprintf(paths[*count], "%s/%s", dir, entry->d_name);
+        (*count)++;
+    }
+    closedir(d);
+    qsort(paths, *count, sizeof(char *), compareNames);
+    return paths;
 }
\ No newline at end of file
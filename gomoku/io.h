@@ -1,10 +1,23 @@
 #ifndef _IO_H_
 #define _IO_H_
 #include "game.h"
+#include "sparse.h"
 
 /** Function to import a game*/
 game* game_import(const char* path);
 // void game_export(game* g, bool binary, const char* path);
 /** Function to export a game*/
 void game_export(game* g, const char* path);
+/** Function to read the board size of a saved game*/
+int game_peek_size(const char* path);
+/** Function to import a large-board game*/
+sparse_board* sparse_import(const char* path, unsigned char* state, unsigned char* winner);
+/** Function to export a large-board game*/
+void sparse_export(sparse_board* b, unsigned char state, unsigned char winner, const char* path);
+/** Function to parse a game held in memory without exiting on errors*/
+game* game_parse(const char* text, size_t len);
+/** Function to read the board size of a game held in memory*/
+int game_parse_size(const char* text, size_t len);
+/** Function to list the games of a directory*/
+char** game_list_dir(const char* dir, size_t* count);
 #endif
\ No newline at end of file
@@ -0,0 +1,481 @@
+/**
+ * @file journal.c
+ * @author Jason Wang
+ * This program keeps an append-only journal of the moves of many games. Each move is a fixed-size record, and a move
+ * returns once its record is on disk. The records of all games go through one buffer: the first waiting thread writes
+ * everything buffered so far with a single write and fdatasync (a group commit) while the others keep buffering,
+ * so the number of syncs follows the number of commits rather than the number of moves.
+ * Several processes may append to the same journal: each batch is written under a lock on the file, and a game takes
+ * its id from the records of every process, so the commits of a process group its own games only.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include "journal.h"
+#include "error-codes.h"
+#include "rules.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Computes the check of a record over its other fields, with 32-bit FNV-1a folded to 16 bits
+ * @param r the record
+ * @return the check
+*/
+static uint16_t recordCheck(const journal_record* r) {
+    const unsigned char* bytes = (const unsigned char *) r;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(journal_record, check); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return (uint16_t) (hash ^ hash >> 16);
+}
+
+/**
+ * Fills the record of a move of a game. The state and winner of the game are recorded with its last move, and its
+ * opening step with every move, so that an opening choice reaches the journal with the next stone.
+ * @param id the journal id of the game
+ * @param g the game
+ * @param ply the index of the move
+ * @param r the record
+*/
+static void makeRecord(uint32_t id, const game* g, size_t ply, journal_record* r) {
+    bool last = ply + 1 == g->moves_count;
+    memset(r, 0, sizeof(*r));
+    r->game = id;
+    r->ply = (uint16_t) ply;
+    r->x = 'A' + BOARD_COL(g->board, g->moves[ply].cell);
+    r->y = BOARD_ROW(g->board, g->moves[ply].cell) + 1;
+    r->stone = g->moves[ply].stone;
+    r->size = g->board->size;
+    r->type = g->type;
+    r->state = last ? g->state : GAME_STATE_PLAYING;
+    r->winner = last ? g->winner : EMPTY_INTERSECTION;
+    r->opening = g->opening | (g->swapped ? JOURNAL_SWAPPED : 0);
+    r->check = recordCheck(r);
+}
+
+/**
+ * Writes a whole buffer to a file, continuing after partial writes
+ * @param fd the file
+ * @param data the buffer
+ * @param len the length of the buffer
+ * @return true if every byte was written
+*/
+static bool writeAll(int fd, const void* data, size_t len) {
+    const char* bytes = (const char *) data;
+    while (len > 0) {
+        ssize_t written = write(fd, bytes, len);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        len -= written;
+    }
+    return true;
+}
+
+/**
+ * Takes or releases the lock on the journal file, waiting for another process that holds it
+ * @param fd the file
+ * @param type F_WRLCK to take the lock, F_UNLCK to release it
+ * @return true on success
+*/
+static bool lockFile(int fd, short type) {
+    struct flock lock = {0};
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+    while (fcntl(fd, F_SETLKW, &lock) != 0) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Reads the records appended since the last scan, by this process or others, to keep the next game id past theirs,
+ * and cuts off a record torn by a crash so that the next ones stay aligned. The caller holds the file lock.
+ * @param j the journal
+ * @return true if the file could be read and cut
+*/
+static bool catchUp(journal* j) {
+    struct stat st;
+    if (fstat(j->fd, &st) != 0) {
+        return false;
+    }
+    journal_record records[JOURNAL_BATCH];
+    bool torn = false;
+    while (!torn && j->scanned + sizeof(journal_record) <= (uint64_t) st.st_size) {
+        ssize_t bytes = pread(j->fd, records, sizeof(records), j->scanned);
+        if (bytes < (ssize_t) sizeof(journal_record)) {
+            return false;
+        }
+        for (size_t i = 0; i < bytes / sizeof(journal_record); i++) {
+            if (records[i].check != recordCheck(&records[i])) {
+                torn = true;
+                break;
+            }
+            j->next_game = records[i].game >= j->next_game ? records[i].game + 1 : j->next_game;
+            j->scanned += sizeof(journal_record);
+        }
+    }
+    return j->scanned == (uint64_t) st.st_size || ftruncate(j->fd, j->scanned) == 0;
+}
+
+/**
+ * Writes records at the end of the journal file under the file lock, after the records of other processes
+ * @param j the journal
+ * @param records the records
+ * @param count the number of records
+ * @param reserve true to give the records the next game id first, which reserves it for a game
+ * @param sync true to wait until the records are on disk
+ * @return true if the records were written
+*/
+static bool writeRecords(journal* j, journal_record* records, size_t count, bool reserve, bool sync) {
+    pthread_mutex_lock(&j->file_lock);
+    bool written = lockFile(j->fd, F_WRLCK) && catchUp(j);
+    for (size_t i = 0; written && reserve && i < count; i++) {
+        records[i].game = j->next_game;
+        records[i].check = recordCheck(&records[i]);
+    }
+    written = written && writeAll(j->fd, records, count * sizeof(journal_record)) && (!sync || fdatasync(j->fd) == 0);
+    if (written) {
+        j->scanned += count * sizeof(journal_record);
+        j->next_game += reserve ? 1 : 0;
+    }
+    lockFile(j->fd, F_UNLCK);
+    pthread_mutex_unlock(&j->file_lock);
+    return written;
+}
+
+/**
+ * Buffers records and waits until they are durable. The first thread to wait while no commit runs becomes the
+ * committer: it takes the whole buffer, writes and syncs it without the lock, then wakes the others, one of which
+ * commits whatever was buffered in the meantime.
+ * @param j the journal
+ * @param records the records
+ * @param count the number of records
+ * @return true if the records are on disk
+*/
+static bool commit(journal* j, const journal_record* records, size_t count) {
+    pthread_mutex_lock(&j->lock);
+    if (j->pending_count + count > j->pending_capacity) {
+        size_t capacity = j->pending_capacity * 2 > j->pending_count + count ? j->pending_capacity * 2
+                                                                              : j->pending_count + count;
+        journal_record* grown = (journal_record *) realloc(j->pending, capacity * sizeof(journal_record));
+        if (!grown) {
+            pthread_mutex_unlock(&j->lock);
+            return false;
+        }
+        j->pending = grown;
+        j->pending_capacity = capacity;
+    }
+    memcpy(j->pending + j->pending_count, records, count * sizeof(journal_record));
+    j->pending_count += count;
+    j->appended += count;
+    uint64_t target = j->appended;
+    while (j->durable < target && !j->failed) {
+        if (j->committing) {
+            pthread_cond_wait(&j->committed, &j->lock);
+            continue;
+        }
+        j->committing = true;
+        journal_record* batch = j->pending;
+        size_t batchCount = j->pending_count;
+        size_t batchCapacity = j->pending_capacity;
+        uint64_t end = j->appended;
+        j->pending = j->writing;
+        j->pending_capacity = j->writing_capacity;
+        j->pending_count = 0;
+        pthread_mutex_unlock(&j->lock);
+        bool written = writeRecords(j, batch, batchCount, false, true);
+        pthread_mutex_lock(&j->lock);
+        j->writing = batch;
+        j->writing_capacity = batchCapacity;
+        j->committing = false;
+        j->commits++;
+        if (written) {
+            j->durable = end;
+        } else {
+            j->failed = true;
+        }
+        pthread_cond_broadcast(&j->committed);
+    }
+    bool durable = j->durable >= target;
+    pthread_mutex_unlock(&j->lock);
+    return durable;
+}
+
+/**
+ * Reads the valid records of a journal file, up to the first torn or corrupt one
+ * @param fd the file
+ * @param count the number of records read
+ * @return the records, NULL if there are none
+*/
+static journal_record* readRecords(int fd, size_t* count) {
+    *count = 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(journal_record)) {
+        return NULL;
+    }
+    size_t total = st.st_size / sizeof(journal_record);
+    journal_record* records = (journal_record *) malloc(total * sizeof(journal_record));
+    if (!records) {
+        return NULL;
+    }
+    ssize_t bytes = pread(fd, records, total * sizeof(journal_record), 0);
+    total = bytes > 0 ? bytes / sizeof(journal_record) : 0;
+    while (*count < total && records[*count].check == recordCheck(&records[*count])) {
+        (*count)++;
+    }
+    return records;
+}
+
+/**
+ * Opens a journal for appending, creating the file if needed, and cuts off a record torn by a crash so that the next
+ * ones stay aligned. Other processes may have the journal open too.
+ * @param path the path of the journal file
+ * @return the journal or NULL if the file cannot be opened
+*/
+journal* journal_open(const char* path) {
+    journal* j = (journal *) calloc(1, sizeof(journal));
+    if (!j) {
+        return NULL;
+    }
+    j->fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    j->pending = (journal_record *) malloc(JOURNAL_BATCH * sizeof(journal_record));
+    j->writing = (journal_record *) malloc(JOURNAL_BATCH * sizeof(journal_record));
+    if (j->fd < 0 || !j->pending || !j->writing) {
+        if (j->fd >= 0) {
+            close(j->fd);
+        }
+        free(j->pending);
+        free(j->writing);
+        free(j);
+        return NULL;
+    }
+    j->pending_capacity = JOURNAL_BATCH;
+    j->writing_capacity = JOURNAL_BATCH;
+    pthread_mutex_init(&j->file_lock, NULL);
+    pthread_mutex_init(&j->lock, NULL);
+    pthread_cond_init(&j->committed, NULL);
+    bool scanned = lockFile(j->fd, F_WRLCK) && catchUp(j);
+    lockFile(j->fd, F_UNLCK);
+    if (!scanned) {
+        journal_close(j);
+        return NULL;
+    }
+    return j;
+}
+
+/**
+ * Closes a journal. Every append has already returned durable, so nothing is left to write. The games it watches
+ * must not be played after it closes.
+ * @param j the journal
+*/
+void journal_close(journal* j) {
+    if (!j) {
+        exit(NULL_POINTER_ERR);
+    }
+    close(j->fd);
+    for (size_t i = 0; i < j->games_count; i++) {
+        free(j->games[i]);
+    }
+    free(j->games);
+    free(j->pending);
+    free(j->writing);
+    pthread_mutex_destroy(&j->file_lock);
+    pthread_mutex_destroy(&j->lock);
+    pthread_cond_destroy(&j->committed);
+    free(j);
+}
+
+/**
+ * Journals every move of a game placed from now on, as its listener. A move that cannot be made durable stops the
+ * game, and the journal stays failed, which the caller reports.
+ * @param g the game
+ * @param context the journal game
+*/
+static void journalMove(game* g, void* context) {
+    journal_game* jg = (journal_game *) context;
+    if (!journal_append(jg->journal, jg->id, g) && g->state == GAME_STATE_PLAYING) {
+        g->state = GAME_STATE_STOPPED;
+    }
+}
+
+/**
+ * Gives a game a journal id, reserved in the file with a record that recovery skips so that no other process takes it,
+ * journals the moves it already has, and adds the journal to its listeners so that each placed stone is journaled.
+ * If the journal cannot be written, exit with FILE_OUTPUT_ERR.
+ * @param j the journal
+ * @param g the game
+ * @return the journal id of the game
+*/
+uint32_t journal_watch(journal* j, game* g) {
+    journal_game* jg = (journal_game *) malloc(sizeof(journal_game));
+    pthread_mutex_lock(&j->lock);
+    journal_game** games = jg ? (journal_game **) realloc(j->games, (j->games_count + 1) * sizeof(journal_game *))
+                              : NULL;
+    if (!games) {
+        exit(NULL_POINTER_ERR);
+    }
+    j->games = games;
+    j->games[j->games_count++] = jg;
+    jg->journal = j;
+    pthread_mutex_unlock(&j->lock);
+    journal_record reservation;
+    memset(&reservation, 0, sizeof(reservation));
+    reservation.ply = JOURNAL_RESERVED_PLY;
+    reservation.size = g->board->size;
+    reservation.type = g->type;
+    if (!writeRecords(j, &reservation, 1, true, false)) {
+        exit(FILE_OUTPUT_ERR);
+    }
+    jg->id = reservation.game;
+    if (g->moves_count > 0) {
+        journal_record* records = (journal_record *) malloc(g->moves_count * sizeof(journal_record));
+        if (!records) {
+            exit(NULL_POINTER_ERR);
+        }
+        for (size_t i = 0; i < g->moves_count; i++) {
+            makeRecord(jg->id, g, i, &records[i]);
+        }
+        if (!commit(j, records, g->moves_count)) {
+            exit(FILE_OUTPUT_ERR);
+        }
+        free(records);
+    }
+    if (!game_listen(g, journalMove, jg)) {
+        exit(ARGUMENT_ERR);
+    }
+    return jg->id;
+}
+
+/**
+ * Appends the record of the last move of a game and waits until it is durable
+ * @param j the journal
+ * @param id the journal id of the game
+ * @param g the game
+ * @return true if the record is on disk, false if the journal could not be written
+*/
+bool journal_append(journal* j, uint32_t id, const game* g) {
+    if (g->moves_count == 0) {
+        return true;
+    }
+    journal_record r;
+    makeRecord(id, g, g->moves_count - 1, &r);
+    return commit(j, &r, 1);
+}
+
+/**
+ * Compares two records for qsort by game, then by move
+ * @param a the first record pointer
+ * @param b the second record pointer
+ * @return the comparison
+*/
+static int compareRecords(const void* a, const void* b) {
+    const journal_record* ra = (const journal_record *) a;
+    const journal_record* rb = (const journal_record *) b;
+    if (ra->game != rb->game) {
+        return ra->game < rb->game ? -1 : 1;
+    }
+    return ra->ply < rb->ply ? -1 : (ra->ply > rb->ply ? 1 : 0);
+}
+
+/**
+ * Rebuilds a game from its records, sorted by move. The moves are replayed up to the first one missing or invalid,
+ * each after the opening choice its record shows at that point, if the rules wait for it; the game takes the state
+ * and winner of the last record, and a game left playing was interrupted and is stopped.
+ * @param records the records of the game
+ * @param count the number of records
+ * @return the game or NULL if its first record is invalid
+*/
+static game* rebuild(const journal_record* records, size_t count) {
+    const journal_record* first = &records[0];
+    if ((first->size != 15 && first->size != 17 && first->size != 19) || first->type >= GAME_VARIANTS) {
+        return NULL;
+    }
+    game* g = game_create(first->size, first->type);
+    if (!g) {
+        return NULL;
+    }
+    const journal_record* last = NULL;
+    for (size_t i = 0; i < count; i++) {
+        const journal_record* r = &records[i];
+        if (r->ply < g->moves_count) {
+            continue;
+        }
+        if (r->ply > g->moves_count || r->x < 'A' || r->x >= 'A' + g->board->size || r->y < 1
+            || r->y > g->board->size
+            || board_get(g->board, BOARD_CELL(g->board, r->x - 'A', r->y - 1)) != EMPTY_INTERSECTION) {
+            break;
+        }
+        const char* choice = g->rules->opening_choice(r->opening & ~JOURNAL_SWAPPED, r->opening & JOURNAL_SWAPPED,
+                                                      g->moves_count);
+        if (choice && !g->rules->opening_choose(g, choice)) {
+            break;
+        }
+        g->stone = r->stone;
+        game_play(g, BOARD_CELL(g->board, r->x - 'A', r->y - 1));
+        last = r;
+    }
+    if (last) {
+        g->state = last->state == GAME_STATE_PLAYING ? GAME_STATE_STOPPED : last->state;
+        g->winner = last->winner;
+    }
+    return g;
+}
+
+/**
+ * Rebuilds the games of a journal that have moves, in the order of their ids
+ * @param path the path of the journal file
+ * @param ids the output journal ids of the games, to free
+ * @param count the number of games
+ * @return the games, to free with each game, or NULL if the file cannot be read or has no games
+*/
+game** journal_recover(const char* path, uint32_t** ids, size_t* count) {
+    *count = 0;
+    *ids = NULL;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    size_t recordsCount;
+    journal_record* records = readRecords(fd, &recordsCount);
+    close(fd);
+    size_t moves = 0;
+    for (size_t i = 0; i < recordsCount; i++) {
+        if (records[i].ply != JOURNAL_RESERVED_PLY) {
+            records[moves++] = records[i];
+        }
+    }
+    recordsCount = moves;
+    if (recordsCount == 0) {
+        free(records);
+        return NULL;
+    }
+    qsort(records, recordsCount, sizeof(journal_record), compareRecords);
+    game** games = (game **) malloc(recordsCount * sizeof(game *));
+    *ids = (uint32_t *) malloc(recordsCount * sizeof(uint32_t));
+    if (!games || !*ids) {
+        exit(NULL_POINTER_ERR);
+    }
+    for (size_t start = 0, end; start < recordsCount; start = end) {
+        for (end = start + 1; end < recordsCount && records[end].game == records[start].game; end++) {
+        }
+        game* g = rebuild(records + start, end - start);
+        if (g) {
+            (*ids)[*count] = records[start].game;
+            games[(*count)++] = g;
+        }
+    }
+    free(records);
+    return games;
+}
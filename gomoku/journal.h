@@ -0,0 +1,72 @@
+#ifndef _JOURNAL_H_
+#define _JOURNAL_H_
+#include "game.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+/** environment variable naming the journal of the games played */
+#define JOURNAL_VARIABLE "GOMOKU_JOURNAL"
+/** initial number of records buffered between two commits */
+#define JOURNAL_BATCH 256
+/** move index of the record that reserves the id of a game, written when the game is watched */
+#define JOURNAL_RESERVED_PLY 0xFFFF
+/** bit of the opening field of a record set once the players swapped colors */
+#define JOURNAL_SWAPPED 0x80
+
+typedef struct {
+    uint32_t game;
+    uint16_t ply;
+    uint8_t x;
+    uint8_t y;
+    uint8_t stone;
+    uint8_t size;
+    uint8_t type;
+    uint8_t state;
+    uint8_t winner;
+    /** opening step the game had reached when the record was written, with JOURNAL_SWAPPED */
+    uint8_t opening;
+    uint16_t check;
+} journal_record;
+
+typedef struct journal journal;
+
+typedef struct {
+    journal* journal;
+    uint32_t id;
+} journal_game;
+
+struct journal {
+    int fd;
+    /** held with the lock on the file by the thread that writes it, as the lock on the file is per process */
+    pthread_mutex_t file_lock;
+    /** length of the file known to hold valid records, read under file_lock */
+    uint64_t scanned;
+    pthread_mutex_t lock;
+    pthread_cond_t committed;
+    journal_record* pending;
+    size_t pending_count;
+    size_t pending_capacity;
+    journal_record* writing;
+    size_t writing_capacity;
+    uint64_t appended;
+    uint64_t durable;
+    bool committing;
+    bool failed;
+    uint64_t commits;
+    uint32_t next_game;
+    journal_game** games;
+    size_t games_count;
+};
+
+/** function to open a journal for appending, which other processes may append to as well */
+journal* journal_open(const char* path);
+/** function to close a journal */
+void journal_close(journal* j);
+/** function to journal the moves of a game from now on */
+uint32_t journal_watch(journal* j, game* g);
+/** function to append the last move of a game and wait until it is durable */
+bool journal_append(journal* j, uint32_t id, const game* g);
+/** function to rebuild the games of a journal */
+game** journal_recover(const char* path, uint32_t** ids, size_t* count);
+#endif
@@ -0,0 +1,243 @@
+/**
+ * @file kernels.c
+ * @author Jason Wang
+ * This program implements the board kernels, the hot loops of the rule checks and the evaluator. They index the grid
+ * directly and compute the number of steps to the edge once per walk, so the walks themselves need no bounds checks.
+*/
+#include "kernels.h"
+#include <string.h>
+
+/** column step of each direction */
+static const int DCOL[4] = {1, 0, 1, 1};
+/** row step of each direction */
+static const int DROW[4] = {0, 1, 1, -1};
+
+/**
+ * Counts the fours through a stone of a line: the empty intersections where one more stone of its color completes
+ * exactly five through the stone, split fours such as XX_XX included. The two ends of a straight four count once.
+ * @param cells the line, changed while counting and restored
+ * @param len the length of the line
+ * @param position the index of the stone within the line
+ * @param stone the color
+ * @return the number of fours
+*/
+static int foursOnLine(unsigned char* cells, int len, int position, unsigned char stone) {
+    int fours = 0;
+    int first = -1;
+    int last = position + 4 < len - 1 ? position + 4 : len - 1;
+    for (int i = position > 4 ? position - 4 : 0; i <= last; i++) {
+        if (cells[i] != EMPTY_INTERSECTION) {
+            continue;
+        }
+        cells[i] = stone;
+        int start = position;
+        int end = position;
+        while (start > 0 && cells[start - 1] == stone) {
+            start--;
+        }
+        while (end < len - 1 && cells[end + 1] == stone) {
+            end++;
+        }
+        cells[i] = EMPTY_INTERSECTION;
+        if (end - start == 4 && i >= start && i <= end) {
+            fours += first >= 0 && i - first == 5 ? 0 : 1;
+            first = first < 0 ? i : first;
+        }
+    }
+    return fours;
+}
+
+/**
+ * Counts the stones of a color next to a grid position in one direction, up to a limit. The number of steps to the
+ * edge is computed once, so the loop itself has no bounds check.
+ * @param grid the grid
+ * @param size the size of the board
+ * @param col the 0-based column
+ * @param row the 0-based row
+ * @param d the direction
+ * @param sign 1 to step forward, -1 to step backward
+ * @param stone the color
+ * @param limit the largest count needed
+ * @param beyond the intersection after the stones, or KERNELS_EDGE past the edge, when the count is below the limit
+ * @return the number of consecutive stones, at most limit
+*/
+static inline int runLength(const unsigned char* grid, int size, int col, int row, int d, int sign,
+                            unsigned char stone, int limit, unsigned char* beyond) {
+    int dcol = sign * DCOL[d];
+    int drow = sign * DROW[d];
+    int steps = limit;
+    if (dcol != 0) {
+        int room = dcol > 0 ? size - 1 - col : col;
+        steps = room < steps ? room : steps;
+    }
+    if (drow != 0) {
+        int room = drow > 0 ? size - 1 - row : row;
+        steps = room < steps ? room : steps;
+    }
+    int step = drow * size + dcol;
+    const unsigned char* cell = grid + row * size + col;
+    int count = 0;
+    *beyond = KERNELS_EDGE;
+    while (count < steps) {
+        cell += step;
+        if (*cell != stone) {
+            *beyond = *cell;
+            break;
+        }
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Checks if a stone at a grid position has at least a number of stones of its color next to it on one line
+ * @param grid the grid
+ * @param size the size of the board
+ * @param col the 0-based column
+ * @param row the 0-based row
+ * @param stone the color
+ * @param neighbours the number of stones, 4 for a five and 5 for an overline
+ * @return true if one of the four lines holds that many
+*/
+static inline bool hasRun(const unsigned char* grid, int size, int col, int row, unsigned char stone, int neighbours) {
+    unsigned char beyond;
+    for (int d = 0; d < 4; d++) {
+        if (runLength(grid, size, col, row, d, 1, stone, neighbours, &beyond)
+            + runLength(grid, size, col, row, d, -1, stone, neighbours, &beyond) >= neighbours) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Checks if the stone at a grid position is part of five or more in a row
+ * @param grid the grid
+ * @param size the size of the board
+ * @param cell the grid index
+ * @param stone the color
+ * @return true if it is
+*/
+bool kernels_is_five(const unsigned char* grid, int size, int cell, unsigned char stone) {
+    int col = cell % size;
+    int row = cell / size;
+    return hasRun(grid, size, col, row, stone, 4);
+}
+
+/**
+ * Checks if the stone at a grid position is part of six or more in a row
+ * @param grid the grid
+ * @param size the size of the board
+ * @param cell the grid index
+ * @param stone the color
+ * @return true if it is
+*/
+bool kernels_is_overline(const unsigned char* grid, int size, int cell, unsigned char stone) {
+    int col = cell % size;
+    int row = cell / size;
+    return hasRun(grid, size, col, row, stone, 5);
+}
+
+/**
+ * Checks if the stone at a grid position is part of exactly five in a row
+ * @param grid the grid
+ * @param size the size of the board
+ * @param cell the grid index
+ * @param stone the color
+ * @return true if it is
+*/
+bool kernels_is_exact_five(const unsigned char* grid, int size, int cell, unsigned char stone) {
+    int col = cell % size;
+    int row = cell / size;
+    unsigned char beyond;
+    for (int d = 0; d < 4; d++) {
+        if (runLength(grid, size, col, row, d, 1, stone, 5, &beyond)
+            + runLength(grid, size, col, row, d, -1, stone, 5, &beyond) == 4) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Checks if the stone at a grid position is part of six or more in a row, or of exactly five in a row that the
+ * opponent has not blocked at both ends. The edge of the board does not block.
+ * @param grid the grid
+ * @param size the size of the board
+ * @param cell the grid index
+ * @param stone the color
+ * @return true if it is
+*/
+bool kernels_is_unblocked_five(const unsigned char* grid, int size, int cell, unsigned char stone) {
+    int col = cell % size;
+    int row = cell / size;
+    unsigned char opponent = stone == BLACK_STONE ? WHITE_STONE : BLACK_STONE;
+    unsigned char after, before;
+    for (int d = 0; d < 4; d++) {
+        int count = runLength(grid, size, col, row, d, 1, stone, 5, &after)
+                    + runLength(grid, size, col, row, d, -1, stone, 5, &before);
+        if (count > 4 || (count == 4 && (after != opponent || before != opponent))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Copies the line through a grid position in one direction, from one edge of the board to the other
+ * @param grid the grid
+ * @param size the size of the board
+ * @param d the direction, 0 row, 1 column, 2 diagonal, 3 anti-diagonal
+ * @param cell the grid index
+ * @param cells the output buffer
+ * @param position the index of the grid position within the buffer
+ * @return the length of the line
+*/
+int kernels_read_line(const unsigned char* grid, int size, int d, int cell, unsigned char* cells, int* position) {
+    int col = cell % size;
+    int row = cell / size;
+    int back;
+    switch (d) {
+        case 0: back = col; break;
+        case 1: back = row; break;
+        case 2: back = col < row ? col : row; break;
+        default: back = col < size - 1 - row ? col : size - 1 - row; break;
+    }
+    *position = back;
+    col -= back * DCOL[d];
+    row -= back * DROW[d];
+    int len;
+    switch (d) {
+        case 0: len = size; break;
+        case 1: len = size; break;
+        case 2: len = size - (col > row ? col : row); break;
+        default: len = (size - col < row + 1) ? size - col : row + 1; break;
+    }
+    int step = DROW[d] * size + DCOL[d];
+    const unsigned char* next = grid + row * size + col;
+    for (int i = 0; i < len; i++) {
+        cells[i] = *next;
+        next += step;
+    }
+    return len;
+}
+
+/**
+ * Checks if the stone at a grid position makes two or more fours, on different lines or on the same one. A four is
+ * a line where one more stone makes exactly five through the position, so fours blocked at both ends do not count.
+ * @param grid the grid
+ * @param size the size of the board
+ * @param cell the grid index
+ * @param stone the color
+ * @return true if it does
+*/
+bool kernels_is_double_four(const unsigned char* grid, int size, int cell, unsigned char stone) {
+    unsigned char cells[KERNELS_MAX_LINE];
+    int fours = 0;
+    for (int d = 0; d < 4 && fours < 2; d++) {
+        int position;
+        int len = kernels_read_line(grid, size, d, cell, cells, &position);
+        fours += foursOnLine(cells, len, position, stone);
+    }
+    return fours >= 2;
+}
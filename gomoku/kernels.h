@@ -0,0 +1,22 @@
+#ifndef _KERNELS_H_
+#define _KERNELS_H_
+#include "board.h"
+#include <stdbool.h>
+/** longest line of a dense board */
+#define KERNELS_MAX_LINE 19
+/** marks the end of a line of stones that runs into the edge of the board */
+#define KERNELS_EDGE 0xFF
+
+/** function to check if a stone is part of five or more in a row */
+bool kernels_is_five(const unsigned char* grid, int size, int cell, unsigned char stone);
+/** function to check if a stone is part of exactly five in a row */
+bool kernels_is_exact_five(const unsigned char* grid, int size, int cell, unsigned char stone);
+/** function to check if a stone is part of an overline or of five the opponent has not blocked at both ends */
+bool kernels_is_unblocked_five(const unsigned char* grid, int size, int cell, unsigned char stone);
+/** function to check if a stone is part of six or more in a row */
+bool kernels_is_overline(const unsigned char* grid, int size, int cell, unsigned char stone);
+/** function to check if a stone makes two or more fours */
+bool kernels_is_double_four(const unsigned char* grid, int size, int cell, unsigned char stone);
+/** function to copy the line through an intersection from edge to edge */
+int kernels_read_line(const unsigned char* grid, int size, int d, int cell, unsigned char* cells, int* position);
+#endif
@@ -0,0 +1,362 @@
+/**
+ * @file mcts.c
+ * @author Jason Wang
+ * This program implements a tree-parallel Monte-Carlo Tree Search engine (PUCT with a heuristic prior).
+ * Workers share one tree whose statistics are updated with atomic operations, use virtual loss to spread out,
+ * and run allocation-free random playouts that only check the lines through each new stone for a win.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include "mcts.h"
+#include "eval.h"
+#include "error-codes.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** largest number of intersections of a board */
+#define MAX_CELLS 361
+/** visits added to a node while a worker is below it */
+#define VIRTUAL_LOSS 3
+/** visits a node needs before its children are created */
+#define EXPAND_VISITS 8
+/** weight of the exploration term of PUCT */
+#define EXPLORATION 1.5f
+/** number of iterations between two clock checks */
+#define CLOCK_INTERVAL 64
+
+typedef struct {
+    mcts* tree;
+    game* game;
+    size_t root_moves;
+    uint64_t rng;
+    double deadline;
+    uint64_t playouts;
+    uint16_t candidates[MAX_CELLS];
+    int16_t position[MAX_CELLS];
+    int candidates_count;
+    pthread_t thread;
+} worker;
+
+/**
+ * Reads the monotonic clock
+ * @return the time in seconds
+*/
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Draws a pseudo-random number with xorshift64*
+ * @param w the worker owning the generator
+ * @return the number
+*/
+static uint32_t nextRandom(worker* w) {
+    w->rng ^= w->rng >> 12;
+    w->rng ^= w->rng << 25;
+    w->rng ^= w->rng >> 27;
+    return (uint32_t) ((w->rng * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+/**
+ * Creates the children of a node, one per empty intersection near a stone, with priors from the threat scores
+ * of the evaluator. If the tree is full, the node stays a leaf.
+ * @param w the worker, whose game is at the position of the node
+ * @param index the index of the node
+*/
+static void expand(worker* w, uint32_t index) {
+    mcts* m = w->tree;
+    game* g = w->game;
+    board* b = g->board;
+    int size = b->size;
+    mcts_node* n = &m->nodes[index];
+    uint16_t cells[MAX_CELLS];
+    int count = (int) board_candidates(b, cells);
+    if (g->moves_count == 0) {
+        cells[count++] = size / 2 * size + size / 2;
+    }
+    // reserve the children only if they fit, so a full tree never moves the counter past its capacity
+    uint32_t first = __atomic_load_n(&m->nodes_used, __ATOMIC_RELAXED);
+    do {
+        if ((uint64_t) first + count > m->nodes_capacity) {
+            __atomic_store_n(&n->expanded, 0, __ATOMIC_RELEASE);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&m->nodes_used, &first, first + count, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    float total = 0;
+    for (int i = 0; i < count; i++) {
+        mcts_node* child = &m->nodes[first + i];
+        child->first_child = 0;
+        child->children_count = 0;
+        child->cell = cells[i];
+        child->prior = 1.0f + eval_threat(g, cells[i]) / 100.0f;
+        child->visits = 0;
+        child->score = 0;
+        child->expanded = 0;
+        total += child->prior;
+    }
+    for (int i = 0; i < count; i++) {
+        m->nodes[first + i].prior /= total;
+    }
+    n->first_child = first;
+    n->children_count = count;
+    __atomic_store_n(&n->expanded, 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * Selects the child of a node with the best PUCT value, counting virtual losses as lost visits
+ * @param m the tree
+ * @param n the node
+ * @return the index of the child
+*/
+static uint32_t selectChild(mcts* m, mcts_node* n) {
+    float parentRoot = sqrtf((float) __atomic_load_n(&n->visits, __ATOMIC_RELAXED) + 1.0f);
+    uint32_t best = n->first_child;
+    float bestValue = -1.0f;
+    for (uint32_t i = n->first_child; i < n->first_child + n->children_count; i++) {
+        int32_t visits = __atomic_load_n(&m->nodes[i].visits, __ATOMIC_RELAXED);
+        int32_t score = __atomic_load_n(&m->nodes[i].score, __ATOMIC_RELAXED);
+        float q = visits > 0 ? score / (2.0f * visits) : 0.5f;
+        float value = q + EXPLORATION * m->nodes[i].prior * parentRoot / (1.0f + visits);
+        if (value > bestValue) {
+            bestValue = value;
+            best = i;
+        }
+    }
+    return best;
+}
+
+/**
+ * Adds an empty intersection to the playout candidates unless it is there already
+ * @param w the worker
+ * @param cell the grid index
+*/
+static void addCandidate(worker* w, int cell) {
+    if (w->game->board->grid[cell] == EMPTY_INTERSECTION && w->position[cell] < 0) {
+        w->position[cell] = w->candidates_count;
+        w->candidates[w->candidates_count++] = cell;
+    }
+}
+
+/**
+ * Adds the empty neighbours of an intersection to the playout candidates. Past an edge the neighbour tables give the
+ * sentinel intersection, which is never empty.
+ * @param w the worker
+ * @param cell the grid index
+*/
+static void addNeighbours(worker* w, int cell) {
+    const board* b = w->game->board;
+    for (int d = 0; d < BOARD_DIRECTIONS; d++) {
+        addCandidate(w, b->neighbours[d][cell]);
+    }
+}
+
+/**
+ * Plays random moves next to the stones on the board until the game ends. The candidate set is kept
+ * incrementally, so a playout touches no memory outside the worker and the game.
+ * @param w the worker
+ * @return the winner, EMPTY_INTERSECTION for a draw
+*/
+static unsigned char playout(worker* w) {
+    game* g = w->game;
+    memset(w->position, -1, sizeof(w->position));
+    w->candidates_count = 0;
+    for (size_t i = 0; i < g->moves_count; i++) {
+        addNeighbours(w, g->moves[i].cell);
+    }
+    while (w->candidates_count > 0) {
+        int pick = nextRandom(w) % w->candidates_count;
+        int cell = w->candidates[pick];
+        w->candidates[pick] = w->candidates[--w->candidates_count];
+        w->position[w->candidates[pick]] = pick;
+        if (game_play(g, cell) != GAME_STATE_PLAYING) {
+            return g->winner;
+        }
+        addNeighbours(w, cell);
+    }
+    return EMPTY_INTERSECTION;
+}
+
+/**
+ * Runs one selection, expansion, playout and backpropagation step from the root
+ * @param w the worker
+*/
+static void iterate(worker* w) {
+    mcts* m = w->tree;
+    game* g = w->game;
+    uint32_t path[MAX_CELLS + 1];
+    int depth = 0;
+    uint32_t index = 0;
+    unsigned char state = GAME_STATE_PLAYING;
+    path[depth++] = index;
+    while (true) {
+        mcts_node* n = &m->nodes[index];
+        if (__atomic_load_n(&n->expanded, __ATOMIC_ACQUIRE) != 2) {
+            int32_t idle = 0;
+            if ((index == 0 || __atomic_load_n(&n->visits, __ATOMIC_RELAXED) >= EXPAND_VISITS) &&
+                __atomic_compare_exchange_n(&n->expanded, &idle, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                expand(w, index);
+            }
+            if (__atomic_load_n(&n->expanded, __ATOMIC_ACQUIRE) != 2) {
+                break;
+            }
+        }
+        index = selectChild(m, n);
+        __atomic_fetch_add(&m->nodes[index].visits, VIRTUAL_LOSS, __ATOMIC_RELAXED);
+        path[depth++] = index;
+        state = game_play(g, m->nodes[index].cell);
+        if (state != GAME_STATE_PLAYING) {
+            break;
+        }
+    }
+    unsigned char winner = state == GAME_STATE_PLAYING ? playout(w) : g->winner;
+    __atomic_fetch_add(&m->nodes[0].visits, 1, __ATOMIC_RELAXED);
+    for (int i = 1; i < depth; i++) {
+        unsigned char mover = g->moves[w->root_moves + i - 1].stone;
+        int32_t score = winner == mover ? 2 : (winner == EMPTY_INTERSECTION ? 1 : 0);
+        __atomic_fetch_add(&m->nodes[path[i]].score, score, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&m->nodes[path[i]].visits, 1 - VIRTUAL_LOSS, __ATOMIC_RELAXED);
+    }
+    while (g->moves_count > w->root_moves) {
+        game_undo(g);
+    }
+    w->playouts++;
+}
+
+/**
+ * Runs iterations until the deadline passes or the search is stopped
+ * @param arg the worker
+ * @return NULL
+*/
+static void* work(void* arg) {
+    worker* w = (worker *) arg;
+    while (!__atomic_load_n(&w->tree->stop, __ATOMIC_RELAXED)) {
+        for (int i = 0; i < CLOCK_INTERVAL; i++) {
+            iterate(w);
+        }
+        if (now() >= w->deadline) {
+            break;
+        }
+    }
+    __atomic_fetch_add(&w->tree->playouts, w->playouts, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+/**
+ * Creates a search tree with room for a fixed number of nodes, allocated once
+ * @param nodes_capacity the number of nodes
+ * @return the tree or NULL if malloc fails
+*/
+mcts* mcts_create(uint32_t nodes_capacity) {
+    mcts* m = (mcts *) calloc(1, sizeof(mcts));
+    if (!m) {
+        return NULL;
+    }
+    m->nodes = (mcts_node *) malloc((size_t) nodes_capacity * sizeof(mcts_node));
+    if (!m->nodes) {
+        free(m);
+        return NULL;
+    }
+    m->nodes_capacity = nodes_capacity;
+    return m;
+}
+
+/**
+ * Deletes a search tree
+ * @param m the tree
+*/
+void mcts_delete(mcts* m) {
+    if (!m) {
+        exit(NULL_POINTER_ERR);
+    }
+    free(m->nodes);
+    free(m);
+}
+
+/**
+ * Asks a running search to stop after the current iterations
+ * @param m the tree
+*/
+void mcts_stop(mcts* m) {
+    __atomic_store_n(&m->stop, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Searches the best move of the side to move with a number of worker threads for a number of seconds.
+ * The tree is rebuilt from the current position of the game, which is left unchanged. The root is expanded before
+ * the workers start, so a tree without room for the children of the root is not searched at all.
+ * @param m the tree
+ * @param g the game
+ * @param threads the number of workers
+ * @param seconds the time budget
+ * @return the most visited move with its win rate and the playout statistics, found is false if the game is over
+ *         or the root cannot be expanded
+*/
+mcts_result mcts_search(mcts* m, game* g, int threads, double seconds) {
+    mcts_result result = {false, 0, 0, 0, 0, 0};
+    if (g->state != GAME_STATE_PLAYING || threads < 1) {
+        return result;
+    }
+    mcts_node root = {0, 0, 0, 1.0f, 0, 0, 1};
+    m->nodes[0] = root;
+    m->nodes_used = 1;
+    m->stop = 0;
+    m->playouts = 0;
+    double start = now();
+    int size = g->board->size;
+    worker* workers = (worker *) calloc(threads, sizeof(worker));
+    if (!workers) {
+        exit(NULL_POINTER_ERR);
+    }
+    for (int i = 0; i < threads; i++) {
+        workers[i].tree = m;
+        workers[i].game = game_clone(g);
+        if (!workers[i].game) {
+            exit(NULL_POINTER_ERR);
+        }
+        move* moves = (move *) realloc(workers[i].game->moves, size * size * sizeof(move));
+        if (!moves) {
+            exit(NULL_POINTER_ERR);
+        }
+        workers[i].game->moves = moves;
+        workers[i].game->moves_capacity = size * size;
+        workers[i].root_moves = g->moves_count;
+        workers[i].rng = 0x9E3779B97F4A7C15ull * (i + 1);
+        workers[i].deadline = start + seconds;
+    }
+    expand(&workers[0], 0);
+    bool expanded = m->nodes[0].expanded == 2;
+    for (int i = 0; i < threads && expanded; i++) {
+        if (pthread_create(&workers[i].thread, NULL, work, &workers[i]) != 0) {
+            exit(NULL_POINTER_ERR);
+        }
+    }
+    for (int i = 0; i < threads; i++) {
+        if (expanded) {
+            pthread_join(workers[i].thread, NULL);
+        }
+        game_delete(workers[i].game);
+    }
+    free(workers);
+    if (!expanded) {
+        return result;
+    }
+    result.seconds = now() - start;
+    result.playouts = m->playouts;
+    result.playouts_per_second = result.playouts / result.seconds;
+    mcts_node* best = NULL;
+    for (uint32_t i = m->nodes[0].first_child; i < m->nodes[0].first_child + m->nodes[0].children_count; i++) {
+        if (!best || m->nodes[i].visits > best->visits) {
+            best = &m->nodes[i];
+        }
+    }
+    if (best) {
+        result.found = true;
+        result.cell = best->cell;
+        result.winrate = best->visits > 0 ? best->score / (2.0 * best->visits) : 0.5;
+    }
+    return result;
+}
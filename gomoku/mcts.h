@@ -0,0 +1,42 @@
+#ifndef _MCTS_H_
+#define _MCTS_H_
+#include "game.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t first_child;
+    uint16_t children_count;
+    uint16_t cell;
+    float prior;
+    int32_t visits;
+    int32_t score;
+    int32_t expanded;
+} mcts_node;
+
+typedef struct {
+    mcts_node* nodes;
+    uint32_t nodes_capacity;
+    uint32_t nodes_used;
+    int32_t stop;
+    uint64_t playouts;
+} mcts;
+
+typedef struct {
+    bool found;
+    uint16_t cell;
+    double winrate;
+    uint64_t playouts;
+    double seconds;
+    double playouts_per_second;
+} mcts_result;
+
+/** function to create a search tree with room for a number of nodes */
+mcts* mcts_create(uint32_t nodes_capacity);
+/** function to delete a search tree */
+void mcts_delete(mcts* m);
+/** function to search the best move of a game with parallel workers */
+mcts_result mcts_search(mcts* m, game* g, int threads, double seconds);
+/** function to ask a running search to stop */
+void mcts_stop(mcts* m);
+#endif
@@ -0,0 +1,234 @@
+/**
+ * @file mkbook.c
+ * @author Jason Wang
+ * This is the main program to build an opening book from archived gomoku/renju games and from self-play.
+ * Every game adds its result, weighted by the strength of its players, to the first moves it played.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "error-codes.h"
+#include "board.h"
+#include "game.h"
+#include "io.h"
+#include "book.h"
+#include "pool.h"
+#include "rules.h"
+#include "search.h"
+#include "sym.h"
+
+#define DEFAULT_PLIES 12
+#define DEFAULT_SIZE 15
+#define DEFAULT_DEPTH 4
+#define DEFAULT_WEIGHT 1.0
+#define TABLE_BYTES (16u << 20)
+/** number of random moves opening a self-play game */
+#define RANDOM_PLIES 3
+/** number of probes timed after the book is written */
+#define TIMED_PROBES 1000000
+
+typedef struct {
+    book_entry* entries;
+    size_t count;
+    size_t capacity;
+    int plies;
+    pthread_mutex_t lock;
+} collection;
+
+typedef struct {
+    collection* c;
+    search** searches;
+    int size;
+    unsigned char type;
+    int depth;
+    float weight;
+    size_t games;
+    size_t index;
+} selfplay;
+
+/**
+ * Prints the usage of the program and exits
+*/
+static void usage(void) {
+    printf("usage: ./mkbook -o <book> [-p <plies>] [-s <self-play-games>] [-d <depth>] [-w <self-play-weight>] [-b <15|17|19>] [-R]\n"
+           "                [-v <freestyle|renju|standard|caro|swap2>] [-j <threads>] [<directory>[:<weight>]]...\n"
+           "       -v plays the self-play games with the rules of a variant and -R is short for -v renju\n");
+    exit(ARGUMENT_ERR);
+}
+
+/**
+ * Adds the first moves of a finished game to the collection, each scored for the player who made it
+ * @param c the collection
+ * @param g the finished game
+ * @param weight the weight of the game
+*/
+static void addGame(collection* c, game* g, float weight) {
+    if (g->state != GAME_STATE_FINISHED && g->state != GAME_STATE_FORBIDDEN && g->state != GAME_STATE_DRAWN) {
+        return;
+    }
+    game* replay = game_create(g->board->size, g->type);
+    pthread_mutex_lock(&c->lock);
+    for (size_t i = 0; i < g->moves_count && i < (size_t) c->plies; i++) {
+        move m = g->moves[i];
+        int transform;
+        int size = g->board->size;
+        book_entry e;
+        memset(&e, 0, sizeof(e));
+        e.key = search_canonical_key(replay, &transform);
+        e.cell = sym_permutation(size, transform)[m.cell];
+        if (g->winner == EMPTY_INTERSECTION) {
+            e.draws = weight;
+        } else if (g->winner == m.stone) {
+            e.wins = weight;
+        } else {
+            e.losses = weight;
+        }
+        if (c->count == c->capacity) {
+            c->capacity *= 2;
+            c->entries = (book_entry *) realloc(c->entries, c->capacity * sizeof(book_entry));
+            if (!c->entries) {
+                exit(NULL_POINTER_ERR);
+            }
+        }
+        c->entries[c->count++] = e;
+        game_play(replay, m.cell);
+    }
+    pthread_mutex_unlock(&c->lock);
+    game_delete(replay);
+}
+
+/**
+ * Plays one self-play game: a few random moves near the center, then the engine's moves for both sides
+ * @param arg the self-play batch
+ * @param worker the index of the worker
+*/
+static void playGame(void* arg, int worker) {
+    selfplay* sp = (selfplay *) arg;
+    pthread_mutex_lock(&sp->c->lock);
+    unsigned int seed = (unsigned int) sp->index++;
+    pthread_mutex_unlock(&sp->c->lock);
+    search* s = sp->searches[worker];
+    game* g = game_create(sp->size, sp->type);
+    int center = sp->size / 2;
+    while (g->state == GAME_STATE_PLAYING) {
+        if (g->moves_count < RANDOM_PLIES) {
+            int col = center + rand_r(&seed) % 5 - 2;
+            int row = center + rand_r(&seed) % 5 - 2;
+            if (board_get(g->board, BOARD_CELL(g->board, col, row)) == EMPTY_INTERSECTION) {
+                game_play(g, BOARD_CELL(g->board, col, row));
+            }
+            continue;
+        }
+        search_result r = search_run(s, g, sp->depth, SEARCH_FOREVER);
+        if (r.depth == 0) {
+            break;
+        }
+        game_play(g, r.cell);
+    }
+    addGame(sp->c, g, sp->weight);
+    game_delete(g);
+}
+
+/**
+ * This is the main function of the book builder
+ * @param argc the number of command line args
+ * @param argv an array of command-line argument strings
+*/
+int main(int argc, char *argv[]) {
+    int opt;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    char* output = NULL;
+    collection c = {NULL, 0, 1024, DEFAULT_PLIES, PTHREAD_MUTEX_INITIALIZER};
+    selfplay sp = {&c, NULL, DEFAULT_SIZE, GAME_FREESTYLE, DEFAULT_DEPTH, DEFAULT_WEIGHT, 0, 0};
+    while ((opt = getopt(argc, argv, "o:p:s:d:w:b:Rv:j:")) != -1) {
+        switch (opt) {
+            case 'o': output = optarg; break;
+            case 'p': c.plies = atoi(optarg); break;
+            case 's': sp.games = (size_t) atol(optarg); break;
+            case 'd': sp.depth = atoi(optarg); break;
+            case 'w': sp.weight = atof(optarg); break;
+            case 'b': sp.size = atoi(optarg); break;
+            case 'R': sp.type = GAME_RENJU; break;
+            case 'v': sp.type = rules_parse(optarg); break;
+            case 'j': threads = atol(optarg); break;
+            default: usage();
+        }
+    }
+    if (!output || c.plies < 1 || sp.depth < 1 || sp.weight <= 0 || threads < 1 || sp.type == GAME_VARIANTS
+        || (sp.size != 15 && sp.size != 17 && sp.size != 19)) {
+        usage();
+    }
+    c.entries = (book_entry *) malloc(c.capacity * sizeof(book_entry));
+    if (!c.entries) {
+        exit(NULL_POINTER_ERR);
+    }
+    size_t archived = 0;
+    for (int i = optind; i < argc; i++) {
+        float weight = DEFAULT_WEIGHT;
+        char* separator = strrchr(argv[i], ':');
+        if (separator) {
+            *separator = '\0';
+            weight = atof(separator + 1);
+            if (weight <= 0) {
+                usage();
+            }
+        }
+        size_t count = 0;
+        char** paths = game_list_dir(argv[i], &count);
+        for (size_t j = 0; j < count; j++) {
+            int size = game_peek_size(paths[j]);
+            if (size != 15 && size != 17 && size != 19) {
+                printf("%s: large board, skipped\n", paths[j]);
+            } else {
+                game* g = game_import(paths[j]);
+                addGame(&c, g, weight);
+                game_delete(g);
+                archived++;
+            }
+            free(paths[j]);
+        }
+        free(paths);
+    }
+    if (sp.games > 0) {
+        sp.searches = (search **) malloc(threads * sizeof(search *));
+        pool* p = pool_create(threads);
+        if (!sp.searches || !p) {
+            exit(NULL_POINTER_ERR);
+        }
+        for (long i = 0; i < threads; i++) {
+            sp.searches[i] = search_create(TABLE_BYTES);
+            if (!sp.searches[i]) {
+                exit(NULL_POINTER_ERR);
+            }
+        }
+        for (size_t i = 0; i < sp.games; i++) {
+            pool_submit(p, i, playGame, &sp);
+        }
+        pool_delete(p);
+        for (long i = 0; i < threads; i++) {
+            search_delete(sp.searches[i]);
+        }
+        free(sp.searches);
+    }
+    size_t positions = book_write(output, c.entries, c.count);
+    printf("%zu archived games, %zu self-play games, %zu moves, %zu book entries\n", archived, sp.games, c.count, positions);
+    book* b = book_open(output);
+    if (!b) {
+        exit(FILE_INPUT_ERR);
+    }
+    if (positions > 0) {
+        double start = search_clock();
+        size_t found = 0;
+        for (size_t i = 0; i < TIMED_PROBES; i++) {
+            found += book_find(b, b->entries[(i * 0x9E3779B1u) % positions].key) < positions;
+        }
+        double seconds = search_clock() - start;
+        printf("%zu of %d probes found, %.1f ns per probe\n", found, TIMED_PROBES, seconds * 1e9 / TIMED_PROBES);
+    }
+    book_close(b);
+    free(c.entries);
+    return 0;
+}
@@ -0,0 +1,317 @@
+/**
+ * @file pcache.c
+ * @author Jason Wang
+ * This program implements the persistent analysis cache: a memory-mapped hash table from position keys to search
+ * results, shared by every process that opens the file. Slots hold the result and the key xor the result, so readers
+ * detect torn slots and never lock. One process at a time writes: it appends each result to a log before updating the
+ * table, replays the log when it opens the cache, and compacts by syncing the table and emptying the log.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include "pcache.h"
+#include "error-codes.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAGIC "GMKCACHE"
+/** number of slots probed for a key */
+#define PROBE_LIMIT 16
+/** extension of the append log */
+#define LOG_EXTENSION ".log"
+
+typedef struct {
+    uint64_t key;
+    uint64_t data;
+} log_record;
+
+/**
+ * Packs an entry into the data word of a slot
+ * @param e the entry
+ * @return the data word
+*/
+static uint64_t pack(pcache_entry e) {
+    return (uint64_t) (uint32_t) e.score | (uint64_t) e.cell << 32 | (uint64_t) e.depth << 48 | (uint64_t) e.bound << 56;
+}
+
+/**
+ * Unpacks the data word of a slot
+ * @param data the data word
+ * @return the entry
+*/
+static pcache_entry unpack(uint64_t data) {
+    pcache_entry e = {(int32_t) (uint32_t) data, (uint16_t) (data >> 32), (uint8_t) (data >> 48), (uint8_t) (data >> 56)};
+    return e;
+}
+
+/**
+ * Computes the size of a cache file
+ * @param capacity the number of slots
+ * @return the size in bytes
+*/
+static size_t fileBytes(uint64_t capacity) {
+    return sizeof(pcache_header) + capacity * sizeof(pcache_slot);
+}
+
+/**
+ * Maps a table file, creating its header first when the file is empty and writable
+ * @param c the cache
+ * @param fd the file descriptor of the table
+ * @return true if the file holds a valid table
+*/
+static bool mapTable(pcache* c, int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return false;
+    }
+    size_t bytes = (size_t) st.st_size;
+    bool created = false;
+    if (bytes == 0) {
+        if (!c->writable) {
+            return false;
+        }
+        bytes = fileBytes(PCACHE_DEFAULT_SLOTS);
+        if (ftruncate(fd, bytes) != 0) {
+            return false;
+        }
+        created = true;
+    }
+    void* map = mmap(NULL, bytes, c->writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    pcache_header* header = (pcache_header *) map;
+    if (created) {
+        memcpy(header->magic, MAGIC, sizeof(header->magic));
+        header->capacity = PCACHE_DEFAULT_SLOTS;
+    }
+    uint64_t capacity = header->capacity;
+    if (memcmp(header->magic, MAGIC, sizeof(header->magic)) != 0 || capacity == 0 || (capacity & (capacity - 1)) != 0
+        || fileBytes(capacity) != bytes) {
+        munmap(map, bytes);
+        return false;
+    }
+    c->header = header;
+    c->slots = (pcache_slot *) (header + 1);
+    c->mapped_bytes = bytes;
+    return true;
+}
+
+/**
+ * Stores a result in a table: in the slot of the same key if the result is as deep, otherwise in the first empty
+ * or the shallowest slot of the probe sequence
+ * @param header the header of the table
+ * @param slots the slots of the table
+ * @param key the key
+ * @param data the packed result
+*/
+static void insert(pcache_header* header, pcache_slot* slots, uint64_t key, uint64_t data) {
+    uint64_t mask = header->capacity - 1;
+    pcache_slot* victim = NULL;
+    int victimDepth = 256;
+    for (uint64_t i = 0; i < PROBE_LIMIT; i++) {
+        pcache_slot* slot = &slots[(key + i) & mask];
+        uint64_t check = __atomic_load_n(&slot->check, __ATOMIC_RELAXED);
+        uint64_t old = __atomic_load_n(&slot->data, __ATOMIC_RELAXED);
+        if (check == 0 && old == 0) {
+            victim = slot;
+            header->used++;
+            break;
+        }
+        if ((check ^ old) == key) {
+            if (unpack(old).depth > unpack(data).depth) {
+                return;
+            }
+            victim = slot;
+            break;
+        }
+        if (unpack(old).depth < victimDepth) {
+            victim = slot;
+            victimDepth = unpack(old).depth;
+        }
+    }
+    __atomic_store_n(&victim->data, data, __ATOMIC_RELAXED);
+    __atomic_store_n(&victim->check, key ^ data, __ATOMIC_RELEASE);
+}
+
+/**
+ * Moves the table into a new file of twice the capacity, which atomically replaces the old file
+ * @param c the cache, opened as writer
+*/
+static void grow(pcache* c) {
+    uint64_t capacity = c->header->capacity * 2;
+    char* tmpPath = (char *) malloc(strlen(c->path) + 5);
+    sprintf(tmpPath, "%s.tmp", c->path);
+    int fd = open(tmpPath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, fileBytes(capacity)) != 0) {
+        exit(FILE_OUTPUT_ERR);
+    }
+    void* map = mmap(NULL, fileBytes(capacity), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        exit(FILE_OUTPUT_ERR);
+    }
+    pcache_header* header = (pcache_header *) map;
+    memcpy(header->magic, MAGIC, sizeof(header->magic));
+    header->capacity = capacity;
+    for (uint64_t i = 0; i < c->header->capacity; i++) {
+        pcache_slot slot = c->slots[i];
+        if (slot.check != 0 || slot.data != 0) {
+            insert(header, (pcache_slot *) (header + 1), slot.check ^ slot.data, slot.data);
+        }
+    }
+    msync(map, fileBytes(capacity), MS_SYNC);
+    if (rename(tmpPath, c->path) != 0) {
+        exit(FILE_OUTPUT_ERR);
+    }
+    munmap(c->header, c->mapped_bytes);
+    close(c->table_fd);
+    c->table_fd = fd;
+    c->header = header;
+    c->slots = (pcache_slot *) (header + 1);
+    c->mapped_bytes = fileBytes(capacity);
+    free(tmpPath);
+}
+
+/**
+ * Syncs the table to disk and empties the log, the caller holding the write lock
+ * @param c the cache, opened as writer
+*/
+static void compact(pcache* c) {
+    msync(c->header, c->mapped_bytes, MS_SYNC);
+    if (ftruncate(c->log_fd, 0) != 0) {
+        exit(FILE_OUTPUT_ERR);
+    }
+    c->log_records = 0;
+}
+
+/**
+ * Opens a cache file. The first process to open it becomes its only writer, and also replays the log left by a writer
+ * that did not close the cache; other processes open it for reading.
+ * @param path the path of the table file, the log is the same path with ".log" appended
+ * @return the cache, or NULL if the file cannot be opened or is not a cache
+*/
+pcache* pcache_open(const char* path) {
+    pcache* c = (pcache *) calloc(1, sizeof(pcache));
+    if (!c) {
+        return NULL;
+    }
+    c->path = (char *) malloc(strlen(path) + strlen(LOG_EXTENSION) + 1);
+    sprintf(c->path, "%s%s", path, LOG_EXTENSION);
+    c->log_fd = open(c->path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    struct flock lock = {0};
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    c->writable = c->log_fd >= 0 && fcntl(c->log_fd, F_SETLK, &lock) == 0;
+    if (!c->writable && c->log_fd >= 0) {
+        close(c->log_fd);
+        c->log_fd = -1;
+    }
+    strcpy(c->path, path);
+    c->table_fd = open(path, c->writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (c->table_fd < 0 || !mapTable(c, c->table_fd)) {
+        if (c->table_fd >= 0) {
+            close(c->table_fd);
+        }
+        if (c->log_fd >= 0) {
+            close(c->log_fd);
+        }
+        free(c->path);
+        free(c);
+        return NULL;
+    }
+    pthread_mutex_init(&c->write_lock, NULL);
+    if (c->writable) {
+        log_record r;
+        off_t offset = 0;
+        while (pread(c->log_fd, &r, sizeof(r), offset) == sizeof(r)) {
+            insert(c->header, c->slots, r.key, r.data);
+            offset += sizeof(r);
+        }
+        if (c->header->used > c->header->capacity / 4 * 3) {
+            grow(c);
+        }
+        compact(c);
+    }
+    return c;
+}
+
+/**
+ * Compacts and closes a cache
+ * @param c the cache
+*/
+void pcache_close(pcache* c) {
+    if (!c) {
+        exit(NULL_POINTER_ERR);
+    }
+    if (c->writable) {
+        compact(c);
+        close(c->log_fd);
+    }
+    munmap(c->header, c->mapped_bytes);
+    close(c->table_fd);
+    pthread_mutex_destroy(&c->write_lock);
+    free(c->path);
+    free(c);
+}
+
+/**
+ * Looks a position up without locking, safe against a concurrent writer
+ * @param c the cache
+ * @param key the key of the position
+ * @param e the entry found
+ * @return true if the position is in the cache
+*/
+bool pcache_get(pcache* c, uint64_t key, pcache_entry* e) {
+    uint64_t mask = c->header->capacity - 1;
+    for (uint64_t i = 0; i < PROBE_LIMIT; i++) {
+        pcache_slot* slot = &c->slots[(key + i) & mask];
+        uint64_t check = __atomic_load_n(&slot->check, __ATOMIC_ACQUIRE);
+        uint64_t data = __atomic_load_n(&slot->data, __ATOMIC_RELAXED);
+        if (check == 0 && data == 0) {
+            return false;
+        }
+        if ((check ^ data) == key) {
+            *e = unpack(data);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Stores the result of a position: appends it to the log, then updates the table. Does nothing for a reader.
+ * @param c the cache
+ * @param key the key of the position
+ * @param e the result
+*/
+void pcache_put(pcache* c, uint64_t key, pcache_entry e) {
+    if (!c->writable) {
+        return;
+    }
+    log_record r = {key, pack(e)};
+    pthread_mutex_lock(&c->write_lock);
+    if (write(c->log_fd, &r, sizeof(r)) != sizeof(r)) {
+        exit(FILE_OUTPUT_ERR);
+    }
+    insert(c->header, c->slots, r.key, r.data);
+    if (++c->log_records >= PCACHE_LOG_LIMIT) {
+        compact(c);
+    }
+    pthread_mutex_unlock(&c->write_lock);
+}
+
+/**
+ * Folds the append log into the table: syncs the table to disk and empties the log. Does nothing for a reader.
+ * @param c the cache
+*/
+void pcache_compact(pcache* c) {
+    if (!c->writable) {
+        return;
+    }
+    pthread_mutex_lock(&c->write_lock);
+    compact(c);
+    pthread_mutex_unlock(&c->write_lock);
+}
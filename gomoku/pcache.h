@@ -0,0 +1,56 @@
+#ifndef _PCACHE_H_
+#define _PCACHE_H_
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+/** initial number of slots of a new cache file */
+#define PCACHE_DEFAULT_SLOTS (1u << 20)
+/** number of log records that triggers a compaction */
+#define PCACHE_LOG_LIMIT 65536
+#define PCACHE_BOUND_EXACT 1
+#define PCACHE_BOUND_LOWER 2
+#define PCACHE_BOUND_UPPER 3
+
+typedef struct {
+    int32_t score;
+    uint16_t cell;
+    uint8_t depth;
+    uint8_t bound;
+} pcache_entry;
+
+typedef struct {
+    uint64_t check;
+    uint64_t data;
+} pcache_slot;
+
+typedef struct {
+    char magic[8];
+    uint64_t capacity;
+    uint64_t used;
+    uint64_t reserved;
+} pcache_header;
+
+typedef struct {
+    char* path;
+    int table_fd;
+    int log_fd;
+    bool writable;
+    pcache_header* header;
+    pcache_slot* slots;
+    size_t mapped_bytes;
+    size_t log_records;
+    pthread_mutex_t write_lock;
+} pcache;
+
+/** function to open a cache file, as its single writer when no other process writes it */
+pcache* pcache_open(const char* path);
+/** function to compact and close a cache */
+void pcache_close(pcache* c);
+/** function to look a position up without locking */
+bool pcache_get(pcache* c, uint64_t key, pcache_entry* e);
+/** function to store the result of a position */
+void pcache_put(pcache* c, uint64_t key, pcache_entry e);
+/** function to fold the append log into the table */
+void pcache_compact(pcache* c);
+#endif
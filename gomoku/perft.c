@@ -0,0 +1,397 @@
+/**
+ * @file perft.c
+ * @author Jason Wang
+ * This is the main program to enumerate the move sequences of a position, to check and time the rules. Every sequence
+ * of up to a given number of moves is played with game_play and taken back with game_undo, and the positions reached
+ * at each ply are counted as wins, forbidden moves, draws or ongoing games. A sequence stops at the move that ends the
+ * game. The subtrees of the first moves are spread over a pool of worker threads, and a shared table can count a
+ * subtree reached by several sequences once. The counts do not depend on the number of threads or on the table, so
+ * they check changes to the rules, and the number of moves played per second measures play, check and undo.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "error-codes.h"
+#include "board.h"
+#include "game.h"
+#include "io.h"
+#include "pool.h"
+#include "rules.h"
+#include "search.h"
+
+#define DEFAULT_DEPTH 2
+#define DEFAULT_SIZE 15
+/** deepest enumeration */
+#define PERFT_MAX_DEPTH 8
+/** kinds of positions, in the order of the columns of the report */
+#define PERFT_ONGOING 0
+#define PERFT_WIN 1
+#define PERFT_FORBIDDEN 2
+#define PERFT_DRAW 3
+#define PERFT_KINDS 4
+/** number of locks shared by the entries of the table */
+#define TABLE_LOCKS 64
+/** multiplier folding the number of remaining moves into the key of a position */
+#define DEPTH_SALT 0x9E3779B97F4A7C15ULL
+#define MAX_CELLS 361
+
+/** the counts of a subtree, one row per ply below its root */
+typedef uint64_t perft_counts[PERFT_KINDS];
+
+typedef struct {
+    uint64_t key;
+    perft_counts counts[PERFT_MAX_DEPTH - 1];
+} perft_entry;
+
+typedef struct {
+    perft_entry* entries;
+    size_t entries_count;
+    pthread_mutex_t locks[TABLE_LOCKS];
+} perft_table;
+
+typedef struct {
+    game* root;
+    perft_table* table;
+    int depth;
+    bool candidates;
+    uint16_t cell;
+    perft_counts counts[PERFT_MAX_DEPTH];
+    uint64_t nodes;
+    uint64_t hits;
+} subtree;
+
+/**
+ * Prints the usage of the program and exits
+*/
+static void usage(void) {
+    printf("usage: ./perft [-j <threads>] [-d <depth>] [-m <table-MB>] [-c] [-p] [-b <15|17|19>] [-R] [<match.gmk>]\n"
+           "               [-v <freestyle|renju|standard|caro|swap2>]\n"
+           "       -d sets the number of moves of the sequences, from 1 to %d (%d by default)\n"
+           "       -m counts the transpositions once through a table of that size\n"
+           "       -c plays only the intersections near the stones instead of every empty one\n"
+           "       -p prints the sequences below each first move\n"
+           "       -v enumerates a rule variant from the empty board and -R is short for -v renju,\n"
+           "       -b, -R and -v conflict with a match file\n", PERFT_MAX_DEPTH, DEFAULT_DEPTH);
+    exit(ARGUMENT_ERR);
+}
+
+/**
+ * Creates a table of subtree counts within a memory budget, with a power of two of entries
+ * @param bytes the budget
+ * @return the table or NULL if malloc fails
+*/
+static perft_table* tableCreate(size_t bytes) {
+    perft_table* t = (perft_table *) malloc(sizeof(perft_table));
+    if (!t) {
+        return NULL;
+    }
+    t->entries_count = 1;
+    while (t->entries_count * 2 * sizeof(perft_entry) <= bytes) {
+        t->entries_count *= 2;
+    }
+    t->entries = (perft_entry *) calloc(t->entries_count, sizeof(perft_entry));
+    if (!t->entries) {
+        free(t);
+        return NULL;
+    }
+    for (int i = 0; i < TABLE_LOCKS; i++) {
+        pthread_mutex_init(&t->locks[i], NULL);
+    }
+    return t;
+}
+
+/**
+ * Deletes a table of subtree counts
+ * @param t the table
+*/
+static void tableDelete(perft_table* t) {
+    for (int i = 0; i < TABLE_LOCKS; i++) {
+        pthread_mutex_destroy(&t->locks[i]);
+    }
+    free(t->entries);
+    free(t);
+}
+
+/**
+ * Looks up the counts of a subtree
+ * @param t the table
+ * @param key the key of the position and of the number of remaining moves
+ * @param depth the number of remaining moves
+ * @param counts the output counts
+ * @return true if the table holds the subtree
+*/
+static bool tableGet(perft_table* t, uint64_t key, int depth, perft_counts* counts) {
+    size_t index = key & (t->entries_count - 1);
+    pthread_mutex_t* lock = &t->locks[index % TABLE_LOCKS];
+    pthread_mutex_lock(lock);
+    bool found = t->entries[index].key == key;
+    if (found) {
+        memcpy(counts, t->entries[index].counts, depth * sizeof(perft_counts));
+    }
+    pthread_mutex_unlock(lock);
+    return found;
+}
+
+/**
+ * Stores the counts of a subtree, replacing the entry of its slot
+ * @param t the table
+ * @param key the key of the position and of the number of remaining moves
+ * @param depth the number of remaining moves
+ * @param counts the counts
+*/
+static void tablePut(perft_table* t, uint64_t key, int depth, perft_counts* counts) {
+    size_t index = key & (t->entries_count - 1);
+    pthread_mutex_t* lock = &t->locks[index % TABLE_LOCKS];
+    pthread_mutex_lock(lock);
+    t->entries[index].key = key;
+    memcpy(t->entries[index].counts, counts, depth * sizeof(perft_counts));
+    pthread_mutex_unlock(lock);
+}
+
+/**
+ * Lists the moves of a position: every empty intersection, or only those near the stones
+ * @param g the game
+ * @param candidates true to list only the intersections near the stones
+ * @param cells the output array
+ * @return the number of moves
+*/
+static size_t listMoves(game* g, bool candidates, uint16_t* cells) {
+    board* b = g->board;
+    int size = b->size;
+    if (candidates) {
+        size_t count = board_candidates(b, cells);
+        if (count == 0) {
+            cells[count++] = size / 2 * size + size / 2;
+        }
+        return count;
+    }
+    size_t count = 0;
+    for (int cell = 0; cell < size * size; cell++) {
+        if (b->grid[cell] == EMPTY_INTERSECTION) {
+            cells[count++] = cell;
+        }
+    }
+    return count;
+}
+
+/**
+ * Gets the kind of the position after a move
+ * @param g the game
+ * @param state the state returned by game_play
+ * @return the kind
+*/
+static int kindOf(game* g, unsigned char state) {
+    if (state == GAME_STATE_FORBIDDEN) {
+        return PERFT_FORBIDDEN;
+    }
+    if (state == GAME_STATE_DRAWN) {
+        return PERFT_DRAW;
+    }
+    if (state == GAME_STATE_FINISHED) {
+        return g->winner == EMPTY_INTERSECTION ? PERFT_DRAW : PERFT_WIN;
+    }
+    return PERFT_ONGOING;
+}
+
+static void countSubtree(subtree* t, game* g, perft_counts* counts, int depth);
+
+/**
+ * Plays every move of a position and counts the positions it leads to, ply by ply
+ * @param t the subtree being counted, which holds the options and the statistics
+ * @param g the game at the position
+ * @param counts the counts, whose first row is the ply of the moves
+ * @param depth the number of moves left to play, at least 1
+*/
+static void countMoves(subtree* t, game* g, perft_counts* counts, int depth) {
+    uint16_t cells[MAX_CELLS];
+    size_t count = listMoves(g, t->candidates, cells);
+    for (size_t i = 0; i < count; i++) {
+        unsigned char state = game_play(g, cells[i]);
+        t->nodes++;
+        counts[0][kindOf(g, state)]++;
+        if (state == GAME_STATE_PLAYING && depth > 1) {
+            countSubtree(t, g, counts + 1, depth - 1);
+        }
+        game_undo(g);
+    }
+}
+
+/**
+ * Counts the positions below an ongoing position, through the table when there is one. The positions of a subtree
+ * depend only on its root position and its depth, whatever the order of the moves that reached it.
+ * @param t the subtree being counted, which holds the options and the statistics
+ * @param g the game at the position
+ * @param counts the counts, whose first row is the ply of the next moves
+ * @param depth the number of moves left to play, at least 1
+*/
+static void countSubtree(subtree* t, game* g, perft_counts* counts, int depth) {
+    // the moves right above the horizon cost less than a lookup
+    if (!t->table || depth < 2) {
+        countMoves(t, g, counts, depth);
+        return;
+    }
+    uint64_t key = g->board->hash ^ (uint64_t) depth * DEPTH_SALT;
+    perft_counts found[PERFT_MAX_DEPTH - 1];
+    if (tableGet(t->table, key, depth, found)) {
+        t->hits++;
+    } else {
+        memset(found, 0, depth * sizeof(perft_counts));
+        countMoves(t, g, found, depth);
+        tablePut(t->table, key, depth, found);
+    }
+    for (int ply = 0; ply < depth; ply++) {
+        for (int kind = 0; kind < PERFT_KINDS; kind++) {
+            counts[ply][kind] += found[ply][kind];
+        }
+    }
+}
+
+/**
+ * Counts the subtree of a first move on a copy of the root game
+ * @param arg the subtree
+ * @param worker the index of the worker
+*/
+static void countFirstMove(void* arg, int worker) {
+    (void) worker;
+    subtree* t = (subtree *) arg;
+    game* g = game_clone(t->root);
+    if (!g) {
+        exit(NULL_POINTER_ERR);
+    }
+    unsigned char state = game_play(g, t->cell);
+    t->nodes++;
+    t->counts[0][kindOf(g, state)]++;
+    if (state == GAME_STATE_PLAYING && t->depth > 1) {
+        countSubtree(t, g, t->counts + 1, t->depth - 1);
+    }
+    game_delete(g);
+}
+
+/**
+ * Counts the sequences that end at a subtree: those that end the game before the horizon and those that reach it
+ * @param counts the counts of the subtree
+ * @param depth the number of plies of the counts
+ * @return the number of sequences
+*/
+static uint64_t sequences(perft_counts* counts, int depth) {
+    uint64_t total = counts[depth - 1][PERFT_ONGOING];
+    for (int ply = 0; ply < depth; ply++) {
+        total += counts[ply][PERFT_WIN] + counts[ply][PERFT_FORBIDDEN] + counts[ply][PERFT_DRAW];
+    }
+    return total;
+}
+
+/**
+ * This is the main function of the enumeration
+ * @param argc the number of command line args
+ * @param argv an array of command-line argument strings
+*/
+int main(int argc, char *argv[]) {
+    int opt;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int depth = DEFAULT_DEPTH;
+    long tableMB = 0;
+    bool candidates = false;
+    bool divide = false;
+    int size = DEFAULT_SIZE;
+    unsigned char type = GAME_FREESTYLE;
+    bool variant = false;
+    while ((opt = getopt(argc, argv, "j:d:m:cpb:Rv:")) != -1) {
+        switch (opt) {
+            case 'j': threads = atol(optarg); break;
+            case 'd': depth = atoi(optarg); break;
+            case 'm': tableMB = atol(optarg); break;
+            case 'c': candidates = true; break;
+            case 'p': divide = true; break;
+            case 'b': size = atoi(optarg); variant = true; break;
+            case 'R': type = GAME_RENJU; variant = true; break;
+            case 'v': type = rules_parse(optarg); variant = true; break;
+            default: usage();
+        }
+    }
+    if (optind < argc - 1 || threads < 1 || depth < 1 || depth > PERFT_MAX_DEPTH || tableMB < 0
+        || type == GAME_VARIANTS || (variant && optind == argc - 1)) {
+        usage();
+    }
+    game* root = NULL;
+    if (optind == argc - 1) {
+        root = game_import(argv[optind]);
+        if (root->state == GAME_STATE_STOPPED) {
+            root->state = GAME_STATE_PLAYING;
+        }
+    } else {
+        root = game_create(size, type);
+    }
+    if (root->state != GAME_STATE_PLAYING) {
+        printf("The game is over.\n");
+        game_delete(root);
+        return 0;
+    }
+    perft_table* table = NULL;
+    if (tableMB > 0) {
+        table = tableCreate((size_t) tableMB << 20);
+        if (!table) {
+            exit(NULL_POINTER_ERR);
+        }
+    }
+    uint16_t cells[MAX_CELLS];
+    size_t count = listMoves(root, candidates, cells);
+    subtree* subtrees = (subtree *) calloc(count + 1, sizeof(subtree));
+    pool* p = pool_create(threads);
+    if (!subtrees || !p) {
+        exit(NULL_POINTER_ERR);
+    }
+    double start = search_clock();
+    for (size_t i = 0; i < count; i++) {
+        subtrees[i].root = root;
+        subtrees[i].table = table;
+        subtrees[i].depth = depth;
+        subtrees[i].candidates = candidates;
+        subtrees[i].cell = cells[i];
+        pool_submit(p, i, countFirstMove, &subtrees[i]);
+    }
+    pool_wait(p);
+    double seconds = search_clock() - start;
+    perft_counts totals[PERFT_MAX_DEPTH] = {{0}};
+    uint64_t nodes = 0;
+    uint64_t hits = 0;
+    for (size_t i = 0; i < count; i++) {
+        for (int ply = 0; ply < depth; ply++) {
+            for (int kind = 0; kind < PERFT_KINDS; kind++) {
+                totals[ply][kind] += subtrees[i].counts[ply][kind];
+            }
+        }
+        nodes += subtrees[i].nodes;
+        hits += subtrees[i].hits;
+        if (divide) {
+            char formalCoord[BOARD_COORD_LEN];
+            board_formal_coord(root->board, cells[i], formalCoord);
+            printf("%s %llu\n", formalCoord, (unsigned long long) sequences(subtrees[i].counts, depth));
+        }
+    }
+    if (divide) {
+        printf("\n");
+    }
+    printf("%-4s %14s %14s %14s %14s %14s\n", "ply", "positions", "wins", "forbidden", "draws", "ongoing");
+    for (int ply = 0; ply < depth; ply++) {
+        uint64_t* c = totals[ply];
+        printf("%-4d %14llu %14llu %14llu %14llu %14llu\n", ply + 1,
+               (unsigned long long) (c[PERFT_ONGOING] + c[PERFT_WIN] + c[PERFT_FORBIDDEN] + c[PERFT_DRAW]),
+               (unsigned long long) c[PERFT_WIN], (unsigned long long) c[PERFT_FORBIDDEN],
+               (unsigned long long) c[PERFT_DRAW], (unsigned long long) c[PERFT_ONGOING]);
+    }
+    printf("%llu sequences, %llu moves played in %.2f s with %ld threads, %.0f moves/s\n",
+           (unsigned long long) sequences(totals, depth), (unsigned long long) nodes, seconds, threads,
+           seconds > 0 ? nodes / seconds : 0.0);
+    if (table) {
+        printf("table: %llu subtrees counted once, %zu entries\n", (unsigned long long) hits, table->entries_count);
+        tableDelete(table);
+    }
+    pool_delete(p);
+    free(subtrees);
+    game_delete(root);
+    return 0;
+}
@@ -0,0 +1,195 @@
+/**
+ * @file ponder.c
+ * @author Jason Wang
+ * This program implements the game loop against the computer. While the human thinks, the computer searches the
+ * position after the reply it predicts in a background thread; a correct prediction turns that search into its answer,
+ * and a wrong one stops it and keeps the transposition table for the real search.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include "ponder.h"
+#include "search.h"
+#include "book.h"
+#include "rules.h"
+#include "error-codes.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    search* s;
+    game* g;
+    search_result result;
+} ponder_job;
+
+/** persistent cache of the process, shared by the computer and the hint and analyze commands */
+static pcache* sharedCache = NULL;
+/** true once ponder_cache has looked for the cache */
+static bool sharedCacheOpened = false;
+
+/**
+ * Runs the background search of a ponder job
+ * @param arg the ponder job
+ * @return NULL
+*/
+static void* ponderThread(void* arg) {
+    ponder_job* job = (ponder_job *) arg;
+    job->result = search_think(job->s, job->g, SEARCH_MAX_DEPTH);
+    return NULL;
+}
+
+/**
+ * Plays the move found by a search and reports it
+ * @param g the game
+ * @param r the search result
+ * @param ponderHit true if the move comes from a ponder search
+*/
+static void playResult(game* g, search_result* r, bool ponderHit) {
+    char formalCoord[BOARD_COORD_LEN];
+    board_formal_coord(g->board, r->cell, formalCoord);
+    printf("%s plays %s%s, depth %d, %llu nodes in %.2f s (%.0f nodes/s)", g->stone == BLACK_STONE ? "Black" : "White",
+           formalCoord, ponderHit ? " (ponder hit)" : "", r->depth, (unsigned long long) r->nodes, r->seconds,
+           r->seconds > 0 ? r->nodes / r->seconds : 0.0);
+    if (r->pv_count > 1) {
+        board_formal_coord(g->board, r->pv[1].cell, formalCoord);
+        printf(", expects %s", formalCoord);
+    }
+    printf("\n");
+    game_place_stone(g, r->cell);
+}
+
+/**
+ * Opens the persistent cache named by GOMOKU_CACHE on the first call and returns it on every call. The writer of a
+ * cache is chosen by a lock that is held per process, so the cache must not be opened twice in one process.
+ * @return the cache, or NULL if the variable is not set or the file is not a cache
+*/
+pcache* ponder_cache(void) {
+    if (!sharedCacheOpened) {
+        const char* path = getenv(PONDER_CACHE_VARIABLE);
+        sharedCache = path ? pcache_open(path) : NULL;
+        sharedCacheOpened = true;
+    }
+    return sharedCache;
+}
+
+/**
+ * Compacts and closes the persistent cache of the process, if it was opened
+*/
+void ponder_cache_close(void) {
+    if (sharedCache) {
+        pcache_close(sharedCache);
+    }
+    sharedCache = NULL;
+    sharedCacheOpened = false;
+}
+
+/**
+ * Parses the color played by the computer
+ * @param name "black" or "white"
+ * @return the stone of the color, or EMPTY_INTERSECTION if the name is not a color
+*/
+unsigned char ponder_parse_color(const char* name) {
+    if (strcmp(name, "black") == 0) {
+        return BLACK_STONE;
+    } else if (strcmp(name, "white") == 0) {
+        return WHITE_STONE;
+    }
+    return EMPTY_INTERSECTION;
+}
+
+/**
+ * Runs the game loop against the computer. On the computer's turn the engine searches for the given time and plays;
+ * on the human's turn it ponders the position after the second move of its principal variation until the human moves.
+ * The computer keeps its color when an opening protocol offers it a swap, but follows the human's swaps.
+ * @param g the game structure pointer
+ * @param computer the stone the computer starts with
+ * @param seconds the thinking time of the computer per move
+*/
+void ponder_loop(game* g, unsigned char computer, double seconds) {
+    search* s = search_create(PONDER_TABLE_BYTES);
+    if (!s) {
+        exit(NULL_POINTER_ERR);
+    }
+    s->persistent = ponder_cache();
+    const char* bookPath = getenv(PONDER_BOOK_VARIABLE);
+    book* openings = bookPath ? book_open(bookPath) : NULL;
+    search_result last;
+    memset(&last, 0, sizeof(last));
+    board_print(g->board, true);
+    while (g->state == GAME_STATE_PLAYING) {
+        if (g->rules->first_player_moves(g) == (computer == BLACK_STONE)) {
+            uint16_t cell;
+            if (openings && book_choose(openings, g, &cell)) {
+                char formalCoord[BOARD_COORD_LEN];
+                board_formal_coord(g->board, cell, formalCoord);
+                printf("%s plays %s from the book\n", g->stone == BLACK_STONE ? "Black" : "White", formalCoord);
+                game_place_stone(g, cell);
+                board_print(g->board, true);
+                last.pv_count = 0;
+                continue;
+            }
+            last = search_run(s, g, SEARCH_MAX_DEPTH, seconds);
+            playResult(g, &last, false);
+            board_print(g->board, true);
+            continue;
+        }
+        if (last.pv_count < 2) {
+            game_update(g);
+            last.pv_count = 0;
+            if (g->state == GAME_STATE_PLAYING) {
+                board_print(g->board, true);
+            }
+            continue;
+        }
+        move predicted = last.pv[1];
+        ponder_job job = {s, game_clone(g), {0}};
+        if (!job.g) {
+            exit(NULL_POINTER_ERR);
+        }
+        game_play(job.g, predicted.cell);
+        pthread_t thread;
+        double ponderStart = search_clock();
+        search_begin(s, SEARCH_FOREVER);
+        if (pthread_create(&thread, NULL, ponderThread, &job) != 0) {
+            exit(NULL_POINTER_ERR);
+        }
+        game_update(g);
+        move played = g->moves[g->moves_count - 1];
+        bool hit = g->state == GAME_STATE_PLAYING && played.cell == predicted.cell;
+        if (hit) {
+            search_set_deadline(s, ponderStart, seconds);
+        } else {
+            search_stop(s);
+        }
+        pthread_join(thread, NULL);
+        game_delete(job.g);
+        last.pv_count = 0;
+        if (g->state != GAME_STATE_PLAYING) {
+            continue;
+        }
+        board_print(g->board, true);
+        if (hit && job.result.depth > 0) {
+            last = job.result;
+            playResult(g, &last, true);
+            board_print(g->board, true);
+        }
+    }
+    if (openings) {
+        book_close(openings);
+    }
+    search_delete(s);
+}
+
+/**
+ * Resumes a stopped game against the computer
+ * @param g the game structure pointer
+ * @param computer the stone played by the computer
+ * @param seconds the thinking time of the computer per move
+*/
+void ponder_resume(game* g, unsigned char computer, double seconds) {
+    if (g->state != GAME_STATE_STOPPED) {
+        exit(RESUME_ERR);
+    }
+    g->state = GAME_STATE_PLAYING;
+    ponder_loop(g, computer, seconds);
+}
@@ -0,0 +1,24 @@
+#ifndef _PONDER_H_
+#define _PONDER_H_
+#include "game.h"
+#include "pcache.h"
+/** default thinking time of the computer in seconds */
+#define PONDER_DEFAULT_SECONDS 2.0
+/** memory budget of the transposition table kept between moves */
+#define PONDER_TABLE_BYTES (64u << 20)
+/** environment variable naming the persistent analysis cache of the computer */
+#define PONDER_CACHE_VARIABLE "GOMOKU_CACHE"
+/** environment variable naming the opening book of the computer and of the hint command */
+#define PONDER_BOOK_VARIABLE "GOMOKU_BOOK"
+
+/** function to loop a game against the computer, which thinks on the human's time */
+void ponder_loop(game* g, unsigned char computer, double seconds);
+/** function to resume a stopped game against the computer */
+void ponder_resume(game* g, unsigned char computer, double seconds);
+/** function to get the persistent cache of the process, opened on the first call */
+pcache* ponder_cache(void);
+/** function to close the persistent cache of the process */
+void ponder_cache_close(void);
+/** function to parse the color played by the computer */
+unsigned char ponder_parse_color(const char* name);
+#endif
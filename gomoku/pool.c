@@ -0,0 +1,199 @@
+/**
+ * @file pool.c
+ * @author Jason Wang
+ * This program implements a work-stealing thread pool. Every worker owns a deque of tasks: it runs the newest task of
+ * its own deque first, and when that deque is empty it steals the oldest task of another worker.
+ * Tasks that belong together (such as the positions of one game) can be queued on the same worker to share its caches.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include "pool.h"
+#include "error-codes.h"
+#include <stdlib.h>
+
+/** initial number of tasks of a deque */
+#define DEQUE_CAPACITY 64
+
+typedef struct {
+    pool* p;
+    int index;
+} worker_start;
+
+/**
+ * Adds a task at the back of a deque, growing it when full
+ * @param d the deque
+ * @param t the task
+*/
+static void pushBack(pool_deque* d, pool_task t) {
+    pthread_mutex_lock(&d->lock);
+    if (d->tail - d->head == d->capacity) {
+        pool_task* tasks = (pool_task *) malloc(2 * d->capacity * sizeof(pool_task));
+        if (!tasks) {
+            exit(NULL_POINTER_ERR);
+        }
+        for (size_t i = d->head; i < d->tail; i++) {
+            tasks[i - d->head] = d->tasks[i % d->capacity];
+        }
+        free(d->tasks);
+        d->tasks = tasks;
+        d->tail -= d->head;
+        d->head = 0;
+        d->capacity *= 2;
+    }
+    d->tasks[d->tail++ % d->capacity] = t;
+    pthread_mutex_unlock(&d->lock);
+}
+
+/**
+ * Takes a task from a deque: the newest for its owner, the oldest for a thief
+ * @param d the deque
+ * @param owner true to take from the back
+ * @param t the task taken
+ * @return true if the deque had a task
+*/
+static bool take(pool_deque* d, bool owner, pool_task* t) {
+    pthread_mutex_lock(&d->lock);
+    bool found = d->tail > d->head;
+    if (found) {
+        *t = owner ? d->tasks[--d->tail % d->capacity] : d->tasks[d->head++ % d->capacity];
+    }
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+/**
+ * Runs tasks until the pool is deleted
+ * @param arg the start parameters of the worker
+ * @return NULL
+*/
+static void* workerLoop(void* arg) {
+    worker_start* start = (worker_start *) arg;
+    pool* p = start->p;
+    int index = start->index;
+    free(start);
+    while (true) {
+        pthread_mutex_lock(&p->lock);
+        while (p->queued == 0 && !p->closing) {
+            pthread_cond_wait(&p->work, &p->lock);
+        }
+        if (p->queued == 0) {
+            pthread_mutex_unlock(&p->lock);
+            return NULL;
+        }
+        // one queued task is reserved for this worker, so one of the deques holds it
+        p->queued--;
+        pthread_mutex_unlock(&p->lock);
+        pool_task t;
+        bool stolen = false;
+        if (!take(&p->deques[index], true, &t)) {
+            stolen = true;
+            for (int i = 1; !take(&p->deques[(index + i) % p->threads_count], false, &t); i++) {
+            }
+        }
+        t.fn(t.arg, index);
+        pthread_mutex_lock(&p->lock);
+        p->steals += stolen;
+        if (--p->pending == 0) {
+            pthread_cond_broadcast(&p->idle);
+        }
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+/**
+ * Creates a work-stealing pool
+ * @param threads_count the number of worker threads
+ * @return the pool or NULL if malloc fails
+*/
+pool* pool_create(int threads_count) {
+    pool* p = (pool *) calloc(1, sizeof(pool));
+    if (!p) {
+        return NULL;
+    }
+    p->threads_count = threads_count;
+    p->threads = (pthread_t *) malloc(threads_count * sizeof(pthread_t));
+    p->deques = (pool_deque *) calloc(threads_count, sizeof(pool_deque));
+    if (!p->threads || !p->deques) {
+        free(p->threads);
+        free(p->deques);
+        free(p);
+        return NULL;
+    }
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->work, NULL);
+    pthread_cond_init(&p->idle, NULL);
+    for (int i = 0; i < threads_count; i++) {
+        p->deques[i].capacity = DEQUE_CAPACITY;
+        p->deques[i].tasks = (pool_task *) malloc(DEQUE_CAPACITY * sizeof(pool_task));
+        if (!p->deques[i].tasks) {
+            exit(NULL_POINTER_ERR);
+        }
+        pthread_mutex_init(&p->deques[i].lock, NULL);
+    }
+    for (int i = 0; i < threads_count; i++) {
+        worker_start* start = (worker_start *) malloc(sizeof(worker_start));
+        if (!start) {
+            exit(NULL_POINTER_ERR);
+        }
+        start->p = p;
+        start->index = i;
+        if (pthread_create(&p->threads[i], NULL, workerLoop, start) != 0) {
+            exit(NULL_POINTER_ERR);
+        }
+    }
+    return p;
+}
+
+/**
+ * Waits for the submitted tasks, stops the workers and deletes a pool
+ * @param p the pool
+*/
+void pool_delete(pool* p) {
+    if (!p) {
+        exit(NULL_POINTER_ERR);
+    }
+    pool_wait(p);
+    pthread_mutex_lock(&p->lock);
+    p->closing = true;
+    pthread_cond_broadcast(&p->work);
+    pthread_mutex_unlock(&p->lock);
+    for (int i = 0; i < p->threads_count; i++) {
+        pthread_join(p->threads[i], NULL);
+        free(p->deques[i].tasks);
+        pthread_mutex_destroy(&p->deques[i].lock);
+    }
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->work);
+    pthread_cond_destroy(&p->idle);
+    free(p->deques);
+    free(p->threads);
+    free(p);
+}
+
+/**
+ * Adds a task to the deque of a worker, where any idle worker may steal it
+ * @param p the pool
+ * @param queue the worker whose deque receives the task, taken modulo the number of workers
+ * @param fn the task function
+ * @param arg the argument of the task function
+*/
+void pool_submit(pool* p, int queue, pool_task_fn fn, void* arg) {
+    pool_task t = {fn, arg};
+    pushBack(&p->deques[queue % p->threads_count], t);
+    pthread_mutex_lock(&p->lock);
+    p->queued++;
+    p->pending++;
+    pthread_cond_signal(&p->work);
+    pthread_mutex_unlock(&p->lock);
+}
+
+/**
+ * Waits until every submitted task has run
+ * @param p the pool
+*/
+void pool_wait(pool* p) {
+    pthread_mutex_lock(&p->lock);
+    while (p->pending > 0) {
+        pthread_cond_wait(&p->idle, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+}
@@ -0,0 +1,44 @@
+#ifndef _POOL_H_
+#define _POOL_H_
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/** task run by a worker of the pool, with the index of that worker */
+typedef void (*pool_task_fn)(void* arg, int worker);
+
+typedef struct {
+    pool_task_fn fn;
+    void* arg;
+} pool_task;
+
+typedef struct {
+    pool_task* tasks;
+    size_t head;
+    size_t tail;
+    size_t capacity;
+    pthread_mutex_t lock;
+} pool_deque;
+
+typedef struct {
+    pthread_t* threads;
+    pool_deque* deques;
+    int threads_count;
+    size_t queued;
+    size_t pending;
+    size_t steals;
+    bool closing;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t idle;
+} pool;
+
+/** function to create a work-stealing pool of worker threads */
+pool* pool_create(int threads_count);
+/** function to stop the workers and delete a pool */
+void pool_delete(pool* p);
+/** function to add a task to the queue of a worker */
+void pool_submit(pool* p, int queue, pool_task_fn fn, void* arg);
+/** function to wait until every submitted task has run */
+void pool_wait(pool* p);
+#endif
@@ -0,0 +1,383 @@
+/**
+ * @file puzzles.c
+ * @author Jason Wang
+ * This is the main program to mine tactical puzzles from archived gomoku/renju games.
+ * Every position of every game of a directory is checked with the threat-space solver, spread over a work-stealing
+ * pool: a position is a winning puzzle when the side to move has a unique first move that wins by fours and open threes,
+ * and a defensive puzzle when the opponent threatens such a win and a single move of the side to move refutes it.
+ * Each puzzle is written as a .gmk position with its solution in a sidecar file next to it.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "error-codes.h"
+#include "board.h"
+#include "game.h"
+#include "io.h"
+#include "dfpn.h"
+#include "eval.h"
+#include "pool.h"
+#include "search.h"
+
+#define DEFAULT_NODES 100000
+#define DEFAULT_TABLE_MB 16
+/** shortest winning line of a puzzle, so that an immediate five or the block of a four is not one */
+#define DEFAULT_MIN_LINE 3
+/** proof tree nodes visited to pick the defender's longest resistance along a solution line */
+#define LINE_BUDGET 100000
+/** largest number of candidate moves of a position */
+#define MAX_MOVES 361
+/** extension of the solution files */
+#define SOLUTION_EXTENSION ".sol"
+#define PUZZLE_NONE 0
+#define PUZZLE_WIN 1
+#define PUZZLE_DEFENCE 2
+
+typedef struct {
+    dfpn_table** tables;
+    const char* output;
+    size_t max_nodes;
+    size_t min_line;
+    size_t solves;
+} batch;
+
+typedef struct {
+    char* path;
+    game* g;
+    unsigned char* puzzles;
+} archive;
+
+typedef struct {
+    batch* b;
+    archive* a;
+    size_t ply;
+} job;
+
+/**
+ * Prints the usage of the program and exits
+*/
+static void usage(void) {
+    printf("usage: ./puzzles -o <output-directory> [-j <threads>] [-n <max-nodes>] [-m <table-MB>] [-l <min-line>] <directory>\n"
+           "       writes every puzzle as <game>-<move>.gmk with its solution in <game>-<move>.gmk" SOLUTION_EXTENSION "\n");
+    exit(ARGUMENT_ERR);
+}
+
+/**
+ * Lists the empty intersections near the stones of a position, the moves worth considering
+ * @param g the game
+ * @param moves the output array
+ * @return the number of moves
+*/
+static size_t nearMoves(game* g, move* moves) {
+    board* b = g->board;
+    uint16_t near[MAX_MOVES];
+    size_t count = board_candidates(b, near);
+    for (size_t i = 0; i < count; i++) {
+        move candidate = {near[i], g->stone};
+        moves[i] = candidate;
+    }
+    return count;
+}
+
+/**
+ * Runs the threat-space solver and counts the call
+ * @param b the batch
+ * @param t the solver table of the worker
+ * @param g the position
+ * @param attacker the color to prove a win for
+ * @param line true to find the defender's longest resistance along the winning line, false when only the result counts
+ * @return the result
+*/
+static dfpn_result solveThreats(batch* b, dfpn_table* t, game* g, unsigned char attacker, bool line) {
+    __atomic_fetch_add(&b->solves, 1, __ATOMIC_RELAXED);
+    return dfpn_solve_bounded(t, g, attacker, b->max_nodes, true, line ? LINE_BUDGET : 0);
+}
+
+/**
+ * Checks that no move of the side to move but the first move of a winning line also wins by threats.
+ * Only fours and open threes can start a threat-space win, so the other moves need no solving.
+ * @param b the batch
+ * @param t the solver table of the worker
+ * @param g the position
+ * @param win the winning line
+ * @return true if the first move is the only winning move
+*/
+static bool uniqueWin(batch* b, dfpn_table* t, game* g, const dfpn_result* win) {
+    unsigned char mover = g->stone;
+    move moves[MAX_MOVES];
+    size_t count = nearMoves(g, moves);
+    for (size_t i = 0; i < count; i++) {
+        if (moves[i].cell == win->line[0].cell) {
+            continue;
+        }
+        int delta[SHAPE_COUNT];
+        eval_placement(g->board, moves[i].cell, mover, delta);
+        if (delta[SHAPE_FIVE] + delta[SHAPE_OPEN_FOUR] + delta[SHAPE_FOUR] <= 0 && delta[SHAPE_OPEN_THREE] <= 0) {
+            continue;
+        }
+        unsigned char state = game_play(g, moves[i].cell);
+        bool wins = state != GAME_STATE_PLAYING ? g->winner == mover : solveThreats(b, t, g, mover, false).result != DFPN_DISPROVEN;
+        game_undo(g);
+        if (wins) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Finds the only move of the side to move that refutes the threats of the opponent
+ * @param b the batch
+ * @param t the solver table of the worker
+ * @param g the position
+ * @param defence the refuting move
+ * @return true if exactly one move is proven to refute the threats
+*/
+static bool uniqueDefence(batch* b, dfpn_table* t, game* g, move* defence) {
+    unsigned char opponent = g->stone == BLACK_STONE ? WHITE_STONE : BLACK_STONE;
+    move moves[MAX_MOVES];
+    size_t count = nearMoves(g, moves);
+    size_t defences = 0;
+    for (size_t i = 0; i < count; i++) {
+        unsigned char state = game_play(g, moves[i].cell);
+        unsigned char result = state != GAME_STATE_PLAYING ? DFPN_PROVEN : solveThreats(b, t, g, opponent, false).result;
+        game_undo(g);
+        if (result == DFPN_UNKNOWN) {
+            // the move might refute the threats, so uniqueness cannot be told
+            return false;
+        }
+        if (result == DFPN_DISPROVEN) {
+            *defence = moves[i];
+            if (++defences > 1) {
+                return false;
+            }
+        }
+    }
+    return defences == 1;
+}
+
+/**
+ * Checks if the attacker only plays fours along a winning line, which makes it a victory by continuous fours
+ * @param g the position before the line
+ * @param r the result holding the line
+ * @return true if every attacker move of the line makes a four or a five
+*/
+static bool isFoursOnly(game* g, const dfpn_result* r) {
+    bool fours = true;
+    size_t played = 0;
+    for (size_t i = 0; i < r->line_count && fours; i++) {
+        if (r->line[i].stone == r->attacker) {
+            int delta[SHAPE_COUNT];
+            eval_placement(g->board, r->line[i].cell, r->attacker, delta);
+            fours = delta[SHAPE_FIVE] + delta[SHAPE_OPEN_FOUR] + delta[SHAPE_FOUR] > 0;
+        }
+        game_play(g, r->line[i].cell);
+        played++;
+    }
+    while (played-- > 0) {
+        game_undo(g);
+    }
+    return fours;
+}
+
+/**
+ * Writes a puzzle position and its solution file to the output directory
+ * @param b the batch
+ * @param a the archived game
+ * @param g the puzzle position
+ * @param ply the number of moves of the position
+ * @param comment the first line of the solution file
+ * @param lines the lines of moves of the solution file, one per line
+ * @param counts the number of moves of each line
+ * @param lines_count the number of lines
+*/
+static void writePuzzle(batch* b, archive* a, game* g, size_t ply, const char* comment, const move** lines,
+                        const size_t* counts, int lines_count) {
+    const char* base = strrchr(a->path, '/') ? strrchr(a->path, '/') + 1 : a->path;
+    size_t baseLen = strlen(base);
+    if (baseLen > 4 && strcmp(base + baseLen - 4, ".gmk") == 0) {
+        baseLen -= 4;
+    }
+    char* path = (char *) malloc(strlen(b->output) + baseLen + 32 + strlen(SOLUTION_EXTENSION));
+    if (!path) {
+        exit(NULL_POINTER_ERR);
+    }
+    sprintf(path, "%s/%.*s-%zu.gmk", b->output, (int) baseLen, base, ply + 1);
+    game_export(g, path);
+    strcat(path, SOLUTION_EXTENSION);
+    FILE* fp = fopen(path, "w");
+    if (!fp) {
+        exit(FILE_OUTPUT_ERR);
+    }
+    fprintf(fp, "# %s\n", comment);
+    for (int i = 0; i < lines_count; i++) {
+        for (size_t j = 0; j < counts[i]; j++) {
+            char coord[BOARD_COORD_LEN];
+            board_formal_coord(g->board, lines[i][j].cell, coord);
+            fprintf(fp, "%s%s", j > 0 ? " " : "", coord);
+        }
+        fprintf(fp, "\n");
+    }
+    fclose(fp);
+    free(path);
+}
+
+/**
+ * Checks one position of an archived game for a winning or a defensive puzzle, and writes it out if there is one
+ * @param arg the job
+ * @param worker the index of the worker
+*/
+static void minePosition(void* arg, int worker) {
+    job* j = (job *) arg;
+    batch* b = j->b;
+    dfpn_table* t = b->tables[worker];
+    game* source = j->a->g;
+    game* g = game_create(source->board->size, source->type);
+    for (size_t i = 0; i < j->ply; i++) {
+        game_play(g, source->moves[i].cell);
+    }
+    unsigned char mover = g->stone;
+    unsigned char opponent = mover == BLACK_STONE ? WHITE_STONE : BLACK_STONE;
+    const char* moverName = mover == BLACK_STONE ? "black" : "white";
+    char comment[128];
+    dfpn_result win = solveThreats(b, t, g, mover, true);
+    if (win.result == DFPN_PROVEN && win.line_count >= b->min_line && uniqueWin(b, t, g, &win)) {
+        snprintf(comment, sizeof(comment), "%s to play and win by %s in %zu moves", moverName,
+                 isFoursOnly(g, &win) ? "fours" : "threats", (win.line_count + 1) / 2);
+        const move* lines[1] = {win.line};
+        size_t counts[1] = {win.line_count};
+        writePuzzle(b, j->a, g, j->ply, comment, lines, counts, 1);
+        j->a->puzzles[j->ply] = PUZZLE_WIN;
+    } else if (win.result == DFPN_DISPROVEN) {
+        // the threats the opponent would win with if it could move again
+        g->stone = opponent;
+        dfpn_result threat = solveThreats(b, t, g, opponent, true);
+        g->stone = mover;
+        move defence;
+        if (threat.result == DFPN_PROVEN && threat.line_count >= b->min_line && uniqueDefence(b, t, g, &defence)) {
+            snprintf(comment, sizeof(comment), "%s to play and stop the threats of %s", moverName,
+                     opponent == BLACK_STONE ? "black" : "white");
+            const move* lines[2] = {&defence, threat.line};
+            size_t counts[2] = {1, threat.line_count};
+            writePuzzle(b, j->a, g, j->ply, comment, lines, counts, 2);
+            j->a->puzzles[j->ply] = PUZZLE_DEFENCE;
+        }
+    }
+    game_delete(g);
+    free(j);
+}
+
+/**
+ * This is the main function of the puzzle miner
+ * @param argc the number of command line args
+ * @param argv an array of command-line argument strings
+*/
+int main(int argc, char *argv[]) {
+    int opt;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    long tableMegabytes = DEFAULT_TABLE_MB;
+    long minLine = DEFAULT_MIN_LINE;
+    batch b;
+    memset(&b, 0, sizeof(b));
+    b.max_nodes = DEFAULT_NODES;
+    while ((opt = getopt(argc, argv, "o:j:n:m:l:")) != -1) {
+        switch (opt) {
+            case 'o': b.output = optarg; break;
+            case 'j': threads = atol(optarg); break;
+            case 'n': b.max_nodes = (size_t) atol(optarg); break;
+            case 'm': tableMegabytes = atol(optarg); break;
+            case 'l': minLine = atol(optarg); break;
+            default: usage();
+        }
+    }
+    if (optind != argc - 1 || !b.output || threads < 1 || b.max_nodes == 0 || tableMegabytes < 1 || minLine < 1) {
+        usage();
+    }
+    b.min_line = (size_t) minLine;
+    b.tables = (dfpn_table **) malloc(threads * sizeof(dfpn_table *));
+    if (!b.tables) {
+        exit(NULL_POINTER_ERR);
+    }
+    for (long i = 0; i < threads; i++) {
+        // the solver only runs in threats-only mode here, so the tables stay valid across positions and games
+        b.tables[i] = dfpn_create((size_t) tableMegabytes << 20);
+        if (!b.tables[i]) {
+            exit(NULL_POINTER_ERR);
+        }
+    }
+    size_t count = 0;
+    char** paths = game_list_dir(argv[optind], &count);
+    archive* archives = (archive *) calloc(count + 1, sizeof(archive));
+    pool* p = pool_create(threads);
+    if (!archives || !p) {
+        exit(NULL_POINTER_ERR);
+    }
+    double start = search_clock();
+    size_t positions = 0;
+    size_t skipped = 0;
+    for (size_t i = 0; i < count; i++) {
+        archives[i].path = paths[i];
+        int size = game_peek_size(paths[i]);
+        if (size != 15 && size != 17 && size != 19) {
+            // the solver and the puzzle files are for dense boards, the game stays without a game struct
+            skipped++;
+            continue;
+        }
+        archives[i].g = game_import(paths[i]);
+        archives[i].puzzles = (unsigned char *) calloc(archives[i].g->moves_count + 1, 1);
+        if (!archives[i].puzzles) {
+            exit(NULL_POINTER_ERR);
+        }
+        for (size_t ply = 0; ply < archives[i].g->moves_count; ply++) {
+            job* j = (job *) malloc(sizeof(job));
+            if (!j) {
+                exit(NULL_POINTER_ERR);
+            }
+            j->b = &b;
+            j->a = &archives[i];
+            j->ply = ply;
+            // the positions of a game start on one worker, whose table they share, and spread by stealing
+            pool_submit(p, i, minePosition, j);
+            positions++;
+        }
+    }
+    pool_wait(p);
+    double seconds = search_clock() - start;
+    size_t wins = 0;
+    size_t defences = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!archives[i].g) {
+            printf("%s: large board, skipped\n", archives[i].path);
+            free(paths[i]);
+            continue;
+        }
+        size_t gameWins = 0;
+        size_t gameDefences = 0;
+        for (size_t ply = 0; ply < archives[i].g->moves_count; ply++) {
+            gameWins += archives[i].puzzles[ply] == PUZZLE_WIN;
+            gameDefences += archives[i].puzzles[ply] == PUZZLE_DEFENCE;
+        }
+        if (gameWins + gameDefences > 0) {
+            printf("%s: %zu winning puzzles, %zu defensive puzzles\n", archives[i].path, gameWins, gameDefences);
+        }
+        wins += gameWins;
+        defences += gameDefences;
+        game_delete(archives[i].g);
+        free(archives[i].puzzles);
+        free(paths[i]);
+    }
+    printf("%zu games, %zu positions, %zu winning puzzles, %zu defensive puzzles, %zu solves in %.2f s with %ld threads "
+           "(%.1f positions/s)\n", count - skipped, positions, wins, defences, b.solves, seconds, threads,
+           seconds > 0 ? positions / seconds : 0.0);
+    pool_delete(p);
+    for (long i = 0; i < threads; i++) {
+        dfpn_delete(b.tables[i]);
+    }
+    free(b.tables);
+    free(archives);
+    free(paths);
+    return 0;
+}
@@ -0,0 +1,85 @@
+/**
+ * @file recover.c
+ * @author Jason Wang
+ * This is the main program to rebuild the games of a move journal, for example after a crash. Every game is listed
+ * with its moves and state, and written to a .gmk file named after its journal id when an output directory is given.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "error-codes.h"
+#include "board.h"
+#include "game.h"
+#include "io.h"
+#include "journal.h"
+
+#define PATH_LEN 4096
+
+/**
+ * Prints the usage of the program and exits
+*/
+static void usage(void) {
+    printf("usage: ./recover [-o <directory>] <journal>\n"
+           "       -o writes each game to <directory>/<id>.gmk\n");
+    exit(ARGUMENT_ERR);
+}
+
+/**
+ * Describes the state of a game
+ * @param g the game
+ * @return the description
+*/
+static const char* describe(game* g) {
+    if (g->state == GAME_STATE_FORBIDDEN) {
+        return "white won by a forbidden move";
+    } else if (g->state == GAME_STATE_FINISHED && g->winner == BLACK_STONE) {
+        return "black won";
+    } else if (g->state == GAME_STATE_FINISHED && g->winner == WHITE_STONE) {
+        return "white won";
+    } else if (g->state == GAME_STATE_FINISHED || g->state == GAME_STATE_DRAWN) {
+        return "draw";
+    }
+    return "stopped";
+}
+
+/**
+ * This is the main function of the recovery tool
+ * @param argc the number of command line args
+ * @param argv an array of command-line argument strings
+*/
+int main(int argc, char *argv[]) {
+    int opt;
+    char* output = NULL;
+    while ((opt = getopt(argc, argv, "o:")) != -1) {
+        switch (opt) {
+            case 'o': output = optarg; break;
+            default: usage();
+        }
+    }
+    if (optind != argc - 1) {
+        usage();
+    }
+    if (access(argv[optind], R_OK) != 0) {
+        exit(FILE_INPUT_ERR);
+    }
+    uint32_t* ids;
+    size_t count;
+    game** games = journal_recover(argv[optind], &ids, &count);
+    for (size_t i = 0; i < count; i++) {
+        printf("game %u: %zu moves on %ux%u, %s", ids[i], games[i]->moves_count, games[i]->board->size,
+               games[i]->board->size, describe(games[i]));
+        if (output) {
+            char path[PATH_LEN];
+            snprintf(path, sizeof(path), "%s/%u.gmk", output, ids[i]);
+            game_export(games[i], path);
+            printf(", saved to %s", path);
+        }
+        printf("\n");
+        game_delete(games[i]);
+    }
+    free(games);
+    free(ids);
+    return 0;
+}
@@ -12,6 +12,9 @@
 #include "board.h"
 #include "game.h"
 #include "io.h"
+#include "ponder.h"
+#include "journal.h"
+#include "feed.h"
 
 #define DEFAULT_SIZE 15
 
@@ -22,20 +25,33 @@
 */
 int main(int argc, char *argv[]) {
     int opt;
-    char *options = "o:r:b:";
+    int batch = 0;
+    static struct option longOptions[] = {
+        {"batch", optional_argument, NULL, 'B'},
+        {NULL, 0, NULL, 0}
+    };
+    char *options = "o:r:b:c:s:";
     char outputFile[255] = {0};
     char replayFile[255] = {0};
     int size = -1;
     int bFlag = 0;
     int rFlag = 0;
-    while ((opt = getopt(argc, argv, options)) != -1) { 
+    int cFlag = 0;
+    unsigned char computer = EMPTY_INTERSECTION;
+    double seconds = PONDER_DEFAULT_SECONDS;
+    while ((opt = getopt_long(argc, argv, options, longOptions, NULL)) != -1) { 
         switch (opt) { 
-            case 'o': strncpy(outputFile, optarg, 255); break;
-            case 'r': rFlag = 1; strncpy(replayFile, optarg, 255); break;
+            case 'o': strncpy(outputFile, optarg, 254); break;
+            case 'r': rFlag = 1; strncpy(replayFile, optarg, 254); break;
             case 'b': bFlag = 1; size = atoi(optarg); break;
+            case 'c': cFlag = 1; computer = ponder_parse_color(optarg); break;
+            case 's': seconds = atof(optarg); break;
+            case 'B': batch = !optarg ? 1 : (strcmp(optarg, "moves") == 0 ? 2 : -1); break;
             default: {
                 printf("usage: ./renju [-r <unfinished-match.gmk>] [-o <saved-match.gmk>] [-b <15|17|19>]\n"
-                       "       -r and -b conflicts with each other\n");
+                       "       [-c <black|white>] [-s <seconds>] [--batch[=moves]]\n"
+                       "       -r and -b conflicts with each other, --batch conflicts with -c\n"
+                       "       --batch plays the moves of the input without prompts, =moves prints a line per move\n");
                 exit(ARGUMENT_ERR);
             }
         } 
@@ -43,47 +59,127 @@ int main(int argc, char *argv[]) {
 
     if (strlen(outputFile) > 0 && outputFile[0] == '-') {
         printf("usage: ./renju [-r <unfinished-match.gmk>] [-o <saved-match.gmk>] [-b <15|17|19>]\n"
-                "       -r and -b conflicts with each other\n");
+                "       [-c <black|white>] [-s <seconds>] [--batch[=moves]]\n"
+                "       -r and -b conflicts with each other, --batch conflicts with -c\n"
+                "       --batch plays the moves of the input without prompts, =moves prints a line per move\n");
         exit(ARGUMENT_ERR);
     }
     if (strlen(replayFile) > 0 && replayFile[0] == '-') {
         printf("usage: ./renju [-r <unfinished-match.gmk>] [-o <saved-match.gmk>] [-b <15|17|19>]\n"
-                "       -r and -b conflicts with each other\n");
+                "       [-c <black|white>] [-s <seconds>] [--batch[=moves]]\n"
+                "       -r and -b conflicts with each other, --batch conflicts with -c\n"
+                "       --batch plays the moves of the input without prompts, =moves prints a line per move\n");
         exit(ARGUMENT_ERR);
     }
     if (bFlag && (size == -1 || size == 0)) {
         printf("usage: ./renju [-r <unfinished-match.gmk>] [-o <saved-match.gmk>] [-b <15|17|19>]\n"
-                "       -r and -b conflicts with each other\n");
+                "       [-c <black|white>] [-s <seconds>] [--batch[=moves]]\n"
+                "       -r and -b conflicts with each other, --batch conflicts with -c\n"
+                "       --batch plays the moves of the input without prompts, =moves prints a line per move\n");
+        exit(ARGUMENT_ERR);
+    }
+    if ((cFlag && computer == EMPTY_INTERSECTION) || seconds <= 0) {
+        printf("usage: ./renju [-r <unfinished-match.gmk>] [-o <saved-match.gmk>] [-b <15|17|19>]\n"
+                "       [-c <black|white>] [-s <seconds>] [--batch[=moves]]\n"
+                "       -r and -b conflicts with each other, --batch conflicts with -c\n"
+                "       --batch plays the moves of the input without prompts, =moves prints a line per move\n");
         exit(ARGUMENT_ERR);
     }
     if (bFlag && rFlag) {
         printf("usage: ./renju [-r <unfinished-match.gmk>] [-o <saved-match.gmk>] [-b <15|17|19>]\n"
-                "       -r and -b conflicts with each other\n");
+                "       [-c <black|white>] [-s <seconds>] [--batch[=moves]]\n"
+                "       -r and -b conflicts with each other, --batch conflicts with -c\n"
+                "       --batch plays the moves of the input without prompts, =moves prints a line per move\n");
+        exit(ARGUMENT_ERR);
+    }
+    if (batch < 0 || (batch && cFlag)) {
+        printf("usage: ./renju [-r <unfinished-match.gmk>] [-o <saved-match.gmk>] [-b <15|17|19>]\n"
+                "       [-c <black|white>] [-s <seconds>] [--batch[=moves]]\n"
+                "       -r and -b conflicts with each other, --batch conflicts with -c\n"
+                "       --batch plays the moves of the input without prompts, =moves prints a line per move\n");
         exit(ARGUMENT_ERR);
     }
 
     for(; optind < argc; optind++) {      
         printf("usage: ./renju [-r <unfinished-match.gmk>] [-o <saved-match.gmk>] [-b <15|17|19>]\n"
-                "       -r and -b conflicts with each other\n");
+                "       [-c <black|white>] [-s <seconds>] [--batch[=moves]]\n"
+                "       -r and -b conflicts with each other, --batch conflicts with -c\n"
+                "       --batch plays the moves of the input without prompts, =moves prints a line per move\n");
         exit(ARGUMENT_ERR);
     }
 
+    journal* j = NULL;
+    if (getenv(JOURNAL_VARIABLE)) {
+        j = journal_open(getenv(JOURNAL_VARIABLE));
+        if (!j) {
+            exit(FILE_OUTPUT_ERR);
+        }
+    }
+    feed* f = NULL;
+    if (getenv(FEED_VARIABLE)) {
+        f = feed_open(getenv(FEED_VARIABLE));
+        if (!f) {
+            exit(FILE_OUTPUT_ERR);
+        }
+    }
     game *g = NULL;
+    int status = 0;
     if (replayFile[0] != 0) {
         g = game_import(replayFile);
         if (g->type != GAME_RENJU) {
             exit(RESUME_ERR);
         }
-        game_resume(g);
+        if (j) {
+            journal_watch(j, g);
+        }
+        if (f && !feed_watch(f, g)) {
+            exit(ARGUMENT_ERR);
+        }
+        if (cFlag) {
+            ponder_resume(g, computer, seconds);
+        } else if (batch) {
+            if (g->state != GAME_STATE_STOPPED) {
+                exit(RESUME_ERR);
+            }
+            g->state = GAME_STATE_PLAYING;
+            status = game_batch(g, STDIN_FILENO, batch == 2) ? 0 : INPUT_ERR;
+        } else {
+            game_resume(g);
+        }
     } else {
         if (size == -1) {
             g = game_create(DEFAULT_SIZE, GAME_RENJU);
         } else {
             g = game_create(size, GAME_RENJU);
         }
-        game_loop(g);
+        if (j) {
+            journal_watch(j, g);
+        }
+        if (f && !feed_watch(f, g)) {
+            exit(ARGUMENT_ERR);
+        }
+        if (cFlag) {
+            ponder_loop(g, computer, seconds);
+        } else if (batch) {
+            status = game_batch(g, STDIN_FILENO, batch == 2) ? 0 : INPUT_ERR;
+        } else {
+            game_loop(g);
+        }
     }
+    ponder_cache_close();
     if (outputFile[0] != 0) {
         game_export(g, outputFile);
     }
-}
\ No newline at end of file
+    if (j) {
+        if (j->failed) {
+            printf("The journal could not be written, the game was stopped.\n");
+            status = FILE_OUTPUT_ERR;
+        }
+        journal_close(j);
+    }
+    if (f) {
+        feed_publish(f, g, FEED_END);
+        feed_close(f);
+    }
+    return status;
+}
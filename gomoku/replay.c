@@ -8,6 +8,7 @@
 #include "error-codes.h"
 #include "game.h"
 #include "io.h"
+#include "sparse.h"
 
 /**
  * This is the main function of the replay function for the game
@@ -20,6 +21,14 @@ int main(int argc, char *argv[]) {
         exit(ARGUMENT_ERR);
     }
 
+    int size = game_peek_size(argv[1]);
+    if (size != 15 && size != 17 && size != 19) {
+        unsigned char state, winner;
+        sparse_board* b = sparse_import(argv[1], &state, &winner);
+        game_sparse_replay(b);
+        sparse_delete(b);
+        return 0;
+    }
     game *g = game_import(argv[1]);
     game_replay(g);
 }
\ No newline at end of file
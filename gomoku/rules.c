@@ -0,0 +1,243 @@
+/**
+ * @file rules.c
+ * @author Jason Wang
+ * This program implements the rule variants: how a game is won, which moves are forbidden, and the opening protocol.
+ * game_create selects the table of a variant once, and each check runs the board kernels of kernels.c.
+*/
+#include "rules.h"
+#include "kernels.h"
+#include <string.h>
+
+/**
+ * Checks if the stone at a grid index is part of five or more in a row
+ * @param b the board
+ * @param cell the grid index
+ * @param stone the color
+ * @return true if the stone wins
+*/
+static bool fiveOrMoreWins(const board* b, uint16_t cell, unsigned char stone) {
+    return kernels_is_five(b->grid, b->size, cell, stone);
+}
+
+/**
+ * Checks if the stone at a grid index is part of exactly five in a row
+ * @param b the board
+ * @param cell the grid index
+ * @param stone the color
+ * @return true if the stone wins
+*/
+static bool exactFiveWins(const board* b, uint16_t cell, unsigned char stone) {
+    return kernels_is_exact_five(b->grid, b->size, cell, stone);
+}
+
+/**
+ * Checks if the stone at a grid index is part of an overline or of a five not blocked at both ends
+ * @param b the board
+ * @param cell the grid index
+ * @param stone the color
+ * @return true if the stone wins
+*/
+static bool unblockedFiveWins(const board* b, uint16_t cell, unsigned char stone) {
+    return kernels_is_unblocked_five(b->grid, b->size, cell, stone);
+}
+
+/**
+ * Checks if the stone at a grid index wins under renju: black needs exactly five, white five or more
+ * @param b the board
+ * @param cell the grid index
+ * @param stone the color
+ * @return true if the stone wins
+*/
+static bool renjuWins(const board* b, uint16_t cell, unsigned char stone) {
+    if (stone == BLACK_STONE) {
+        return kernels_is_exact_five(b->grid, b->size, cell, stone);
+    }
+    return kernels_is_five(b->grid, b->size, cell, stone);
+}
+
+/**
+ * Forbids nothing
+ * @param b the board
+ * @param cell the grid index
+ * @param stone the color
+ * @return false
+*/
+static bool nothingForbidden(const board* b, uint16_t cell, unsigned char stone) {
+    (void) b;
+    (void) cell;
+    (void) stone;
+    return false;
+}
+
+/**
+ * Checks if a black stone makes an overline or two fours, unless it also makes exactly five, which wins
+ * @param b the board
+ * @param cell the grid index
+ * @param stone the color
+ * @return true if the move is forbidden
+*/
+static bool renjuForbidden(const board* b, uint16_t cell, unsigned char stone) {
+    if (stone != BLACK_STONE || kernels_is_exact_five(b->grid, b->size, cell, stone)) {
+        return false;
+    }
+    return kernels_is_overline(b->grid, b->size, cell, stone)
+        || kernels_is_double_four(b->grid, b->size, cell, stone);
+}
+
+/**
+ * Offers no choice
+ * @param g the game struct pointer
+ * @return NULL
+*/
+static const char* noOffer(const game* g) {
+    (void) g;
+    return NULL;
+}
+
+/**
+ * Accepts no choice
+ * @param g the game struct pointer
+ * @param choice the choice typed by a player
+ * @return false
+*/
+static bool noChoice(game* g, const char* choice) {
+    (void) g;
+    (void) choice;
+    return false;
+}
+
+/**
+ * Names the choice made at some point of a variant without opening protocol
+ * @param opening the opening step reached
+ * @param swapped true if the players swapped colors
+ * @param ply the number of stones placed
+ * @return NULL
+*/
+static const char* noChoiceMade(unsigned char opening, bool swapped, size_t ply) {
+    (void) opening;
+    (void) swapped;
+    (void) ply;
+    return NULL;
+}
+
+/**
+ * Checks if the player who started with black is to move, following any swap of colors
+ * @param g the game struct pointer
+ * @return true if the first player moves
+*/
+static bool colorMoves(const game* g) {
+    return (g->stone == BLACK_STONE) != g->swapped;
+}
+
+/**
+ * Describes the choice of the swap2 opening waiting for a player, if any. The first player places the first three
+ * stones. The second player then takes black, keeps white, or places two more stones and lets the first player choose.
+ * @param g the game struct pointer
+ * @return the description or NULL if no choice is waiting
+*/
+static const char* swap2Offer(const game* g) {
+    if (g->moves_count == 0) {
+        return "Swap2 opening: the first player places the first three stones.";
+    }
+    if (g->moves_count == 3 && g->opening == RULES_SWAP2_TENTATIVE) {
+        return "The second player may enter swap to take black, two to place two more stones, or a move to keep white.";
+    }
+    if (g->moves_count == 5 && g->opening == RULES_SWAP2_BALANCE && !g->swapped) {
+        return "The first player may enter swap to take white, or let the second player move with white.";
+    }
+    return NULL;
+}
+
+/**
+ * Applies a choice of the swap2 opening. A swap of the first player keeps the balance step, so that the step and
+ * the swapped field tell which player swapped.
+ * @param g the game struct pointer
+ * @param choice the choice typed by a player, swap or two
+ * @return true if the choice was waiting and is now made
+*/
+static bool swap2Choose(game* g, const char* choice) {
+    bool second = g->moves_count == 3 && g->opening == RULES_SWAP2_TENTATIVE;
+    bool first = g->moves_count == 5 && g->opening == RULES_SWAP2_BALANCE && !g->swapped;
+    if ((second || first) && strcmp(choice, "swap") == 0) {
+        g->swapped = true;
+        g->opening = second ? RULES_SWAP2_SETTLED : RULES_SWAP2_BALANCE;
+        return true;
+    }
+    if (second && strcmp(choice, "two") == 0) {
+        g->opening = RULES_SWAP2_BALANCE;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Names the choice of the swap2 opening made once some stones were placed, from the step and swap the game reached
+ * @param opening the opening step reached
+ * @param swapped true if the players swapped colors
+ * @param ply the number of stones placed
+ * @return swap, two, or NULL if no choice was made at that point
+*/
+static const char* swap2Made(unsigned char opening, bool swapped, size_t ply) {
+    if (ply == 3 && opening == RULES_SWAP2_SETTLED) {
+        return "swap";
+    }
+    if (ply == 3 && opening == RULES_SWAP2_BALANCE) {
+        return "two";
+    }
+    if (ply == 5 && opening == RULES_SWAP2_BALANCE && swapped) {
+        return "swap";
+    }
+    return NULL;
+}
+
+/**
+ * Checks if the first player is to move under swap2, who places the first three stones, while the second player
+ * places the fourth and fifth stones after choosing to
+ * @param g the game struct pointer
+ * @return true if the first player moves
+*/
+static bool swap2Moves(const game* g) {
+    if (g->moves_count < 3) {
+        return true;
+    }
+    if (g->moves_count < 5 && g->opening == RULES_SWAP2_BALANCE) {
+        return false;
+    }
+    return colorMoves(g);
+}
+
+static const game_rules RULES[GAME_VARIANTS] = {
+    {GAME_FREESTYLE, "freestyle", 0, EMPTY_INTERSECTION,
+     fiveOrMoreWins, nothingForbidden, noOffer, noChoice, noChoiceMade, colorMoves},
+    {GAME_RENJU, "renju", 0xA24BAED4963EE407ull, BLACK_STONE,
+     renjuWins, renjuForbidden, noOffer, noChoice, noChoiceMade, colorMoves},
+    {GAME_STANDARD, "standard", 0x9FB21C651E98DF25ull, EMPTY_INTERSECTION,
+     exactFiveWins, nothingForbidden, noOffer, noChoice, noChoiceMade, colorMoves},
+    {GAME_CARO, "caro", 0xD6E8FEB86659FD93ull, EMPTY_INTERSECTION,
+     unblockedFiveWins, nothingForbidden, noOffer, noChoice, noChoiceMade, colorMoves},
+    {GAME_SWAP2, "swap2", 0x3C6EF372FE94F82Bull, EMPTY_INTERSECTION,
+     exactFiveWins, nothingForbidden, swap2Offer, swap2Choose, swap2Made, swap2Moves},
+};
+
+/**
+ * Gets the rules of a game type
+ * @param type the game type
+ * @return the rules or NULL if the type is not a variant
+*/
+const game_rules* rules_select(unsigned char type) {
+    return type < GAME_VARIANTS ? &RULES[type] : NULL;
+}
+
+/**
+ * Parses the name of a rule variant
+ * @param name the name
+ * @return the game type or GAME_VARIANTS if the name is not a variant
+*/
+unsigned char rules_parse(const char* name) {
+    for (unsigned char type = 0; type < GAME_VARIANTS; type++) {
+        if (strcmp(name, RULES[type].name) == 0) {
+            return type;
+        }
+    }
+    return GAME_VARIANTS;
+}
@@ -0,0 +1,34 @@
+#ifndef _RULES_H_
+#define _RULES_H_
+#include "board.h"
+#include "game.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+/** steps of the swap2 opening kept in the opening field of a game; in the balance step, the swapped field of the game
+ * tells that the first player took white after the fifth stone, so that the step and the field tell every choice made */
+#define RULES_SWAP2_TENTATIVE 0
+#define RULES_SWAP2_BALANCE 1
+#define RULES_SWAP2_SETTLED 2
+
+typedef struct game_rules {
+    unsigned char type;
+    const char* name;
+    /** salt of the search keys, so that positions of different variants never share a table entry */
+    uint64_t key;
+    /** the color whose moves may be forbidden, or EMPTY_INTERSECTION if the variant forbids nothing */
+    unsigned char forbidden_stone;
+    bool (*is_win)(const board* b, uint16_t cell, unsigned char stone);
+    bool (*is_forbidden)(const board* b, uint16_t cell, unsigned char stone);
+    const char* (*opening_offer)(const game* g);
+    bool (*opening_choose)(game* g, const char* choice);
+    /** the choice made once the first ply stones were placed by a game that reached an opening step, or NULL */
+    const char* (*opening_choice)(unsigned char opening, bool swapped, size_t ply);
+    bool (*first_player_moves)(const game* g);
+} game_rules;
+
+/** function to get the rules of a game type */
+const game_rules* rules_select(unsigned char type);
+/** function to parse the name of a rule variant */
+unsigned char rules_parse(const char* name);
+#endif
@@ -0,0 +1,590 @@
+/**
+ * @file search.c
+ * @author Jason Wang
+ * This program implements the alpha-beta engine: an iterative deepening principal variation search over the game struct,
+ * scored by the incremental evaluator and sped up by a transposition table that is kept between searches.
+ * A search can be stopped, or have its time budget changed, from another thread.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include "search.h"
+#include "eval.h"
+#include "rules.h"
+#include "sym.h"
+#include "error-codes.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** largest number of intersections of a board */
+#define MAX_CELLS 361
+/** number of best-scored candidate moves searched at each node */
+#define MAX_BRANCH 12
+/** number of nodes between two checks of the clock and the stop flag */
+#define CHECK_INTERVAL 1024
+#define BOUND_EXACT 1
+#define BOUND_LOWER 2
+#define BOUND_UPPER 3
+/** marks a missing move */
+#define NO_CELL 0xFFFF
+
+typedef struct {
+    search* s;
+    game* g;
+    int size;
+    bool aborted;
+    uint16_t root_cell;
+    const uint16_t* excluded;
+    size_t excluded_count;
+} context;
+
+/**
+ * Reads the monotonic clock
+ * @return the time in seconds
+*/
+double search_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Checks, every CHECK_INTERVAL nodes, whether the search was stopped or ran out of time
+ * @param c the search context
+ * @return true if the search must unwind
+*/
+static bool mustStop(context* c) {
+    if (c->aborted) {
+        return true;
+    }
+    if (c->s->nodes % CHECK_INTERVAL == 0) {
+        int64_t deadline = __atomic_load_n(&c->s->deadline, __ATOMIC_RELAXED);
+        c->aborted = __atomic_load_n(&c->s->stop, __ATOMIC_RELAXED) || (int64_t) (search_clock() * 1e9) >= deadline;
+    }
+    return c->aborted;
+}
+
+/**
+ * Computes the key of the current position, which also depends on the side to move and the rule variant
+ * @param g the game
+ * @return the key
+*/
+uint64_t search_key(game* g) {
+    return g->board->hash ^ (g->stone == WHITE_STONE ? 0x5DEECE66DF00DF00ull : 0) ^ g->rules->key;
+}
+
+/**
+ * Converts a score to its table form, making win scores relative to the node instead of the root
+ * @param score the score
+ * @param ply the distance from the root
+ * @return the table score
+*/
+static int toTable(int score, int ply) {
+    return score > SEARCH_WIN_BOUND ? score + ply : (score < -SEARCH_WIN_BOUND ? score - ply : score);
+}
+
+/**
+ * Converts a table score back to a score relative to the root
+ * @param score the table score
+ * @param ply the distance from the root
+ * @return the score
+*/
+static int fromTable(int score, int ply) {
+    return score > SEARCH_WIN_BOUND ? score - ply : (score < -SEARCH_WIN_BOUND ? score + ply : score);
+}
+
+/**
+ * Generates the candidate moves of the current position: the table move first, then the intersections near a stone
+ * with the best threat scores. At the root of an analysis the moves of the lines already found do not count against
+ * MAX_BRANCH, so every line still has as many moves to choose from as the first.
+ * @param c the search context
+ * @param tableCell the move stored in the table, or NO_CELL
+ * @param ply the distance from the root
+ * @param cells the output array
+ * @return the number of moves
+*/
+static int generate(context* c, uint16_t tableCell, int ply, uint16_t* cells) {
+    game* g = c->g;
+    int size = c->size;
+    if (g->moves_count == 0) {
+        cells[0] = size / 2 * size + size / 2;
+        return 1;
+    }
+    uint16_t near[MAX_CELLS];
+    int scores[MAX_CELLS];
+    int count = 0;
+    size_t nearCount = board_candidates(g->board, near);
+    for (size_t i = 0; i < nearCount; i++) {
+        int cell = near[i];
+        int score = cell == tableCell ? SEARCH_WIN : eval_threat(g, cell);
+        int j = count++;
+        for (; j > 0 && scores[j - 1] < score; j--) {
+            scores[j] = scores[j - 1];
+            cells[j] = cells[j - 1];
+        }
+        scores[j] = score;
+        cells[j] = cell;
+    }
+    int branch = ply == 0 ? MAX_BRANCH + (int) c->excluded_count : MAX_BRANCH;
+    return count < branch ? count : branch;
+}
+
+/**
+ * Checks whether a root move was already reported by the analysis
+ * @param c the search context
+ * @param cell the grid index of the move
+ * @return true if the move is excluded from the root
+*/
+static bool isExcluded(context* c, uint16_t cell) {
+    for (size_t i = 0; i < c->excluded_count; i++) {
+        if (c->excluded[i] == cell) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Searches the current position with a principal variation alpha-beta search
+ * @param c the search context
+ * @param depth the remaining depth
+ * @param ply the distance from the root
+ * @param alpha the lower bound
+ * @param beta the upper bound
+ * @return the score for the side to move
+*/
+static int negamax(context* c, int depth, int ply, int alpha, int beta) {
+    search* s = c->s;
+    game* g = c->g;
+    s->nodes++;
+    if (mustStop(c)) {
+        return 0;
+    }
+    if (depth == 0) {
+        return eval(g);
+    }
+    uint64_t key = search_key(g);
+    search_entry* entry = &s->entries[key & (s->entries_count - 1)];
+    uint16_t tableCell = NO_CELL;
+    if (entry->key == key) {
+        tableCell = entry->cell;
+        int score = fromTable(entry->score, ply);
+        if (ply > 0 && entry->depth >= depth) {
+            if (entry->bound == BOUND_EXACT) {
+                return score;
+            } else if (entry->bound == BOUND_LOWER && score > alpha) {
+                alpha = score;
+            } else if (entry->bound == BOUND_UPPER && score < beta) {
+                beta = score;
+            }
+            if (alpha >= beta) {
+                return score;
+            }
+        }
+    }
+    uint16_t cells[MAX_CELLS];
+    int count = generate(c, tableCell, ply, cells);
+    if (count == 0) {
+        return 0;
+    }
+    int originalAlpha = alpha;
+    int best = -SEARCH_WIN - 1;
+    uint16_t bestCell = NO_CELL;
+    bool first = true;
+    for (int i = 0; i < count; i++) {
+        if (ply == 0 && isExcluded(c, cells[i])) {
+            continue;
+        }
+        unsigned char mover = g->stone;
+        int score;
+        if (game_play(g, cells[i]) != GAME_STATE_PLAYING) {
+            score = g->winner == mover ? SEARCH_WIN - ply - 1 : (g->winner == EMPTY_INTERSECTION ? 0 : -(SEARCH_WIN - ply - 1));
+        } else if (first) {
+            score = -negamax(c, depth - 1, ply + 1, -beta, -alpha);
+        } else {
+            score = -negamax(c, depth - 1, ply + 1, -alpha - 1, -alpha);
+            if (score > alpha && score < beta) {
+                score = -negamax(c, depth - 1, ply + 1, -beta, -alpha);
+            }
+        }
+        game_undo(g);
+        first = false;
+        if (c->aborted) {
+            return 0;
+        }
+        if (score > best) {
+            best = score;
+            bestCell = cells[i];
+            if (ply == 0) {
+                c->root_cell = bestCell;
+            }
+            if (score > alpha) {
+                alpha = score;
+            }
+            if (alpha >= beta) {
+                break;
+            }
+        }
+    }
+    if (bestCell == NO_CELL) {
+        return 0;
+    }
+    if (ply == 0 && c->excluded_count > 0) {
+        // the best of the remaining root moves is not the score of the position
+        return best;
+    }
+    entry->key = key;
+    entry->score = toTable(best, ply);
+    entry->cell = bestCell;
+    entry->depth = depth;
+    entry->bound = best <= originalAlpha ? BOUND_UPPER : (best >= beta ? BOUND_LOWER : BOUND_EXACT);
+    return best;
+}
+
+/**
+ * Follows the table moves from the current position to extend the principal variation
+ * @param c the search context
+ * @param result the result to fill
+*/
+static void principalVariation(context* c, search_result* result) {
+    game* g = c->g;
+    size_t played = 0;
+    while (g->state == GAME_STATE_PLAYING && result->pv_count < SEARCH_MAX_PV) {
+        uint64_t key = search_key(g);
+        search_entry* entry = &c->s->entries[key & (c->s->entries_count - 1)];
+        if (entry->key != key || entry->cell == NO_CELL || g->board->grid[entry->cell] != EMPTY_INTERSECTION) {
+            break;
+        }
+        move m = {entry->cell, g->stone};
+        result->pv[result->pv_count++] = m;
+        game_play(g, entry->cell);
+        played++;
+    }
+    while (played-- > 0) {
+        game_undo(g);
+    }
+}
+
+/**
+ * Computes the key of the current position folded over the symmetries of the board, as used by the persistent cache
+ * and the opening book
+ * @param g the game
+ * @param transform the symmetry from the position to its canonical image
+ * @return the key
+*/
+uint64_t search_canonical_key(game* g, int* transform) {
+    return sym_canonical_hash(g->board, transform) ^ search_key(g) ^ g->board->hash;
+}
+
+/**
+ * Looks the current position up in the persistent cache
+ * @param s the searcher
+ * @param g the game
+ * @param result the result to fill with the cached move, score and depth
+ * @return true if the cache holds a legal move for the position
+*/
+static bool probePersistent(search* s, game* g, search_result* result) {
+    int transform;
+    pcache_entry e;
+    if (!pcache_get(s->persistent, search_canonical_key(g, &transform), &e)) {
+        return false;
+    }
+    int size = g->board->size;
+    if (e.cell >= size * size) {
+        return false;
+    }
+    int cell = sym_permutation(size, sym_invert(transform))[e.cell];
+    if (g->board->grid[cell] != EMPTY_INTERSECTION) {
+        return false;
+    }
+    result->cell = cell;
+    result->score = e.score;
+    result->depth = e.depth;
+    result->pv[0] = (move) {result->cell, g->stone};
+    result->pv_count = 1;
+    return true;
+}
+
+/**
+ * Stores the result of the current position in the persistent cache
+ * @param s the searcher
+ * @param g the game
+ * @param result the result of a completed iteration
+*/
+static void storePersistent(search* s, game* g, search_result* result) {
+    int transform;
+    uint64_t key = search_canonical_key(g, &transform);
+    int size = g->board->size;
+    int cell = sym_permutation(size, transform)[result->cell];
+    pcache_entry e = {result->score, (uint16_t) cell, (uint8_t) result->depth, PCACHE_BOUND_EXACT};
+    pcache_put(s->persistent, key, e);
+}
+
+/**
+ * Makes a move the first one the next search of the current position tries, through its transposition table entry
+ * @param s the searcher
+ * @param g the game
+ * @param cell the move
+*/
+static void seedRoot(search* s, game* g, uint16_t cell) {
+    uint64_t key = search_key(g);
+    search_entry* entry = &s->entries[key & (s->entries_count - 1)];
+    if (entry->key != key) {
+        memset(entry, 0, sizeof(search_entry));
+        entry->key = key;
+    }
+    entry->cell = cell;
+}
+
+/**
+ * Creates a searcher whose transposition table uses at most the given number of bytes
+ * @param table_bytes the memory budget
+ * @return the searcher or NULL if malloc fails
+*/
+search* search_create(size_t table_bytes) {
+    search* s = (search *) calloc(1, sizeof(search));
+    if (!s) {
+        return NULL;
+    }
+    s->entries_count = 1;
+    while (s->entries_count * 2 * sizeof(search_entry) <= table_bytes) {
+        s->entries_count *= 2;
+    }
+    s->entries = (search_entry *) calloc(s->entries_count, sizeof(search_entry));
+    if (!s->entries) {
+        free(s);
+        return NULL;
+    }
+    s->persistent = NULL;
+    return s;
+}
+
+/**
+ * Deletes a searcher
+ * @param s the searcher
+*/
+void search_delete(search* s) {
+    if (!s) {
+        exit(NULL_POINTER_ERR);
+    }
+    free(s->entries);
+    free(s);
+}
+
+/**
+ * Asks a running search to stop, it returns the result of its last completed iteration
+ * @param s the searcher
+*/
+void search_stop(search* s) {
+    __atomic_store_n(&s->stop, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Sets the time budget of the next or the running search, counted from start
+ * @param s the searcher
+ * @param start the start time from search_clock
+ * @param seconds the budget, SEARCH_FOREVER to run until stopped
+*/
+void search_set_deadline(search* s, double start, double seconds) {
+    int64_t deadline = seconds == SEARCH_FOREVER ? INT64_MAX : (int64_t) ((start + seconds) * 1e9);
+    __atomic_store_n(&s->deadline, deadline, __ATOMIC_RELAXED);
+}
+
+/**
+ * Prepares a search: clears the stop flag and sets the time budget, counted from now
+ * @param s the searcher
+ * @param seconds the budget, SEARCH_FOREVER to run until stopped
+*/
+void search_begin(search* s, double seconds) {
+    __atomic_store_n(&s->stop, 0, __ATOMIC_RELAXED);
+    search_set_deadline(s, search_clock(), seconds);
+}
+
+/**
+ * Searches the current position of a game by iterative deepening until max_depth, the deadline or a stop request,
+ * with the stop flag and the deadline prepared by search_begin. The game is left unchanged.
+ * @param s the searcher
+ * @param g the game
+ * @param max_depth the deepest iteration
+ * @return the best move of the deepest completed iteration, with its score and principal variation, or the best move
+ * found so far at depth 0 when no iteration completed
+*/
+search_result search_think(search* s, game* g, int max_depth) {
+    search_result result;
+    memset(&result, 0, sizeof(result));
+    double start = search_clock();
+    s->nodes = 0;
+    if (g->state != GAME_STATE_PLAYING) {
+        return result;
+    }
+    int cachedDepth = 0;
+    if (s->persistent && probePersistent(s, g, &result)) {
+        cachedDepth = result.depth;
+        if (cachedDepth >= max_depth || result.score > SEARCH_WIN_BOUND || result.score < -SEARCH_WIN_BOUND) {
+            result.seconds = search_clock() - start;
+            return result;
+        }
+        // deepen from the cached iteration, trying the cached move first
+        seedRoot(s, g, result.cell);
+    }
+    context c = {s, game_clone(g), g->board->size, false, NO_CELL, NULL, 0};
+    if (!c.g || !eval_create(c.g->board)) {
+        exit(NULL_POINTER_ERR);
+    }
+    for (int depth = cachedDepth + 1; depth <= max_depth && depth <= SEARCH_MAX_DEPTH; depth++) {
+        c.root_cell = NO_CELL;
+        int score = negamax(&c, depth, 0, -SEARCH_WIN - 1, SEARCH_WIN + 1);
+        if (c.aborted) {
+            // without a completed iteration, the best move found so far is still playable, at depth 0
+            if (result.depth == 0 && c.root_cell != NO_CELL) {
+                result.cell = c.root_cell;
+            }
+            break;
+        }
+        if (c.root_cell != NO_CELL) {
+            result.cell = c.root_cell;
+            result.score = score;
+            result.depth = depth;
+        }
+        if (score > SEARCH_WIN_BOUND || score < -SEARCH_WIN_BOUND) {
+            break;
+        }
+    }
+    if (s->persistent && result.depth > cachedDepth) {
+        storePersistent(s, g, &result);
+    }
+    result.pv_count = 0;
+    principalVariation(&c, &result);
+    if (result.pv_count > 0 && result.pv[0].cell != result.cell) {
+        result.pv_count = 0;
+    }
+    result.nodes = s->nodes;
+    result.seconds = search_clock() - start;
+    game_delete(c.g);
+    return result;
+}
+
+/**
+ * Searches the current position of a game by iterative deepening within a time budget
+ * @param s the searcher
+ * @param g the game
+ * @param max_depth the deepest iteration
+ * @param seconds the budget, SEARCH_FOREVER to run until stopped
+ * @return the best move with its score and principal variation
+*/
+search_result search_run(search* s, game* g, int max_depth, double seconds) {
+    search_begin(s, seconds);
+    return search_think(s, g, max_depth);
+}
+
+/**
+ * Searches the best moves of a game, each with its own score and principal variation, by iterative deepening until
+ * max_depth or the deadline. Every iteration searches the root once per line, excluding the moves of the lines before.
+ * With a persistent cache, a cached move leads the first line until an iteration reaches its depth, and a single line
+ * cached at max_depth or with a forced result is returned without searching; the first line of a completed iteration
+ * deeper than the cache is stored in it.
+ * @param s the searcher
+ * @param g the game
+ * @param lines the number of moves wanted
+ * @param max_depth the deepest iteration
+ * @param seconds the budget
+ * @param results the output array with room for lines results, sorted from the best move
+ * @return the number of results, smaller than lines when there are fewer candidate moves
+*/
+size_t search_analyze(search* s, game* g, size_t lines, int max_depth, double seconds, search_result* results) {
+    double start = search_clock();
+    search_begin(s, seconds);
+    s->nodes = 0;
+    if (g->state != GAME_STATE_PLAYING || lines == 0) {
+        return 0;
+    }
+    search_result cached;
+    memset(&cached, 0, sizeof(cached));
+    if (s->persistent && probePersistent(s, g, &cached)) {
+        if (lines == 1 && (cached.depth >= max_depth || cached.score > SEARCH_WIN_BOUND
+                           || cached.score < -SEARCH_WIN_BOUND)) {
+            results[0] = cached;
+            results[0].seconds = search_clock() - start;
+            return 1;
+        }
+        seedRoot(s, g, cached.cell);
+    }
+    uint16_t* found = (uint16_t *) malloc(lines * sizeof(uint16_t));
+    search_result* current = (search_result *) calloc(lines, sizeof(search_result));
+    if (!found || !current) {
+        exit(NULL_POINTER_ERR);
+    }
+    context c = {s, game_clone(g), g->board->size, false, NO_CELL, found, 0};
+    if (!c.g || !eval_create(c.g->board)) {
+        exit(NULL_POINTER_ERR);
+    }
+    size_t count = 0;
+    int completed = 0;
+    for (int depth = 1; depth <= max_depth && depth <= SEARCH_MAX_DEPTH && !c.aborted; depth++) {
+        c.excluded_count = 0;
+        while (c.excluded_count < lines) {
+            c.root_cell = NO_CELL;
+            int score = negamax(&c, depth, 0, -SEARCH_WIN - 1, SEARCH_WIN + 1);
+            if (c.aborted || c.root_cell == NO_CELL) {
+                break;
+            }
+            search_result* r = &current[c.excluded_count];
+            memset(r, 0, sizeof(search_result));
+            r->cell = c.root_cell;
+            r->score = score;
+            r->depth = depth;
+            r->pv[0] = (move) {r->cell, c.g->stone};
+            r->pv_count = 1;
+            game_play(c.g, c.root_cell);
+            principalVariation(&c, r);
+            game_undo(c.g);
+            found[c.excluded_count++] = c.root_cell;
+        }
+        // a partial iteration only replaces the lines it completed when nothing better is known
+        if (!c.aborted || count == 0) {
+            count = c.excluded_count;
+            memcpy(results, current, count * sizeof(search_result));
+        }
+        if (!c.aborted && count > 0) {
+            completed = depth;
+        }
+    }
+    if (s->persistent && completed > cached.depth) {
+        storePersistent(s, g, &results[0]);
+    } else if (cached.depth > 0 && cached.depth > (count > 0 ? results[0].depth : 0)) {
+        // the cached move was searched deeper than any line found now, it leads with its cached score
+        size_t i = 0;
+        while (i < count && results[i].cell != cached.cell) {
+            i++;
+        }
+        if (i == count) {
+            count = count < lines ? count + 1 : count;
+            i = count - 1;
+        }
+        memmove(&results[1], &results[0], i * sizeof(search_result));
+        results[0] = cached;
+    }
+    for (size_t i = 0; i < count; i++) {
+        results[i].nodes = s->nodes;
+        results[i].seconds = search_clock() - start;
+    }
+    game_delete(c.g);
+    free(current);
+    free(found);
+    return count;
+}
+
+/**
+ * Formats a score for players: a signed number, or the number of moves to a forced win or loss
+ * @param score the score
+ * @param str the output string with room for SEARCH_SCORE_LEN characters
+*/
+void search_format_score(int score, char* str) {
+    if (score > SEARCH_WIN_BOUND) {
+        snprintf(str, SEARCH_SCORE_LEN, "win in %d", (SEARCH_WIN - score + 1) / 2);
+    } else if (score < -SEARCH_WIN_BOUND) {
+        snprintf(str, SEARCH_SCORE_LEN, "loss in %d", (SEARCH_WIN + score + 1) / 2);
+    } else {
+        snprintf(str, SEARCH_SCORE_LEN, "%+d", score);
+    }
+}
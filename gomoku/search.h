@@ -0,0 +1,70 @@
+#ifndef _SEARCH_H_
+#define _SEARCH_H_
+#include "game.h"
+#include "pcache.h"
+#include <stdint.h>
+/** score of a won position, reduced by the number of moves to the win */
+#define SEARCH_WIN 10000000
+/** scores beyond this bound are wins or losses */
+#define SEARCH_WIN_BOUND (SEARCH_WIN - 1000)
+/** deepest iteration of the search */
+#define SEARCH_MAX_DEPTH 32
+/** longest principal variation reported */
+#define SEARCH_MAX_PV 16
+/** time budget meaning "until stopped" */
+#define SEARCH_FOREVER 0
+/** length of a formatted score */
+#define SEARCH_SCORE_LEN 24
+
+typedef struct {
+    uint64_t key;
+    int32_t score;
+    uint16_t cell;
+    int8_t depth;
+    uint8_t bound;
+} search_entry;
+
+typedef struct {
+    search_entry* entries;
+    size_t entries_count;
+    int32_t stop;
+    int64_t deadline;
+    uint64_t nodes;
+    pcache* persistent;
+} search;
+
+typedef struct {
+    uint16_t cell;
+    int score;
+    int depth;
+    uint64_t nodes;
+    double seconds;
+    move pv[SEARCH_MAX_PV];
+    size_t pv_count;
+} search_result;
+
+/** function to create a searcher with a transposition table within a memory budget */
+search* search_create(size_t table_bytes);
+/** function to delete a searcher */
+void search_delete(search* s);
+/** function to search the best move of a game by iterative deepening */
+search_result search_run(search* s, game* g, int max_depth, double seconds);
+/** function to prepare the stop flag and time budget of a search */
+void search_begin(search* s, double seconds);
+/** function to search with the stop flag and time budget prepared by search_begin */
+search_result search_think(search* s, game* g, int max_depth);
+/** function to search the best moves of a game with their own scores and principal variations */
+size_t search_analyze(search* s, game* g, size_t lines, int max_depth, double seconds, search_result* results);
+/** function to format a score for players */
+void search_format_score(int score, char* str);
+/** function to ask a running search to stop */
+void search_stop(search* s);
+/** function to change the time budget of a running search */
+void search_set_deadline(search* s, double start, double seconds);
+/** function to compute the key of a position, including the side to move and the rule set */
+uint64_t search_key(game* g);
+/** function to compute the key of a position folded over the symmetries of the board */
+uint64_t search_canonical_key(game* g, int* transform);
+/** function to read the monotonic clock */
+double search_clock(void);
+#endif
@@ -0,0 +1,108 @@
+/**
+ * @file solve.c
+ * @author Jason Wang
+ * This is the main program to adjudicate stopped gomoku/renju games with the proof-number solver.
+ * Every stopped game of a directory is solved for both colors, spread over worker threads.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "error-codes.h"
+#include "board.h"
+#include "game.h"
+#include "io.h"
+#include "dfpn.h"
+
+#define DEFAULT_NODES 1000000
+#define DEFAULT_TABLE_MB 64
+
+typedef struct {
+    char** paths;
+    char** reports;
+    size_t count;
+    size_t next;
+    size_t max_nodes;
+    size_t table_bytes;
+    bool threats_only;
+    pthread_mutex_t lock;
+} batch;
+
+/**
+ * Prints the usage of the program and exits
+*/
+static void usage(void) {
+    printf("usage: ./solve [-j <threads>] [-n <max-nodes>] [-m <table-MB>] [-t] <directory>\n"
+           "       -t restricts the attacker to fours and open threes\n");
+    exit(ARGUMENT_ERR);
+}
+
+/**
+ * Solves games of the batch until none is left
+ * @param arg the batch
+ * @return NULL
+*/
+static void* worker(void* arg) {
+    batch* b = (batch *) arg;
+    dfpn_table* t = dfpn_create(b->table_bytes);
+    if (!t) {
+        exit(NULL_POINTER_ERR);
+    }
+    while (true) {
+        pthread_mutex_lock(&b->lock);
+        size_t i = b->next++;
+        pthread_mutex_unlock(&b->lock);
+        if (i >= b->count) {
+            break;
+        }
+        dfpn_adjudicate(t, b->paths[i], b->max_nodes, b->threats_only, b->reports[i]);
+    }
+    dfpn_delete(t);
+    return NULL;
+}
+
+/**
+ * This is the main function of the solver
+ * @param argc the number of command line args
+ * @param argv an array of command-line argument strings
+*/
+int main(int argc, char *argv[]) {
+    int opt;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    batch b = {NULL, NULL, 0, 0, DEFAULT_NODES, (size_t) DEFAULT_TABLE_MB << 20, false, PTHREAD_MUTEX_INITIALIZER};
+    while ((opt = getopt(argc, argv, "j:n:m:t")) != -1) {
+        switch (opt) {
+            case 'j': threads = atol(optarg); break;
+            case 'n': b.max_nodes = (size_t) atol(optarg); break;
+            case 'm': b.table_bytes = (size_t) atol(optarg) << 20; break;
+            case 't': b.threats_only = true; break;
+            default: usage();
+        }
+    }
+    if (optind != argc - 1 || threads < 1 || b.max_nodes == 0 || b.table_bytes == 0) {
+        usage();
+    }
+    b.paths = game_list_dir(argv[optind], &b.count);
+    b.reports = (char **) malloc((b.count + 1) * sizeof(char *));
+    for (size_t i = 0; i < b.count; i++) {
+        b.reports[i] = (char *) calloc(DFPN_REPORT_LEN, 1);
+    }
+    pthread_t* workers = (pthread_t *) malloc(threads * sizeof(pthread_t));
+    for (long i = 0; i < threads; i++) {
+        pthread_create(&workers[i], NULL, worker, &b);
+    }
+    for (long i = 0; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    for (size_t i = 0; i < b.count; i++) {
+        printf("%s\n", b.reports[i]);
+        free(b.reports[i]);
+        free(b.paths[i]);
+    }
+    free(b.reports);
+    free(b.paths);
+    free(workers);
+    return 0;
+}
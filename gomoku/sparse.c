@@ -0,0 +1,283 @@
+/**
+ * @file sparse.c
+ * @author Jason Wang
+ * This program provides a sparse board backend for large and unbounded freestyle boards.
+ * Occupied intersections live in an open-addressing hash map, and every stone keeps the length of
+ * its run in each of the four line directions, so memory and win checks cost O(stones) instead of O(area).
+*/
+#include "sparse.h"
+#include "error-codes.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** horizontal step of each line direction */
+static const int DX[SPARSE_DIRECTIONS] = {1, 0, 1, 1};
+/** vertical step of each line direction */
+static const int DY[SPARSE_DIRECTIONS] = {0, 1, 1, -1};
+
+/**
+ * Hashes a coordinate pair
+ * @param x the x coordinate
+ * @param y the y coordinate
+ * @return the hash value
+*/
+static unsigned int hashCell(int x, int y) {
+    unsigned int h = (unsigned int) x * 0x9E3779B1u ^ (unsigned int) y * 0x85EBCA77u;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return h;
+}
+
+/**
+ * Finds the slot of an occupied intersection
+ * @param b the sparse board
+ * @param x the x coordinate
+ * @param y the y coordinate
+ * @return the slot or NULL if the intersection is empty
+*/
+static sparse_cell* findCell(sparse_board* b, int x, int y) {
+    size_t mask = b->cells_capacity - 1;
+    for (size_t i = hashCell(x, y) & mask; b->cells[i].stone != EMPTY_INTERSECTION; i = (i + 1) & mask) {
+        if (b->cells[i].x == x && b->cells[i].y == y) {
+            return &b->cells[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Stores a cell in the first free slot of its probe sequence, the cell must not be present yet
+ * @param cells the slot array
+ * @param capacity the number of slots, a power of two
+ * @param cell the cell to store
+*/
+static void storeCell(sparse_cell* cells, size_t capacity, const sparse_cell* cell) {
+    size_t mask = capacity - 1;
+    size_t i = hashCell(cell->x, cell->y) & mask;
+    while (cells[i].stone != EMPTY_INTERSECTION) {
+        i = (i + 1) & mask;
+    }
+    cells[i] = *cell;
+}
+
+/**
+ * Doubles the slot array of the sparse board and rehashes every stone
+ * @param b the sparse board
+*/
+static void growCells(sparse_board* b) {
+    size_t capacity = b->cells_capacity * 2;
+    sparse_cell* cells = (sparse_cell *) calloc(capacity, sizeof(sparse_cell));
+    if (!cells) {
+        exit(NULL_POINTER_ERR);
+    }
+    for (size_t i = 0; i < b->cells_capacity; i++) {
+        if (b->cells[i].stone != EMPTY_INTERSECTION) {
+            storeCell(cells, capacity, &b->cells[i]);
+        }
+    }
+    free(b->cells);
+    b->cells = cells;
+    b->cells_capacity = capacity;
+}
+
+/**
+ * This function creates a new sparse board of the given size.
+ * Sizes from SPARSE_MIN_SIZE to SPARSE_MAX_SIZE are bounded boards, SPARSE_UNBOUNDED accepts every coordinate
+ * up to BOARD_COORD_MAX. If an invalid size is given, exit with the code BOARD_SIZE_ERR as defined in error-codes.h
+ * @param size the size of the board
+ * @return sparse board structure or NULL if malloc fails
+*/
+sparse_board* sparse_create(unsigned short size) {
+    if (size != SPARSE_UNBOUNDED && (size < SPARSE_MIN_SIZE || size > SPARSE_MAX_SIZE)) {
+        exit(BOARD_SIZE_ERR);
+    }
+    sparse_board* b = (sparse_board *) calloc(1, sizeof(sparse_board));
+    if (!b) {
+        return NULL;
+    }
+    b->size = size;
+    b->cells_capacity = 64;
+    b->cells = (sparse_cell *) calloc(b->cells_capacity, sizeof(sparse_cell));
+    b->moves_capacity = 16;
+    b->moves = (sparse_move *) malloc(b->moves_capacity * sizeof(sparse_move));
+    if (!b->cells || !b->moves) {
+        free(b->cells);
+        free(b->moves);
+        free(b);
+        return NULL;
+    }
+    return b;
+}
+
+/**
+ * This function frees the memory of a sparse board.
+ * If the pointer b is NULL, exit with the code NULL_POINTER_ERR as defined in error-codes.h.
+ * @param b the sparse board
+*/
+void sparse_delete(sparse_board* b) {
+    if (!b) {
+        exit(NULL_POINTER_ERR);
+    }
+    free(b->cells);
+    free(b->moves);
+    free(b);
+}
+
+/**
+ * This function returns true if the 0-based coordinate pair lies on the sparse board
+ * @param b the sparse board
+ * @param x the x coordinate
+ * @param y the y coordinate
+ * @return true or false
+*/
+bool sparse_contains(sparse_board* b, int x, int y) {
+    int limit = b->size == SPARSE_UNBOUNDED ? BOARD_COORD_MAX + 1 : b->size;
+    return x >= 0 && y >= 0 && x < limit && y < limit;
+}
+
+/**
+ * This function returns the intersection occupation state at the 0-based coordinate pair x and y.
+ * @param b the sparse board
+ * @param x the x coordinate
+ * @param y the y coordinate
+ * @return the stone at the location
+*/
+unsigned char sparse_get(sparse_board* b, int x, int y) {
+    sparse_cell* cell = findCell(b, x, y);
+    return cell ? cell->stone : EMPTY_INTERSECTION;
+}
+
+/**
+ * This function places a stone at the 0-based coordinate pair x and y, links it into the runs of its four lines,
+ * and records it as the last move. If stone is neither BLACK_STONE or WHITE_STONE, exit with the code STONE_TYPE_ERR.
+ * If the coordinate is off the board or already occupied, return COORDINATE_ERR instead.
+ * @param b the sparse board
+ * @param x the x coordinate
+ * @param y the y coordinate
+ * @param stone the color of the stone
+ * @return return codes
+*/
+unsigned char sparse_set(sparse_board* b, int x, int y, unsigned char stone) {
+    if (!(stone == BLACK_STONE || stone == WHITE_STONE)) {
+        exit(STONE_TYPE_ERR);
+    }
+    if (!sparse_contains(b, x, y) || findCell(b, x, y)) {
+        return COORDINATE_ERR;
+    }
+    sparse_cell cell = {x, y, stone, {0}, {0}};
+    for (int d = 0; d < SPARSE_DIRECTIONS; d++) {
+        sparse_cell* back = findCell(b, x - DX[d], y - DY[d]);
+        sparse_cell* ahead = findCell(b, x + DX[d], y + DY[d]);
+        cell.before[d] = back && back->stone == stone ? back->before[d] + 1 : 0;
+        cell.after[d] = ahead && ahead->stone == stone ? ahead->after[d] + 1 : 0;
+    }
+    if ((b->cells_count + 1) * 2 > b->cells_capacity) {
+        growCells(b);
+    }
+    storeCell(b->cells, b->cells_capacity, &cell);
+    b->cells_count++;
+    for (int d = 0; d < SPARSE_DIRECTIONS; d++) {
+        for (int k = 1; k <= cell.before[d]; k++) {
+            findCell(b, x - k * DX[d], y - k * DY[d])->after[d] += 1 + cell.after[d];
+        }
+        for (int k = 1; k <= cell.after[d]; k++) {
+            findCell(b, x + k * DX[d], y + k * DY[d])->before[d] += 1 + cell.before[d];
+        }
+    }
+    if (b->moves_count == b->moves_capacity) {
+        b->moves_capacity *= 2;
+        b->moves = (sparse_move *) realloc(b->moves, b->moves_capacity * sizeof(sparse_move));
+    }
+    sparse_move newMove = {x, y, stone};
+    b->moves[b->moves_count++] = newMove;
+
+    return SUCCESS;
+}
+
+/**
+ * This function returns true if the stone at x and y is part of five or more in a row
+ * @param b the sparse board
+ * @param x the x coordinate
+ * @param y the y coordinate
+ * @return true or false
+*/
+bool sparse_is_five(sparse_board* b, int x, int y) {
+    sparse_cell* cell = findCell(b, x, y);
+    if (!cell) {
+        return false;
+    }
+    for (int d = 0; d < SPARSE_DIRECTIONS; d++) {
+        if (cell->before[d] + cell->after[d] + 1 >= 5) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * This function prints the part of a sparse board around its stones, SPARSE_PRINT_MARGIN intersections past the
+ * outermost stones, or around the centre of an empty board. Stones further apart than SPARSE_PRINT_MAX
+ * intersections are shown around the last move instead. Column letters are written top to bottom.
+ * If in_place is true, it clears the terminal first
+ * @param b the sparse board
+ * @param in_place clears terminal if true.
+*/
+void sparse_print(sparse_board* b, bool in_place) {
+    if (in_place) {
+        clear();
+    }
+    int centre = b->size == SPARSE_UNBOUNDED ? BOARD_COORD_MAX / 2 : b->size / 2;
+    int left = centre, right = centre, bottom = centre, top = centre;
+    for (size_t i = 0; i < b->moves_count; i++) {
+        if (i == 0) {
+            left = right = b->moves[i].x;
+            bottom = top = b->moves[i].y;
+        }
+        left = b->moves[i].x < left ? b->moves[i].x : left;
+        right = b->moves[i].x > right ? b->moves[i].x : right;
+        bottom = b->moves[i].y < bottom ? b->moves[i].y : bottom;
+        top = b->moves[i].y > top ? b->moves[i].y : top;
+    }
+    left -= SPARSE_PRINT_MARGIN;
+    bottom -= SPARSE_PRINT_MARGIN;
+    right += SPARSE_PRINT_MARGIN;
+    top += SPARSE_PRINT_MARGIN;
+    if (right - left >= SPARSE_PRINT_MAX) {
+        left = b->moves[b->moves_count - 1].x - SPARSE_PRINT_MAX / 2;
+        right = left + SPARSE_PRINT_MAX - 1;
+    }
+    if (top - bottom >= SPARSE_PRINT_MAX) {
+        bottom = b->moves[b->moves_count - 1].y - SPARSE_PRINT_MAX / 2;
+        top = bottom + SPARSE_PRINT_MAX - 1;
+    }
+    int limit = b->size == SPARSE_UNBOUNDED ? BOARD_COORD_MAX : b->size - 1;
+    left = left < 0 ? 0 : left;
+    bottom = bottom < 0 ? 0 : bottom;
+    right = right > limit ? limit : right;
+    top = top > limit ? limit : top;
+    for (int y = top; y >= bottom; y--) {
+        printf("%5d ", y + 1);
+        for (int x = left; x <= right; x++) {
+            switch (sparse_get(b, x, y)) {
+                case EMPTY_INTERSECTION: printf("+"); break;
+                case BLACK_STONE: printf("\u25CF"); break;
+                case WHITE_STONE: printf("\u25CB"); break;
+                default: break;
+            }
+            printf(x == right ? "\n" : "-");
+        }
+    }
+    char coord[BOARD_COORD_LEN];
+    board_format_coord(right, 0, coord);
+    int depth = (int) strcspn(coord, "0123456789");
+    for (int line = 0; line < depth; line++) {
+        printf("      ");
+        for (int x = left; x <= right; x++) {
+            board_format_coord(x, 0, coord);
+            int k = line - (depth - (int) strcspn(coord, "0123456789"));
+            printf("%c%s", k >= 0 ? coord[k] : ' ', x == right ? "\n" : " ");
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef _SPARSE_H_
+#define _SPARSE_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include "board.h"
+/** size of an unbounded sparse board */
+#define SPARSE_UNBOUNDED 0
+/** smallest bounded size handled by the sparse backend, smaller boards are dense */
+#define SPARSE_MIN_SIZE 20
+/** largest bounded size handled by the sparse backend */
+#define SPARSE_MAX_SIZE 100
+/** true if a size is handled by the sparse backend */
+#define SPARSE_SIZE(size) ((size) == SPARSE_UNBOUNDED || ((size) >= SPARSE_MIN_SIZE && (size) <= SPARSE_MAX_SIZE))
+/** intersections printed past the outermost stones */
+#define SPARSE_PRINT_MARGIN 3
+/** largest number of columns or rows printed */
+#define SPARSE_PRINT_MAX 39
+/** number of line directions */
+#define SPARSE_DIRECTIONS 4
+
+typedef struct {
+    int x;
+    int y;
+    unsigned char stone;
+    unsigned short before[SPARSE_DIRECTIONS];
+    unsigned short after[SPARSE_DIRECTIONS];
+} sparse_cell;
+
+typedef struct {
+    int x;
+    int y;
+    unsigned char stone;
+} sparse_move;
+
+typedef struct {
+    unsigned short size;
+    sparse_cell* cells;
+    size_t cells_count;
+    size_t cells_capacity;
+    sparse_move* moves;
+    size_t moves_count;
+    size_t moves_capacity;
+} sparse_board;
+
+/** function to create a sparse board */
+sparse_board* sparse_create(unsigned short size);
+/** function to delete a sparse board */
+void sparse_delete(sparse_board* b);
+/** function to get a stone from a sparse board */
+unsigned char sparse_get(sparse_board* b, int x, int y);
+/** function to set a stone on a sparse board */
+unsigned char sparse_set(sparse_board* b, int x, int y, unsigned char stone);
+/** function to check if a stone completes five in a row */
+bool sparse_is_five(sparse_board* b, int x, int y);
+/** function to check if a sparse coordinate is on the board */
+bool sparse_contains(sparse_board* b, int x, int y);
+/** function to print the part of a sparse board around its stones */
+void sparse_print(sparse_board* b, bool in_place);
+#endif
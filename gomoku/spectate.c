@@ -0,0 +1,168 @@
+/**
+ * @file spectate.c
+ * @author Jason Wang
+ * This is the main program to watch a game played by another process through its shared memory feed. The board is
+ * rebuilt from the snapshot of the feed, then follows the events of the ring; when the reader falls too far behind,
+ * it starts over from a new snapshot.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "error-codes.h"
+#include "board.h"
+#include "game.h"
+#include "feed.h"
+
+/** time between two polls of the feed when no event is ready */
+#define POLL_NANOSECONDS 1000000
+
+/**
+ * Prints the usage of the program and exits
+*/
+static void usage(void) {
+    printf("usage: ./spectate [-m] [<feed>]\n"
+           "       -m prints one line per move instead of the board\n"
+           "       the feed defaults to $" FEED_VARIABLE ", then " FEED_DEFAULT "\n");
+    exit(ARGUMENT_ERR);
+}
+
+/**
+ * Describes the state of a game
+ * @param state the state
+ * @param winner the winner
+ * @return the description
+*/
+static const char* describe(unsigned char state, unsigned char winner) {
+    if (state == GAME_STATE_FORBIDDEN) {
+        return "black made a forbidden move, white won";
+    } else if (state == GAME_STATE_FINISHED && winner == BLACK_STONE) {
+        return "black won";
+    } else if (state == GAME_STATE_FINISHED && winner == WHITE_STONE) {
+        return "white won";
+    } else if (state == GAME_STATE_FINISHED || state == GAME_STATE_DRAWN) {
+        return "draw";
+    } else if (state == GAME_STATE_STOPPED) {
+        return "stopped";
+    }
+    return "playing";
+}
+
+/**
+ * Rebuilds the board of a feed from its snapshot, waiting for the first game of a new feed
+ * @param s the shared feed
+ * @param b the current board, deleted
+ * @param next the sequence number of the next event to read
+ * @param swapped set if the players of the game swapped colors
+ * @return the new board
+*/
+static board* resynchronize(const feed_shared* s, board* b, uint64_t* next, bool* swapped) {
+    feed_snapshot snapshot;
+    struct timespec poll = {0, POLL_NANOSECONDS};
+    feed_read_snapshot(s, &snapshot);
+    while (snapshot.size == 0) {
+        nanosleep(&poll, NULL);
+        feed_read_snapshot(s, &snapshot);
+    }
+    if (b) {
+        board_delete(b);
+    }
+    b = board_create(snapshot.size);
+    for (int cell = 0; cell < snapshot.size * snapshot.size; cell++) {
+        if (snapshot.grid[cell] != EMPTY_INTERSECTION) {
+            board_set(b, cell, snapshot.grid[cell]);
+        }
+    }
+    *next = snapshot.events;
+    *swapped = snapshot.opening & FEED_SWAPPED;
+    return b;
+}
+
+/**
+ * This is the main function of the spectator
+ * @param argc the number of command line args
+ * @param argv an array of command-line argument strings
+*/
+int main(int argc, char *argv[]) {
+    int opt;
+    bool movesOnly = false;
+    while ((opt = getopt(argc, argv, "m")) != -1) {
+        switch (opt) {
+            case 'm': movesOnly = true; break;
+            default: usage();
+        }
+    }
+    if (optind < argc - 1) {
+        usage();
+    }
+    const char* name = optind < argc ? argv[optind] : getenv(FEED_VARIABLE);
+    const feed_shared* s = feed_attach(name ? name : FEED_DEFAULT);
+    if (!s) {
+        exit(FILE_INPUT_ERR);
+    }
+    uint64_t next;
+    bool swapped;
+    board* b = resynchronize(s, NULL, &next, &swapped);
+    if (movesOnly) {
+        printf("game %dx%d%s\n", b->size, b->size, swapped ? " swapped" : "");
+    } else {
+        board_print(b, true);
+        if (swapped) {
+            printf("The players swapped colors.\n");
+        }
+    }
+    struct timespec poll = {0, POLL_NANOSECONDS};
+    while (true) {
+        feed_event e;
+        int result = feed_read(s, next, &e);
+        if (result == FEED_WAIT) {
+            bool closed = __atomic_load_n(&s->closed, __ATOMIC_ACQUIRE);
+            if (closed && __atomic_load_n(&s->published, __ATOMIC_ACQUIRE) <= next) {
+                break;
+            }
+            nanosleep(&poll, NULL);
+            continue;
+        }
+        if (result == FEED_OVERRUN || e.kind == FEED_GAME) {
+            b = resynchronize(s, b, &next, &swapped);
+            if (movesOnly && result == FEED_OVERRUN) {
+                printf("resync\n");
+            } else if (movesOnly) {
+                printf("game %dx%d%s\n", b->size, b->size, swapped ? " swapped" : "");
+            } else {
+                board_print(b, true);
+            }
+            continue;
+        }
+        next++;
+        if (e.kind == FEED_MOVE) {
+            char formalCoord[BOARD_COORD_LEN];
+            uint16_t cell = BOARD_CELL(b, e.x - 'A', e.y - 1);
+            board_set(b, cell, e.stone);
+            board_formal_coord(b, cell, formalCoord);
+            if (!movesOnly) {
+                board_print(b, true);
+            }
+            printf("%u %s %s", e.ply, e.stone == BLACK_STONE ? "black" : "white", formalCoord);
+        } else {
+            printf("%u", e.ply);
+        }
+        if (e.state != GAME_STATE_PLAYING) {
+            printf(" %s", describe(e.state, e.winner));
+        }
+        printf("\n");
+        // an opening choice reaches the snapshot with the next stone, which is published before its event
+        bool nowSwapped = __atomic_load_n(&s->opening, __ATOMIC_RELAXED) & FEED_SWAPPED;
+        if (nowSwapped != swapped) {
+            swapped = nowSwapped;
+            printf(movesOnly ? "swapped\n" : "The players swapped colors.\n");
+        }
+        fflush(stdout);
+    }
+    board_delete(b);
+    feed_detach(s);
+    return 0;
+}
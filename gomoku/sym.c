@@ -0,0 +1,250 @@
+/**
+ * @file sym.c
+ * @author Jason Wang
+ * This program folds positions over the 8 symmetries of the square board, so that rotated and reflected positions
+ * share one canonical hash. A symmetry is a bit set: 1 mirrors the columns, 2 mirrors the rows, 4 swaps rows and
+ * columns, applied in that order.
+ * For the board sizes 15, 17 and 19 the symmetries are precomputed as grid index permutations, which let the board keep
+ * the hashes of its 8 images up to date on every move.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include "sym.h"
+#include "error-codes.h"
+#include <assert.h>
+#include <pthread.h>
+#include <string.h>
+
+/** largest number of intersections of a board */
+#define MAX_CELLS 361
+/** number of board sizes with permutation tables */
+#define SIZES_COUNT 3
+
+static uint16_t permutations[SIZES_COUNT][SYM_COUNT][MAX_CELLS];
+static pthread_once_t tablesOnce = PTHREAD_ONCE_INIT;
+/** the inverse of each symmetry: mirroring then swapping is undone by swapping then mirroring the other axis */
+static const int INVERSES[SYM_COUNT] = {0, 1, 2, 3, 4, 6, 5, 7};
+
+/**
+ * Maps an intersection through a symmetry
+ * @param transform the symmetry
+ * @param size the size of the board
+ * @param col the column of the intersection
+ * @param row the row of the intersection
+ * @param out_col the column of the image
+ * @param out_row the row of the image
+*/
+void sym_transform(int transform, int size, int col, int row, int* out_col, int* out_row) {
+    if (transform & 1) {
+        col = size - 1 - col;
+    }
+    if (transform & 2) {
+        row = size - 1 - row;
+    }
+    if (transform & 4) {
+        int swap = col;
+        col = row;
+        row = swap;
+    }
+    *out_col = col;
+    *out_row = row;
+}
+
+/**
+ * Maps an intersection back through the inverse of a symmetry
+ * @param transform the symmetry
+ * @param size the size of the board
+ * @param col the column of the image
+ * @param row the row of the image
+ * @param out_col the column of the intersection
+ * @param out_row the row of the intersection
+*/
+void sym_inverse(int transform, int size, int col, int row, int* out_col, int* out_row) {
+    if (transform & 4) {
+        int swap = col;
+        col = row;
+        row = swap;
+    }
+    if (transform & 2) {
+        row = size - 1 - row;
+    }
+    if (transform & 1) {
+        col = size - 1 - col;
+    }
+    *out_col = col;
+    *out_row = row;
+}
+
+/**
+ * Fills the permutation tables of the board sizes
+*/
+static void buildTables(void) {
+    for (int i = 0; i < SIZES_COUNT; i++) {
+        int size = 15 + 2 * i;
+        for (int t = 0; t < SYM_COUNT; t++) {
+            for (int cell = 0; cell < size * size; cell++) {
+                int col, row;
+                sym_transform(t, size, cell % size, cell / size, &col, &row);
+                permutations[i][t][cell] = row * size + col;
+            }
+        }
+    }
+}
+
+/**
+ * Builds the permutation tables of the board sizes once, board_create calls it before any stone is placed
+*/
+void sym_init(void) {
+    pthread_once(&tablesOnce, buildTables);
+}
+
+/**
+ * Gets the grid index permutation of a symmetry: the image of the intersection with index cell is permutation[cell]
+ * @param size the size of the board, 15, 17 or 19
+ * @param transform the symmetry
+ * @return the permutation
+*/
+const uint16_t* sym_permutation(int size, int transform) {
+    return permutations[(size - 15) / 2][transform];
+}
+
+/**
+ * Gets the inverse of a symmetry
+ * @param transform the symmetry
+ * @return the inverse symmetry
+*/
+int sym_invert(int transform) {
+    return INVERSES[transform];
+}
+
+/**
+ * Computes the hash of a board folded over its symmetries: the smallest hash among its 8 images, read from the
+ * hashes the board keeps up to date. The identity image hashes to the incremental hash of the board.
+ * With GOMOKU_DEBUG defined, the symmetric hashes are checked against a from-scratch computation.
+ * @param b the board
+ * @param transform the symmetry giving the canonical image
+ * @return the canonical hash
+*/
+uint64_t sym_canonical_hash(board* b, int* transform) {
+#ifdef GOMOKU_DEBUG
+    assert(sym_check(b));
+#endif
+    int best = 0;
+    for (int t = 1; t < SYM_COUNT; t++) {
+        if (b->sym_hash[t] < b->sym_hash[best]) {
+            best = t;
+        }
+    }
+    *transform = best;
+    // the seed of the incremental hash is the same for every image
+    return b->sym_hash[best] ^ b->hash ^ b->sym_hash[0];
+}
+
+/**
+ * Checks the symmetric hashes of a board against a from-scratch computation
+ * @param b the board
+ * @return true if every symmetric hash is right
+*/
+bool sym_check(board* b) {
+    uint64_t hashes[SYM_COUNT] = {0};
+    int size = b->size;
+    for (int cell = 0; cell < size * size; cell++) {
+        if (b->grid[cell] == EMPTY_INTERSECTION) {
+            continue;
+        }
+        for (int t = 0; t < SYM_COUNT; t++) {
+            int col, row;
+            sym_transform(t, size, cell % size, cell / size, &col, &row);
+            hashes[t] ^= board_zobrist(row * size + col, b->grid[cell]);
+        }
+    }
+    return memcmp(hashes, b->sym_hash, sizeof(hashes)) == 0;
+}
+
+/**
+ * Copies the image of a board through a symmetry into another board of the same size
+ * @param src the board
+ * @param transform the symmetry
+ * @param dst the board receiving the image, cleared first
+*/
+void sym_board(board* src, int transform, board* dst) {
+    if (!src || !dst || src == dst || src->size != dst->size) {
+        exit(NULL_POINTER_ERR);
+    }
+    int size = src->size;
+    const uint16_t* permutation = sym_permutation(size, transform);
+    for (int cell = 0; cell < size * size; cell++) {
+        if (dst->grid[cell] != EMPTY_INTERSECTION) {
+            board_unset(dst, cell);
+        }
+    }
+    for (int cell = 0; cell < size * size; cell++) {
+        if (src->grid[cell] != EMPTY_INTERSECTION) {
+            board_set(dst, permutation[cell], src->grid[cell]);
+        }
+    }
+}
+
+/**
+ * Copies a board in its canonical orientation, the image with the smallest hash
+ * @param src the board
+ * @param dst the board receiving the canonical image
+ * @return the symmetry from src to dst, sym_invert of it maps dst back to src
+*/
+int sym_canonical_board(board* src, board* dst) {
+    int transform;
+    sym_canonical_hash(src, &transform);
+    sym_board(src, transform, dst);
+    return transform;
+}
+
+/**
+ * Maps a move list through a symmetry, the output may be the input
+ * @param moves the moves
+ * @param count the number of moves
+ * @param size the size of the board
+ * @param transform the symmetry
+ * @param out the mapped moves
+*/
+void sym_moves(const move* moves, size_t count, int size, int transform, move* out) {
+    const uint16_t* permutation = sym_permutation(size, transform);
+    for (size_t i = 0; i < count; i++) {
+        move m = {permutation[moves[i].cell], moves[i].stone};
+        out[i] = m;
+    }
+}
+
+/**
+ * Maps a move list to its canonical orientation: the image whose sequence of grid indexes is the smallest.
+ * Games that differ only by orientation have the same canonical move list.
+ * @param moves the moves
+ * @param count the number of moves
+ * @param size the size of the board
+ * @param out the canonical moves, the output may be the input
+ * @return the symmetry from the moves to the canonical moves
+*/
+int sym_canonical_moves(const move* moves, size_t count, int size, move* out) {
+    bool candidates[SYM_COUNT] = {true, true, true, true, true, true, true, true};
+    int best = 0;
+    for (size_t i = 0; i < count; i++) {
+        int cell = moves[i].cell;
+        int smallest = MAX_CELLS;
+        for (int t = 0; t < SYM_COUNT; t++) {
+            if (candidates[t] && sym_permutation(size, t)[cell] < smallest) {
+                smallest = sym_permutation(size, t)[cell];
+            }
+        }
+        int remaining = 0;
+        for (int t = 0; t < SYM_COUNT; t++) {
+            candidates[t] = candidates[t] && sym_permutation(size, t)[cell] == smallest;
+            remaining += candidates[t];
+        }
+        if (remaining == 1) {
+            break;
+        }
+    }
+    while (!candidates[best]) {
+        best++;
+    }
+    sym_moves(moves, count, size, best, out);
+    return best;
+}
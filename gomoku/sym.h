@@ -0,0 +1,32 @@
+#ifndef _SYM_H_
+#define _SYM_H_
+#include "board.h"
+#include "game.h"
+#include <stddef.h>
+#include <stdint.h>
+/** number of symmetries of a square board: rotations and reflections */
+#define SYM_COUNT BOARD_SYMMETRIES
+
+/** function to build the permutation tables of the board sizes */
+void sym_init(void);
+/** function to get the grid index permutation of a symmetry for a board size */
+const uint16_t* sym_permutation(int size, int transform);
+/** function to get the inverse of a symmetry */
+int sym_invert(int transform);
+/** function to map an intersection through a symmetry */
+void sym_transform(int transform, int size, int col, int row, int* out_col, int* out_row);
+/** function to map an intersection back through the inverse of a symmetry */
+void sym_inverse(int transform, int size, int col, int row, int* out_col, int* out_row);
+/** function to compute the hash of a board folded over its symmetries */
+uint64_t sym_canonical_hash(board* b, int* transform);
+/** function to check the incremental symmetric hashes of a board */
+bool sym_check(board* b);
+/** function to copy the image of a board through a symmetry */
+void sym_board(board* src, int transform, board* dst);
+/** function to copy a board in its canonical orientation */
+int sym_canonical_board(board* src, board* dst);
+/** function to map a move list through a symmetry */
+void sym_moves(const move* moves, size_t count, int size, int transform, move* out);
+/** function to map a move list to its canonical orientation */
+int sym_canonical_moves(const move* moves, size_t count, int size, move* out);
+#endif
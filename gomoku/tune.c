@@ -0,0 +1,428 @@
+/**
+ * @file tune.c
+ * @author Jason Wang
+ * This is the main program to fit the shape weights of the evaluator to the results of archived games, Texel style.
+ * Every position of every finished game is a sample: the shape counts of both colors, seen from the side to move, and
+ * the final result for that side. The counts are computed once while the games are replayed over a work-stealing pool
+ * and kept one byte each, 15 bytes a position, so tens of millions of positions fit in memory. The sigmoid scale that maps scores to
+ * expected results is fitted first with the current weights, then the weights are fitted by gradient descent (Adam)
+ * on the logistic loss, each step splitting the samples over the workers, and written out as weights.h.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "error-codes.h"
+#include "board.h"
+#include "game.h"
+#include "io.h"
+#include "eval.h"
+#include "pool.h"
+#include "search.h"
+#include "weights.h"
+
+#define DEFAULT_ITERATIONS 300
+/** default step of the logarithm of a weight, about 2% of the weight per iteration at most */
+#define DEFAULT_RATE 0.02
+/** default number of opening moves of each game that are not sampled */
+#define DEFAULT_SKIP 4
+#define INITIAL_SAMPLES 4096
+/** iterations between two progress lines */
+#define REPORT_INTERVAL 50
+/** range of the base 10 logarithm of the sigmoid scale, and the golden-section steps that search it */
+#define SCALE_MIN -8.0
+#define SCALE_MAX 0.0
+#define SCALE_STEPS 60
+/** decay rates of the moment estimates of Adam */
+#define BETA1 0.9
+#define BETA2 0.999
+#define EPSILON 1e-8
+
+typedef struct {
+    uint8_t own[SHAPE_COUNT];
+    uint8_t opponent[SHAPE_COUNT];
+    /** 0 for a loss, 1 for a draw and 2 for a win of the side to move */
+    uint8_t result;
+} sample;
+
+typedef struct {
+    sample* samples;
+    size_t count;
+    size_t capacity;
+    uint64_t games;
+    uint64_t unfinished;
+    uint64_t large;
+} shard;
+
+typedef struct {
+    shard* shards;
+    size_t skip;
+} corpus;
+
+typedef struct {
+    corpus* c;
+    const char* path;
+} job;
+
+typedef struct {
+    const sample* samples;
+    size_t count;
+    const double (*weights)[SHAPE_COUNT];
+    double scale;
+    double loss;
+    double gradient[2][SHAPE_COUNT];
+} slice;
+
+/**
+ * Prints the usage of the program and exits
+*/
+static void usage(void) {
+    printf("usage: ./tune -o <weights.h> [-j <threads>] [-i <iterations>] [-r <rate>] [-s <skipped-plies>] <directory>\n"
+           "       fits the shape weights to the results of the finished games of <directory>\n");
+    exit(ARGUMENT_ERR);
+}
+
+/**
+ * Adds the position of a game as a sample, unless a five is already on the board
+ * @param s the shard of the worker
+ * @param g the position
+ * @param winner the winner of the game, EMPTY_INTERSECTION for a draw
+*/
+static void addSample(shard* s, game* g, unsigned char winner) {
+    const int* own = g->board->eval->counts[g->stone - 1];
+    const int* opponent = g->board->eval->counts[2 - g->stone];
+    if (own[SHAPE_FIVE] > 0 || opponent[SHAPE_FIVE] > 0) {
+        return;
+    }
+    if (s->count == s->capacity) {
+        s->capacity = s->capacity ? s->capacity * 2 : INITIAL_SAMPLES;
+        s->samples = (sample *) realloc(s->samples, s->capacity * sizeof(sample));
+        if (!s->samples) {
+            exit(NULL_POINTER_ERR);
+        }
+    }
+    sample* x = &s->samples[s->count++];
+    for (int k = 0; k < SHAPE_COUNT; k++) {
+        x->own[k] = own[k] < UINT8_MAX ? own[k] : UINT8_MAX;
+        x->opponent[k] = opponent[k] < UINT8_MAX ? opponent[k] : UINT8_MAX;
+    }
+    x->result = winner == g->stone ? 2 : (winner == EMPTY_INTERSECTION ? 1 : 0);
+}
+
+/**
+ * Replays a finished game and samples its positions into the shard of the worker. A game on a large board is skipped,
+ * as the evaluator only counts the shapes of 15x15 to 19x19 boards.
+ * @param arg the job
+ * @param worker the index of the worker
+*/
+static void extractGame(void* arg, int worker) {
+    job* j = (job *) arg;
+    shard* s = &j->c->shards[worker];
+    int size = game_peek_size(j->path);
+    if (size != 15 && size != 17 && size != 19) {
+        printf("%s: large board, skipped\n", j->path);
+        s->large++;
+        return;
+    }
+    game* source = game_import(j->path);
+    if (source->state != GAME_STATE_FINISHED && source->state != GAME_STATE_FORBIDDEN && source->state != GAME_STATE_DRAWN) {
+        s->unfinished++;
+        game_delete(source);
+        return;
+    }
+    game* g = game_create(source->board->size, source->type);
+    if (!g || !eval_create(g->board)) {
+        exit(NULL_POINTER_ERR);
+    }
+    for (size_t ply = 0; ply < source->moves_count && g->state == GAME_STATE_PLAYING; ply++) {
+        if (ply >= j->c->skip) {
+            addSample(s, g, source->winner);
+        }
+        game_play(g, source->moves[ply].cell);
+    }
+    s->games++;
+    game_delete(g);
+    game_delete(source);
+}
+
+/**
+ * Computes the logistic loss of a slice of the samples and its gradient with respect to the weights
+ * @param arg the slice
+ * @param worker the index of the worker
+*/
+static void lossSlice(void* arg, int worker) {
+    slice* sl = (slice *) arg;
+    const double (*w)[SHAPE_COUNT] = sl->weights;
+    double loss = 0;
+    double gradient[2][SHAPE_COUNT];
+    memset(gradient, 0, sizeof(gradient));
+    for (size_t i = 0; i < sl->count; i++) {
+        const sample* x = &sl->samples[i];
+        double score = 0;
+        for (int k = 0; k < SHAPE_COUNT; k++) {
+            score += w[0][k] * x->own[k] - w[1][k] * x->opponent[k];
+        }
+        double z = sl->scale * score;
+        double r = x->result / 2.0;
+        // log(1 + e^z) - r z, the cross-entropy of the result and the sigmoid of z, without overflow
+        loss += (z > 0 ? z + log1p(exp(-z)) : log1p(exp(z))) - r * z;
+        double error = sl->scale * (1.0 / (1.0 + exp(-z)) - r);
+        for (int k = 0; k < SHAPE_COUNT; k++) {
+            gradient[0][k] += error * x->own[k];
+            gradient[1][k] -= error * x->opponent[k];
+        }
+    }
+    sl->loss = loss;
+    memcpy(sl->gradient, gradient, sizeof(gradient));
+}
+
+/**
+ * Computes the mean logistic loss of all the samples and its gradient, one slice per worker
+ * @param p the pool
+ * @param slices the slices, one per worker, covering the samples
+ * @param count the number of slices
+ * @param total the number of samples
+ * @param weights the weights
+ * @param scale the sigmoid scale
+ * @param gradient the mean gradient
+ * @return the mean loss
+*/
+static double meanLoss(pool* p, slice* slices, int count, size_t total, const double weights[2][SHAPE_COUNT],
+                       double scale, double gradient[2][SHAPE_COUNT]) {
+    for (int i = 0; i < count; i++) {
+        slices[i].weights = weights;
+        slices[i].scale = scale;
+        pool_submit(p, i, lossSlice, &slices[i]);
+    }
+    pool_wait(p);
+    double loss = 0;
+    memset(gradient, 0, 2 * SHAPE_COUNT * sizeof(double));
+    for (int i = 0; i < count; i++) {
+        loss += slices[i].loss;
+        for (int k = 0; k < SHAPE_COUNT; k++) {
+            gradient[0][k] += slices[i].gradient[0][k] / total;
+            gradient[1][k] += slices[i].gradient[1][k] / total;
+        }
+    }
+    return loss / total;
+}
+
+/**
+ * Finds the sigmoid scale with the smallest loss for fixed weights by a golden-section search over its logarithm
+ * @param p the pool
+ * @param slices the slices
+ * @param count the number of slices
+ * @param total the number of samples
+ * @param weights the weights
+ * @return the scale
+*/
+static double fitScale(pool* p, slice* slices, int count, size_t total, const double weights[2][SHAPE_COUNT]) {
+    const double ratio = (sqrt(5.0) - 1) / 2;
+    double gradient[2][SHAPE_COUNT];
+    double lo = SCALE_MIN;
+    double hi = SCALE_MAX;
+    double a = hi - ratio * (hi - lo);
+    double b = lo + ratio * (hi - lo);
+    double lossA = meanLoss(p, slices, count, total, weights, pow(10, a), gradient);
+    double lossB = meanLoss(p, slices, count, total, weights, pow(10, b), gradient);
+    for (int i = 0; i < SCALE_STEPS; i++) {
+        if (lossA < lossB) {
+            hi = b;
+            b = a;
+            lossB = lossA;
+            a = hi - ratio * (hi - lo);
+            lossA = meanLoss(p, slices, count, total, weights, pow(10, a), gradient);
+        } else {
+            lo = a;
+            a = b;
+            lossA = lossB;
+            b = lo + ratio * (hi - lo);
+            lossB = meanLoss(p, slices, count, total, weights, pow(10, b), gradient);
+        }
+    }
+    return pow(10, (lo + hi) / 2);
+}
+
+/**
+ * Writes the weights as a header the evaluator compiles against
+ * @param path the path of the header
+ * @param weights the weights, rounded
+ * @param samples the number of samples they were fitted to
+ * @param games the number of games of the samples
+ * @param loss the loss of the rounded weights
+*/
+static void writeHeader(const char* path, const long weights[2][SHAPE_COUNT], size_t samples, uint64_t games,
+                        double loss) {
+    FILE* fp = fopen(path, "w");
+    if (!fp) {
+        exit(FILE_OUTPUT_ERR);
+    }
+    fprintf(fp, "/**\n"
+                " * @file weights.h\n"
+                " * Shape weights of the evaluator, in the order of the SHAPE_ constants of eval.h.\n"
+                " * Generated by ./tune from %zu positions of %llu games, logistic loss %.6f; rerun it to refit them.\n"
+                "*/\n"
+                "#ifndef _WEIGHTS_H_\n"
+                "#define _WEIGHTS_H_\n", samples, (unsigned long long) games, loss);
+    const char* names[2] = {"OWN", "OPPONENT"};
+    const char* comments[2] = {"shape weights of the side to move", "shape weights of the side waiting for its turn"};
+    for (int side = 0; side < 2; side++) {
+        fprintf(fp, "/** %s */\n#define WEIGHTS_%s {", comments[side], names[side]);
+        for (int k = 0; k < SHAPE_COUNT; k++) {
+            fprintf(fp, "%s%ld", k > 0 ? ", " : "", weights[side][k]);
+        }
+        fprintf(fp, "}\n");
+    }
+    fprintf(fp, "#endif\n");
+    fclose(fp);
+}
+
+/**
+ * This is the main function of the weight tuner
+ * @param argc the number of command line args
+ * @param argv an array of command-line argument strings
+*/
+int main(int argc, char *argv[]) {
+    int opt;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    long iterations = DEFAULT_ITERATIONS;
+    long skip = DEFAULT_SKIP;
+    double rate = DEFAULT_RATE;
+    const char* output = NULL;
+    while ((opt = getopt(argc, argv, "o:j:i:r:s:")) != -1) {
+        switch (opt) {
+            case 'o': output = optarg; break;
+            case 'j': threads = atol(optarg); break;
+            case 'i': iterations = atol(optarg); break;
+            case 'r': rate = atof(optarg); break;
+            case 's': skip = atol(optarg); break;
+            default: usage();
+        }
+    }
+    if (optind != argc - 1 || !output || threads < 1 || iterations < 0 || rate <= 0 || skip < 0) {
+        usage();
+    }
+    size_t count = 0;
+    char** paths = game_list_dir(argv[optind], &count);
+    corpus c;
+    c.skip = (size_t) skip;
+    c.shards = (shard *) calloc(threads, sizeof(shard));
+    job* jobs = (job *) malloc((count + 1) * sizeof(job));
+    pool* p = pool_create(threads);
+    if (!c.shards || !jobs || !p) {
+        exit(NULL_POINTER_ERR);
+    }
+    double start = search_clock();
+    for (size_t i = 0; i < count; i++) {
+        jobs[i].c = &c;
+        jobs[i].path = paths[i];
+        pool_submit(p, i, extractGame, &jobs[i]);
+    }
+    pool_wait(p);
+
+    // each shard is trimmed and kept as the slice of its worker, so the samples are never copied
+    size_t total = 0;
+    uint64_t games = 0;
+    uint64_t unfinished = 0;
+    uint64_t large = 0;
+    slice* slices = (slice *) calloc(threads, sizeof(slice));
+    if (!slices) {
+        exit(NULL_POINTER_ERR);
+    }
+    for (long i = 0; i < threads; i++) {
+        shard* s = &c.shards[i];
+        if (s->count > 0) {
+            s->samples = (sample *) realloc(s->samples, s->count * sizeof(sample));
+        }
+        slices[i].samples = s->samples;
+        slices[i].count = s->count;
+        total += s->count;
+        games += s->games;
+        unfinished += s->unfinished;
+        large += s->large;
+    }
+    if (total == 0) {
+        printf("no positions to tune on in %zu games (%llu unfinished, %llu on large boards)\n", count,
+               (unsigned long long) unfinished, (unsigned long long) large);
+        exit(INPUT_ERR);
+    }
+    printf("%zu positions from %llu games (%llu unfinished and %llu on large boards skipped), %.1f MB of features, "
+           "extracted in %.2f s\n", total, (unsigned long long) games, (unsigned long long) unfinished,
+           (unsigned long long) large,
+           total * sizeof(sample) / 1048576.0, search_clock() - start);
+
+    const int initial[2][SHAPE_COUNT] = {WEIGHTS_OWN, WEIGHTS_OPPONENT};
+    double weights[2][SHAPE_COUNT];
+    double logs[2][SHAPE_COUNT];
+    double moment[2][SHAPE_COUNT];
+    double velocity[2][SHAPE_COUNT];
+    double gradient[2][SHAPE_COUNT];
+    for (int side = 0; side < 2; side++) {
+        for (int k = 0; k < SHAPE_COUNT; k++) {
+            weights[side][k] = initial[side][k];
+            logs[side][k] = log(initial[side][k]);
+            moment[side][k] = 0;
+            velocity[side][k] = 0;
+        }
+    }
+    start = search_clock();
+    double scale = fitScale(p, slices, threads, total, weights);
+    double loss = meanLoss(p, slices, threads, total, weights, scale, gradient);
+    printf("scale %.3g, loss %.6f with the current weights\n", scale, loss);
+    // the weights are fitted as logarithms, so they stay positive and move in proportion to their size;
+    // a five ends the game, so its weight is left alone and no other weight grows past it
+    for (long it = 1; it <= iterations; it++) {
+        loss = meanLoss(p, slices, threads, total, weights, scale, gradient);
+        for (int side = 0; side < 2; side++) {
+            for (int k = SHAPE_FIVE + 1; k < SHAPE_COUNT; k++) {
+                double g = gradient[side][k] * weights[side][k];
+                moment[side][k] = BETA1 * moment[side][k] + (1 - BETA1) * g;
+                velocity[side][k] = BETA2 * velocity[side][k] + (1 - BETA2) * g * g;
+                double m = moment[side][k] / (1 - pow(BETA1, it));
+                double v = velocity[side][k] / (1 - pow(BETA2, it));
+                logs[side][k] -= rate * m / (sqrt(v) + EPSILON);
+                logs[side][k] = fmin(logs[side][k], log(initial[side][SHAPE_FIVE]));
+                weights[side][k] = exp(logs[side][k]);
+            }
+        }
+        if (it % REPORT_INTERVAL == 0) {
+            printf("iteration %ld, loss %.6f\n", it, loss);
+        }
+    }
+    long rounded[2][SHAPE_COUNT];
+    for (int side = 0; side < 2; side++) {
+        for (int k = 0; k < SHAPE_COUNT; k++) {
+            rounded[side][k] = lround(weights[side][k]) > 1 ? lround(weights[side][k]) : 1;
+            weights[side][k] = rounded[side][k];
+        }
+    }
+    loss = meanLoss(p, slices, threads, total, weights, scale, gradient);
+    double seconds = search_clock() - start;
+    printf("loss %.6f after %ld iterations in %.2f s with %ld threads (%.0f sample evaluations/s)\n", loss,
+           iterations, seconds, threads, seconds > 0 ? total * (iterations + SCALE_STEPS + 4) / seconds : 0.0);
+    for (int side = 0; side < 2; side++) {
+        printf("%-8s", side == 0 ? "own" : "opponent");
+        for (int k = 0; k < SHAPE_COUNT; k++) {
+            printf(" %7ld", rounded[side][k]);
+        }
+        printf("\n");
+    }
+    writeHeader(output, rounded, total, games, loss);
+    printf("wrote %s, rebuild to use it\n", output);
+    pool_delete(p);
+    for (size_t i = 0; i < count; i++) {
+        free(paths[i]);
+    }
+    free(paths);
+    free(jobs);
+    for (long i = 0; i < threads; i++) {
+        free(c.shards[i].samples);
+    }
+    free(slices);
+    free(c.shards);
+    return 0;
+}
@@ -0,0 +1,12 @@
+/**
+ * @file weights.h
+ * Shape weights of the evaluator, in the order of the SHAPE_ constants of eval.h.
+ * These are the hand-set weights; ./tune -o weights.h <directory> replaces this file with weights fitted to a corpus.
+*/
+#ifndef _WEIGHTS_H_
+#define _WEIGHTS_H_
+/** shape weights of the side to move */
+#define WEIGHTS_OWN {100000, 50000, 20000, 3000, 500, 200, 20}
+/** shape weights of the side waiting for its turn */
+#define WEIGHTS_OPPONENT {100000, 20000, 1000, 1000, 200, 100, 10}
+#endif